@@ -0,0 +1,205 @@
+/******************************************************************************\
+Copyright (c) 2005-2016, Intel Corporation
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without modification, are permitted provided that the following conditions are met:
+
+1. Redistributions of source code must retain the above copyright notice, this list of conditions and the following disclaimer.
+
+2. Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the following disclaimer in the documentation and/or other materials provided with the distribution.
+
+3. Neither the name of the copyright holder nor the names of its contributors may be used to endorse or promote products derived from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+This sample was distributed or derived from the Intel's Media Samples package.
+The original version of this sample may be obtained from https://software.intel.com/en-us/intel-media-server-studio
+or https://software.intel.com/en-us/media-client-solutions-support.
+\**********************************************************************************/
+
+#include "mfx_samples_config.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <vector>
+
+#include "chroma_conversion.h"
+#include "sample_defs.h"
+#include "vm/time_defs.h"
+
+/*
+ * Compares the SIMD chroma row kernels with the scalar ones and measures their throughput.
+ * "-check" runs the comparison only and is used as a test.
+ */
+
+namespace
+{
+    // widths up to this one cover several vectors of every kernel with all lengths of tails
+    const mfxU32 CHECK_MAX_WIDTH = 200;
+    const mfxU32 CHECK_HEIGHT    = 3;
+    // pitches are the width plus these numbers of samples, so most of them are odd
+    const mfxU32 CHECK_PADS[]    = { 0, 1, 3, 17 };
+    // value of the samples which kernels must not touch and their number after the last row
+    const mfxU8  GUARD           = 0xa5;
+    const mfxU32 GUARD_SIZE      = 64;
+
+    // size of the chroma planes of a 1080p frame
+    const mfxU32 BENCH_WIDTH     = 960;
+    const mfxU32 BENCH_HEIGHT    = 540;
+    const mfxF64 BENCH_TIME      = 0.5; // seconds per kernel
+
+    template<class T>
+    void FillRandom(std::vector<T>& buf, mfxU32 nSeed)
+    {
+        for (size_t i = 0; i < buf.size(); i++)
+        {
+            nSeed = nSeed * 1103515245 + 12345;
+            buf[i] = (T)(nSeed >> 8);
+        }
+    }
+
+    // runs the kernels on planes with the given width and pitches and compares whole buffers with the scalar results,
+    // so writes out of the rows are caught too; planes start at an odd sample to make the accesses unaligned
+    template<class T>
+    bool CheckPlanes(void (*Interleave)(const T*, const T*, T*, mfxU32),
+                     void (*InterleaveRef)(const T*, const T*, T*, mfxU32),
+                     void (*Deinterleave)(const T*, T*, T*, mfxU32),
+                     void (*DeinterleaveRef)(const T*, T*, T*, mfxU32),
+                     mfxU32 nWidth, mfxU32 nPitch, mfxU32 nPitchUV)
+    {
+        const size_t nSize   = 1 + CHECK_HEIGHT * nPitch + GUARD_SIZE;
+        const size_t nSizeUV = 1 + CHECK_HEIGHT * nPitchUV + GUARD_SIZE;
+        std::vector<T> u(nSize), v(nSize), uv(nSizeUV);
+        std::vector<T> dst(nSizeUV, (T)GUARD), ref(nSizeUV, (T)GUARD);
+        std::vector<T> dstU(nSize, (T)GUARD), dstV(nSize, (T)GUARD), refU(nSize, (T)GUARD), refV(nSize, (T)GUARD);
+
+        FillRandom(u, nWidth * 3 + 1);
+        FillRandom(v, nPitch * 5 + 2);
+        FillRandom(uv, nPitchUV * 7 + 3);
+
+        for (mfxU32 i = 0; i < CHECK_HEIGHT; i++)
+        {
+            Interleave(&u[1 + i * nPitch], &v[1 + i * nPitch], &dst[1 + i * nPitchUV], nWidth);
+            InterleaveRef(&u[1 + i * nPitch], &v[1 + i * nPitch], &ref[1 + i * nPitchUV], nWidth);
+
+            Deinterleave(&uv[1 + i * nPitchUV], &dstU[1 + i * nPitch], &dstV[1 + i * nPitch], nWidth);
+            DeinterleaveRef(&uv[1 + i * nPitchUV], &refU[1 + i * nPitch], &refV[1 + i * nPitch], nWidth);
+        }
+
+        return dst == ref && dstU == refU && dstV == refV;
+    }
+
+    template<class T>
+    bool CheckKernels(const char* szName,
+                      void (*Interleave)(const T*, const T*, T*, mfxU32),
+                      void (*InterleaveRef)(const T*, const T*, T*, mfxU32),
+                      void (*Deinterleave)(const T*, T*, T*, mfxU32),
+                      void (*DeinterleaveRef)(const T*, T*, T*, mfxU32))
+    {
+        for (mfxU32 nWidth = 0; nWidth <= CHECK_MAX_WIDTH; nWidth++)
+        {
+            for (mfxU32 i = 0; i < MSDK_ARRAY_LEN(CHECK_PADS); i++)
+            {
+                mfxU32 nPitch   = nWidth + CHECK_PADS[i];
+                mfxU32 nPitchUV = 2 * nWidth + CHECK_PADS[i];
+                if (!CheckPlanes(Interleave, InterleaveRef, Deinterleave, DeinterleaveRef, nWidth, nPitch, nPitchUV))
+                {
+                    printf("FAILED: %s, width %u, pitches %u and %u samples\n", szName, nWidth, nPitch, nPitchUV);
+                    return false;
+                }
+            }
+        }
+        return true;
+    }
+
+    // returns throughput in GB/s of the interleaved plane
+    template<class T>
+    mfxF64 MeasureInterleave(void (*Interleave)(const T*, const T*, T*, mfxU32))
+    {
+        std::vector<T> u(BENCH_WIDTH * BENCH_HEIGHT), v(BENCH_WIDTH * BENCH_HEIGHT), uv(2 * BENCH_WIDTH * BENCH_HEIGHT);
+        FillRandom(u, 1);
+        FillRandom(v, 2);
+
+        const msdk_tick nFreq  = msdk_time_get_frequency();
+        const msdk_tick nStart = msdk_time_get_tick();
+        mfxU64 nFrames = 0;
+        mfxF64 fTime = 0;
+        do
+        {
+            for (mfxU32 i = 0; i < BENCH_HEIGHT; i++)
+            {
+                Interleave(&u[i * BENCH_WIDTH], &v[i * BENCH_WIDTH], &uv[2 * i * BENCH_WIDTH], BENCH_WIDTH);
+            }
+            nFrames++;
+            fTime = MSDK_GET_TIME(msdk_time_get_tick(), nStart, nFreq);
+        } while (fTime < BENCH_TIME);
+
+        return (mfxF64)nFrames * uv.size() * sizeof(T) / fTime / 1e9;
+    }
+
+    template<class T>
+    mfxF64 MeasureDeinterleave(void (*Deinterleave)(const T*, T*, T*, mfxU32))
+    {
+        std::vector<T> u(BENCH_WIDTH * BENCH_HEIGHT), v(BENCH_WIDTH * BENCH_HEIGHT), uv(2 * BENCH_WIDTH * BENCH_HEIGHT);
+        FillRandom(uv, 3);
+
+        const msdk_tick nFreq  = msdk_time_get_frequency();
+        const msdk_tick nStart = msdk_time_get_tick();
+        mfxU64 nFrames = 0;
+        mfxF64 fTime = 0;
+        do
+        {
+            for (mfxU32 i = 0; i < BENCH_HEIGHT; i++)
+            {
+                Deinterleave(&uv[2 * i * BENCH_WIDTH], &u[i * BENCH_WIDTH], &v[i * BENCH_WIDTH], BENCH_WIDTH);
+            }
+            nFrames++;
+            fTime = MSDK_GET_TIME(msdk_time_get_tick(), nStart, nFreq);
+        } while (fTime < BENCH_TIME);
+
+        return (mfxF64)nFrames * uv.size() * sizeof(T) / fTime / 1e9;
+    }
+}
+
+int main(int argc, char *argv[])
+{
+    const char* isas[] = { "C", "SSE2", "AVX2" };
+    bool bCheckOnly = (argc > 1 && !strcmp(argv[1], "-check"));
+    const ChromaKernels* ref = GetChromaKernels("C");
+    bool bOk = true;
+
+    printf("kernels used by the conversions: %s\n", GetChromaConversionIsa());
+
+    for (mfxU32 i = 1; i < MSDK_ARRAY_LEN(isas); i++)
+    {
+        const ChromaKernels* k = GetChromaKernels(isas[i]);
+        if (!k)
+        {
+            printf("%s: not supported by the CPU, skipped\n", isas[i]);
+            continue;
+        }
+
+        bool bKernelsOk = CheckKernels<mfxU8>("8-bit", k->Interleave, ref->Interleave, k->Deinterleave, ref->Deinterleave) &&
+                          CheckKernels<mfxU16>("16-bit", k->Interleave16, ref->Interleave16, k->Deinterleave16, ref->Deinterleave16);
+        printf("%s: %s\n", k->szIsa, bKernelsOk ? "matches scalar code" : "DIFFERS from scalar code");
+        bOk = bOk && bKernelsOk;
+    }
+
+    if (!bCheckOnly)
+    {
+        printf("\nthroughput on %ux%u chroma planes, GB/s of the interleaved plane:\n", BENCH_WIDTH, BENCH_HEIGHT);
+        printf("%-6s %12s %14s %12s %14s\n", "", "interleave", "deinterleave", "interleave16", "deinterleave16");
+        for (mfxU32 i = 0; i < MSDK_ARRAY_LEN(isas); i++)
+        {
+            const ChromaKernels* k = GetChromaKernels(isas[i]);
+            if (!k)
+                continue;
+
+            printf("%-6s %12.2f %14.2f %12.2f %14.2f\n", k->szIsa,
+                MeasureInterleave<mfxU8>(k->Interleave), MeasureDeinterleave<mfxU8>(k->Deinterleave),
+                MeasureInterleave<mfxU16>(k->Interleave16), MeasureDeinterleave<mfxU16>(k->Deinterleave16));
+        }
+    }
+
+    return bOk ? 0 : 1;
+}
@@ -0,0 +1,198 @@
+/******************************************************************************\
+Copyright (c) 2005-2016, Intel Corporation
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without modification, are permitted provided that the following conditions are met:
+
+1. Redistributions of source code must retain the above copyright notice, this list of conditions and the following disclaimer.
+
+2. Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the following disclaimer in the documentation and/or other materials provided with the distribution.
+
+3. Neither the name of the copyright holder nor the names of its contributors may be used to endorse or promote products derived from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+This sample was distributed or derived from the Intel's Media Samples package.
+The original version of this sample may be obtained from https://software.intel.com/en-us/intel-media-server-studio
+or https://software.intel.com/en-us/media-client-solutions-support.
+\**********************************************************************************/
+
+#include "mfx_samples_config.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <vector>
+
+#include "mfx_buffering.h"
+#include "sample_defs.h"
+
+/*
+ * Measures surface pools of CBuffering with the mutex and in the lock-free mode:
+ *  - free surfaces pool: 1 to 32 threads take a free surface and return it;
+ *  - output surfaces pool: one producer and one consumer pass surfaces through it, as the decoding
+ *    loop and the delivery thread do.
+ * "-n <count>" sets the number of operations per thread.
+ */
+
+namespace
+{
+    const mfxU32 DEFAULT_OPS  = 200000;
+    const mfxU32 SURFACES     = 64;
+    // output surfaces in flight
+    const mfxU32 OUTPUT_DEPTH = 16;
+    const mfxU32 THREADS[]    = { 1, 2, 4, 8, 16, 32 };
+
+    class CPoolsBench : public CBuffering
+    {
+    public:
+        CPoolsBench(bool bLockFree, mfxU32 nOps)
+            : m_nOps(nOps)
+            , m_bStart(0)
+        {
+            m_sts = AllocBuffers(SURFACES, bLockFree);
+        }
+
+        // returns ns per operation, operations of all threads are counted
+        mfxF64 RunFreePool(mfxU32 nThreads)
+        {
+            return Run(FreePoolThread, nThreads) * 1e9 / (2.0 * m_nOps * nThreads);
+        }
+
+        // returns ns per surface passed from the producer to the consumer
+        mfxF64 RunOutputPool()
+        {
+            return Run(ProducerThread, 1, true) * 1e9 / m_nOps;
+        }
+
+        mfxStatus GetStatus() const { return m_sts; }
+
+    protected:
+        mfxF64 Run(msdk_thread_callback func, mfxU32 nThreads, bool bConsume = false)
+        {
+            std::vector<MSDKThread*> threads;
+            mfxStatus sts = MFX_ERR_NONE;
+
+            m_bStart = 0;
+            for (mfxU32 i = 0; i < nThreads; i++)
+            {
+                threads.push_back(new MSDKThread(sts, func, this));
+            }
+
+            const msdk_tick nStart = msdk_time_get_tick();
+            m_bStart = 1;
+
+            // the main thread is the consumer of the output pool
+            for (mfxU32 i = 0; bConsume && i < m_nOps; )
+            {
+                msdkOutputSurface* surface = m_OutputSurfacesPool.GetSurface();
+                if (!surface)
+                {
+                    MSDK_YIELD();
+                    continue;
+                }
+                AddFreeOutputSurface(surface);
+                i++;
+            }
+
+            for (size_t i = 0; i < threads.size(); i++)
+            {
+                threads[i]->Wait();
+                delete threads[i];
+            }
+            return MSDK_GET_TIME(msdk_time_get_tick(), nStart, msdk_time_get_frequency());
+        }
+
+        void WaitForStart()
+        {
+            while (!m_bStart)
+                MSDK_YIELD();
+        }
+
+        static mfxU32 MFX_STDCALL FreePoolThread(void* arg)
+        {
+            CPoolsBench* pBench = (CPoolsBench*)arg;
+            pBench->WaitForStart();
+
+            for (mfxU32 i = 0; i < pBench->m_nOps; i++)
+            {
+                msdkFrameSurface* surface = pBench->m_FreeSurfacesPool.GetSurface();
+                if (surface)
+                {
+                    pBench->m_FreeSurfacesPool.AddSurface(surface);
+                }
+            }
+            return 0;
+        }
+
+        static mfxU32 MFX_STDCALL ProducerThread(void* arg)
+        {
+            CPoolsBench* pBench = (CPoolsBench*)arg;
+            pBench->WaitForStart();
+
+            for (mfxU32 i = 0; i < pBench->m_nOps; )
+            {
+                msdkOutputSurface* surface = NULL;
+                if (pBench->m_OutputSurfacesPool.GetSurfaceCount() < OUTPUT_DEPTH)
+                {
+                    surface = pBench->GetFreeOutputSurface();
+                }
+                if (!surface)
+                {
+                    MSDK_YIELD();
+                    continue;
+                }
+                pBench->m_OutputSurfacesPool.AddSurface(surface);
+                i++;
+            }
+            return 0;
+        }
+
+        mfxU32          m_nOps;
+        volatile mfxU32 m_bStart;
+        mfxStatus       m_sts;
+    };
+}
+
+int main(int argc, char *argv[])
+{
+    mfxU32 nOps = DEFAULT_OPS;
+    if (argc > 2 && !strcmp(argv[1], "-n"))
+    {
+        nOps = (mfxU32)atoi(argv[2]);
+    }
+    if (!nOps)
+    {
+        printf("usage: %s [-n <operations per thread>]\n", argv[0]);
+        return 1;
+    }
+
+    // unbuffered output shows the progress, the runs with many threads may be long on few cores
+    setvbuf(stdout, NULL, _IONBF, 0);
+
+    printf("free surfaces pool, ns per operation (%u x 2 operations per thread)\n", nOps);
+    printf("%7s %8s %10s\n", "threads", "mutex", "lock-free");
+    for (mfxU32 i = 0; i < MSDK_ARRAY_LEN(THREADS); i++)
+    {
+        CPoolsBench mutexPools(false, nOps), lockFreePools(true, nOps);
+        if (mutexPools.GetStatus() != MFX_ERR_NONE || lockFreePools.GetStatus() != MFX_ERR_NONE)
+        {
+            printf("failed to allocate surfaces\n");
+            return 1;
+        }
+        mfxF64 fMutex = mutexPools.RunFreePool(THREADS[i]);
+        printf("%7u %8.1f %10.1f\n", THREADS[i], fMutex, lockFreePools.RunFreePool(THREADS[i]));
+    }
+
+    CPoolsBench mutexPools(false, nOps), lockFreePools(true, nOps);
+    if (mutexPools.GetStatus() != MFX_ERR_NONE || lockFreePools.GetStatus() != MFX_ERR_NONE)
+    {
+        printf("failed to allocate surfaces\n");
+        return 1;
+    }
+    mfxF64 fMutex = mutexPools.RunOutputPool();
+    printf("\noutput surfaces pool, 1 producer and 1 consumer, %u surfaces in flight, ns per surface\n", OUTPUT_DEPTH);
+    printf("%8s %10s\n%8.1f %10.1f\n", "mutex", "lock-free", fMutex, lockFreePools.RunOutputPool());
+
+    return 0;
+}
@@ -67,6 +67,12 @@ public:
     virtual mfxStatus PostProcessing(FrameSplitterInfo *frame, mfxU32 sliceNum) = 0;
 
     virtual void ResetCurrentState() = 0;
+
+    // A splitter may refer to the data passed to GetFrame() instead of copying it, so the
+    // returned frame and the pending NAL units are valid only while that data is unchanged.
+    // The caller has to call DetachInput() before it moves or overwrites the input data.
+    virtual void DetachInput()
+    {}
 };
 
 #endif // _ABSTRACT_SPL_H__
@@ -44,6 +44,9 @@ public:
 
     void SetSuggestedSize(mfxU32 size);
 
+    // H.265 NAL unit type may be 0, so in this mode returned codes are H.265 NAL unit types plus 1
+    void SetHEVC(bool bHEVC) { m_bHEVC = bHEVC; }
+
     mfxI32 CheckNalUnitType(mfxBitstream * source);
 
     mfxI32 GetNALUnit(mfxBitstream * source, mfxBitstream * destination);
@@ -63,6 +66,8 @@ private:
 
     mfxU32  m_suggestedSize;
 
+    bool    m_bHEVC;
+
     mfxI32 FindStartCode(mfxU8 * (&pb), mfxU32 & size, mfxI32 & startCodeSize);
 };
 
@@ -87,6 +92,11 @@ public:
         m_pStartCodeIter.SetSuggestedSize(size);
     }
 
+    virtual void SetHEVC(bool bHEVC)
+    {
+        m_pStartCodeIter.SetHEVC(bHEVC);
+    }
+
 protected:
 
     StartCodeIterator m_pStartCodeIter;
@@ -94,6 +104,9 @@ protected:
     mfxBitstream m_bitstream;
 };
 
+// converts NAL unit to RBSP, may be done in place
+void RemovePreventingBytes(mfxU8 *pDestination, mfxU32 &nDstSize, mfxU8 *pSource, mfxU32 nSrcSize);
+// the same and swaps bytes in dwords for AVCBaseBitstream, pDestination should have 3 more bytes for padding
 void SwapMemoryAndRemovePreventingBytes(mfxU8 *pDestination, mfxU32 &nDstSize, mfxU8 *pSource, mfxU32 nSrcSize);
 
 } //namespace ProtectedLibrary
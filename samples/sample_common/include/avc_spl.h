@@ -58,6 +58,9 @@ public:
 
     mfxU64 m_dTime;
 
+    // memory_management_control_operation 5 resets frame numbering and picture order count
+    bool m_bHasMMCO5;
+
 protected:
     AVCSliceHeader m_sliceHeader;
     AVCHeadersBitstream m_bitStream;
@@ -93,6 +96,8 @@ public:
 
     void ResetCurrentState();
 
+    virtual void DetachInput();
+
 protected:
     std::auto_ptr<NALUnitSplitter> m_pNALSplitter;
 
@@ -100,7 +105,7 @@ protected:
 
     void Close();
 
-    mfxStatus ProcessNalUnit(mfxI32 nalType, mfxBitstream * destination);
+    virtual mfxStatus ProcessNalUnit(mfxI32 nalType, mfxBitstream * destination);
 
     mfxStatus DecodeHeader(mfxBitstream * nalUnit);
     mfxStatus DecodeSEI(mfxBitstream * nalUnit);
@@ -113,6 +118,11 @@ protected:
 
     mfxStatus AddNalUnit(mfxBitstream * nalUnit);
     mfxStatus AddSliceNalUnit(mfxBitstream * nalUnit, AVCSlice * pSlice);
+    // appends NAL unit with start code to the frame, offset receives position of the start code
+    mfxStatus AppendNalUnit(mfxBitstream * nalUnit, mfxU32 & offset);
+    // copies the frame referring to the input data into m_currentFrame
+    void MaterializeFrame();
+    bool IsInInput(mfxBitstream * nalUnit) const;
     bool IsFieldOfOneFrame(AVCFrameInfo * frame, const AVCSliceHeader * slice1, const AVCSliceHeader *slice2);
 
     bool                m_WaitForIDR;
@@ -124,9 +134,19 @@ protected:
 
     mfxBitstream * m_lastNalUnit;
 
+    // input data which frames may refer to until DetachInput() is called
+    mfxU8 * m_pInputBegin;
+    mfxU8 * m_pInputEnd;
+
+    // pending NAL unit copied out of the input by DetachInput()
+    mfxBitstream m_lastNalCopy;
+    std::vector<mfxU8> m_lastNalData;
+
     enum
     {
-        BUFFER_SIZE = 1024 * 1024
+        BUFFER_SIZE = 1024 * 1024,
+        // upper bound of slice header size with all optional tables
+        SLICE_HEADER_MAX_SIZE = 16 * 1024
     };
 
     std::vector<mfxU8>  m_currentFrame;
@@ -0,0 +1,124 @@
+/******************************************************************************\
+Copyright (c) 2005-2016, Intel Corporation
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without modification, are permitted provided that the following conditions are met:
+
+1. Redistributions of source code must retain the above copyright notice, this list of conditions and the following disclaimer.
+
+2. Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the following disclaimer in the documentation and/or other materials provided with the distribution.
+
+3. Neither the name of the copyright holder nor the names of its contributors may be used to endorse or promote products derived from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+This sample was distributed or derived from the Intel's Media Samples package.
+The original version of this sample may be obtained from https://software.intel.com/en-us/intel-media-server-studio
+or https://software.intel.com/en-us/media-client-solutions-support.
+\**********************************************************************************/
+
+#ifndef __BITSTREAM_INDEX_H__
+#define __BITSTREAM_INDEX_H__
+
+#include <vector>
+
+#include "sample_utils.h"
+
+/*
+ * Index of access units of an elementary stream. It is kept in a binary sidecar file next to
+ * the stream (<stream>.idx), so the stream is parsed only once: readers open it at any frame,
+ * read each frame with one request and know the stream duration without reading the stream.
+ * Supported streams are H.264 elementary streams, VP8 in IVF and concatenated JPEG pictures.
+ */
+
+enum
+{
+    AU_FLAG_KEY_FRAME  = 0x0001, // decoding can start from the access unit
+    AU_FLAG_PARAM_SETS = 0x0002  // the access unit carries H.264 sequence or picture parameter sets
+};
+
+struct AccessUnitInfo
+{
+    mfxU64 Offset;      // position of the access unit in the stream
+    mfxU32 Size;        // size of the access unit in bytes
+    mfxU16 FrameType;   // MFX_FRAMETYPE_I/P/B combined with MFX_FRAMETYPE_IDR and MFX_FRAMETYPE_REF
+    mfxU16 Flags;       // AU_FLAG_*
+    mfxI64 Timestamp;   // picture order count for H.264, presentation timestamp for IVF, picture number for JPEG
+};
+
+class CBitstreamIndex
+{
+public:
+    CBitstreamIndex();
+
+    // Loads the sidecar of the stream. If it is missing or does not match the stream and bCreate is set,
+    // indexes the stream and writes the sidecar. nCodecId may be 0 to accept an index of any codec.
+    mfxStatus Open(const msdk_char *strFileName, mfxU32 nCodecId, bool bCreate);
+
+    mfxStatus Build(const msdk_char *strFileName, mfxU32 nCodecId);
+    // the sidecar is accepted only if it was built for a stream of this size and head and tail checksum
+    mfxStatus Load(const msdk_char *strIndexName, mfxU64 nStreamSize, mfxU64 nStreamChecksum);
+    mfxStatus Save(const msdk_char *strIndexName) const;
+
+    static msdk_tstring GetIndexName(const msdk_char *strFileName);
+    static bool IsCodecSupported(mfxU32 nCodecId);
+
+    mfxU32 GetCodecId() const { return m_nCodecId; }
+    mfxU32 GetCount() const { return (mfxU32)m_units.size(); }
+    const AccessUnitInfo& GetUnit(mfxU32 nFrame) const { return m_units[nFrame]; }
+
+    // returns number of the last key frame at or before nFrame, GetCount() if there is none
+    mfxU32 FindKeyFrame(mfxU32 nFrame) const;
+    // returns number of the first key frame after nFrame, GetCount() if there is none
+    mfxU32 FindNextKeyFrame(mfxU32 nFrame) const;
+
+    // frame rate is 0/0 if the stream does not signal it
+    mfxU32 GetFrameRateExtN() const { return m_nFrameRateExtN; }
+    mfxU32 GetFrameRateExtD() const { return m_nFrameRateExtD; }
+    // duration in seconds, 0 if frame rate is unknown
+    mfxF64 GetDuration() const;
+
+protected:
+    void Clear();
+
+    mfxU32 m_nCodecId;
+    mfxU64 m_nStreamSize;
+    mfxU64 m_nStreamChecksum;
+    mfxU32 m_nFrameRateExtN;
+    mfxU32 m_nFrameRateExtD;
+    std::vector<AccessUnitInfo> m_units;
+};
+
+// Reads exactly one access unit of the indexed stream per ReadNextFrame() call.
+class CIndexedFrameReader : public CSmplBitstreamReader
+{
+public:
+    CIndexedFrameReader();
+
+    // opens the stream only if it has a valid sidecar
+    virtual mfxStatus Init(const msdk_char *strFileName);
+    mfxStatus Init(const msdk_char *strFileName, mfxU32 nCodecId, bool bCreateIndex);
+    virtual void      Reset();
+    virtual mfxStatus ReadNextFrame(mfxBitstream *pBS);
+
+    // Limits reading to frames [nFirst, nFirst + nCount) and rewinds to nFirst.
+    // Decoding has to start from a key frame. If parameter sets of an H.264 stream are not repeated there,
+    // the ones sent earlier in the stream are prepended to the first frame of the range.
+    mfxStatus SetRange(mfxU32 nFirst, mfxU32 nCount);
+    // rewinds to the key frame at or before nFrame, its number is returned through pKeyFrame
+    mfxStatus SeekFrame(mfxU32 nFrame, mfxU32 *pKeyFrame);
+
+    const CBitstreamIndex& GetIndex() const { return m_index; }
+
+protected:
+    // collects SPS and PPS NAL units sent before frame nFirst into m_paramSets
+    mfxStatus CollectParamSets(mfxU32 nFirst);
+
+    CBitstreamIndex m_index;
+    std::vector<mfxU8> m_paramSets;  // prepended to the first frame of the range
+    mfxU32 m_nFirst;
+    mfxU32 m_nEnd;
+    mfxU32 m_nNext;
+};
+
+#endif // __BITSTREAM_INDEX_H__
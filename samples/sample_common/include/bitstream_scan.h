@@ -0,0 +1,43 @@
+/******************************************************************************\
+Copyright (c) 2005-2016, Intel Corporation
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without modification, are permitted provided that the following conditions are met:
+
+1. Redistributions of source code must retain the above copyright notice, this list of conditions and the following disclaimer.
+
+2. Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the following disclaimer in the documentation and/or other materials provided with the distribution.
+
+3. Neither the name of the copyright holder nor the names of its contributors may be used to endorse or promote products derived from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+This sample was distributed or derived from the Intel's Media Samples package.
+The original version of this sample may be obtained from https://software.intel.com/en-us/intel-media-server-studio
+or https://software.intel.com/en-us/media-client-solutions-support.
+\**********************************************************************************/
+
+#ifndef __BITSTREAM_SCAN_H__
+#define __BITSTREAM_SCAN_H__
+
+#include "mfxdefs.h"
+
+/*
+ * Search for start codes, emulation prevention bytes and JPEG markers in elementary streams.
+ * The scanners use AVX2 if the CPU the application runs on supports it and SSE2 otherwise,
+ * the last bytes of a buffer are processed by scalar code. They keep no state between calls,
+ * callers which process a stream by portions leave unfinished prefixes in their input.
+ */
+
+// returns pointer to the first byte of the first 00 00 01 sequence lying entirely in [pBegin, pEnd), pEnd if there is none
+const mfxU8* FindStartCodePrefix(const mfxU8* pBegin, const mfxU8* pEnd);
+// the same for 00 00 03, the last byte of which is an emulation prevention byte
+const mfxU8* FindEmulationPreventionPrefix(const mfxU8* pBegin, const mfxU8* pEnd);
+
+// returns pointer to the first byte equal to nValue in [pBegin, pEnd), pEnd if there is none
+const mfxU8* FindByte(const mfxU8* pBegin, const mfxU8* pEnd, mfxU8 nValue);
+
+// reverses the order of bytes in each of nCount 32-bit words, pData needn't be aligned
+void SwapBytes32(mfxU8* pData, mfxU32 nCount);
+
+#endif // __BITSTREAM_SCAN_H__
@@ -0,0 +1,80 @@
+/******************************************************************************\
+Copyright (c) 2005-2016, Intel Corporation
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without modification, are permitted provided that the following conditions are met:
+
+1. Redistributions of source code must retain the above copyright notice, this list of conditions and the following disclaimer.
+
+2. Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the following disclaimer in the documentation and/or other materials provided with the distribution.
+
+3. Neither the name of the copyright holder nor the names of its contributors may be used to endorse or promote products derived from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+This sample was distributed or derived from the Intel's Media Samples package.
+The original version of this sample may be obtained from https://software.intel.com/en-us/intel-media-server-studio
+or https://software.intel.com/en-us/media-client-solutions-support.
+\**********************************************************************************/
+
+#ifndef __CHROMA_CONVERSION_H__
+#define __CHROMA_CONVERSION_H__
+
+#include "mfxdefs.h"
+
+/*
+ * Conversions between planar and semi-planar (interleaved) layouts of chroma planes.
+ * The row kernels use AVX2 if the CPU the application runs on supports it and SSE2 otherwise,
+ * tails of rows are processed by scalar code. Pitches are in bytes, widths and heights are in samples.
+ */
+
+// pDst[2*i] = pA[i], pDst[2*i+1] = pB[i]
+void InterleaveRow(const mfxU8* pA, const mfxU8* pB, mfxU8* pDst, mfxU32 nCount);
+// pA[i] = pSrc[2*i], pB[i] = pSrc[2*i+1]
+void DeinterleaveRow(const mfxU8* pSrc, mfxU8* pA, mfxU8* pB, mfxU32 nCount);
+// the same for 16-bit samples
+void InterleaveRow16(const mfxU16* pA, const mfxU16* pB, mfxU16* pDst, mfxU32 nCount);
+void DeinterleaveRow16(const mfxU16* pSrc, mfxU16* pA, mfxU16* pB, mfxU32 nCount);
+
+// separate U and V planes (I420, YV12) -> UV plane of NV12; nWidth, nHeight - size of the chroma planes
+void ConvertPlanarToNV12(const mfxU8* pU, mfxU32 nPitchU, const mfxU8* pV, mfxU32 nPitchV,
+                         mfxU8* pUV, mfxU32 nPitchUV, mfxU32 nWidth, mfxU32 nHeight);
+// UV plane of NV12 -> separate U and V planes
+void ConvertNV12ToPlanar(const mfxU8* pUV, mfxU32 nPitchUV,
+                         mfxU8* pU, mfxU32 nPitchU, mfxU8* pV, mfxU32 nPitchV, mfxU32 nWidth, mfxU32 nHeight);
+
+// 16-bit U and V planes -> UV plane of P010 and back
+void ConvertPlanarToP010(const mfxU16* pU, mfxU32 nPitchU, const mfxU16* pV, mfxU32 nPitchV,
+                         mfxU16* pUV, mfxU32 nPitchUV, mfxU32 nWidth, mfxU32 nHeight);
+void ConvertP010ToPlanar(const mfxU16* pUV, mfxU32 nPitchUV,
+                         mfxU16* pU, mfxU32 nPitchU, mfxU16* pV, mfxU32 nPitchV, mfxU32 nWidth, mfxU32 nHeight);
+
+// packed YUY2 -> NV12, chroma of each pair of rows is taken from the top row; nWidth, nHeight - size of the frame
+void ConvertYUY2ToNV12(const mfxU8* pSrc, mfxU32 nPitchSrc,
+                       mfxU8* pY, mfxU32 nPitchY, mfxU8* pUV, mfxU32 nPitchUV, mfxU32 nWidth, mfxU32 nHeight);
+// NV12 -> packed YUY2, chroma rows are duplicated
+void ConvertNV12ToYUY2(const mfxU8* pY, mfxU32 nPitchY, const mfxU8* pUV, mfxU32 nPitchUV,
+                       mfxU8* pDst, mfxU32 nPitchDst, mfxU32 nWidth, mfxU32 nHeight);
+
+// name of the instruction set used by the row kernels: "AVX2" or "SSE2"
+const char* GetChromaConversionIsa();
+
+typedef void (*InterleaveFunc)(const mfxU8* pA, const mfxU8* pB, mfxU8* pDst, mfxU32 nCount);
+typedef void (*DeinterleaveFunc)(const mfxU8* pSrc, mfxU8* pA, mfxU8* pB, mfxU32 nCount);
+typedef void (*Interleave16Func)(const mfxU16* pA, const mfxU16* pB, mfxU16* pDst, mfxU32 nCount);
+typedef void (*Deinterleave16Func)(const mfxU16* pSrc, mfxU16* pA, mfxU16* pB, mfxU32 nCount);
+
+struct ChromaKernels
+{
+    InterleaveFunc     Interleave;
+    DeinterleaveFunc   Deinterleave;
+    Interleave16Func   Interleave16;
+    Deinterleave16Func Deinterleave16;
+    const char*        szIsa;
+};
+
+// row kernels of the given instruction set ("C", "SSE2" or "AVX2") for tests and benchmarks;
+// NULL if the name is unknown or the CPU doesn't support the instruction set
+const ChromaKernels* GetChromaKernels(const char* szIsa);
+
+#endif //__CHROMA_CONVERSION_H__
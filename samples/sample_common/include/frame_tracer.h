@@ -0,0 +1,127 @@
+/******************************************************************************\
+Copyright (c) 2005-2016, Intel Corporation
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without modification, are permitted provided that the following conditions are met:
+
+1. Redistributions of source code must retain the above copyright notice, this list of conditions and the following disclaimer.
+
+2. Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the following disclaimer in the documentation and/or other materials provided with the distribution.
+
+3. Neither the name of the copyright holder nor the names of its contributors may be used to endorse or promote products derived from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+This sample was distributed or derived from the Intel's Media Samples package.
+The original version of this sample may be obtained from https://software.intel.com/en-us/intel-media-server-studio
+or https://software.intel.com/en-us/media-client-solutions-support.
+\**********************************************************************************/
+
+#ifndef __FRAME_TRACER_H__
+#define __FRAME_TRACER_H__
+
+#include <vector>
+#include "mfxdefs.h"
+#include "vm/time_defs.h"
+#include "vm/thread_defs.h"
+#include "sample_defs.h"
+
+/*
+ * Built-in tracer of pipeline stages, it doesn't need VTune unlike MFX_ITT_TASK.
+ * Tracing is enabled by MSDK_TRACE_FILE environment variable set to the output file name.
+ * Every thread records its events into its own ring buffer without locks, the newest
+ * TRACE_BUFFER_SIZE events of each thread are written in Chrome trace event format
+ * (chrome://tracing, ui.perfetto.dev) on exit and, on Linux, after SIGUSR1 is received.
+ * Sessions are shown as processes, so pipeline bubbles across concurrent sessions are visible.
+ */
+
+#define TRACE_BUFFER_SIZE 32768
+
+enum TraceStage
+{
+    TRACE_STAGE_READ = 0,
+    TRACE_STAGE_DECODE,
+    TRACE_STAGE_SYNC,
+    TRACE_STAGE_VPP,
+    TRACE_STAGE_ENCODE,
+    TRACE_STAGE_WRITE,
+    TRACE_STAGE_COUNT
+};
+
+struct TraceEvent
+{
+    msdk_tick nStart;
+    msdk_tick nEnd;
+    mfxU32 nSession;
+    mfxU32 nFrame;
+    mfxU32 nStage;
+};
+
+// events of one thread, written by the owner thread only
+struct TraceBuffer
+{
+    TraceBuffer(mfxU32 nThread) : nThreadIdx(nThread), nCount(0), Events(TRACE_BUFFER_SIZE) {}
+
+    mfxU32 nThreadIdx;
+    volatile mfxU32 nCount; // number of recorded events, published with release semantics
+    std::vector<TraceEvent> Events;
+};
+
+class CFrameTracer : private no_copy
+{
+public:
+    static CFrameTracer& Instance();
+
+    inline bool IsEnabled() const { return m_bEnabled; }
+
+    void AddEvent(mfxU32 nStage, mfxU32 nSession, mfxU32 nFrame, msdk_tick nStart, msdk_tick nEnd);
+    // writes events collected so far to the trace file
+    mfxStatus Dump();
+
+protected:
+    CFrameTracer();
+    ~CFrameTracer();
+
+    TraceBuffer* GetThreadBuffer();
+
+    bool m_bEnabled;
+    msdk_tick m_nStartTick;
+    std::vector<char> m_FileName;
+
+    MSDKMutex m_mutex; // protects m_Buffers and file writing
+    std::vector<TraceBuffer*> m_Buffers;
+};
+
+// records a stage from construction till destruction
+class CTraceScope : private no_copy
+{
+public:
+    CTraceScope(mfxU32 nStage, mfxU32 nSession, mfxU32 nFrame)
+        : m_nStage(nStage)
+        , m_nSession(nSession)
+        , m_nFrame(nFrame)
+        , m_nStart(CFrameTracer::Instance().IsEnabled() ? msdk_time_get_tick() : 0)
+    {
+    }
+
+    ~CTraceScope()
+    {
+        if (m_nStart)
+        {
+            CFrameTracer::Instance().AddEvent(m_nStage, m_nSession, m_nFrame, m_nStart, msdk_time_get_tick());
+        }
+    }
+
+private:
+    mfxU32 m_nStage;
+    mfxU32 m_nSession;
+    mfxU32 m_nFrame;
+    msdk_tick m_nStart;
+};
+
+#define MSDK_TRACE_CONCAT_(a, b) a##b
+#define MSDK_TRACE_CONCAT(a, b) MSDK_TRACE_CONCAT_(a, b)
+#define MSDK_TRACE_SCOPE(stage, session, frame) \
+    CTraceScope MSDK_TRACE_CONCAT(__msdk_trace_scope, __LINE__)((stage), (session), (frame));
+
+#endif //__FRAME_TRACER_H__
@@ -0,0 +1,124 @@
+/******************************************************************************\
+Copyright (c) 2005-2016, Intel Corporation
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without modification, are permitted provided that the following conditions are met:
+
+1. Redistributions of source code must retain the above copyright notice, this list of conditions and the following disclaimer.
+
+2. Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the following disclaimer in the documentation and/or other materials provided with the distribution.
+
+3. Neither the name of the copyright holder nor the names of its contributors may be used to endorse or promote products derived from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+This sample was distributed or derived from the Intel's Media Samples package.
+The original version of this sample may be obtained from https://software.intel.com/en-us/intel-media-server-studio
+or https://software.intel.com/en-us/media-client-solutions-support.
+\**********************************************************************************/
+
+#ifndef _HEVC_SPL_H__
+#define _HEVC_SPL_H__
+
+#include <vector>
+#pragma warning(disable : 4201)
+#include <memory>
+#pragma warning(default : 4201)
+
+#include "abstract_splitter.h"
+
+#include "avc_bitstream.h"
+#include "avc_nal_spl.h"
+
+namespace ProtectedLibrary
+{
+
+enum HEVCNalUnitType
+{
+    HEVC_NAL_UT_CODED_SLICE_BLA_W_LP   = 16,
+    HEVC_NAL_UT_RESERVED_IRAP_VCL23    = 23,
+    HEVC_NAL_UT_RESERVED_VCL31         = 31,
+    HEVC_NAL_UT_VPS                    = 32,
+    HEVC_NAL_UT_SPS                    = 33,
+    HEVC_NAL_UT_PPS                    = 34,
+    HEVC_NAL_UT_AU_DELIMITER           = 35,
+    HEVC_NAL_UT_EOS                    = 36,
+    HEVC_NAL_UT_EOB                    = 37,
+    HEVC_NAL_UT_FILLER_DATA            = 38,
+    HEVC_NAL_UT_SEI_PREFIX             = 39,
+    HEVC_NAL_UT_SEI_SUFFIX             = 40,
+    HEVC_NAL_UT_RESERVED_NVCL41        = 41,
+    HEVC_NAL_UT_RESERVED_NVCL44        = 44,
+    HEVC_NAL_UT_UNSPECIFIED48          = 48,
+    HEVC_NAL_UT_UNSPECIFIED55          = 55
+};
+
+// fields of parameter sets needed to parse the beginning of slice segment headers
+struct HEVCSeqParamSet
+{
+    bool   bValid;
+    mfxU32 PicSizeInCtbsY;
+};
+
+struct HEVCPicParamSet
+{
+    bool   bValid;
+    mfxU32 seq_parameter_set_id;
+    mfxU8  dependent_slice_segments_enabled_flag;
+    mfxU8  num_extra_slice_header_bits;
+};
+
+// Splits H.265 stream into access units, see 7.4.2.4.4 of H.265. NAL units are copied to the frame,
+// so the splitter does not refer to the input data.
+class HEVC_Spl : public AbstractSplitter
+{
+public:
+
+    HEVC_Spl();
+
+    virtual ~HEVC_Spl();
+
+    virtual mfxStatus Reset();
+
+    virtual mfxStatus GetFrame(mfxBitstream * bs_in, FrameSplitterInfo ** frame);
+
+    virtual mfxStatus PostProcessing(FrameSplitterInfo *frame, mfxU32 sliceNum);
+
+    virtual void ResetCurrentState();
+
+protected:
+    NALUnitSplitter m_NALSplitter;
+
+    mfxStatus ProcessNalUnit(mfxI32 nalType, mfxBitstream * nalUnit);
+    // returns true if the NAL unit is the first one of an access unit
+    bool IsFirstNalUnitOfAU(mfxI32 nalType, mfxBitstream * nalUnit);
+    mfxStatus AddNalUnit(mfxI32 nalType, mfxBitstream * nalUnit);
+
+    mfxStatus DecodeSeqParamSet(mfxBitstream * nalUnit);
+    mfxStatus DecodePicParamSet(mfxBitstream * nalUnit);
+    mfxStatus DecodeSliceHeader(mfxI32 nalType, mfxBitstream * nalUnit, SliceSplitterInfo & slice);
+
+    // converts NAL unit payload to the bitstream reader format
+    void InitBitstream(mfxBitstream * nalUnit, mfxU32 nMaxSize);
+
+    std::vector<mfxU8>  m_swappingMemory;
+    AVCBaseBitstream    m_bitStream;
+
+    HEVCSeqParamSet m_sps[16];
+    HEVCPicParamSet m_pps[64];
+
+    bool m_bHasVCL;             // slice of the current access unit is added
+
+    // NAL unit beginning the next access unit
+    std::vector<mfxU8>  m_pendingNal;
+    mfxI32              m_pendingNalType;
+    mfxU64              m_pendingTimeStamp;
+
+    std::vector<mfxU8>  m_currentFrame;
+    std::vector<SliceSplitterInfo>  m_slices;
+    FrameSplitterInfo m_frame;
+};
+
+} // namespace ProtectedLibrary
+
+#endif // _HEVC_SPL_H__
@@ -21,6 +21,7 @@ or https://software.intel.com/en-us/media-client-solutions-support.
 #define __MFX_BUFFERING_H__
 
 #include <stdio.h>
+#include <stdlib.h>
 
 #include "mfxstructures.h"
 
@@ -66,6 +67,123 @@ struct msdkOutputSurface
 
 class CBuffering;
 
+/** \brief Lock-free LIFO (Treiber stack) of nodes linked through their 'next' field.
+ *
+ * All nodes belong to a single array. The head keeps index of the top node plus one (zero
+ * means empty stack) in the low 32 bits and a modification tag in the high 32 bits: the tag
+ * is changed on every push and pop, so compare-and-exchange with a stale head fails even if
+ * the same node returned to the top meanwhile (ABA problem). Nodes are not freed while the
+ * stack is in use, thus reading 'next' of a node which was popped by other thread is harmless.
+ */
+template<class T>
+class msdkLockFreeStack
+{
+public:
+    msdkLockFreeStack():
+        m_pNodes(NULL),
+        m_Head(0) {}
+
+    inline void Reset(T* nodes) {
+        m_pNodes = nodes;
+        m_Head = 0;
+    }
+    inline void Push(T* node) {
+        mfxU64 head;
+        do {
+            head = m_Head;
+            node->next = GetNode(head);
+        } while (msdk_atomic_cas64(&m_Head, MakeHead(head, node), head) != head);
+    }
+    inline T* Pop() {
+        mfxU64 head;
+        T* node;
+        do {
+            head = m_Head;
+            node = GetNode(head);
+            if (!node) return NULL;
+        } while (msdk_atomic_cas64(&m_Head, MakeHead(head, node->next), head) != head);
+        node->next = NULL;
+        return node;
+    }
+
+private:
+    inline T* GetNode(mfxU64 head) {
+        mfxU32 index = (mfxU32)head;
+        return index ? m_pNodes + index - 1 : NULL;
+    }
+    inline mfxU64 MakeHead(mfxU64 head, T* node) {
+        mfxU64 tag = (head >> 32) + 1;
+        return (tag << 32) | (node ? (mfxU64)(node - m_pNodes + 1) : 0);
+    }
+
+    T* m_pNodes;
+    volatile mfxU64 m_Head;
+
+private:
+    msdkLockFreeStack(const msdkLockFreeStack&);
+    void operator=(const msdkLockFreeStack&);
+};
+
+/** \brief Bounded lock-free FIFO for exactly one producer and one consumer thread.
+ *
+ * Capacity should be a power of two. Head is modified only by the consumer, tail - only by
+ * the producer, so plain acquire loads and release stores are enough.
+ */
+template<class T>
+class msdkSpscRing
+{
+public:
+    msdkSpscRing():
+        m_pItems(NULL),
+        m_Mask(0),
+        m_Head(0),
+        m_Tail(0) {}
+
+    ~msdkSpscRing() {
+        Free();
+    }
+
+    inline bool Alloc(mfxU32 capacity) {
+        Free();
+        m_pItems = (T**)calloc(capacity, sizeof(T*));
+        if (!m_pItems) return false;
+        m_Mask = capacity - 1;
+        return true;
+    }
+    inline void Free() {
+        free(m_pItems);
+        m_pItems = NULL;
+        m_Mask = m_Head = m_Tail = 0;
+    }
+    inline bool Push(T* item) {
+        mfxU32 tail = m_Tail;
+        if (tail - msdk_atomic_load32(&m_Head) > m_Mask) return false;
+        m_pItems[tail & m_Mask] = item;
+        msdk_atomic_store32(&m_Tail, tail + 1);
+        return true;
+    }
+    inline T* Pop() {
+        mfxU32 head = m_Head;
+        if (head == msdk_atomic_load32(&m_Tail)) return NULL;
+        T* item = m_pItems[head & m_Mask];
+        msdk_atomic_store32(&m_Head, head + 1);
+        return item;
+    }
+    inline mfxU32 GetCount() {
+        return msdk_atomic_load32(&m_Tail) - msdk_atomic_load32(&m_Head);
+    }
+
+private:
+    T**             m_pItems;
+    mfxU32          m_Mask;
+    volatile mfxU32 m_Head;
+    volatile mfxU32 m_Tail;
+
+private:
+    msdkSpscRing(const msdkSpscRing&);
+    void operator=(const msdkSpscRing&);
+};
+
 // LIFO list of frame surfaces
 class msdkFreeSurfacesPool
 {
@@ -73,7 +191,8 @@ class msdkFreeSurfacesPool
 public:
     msdkFreeSurfacesPool(MSDKMutex* mutex):
         m_pSurfaces(NULL),
-        m_pMutex(mutex) {}
+        m_pMutex(mutex),
+        m_bLockFree(false) {}
 
     ~msdkFreeSurfacesPool() {
         m_pSurfaces = NULL;
@@ -85,6 +204,10 @@ public:
      * will be actually used we have good chance to avoid actual allocation of the surface memory.
      */
     inline void AddSurface(msdkFrameSurface* surface) {
+        if (m_bLockFree) {
+            AddSurfaceUnsafe(surface);
+            return;
+        }
         AutomaticMutex lock(*m_pMutex);
         AddSurfaceUnsafe(surface);
     }
@@ -93,6 +216,9 @@ public:
      * @note Surface is detached from the free surfaces array.
      */
     inline msdkFrameSurface* GetSurface() {
+        if (m_bLockFree) {
+            return GetSurfaceUnsafe();
+        }
         AutomaticMutex lock(*m_pMutex);
         return GetSurfaceUnsafe();
     }
@@ -105,6 +231,10 @@ private:
         MSDK_SELF_CHECK(!surface->prev);
         MSDK_SELF_CHECK(!surface->next);
 
+        if (m_bLockFree) {
+            m_LockFreeSurfaces.Push(surface);
+            return;
+        }
         head = m_pSurfaces;
         m_pSurfaces = surface;
         m_pSurfaces->next = head;
@@ -113,6 +243,9 @@ private:
 
         msdkFrameSurface* surface = NULL;
 
+        if (m_bLockFree) {
+            return m_LockFreeSurfaces.Pop();
+        }
         if (m_pSurfaces) {
             surface = m_pSurfaces;
             m_pSurfaces = m_pSurfaces->next;
@@ -126,6 +259,9 @@ private:
 protected:
     msdkFrameSurface* m_pSurfaces;
     MSDKMutex* m_pMutex;
+    // if set, m_LockFreeSurfaces is used instead of m_pSurfaces list and the mutex
+    bool m_bLockFree;
+    msdkLockFreeStack<msdkFrameSurface> m_LockFreeSurfaces;
 
 private:
     msdkFreeSurfacesPool(const msdkFreeSurfacesPool&);
@@ -231,7 +367,8 @@ public:
         m_pSurfacesHead(NULL),
         m_pSurfacesTail(NULL),
         m_SurfacesCount(0),
-        m_pMutex(mutex) {}
+        m_pMutex(mutex),
+        m_bLockFree(false) {}
 
     ~msdkOutputSurfacesPool() {
         m_pSurfacesHead = NULL;
@@ -239,16 +376,23 @@ public:
     }
 
     inline void AddSurface(msdkOutputSurface* surface) {
+        if (m_bLockFree) {
+            AddSurfaceUnsafe(surface);
+            return;
+        }
         AutomaticMutex lock(*m_pMutex);
         AddSurfaceUnsafe(surface);
     }
     inline msdkOutputSurface* GetSurface() {
+        if (m_bLockFree) {
+            return GetSurfaceUnsafe();
+        }
         AutomaticMutex lock(*m_pMutex);
         return GetSurfaceUnsafe();
     }
 
     inline mfxU32 GetSurfaceCount() {
-        return m_SurfacesCount;
+        return m_bLockFree ? m_LockFreeSurfaces.GetCount() : m_SurfacesCount;
     }
 private:
     inline void AddSurfaceUnsafe(msdkOutputSurface* surface)
@@ -257,6 +401,11 @@ private:
         MSDK_SELF_CHECK(!surface->next);
         surface->next = NULL;
 
+        if (m_bLockFree) {
+            // ring is allocated to hold all output surfaces, so it can't overflow
+            m_LockFreeSurfaces.Push(surface);
+            return;
+        }
         if (m_pSurfacesTail) {
             m_pSurfacesTail->next = surface;
             m_pSurfacesTail = m_pSurfacesTail->next;
@@ -269,6 +418,9 @@ private:
     {
         msdkOutputSurface* surface = NULL;
 
+        if (m_bLockFree) {
+            return m_LockFreeSurfaces.Pop();
+        }
         if (m_pSurfacesHead) {
             surface = m_pSurfacesHead;
             m_pSurfacesHead = m_pSurfacesHead->next;
@@ -288,6 +440,9 @@ protected:
     msdkOutputSurface*      m_pSurfacesTail; // youngest surface
     mfxU32                  m_SurfacesCount;
     MSDKMutex*              m_pMutex;
+    // if set, m_LockFreeSurfaces is used instead of the list and the mutex
+    bool                    m_bLockFree;
+    msdkSpscRing<msdkOutputSurface> m_LockFreeSurfaces;
 
 private:
     msdkOutputSurfacesPool(const msdkOutputSurfacesPool&);
@@ -303,7 +458,14 @@ public:
     virtual ~CBuffering();
 
 protected: // functions
-    mfxStatus AllocBuffers(mfxU32 SurfaceNumber);
+    /** \brief Allocates surface arrays and fills free surfaces pools.
+     *
+     * If bLockFree is set, free surfaces pools become lock-free stacks and output surfaces pools
+     * become single producer/single consumer rings. Used surfaces pools are still protected by
+     * the mutex. In this mode all output surfaces are allocated at once and the number of them
+     * can't grow later.
+     */
+    mfxStatus AllocBuffers(mfxU32 SurfaceNumber, bool bLockFree = false);
     mfxStatus AllocVppBuffers(mfxU32 VppSurfaceNumber);
     void AllocOutputBuffer();
     void FreeBuffers();
@@ -337,6 +499,12 @@ protected: // functions
         m_pFreeOutputSurfaces->next = head;
     }
     inline void AddFreeOutputSurface(msdkOutputSurface* surface) {
+        if (m_bLockFree) {
+            MSDK_SELF_CHECK(surface);
+            MSDK_SELF_CHECK(!surface->next);
+            m_FreeOutputSurfacesStack.Push(surface);
+            return;
+        }
         AutomaticMutex lock(m_Mutex);
         AddFreeOutputSurfaceUnsafe(surface);
     }
@@ -359,6 +527,9 @@ protected: // functions
         return surface;
     }
     inline msdkOutputSurface* GetFreeOutputSurface() {
+        if (m_bLockFree) {
+            return m_FreeOutputSurfacesStack.Pop();
+        }
         AutomaticMutex lock(m_Mutex);
         return GetFreeOutputSurfaceUnsafe();
     }
@@ -385,6 +556,7 @@ protected: // variables
     msdkFrameSurface*       m_pSurfaces;
     msdkFrameSurface*       m_pVppSurfaces;
     MSDKMutex               m_Mutex;
+    bool                    m_bLockFree;
 
     // LIFO list of frame surfaces
     msdkFreeSurfacesPool    m_FreeSurfacesPool;
@@ -397,6 +569,10 @@ protected: // variables
     // LIFO list of output surfaces
     msdkOutputSurface*      m_pFreeOutputSurfaces;
 
+    // lock-free mode: array of all output surfaces and LIFO of free ones
+    msdkOutputSurface*      m_pOutputSurfaces;
+    msdkLockFreeStack<msdkOutputSurface> m_FreeOutputSurfacesStack;
+
     // FIFO list of surfaces
     msdkOutputSurfacesPool  m_OutputSurfacesPool;
     msdkOutputSurfacesPool  m_DeliveredSurfacesPool;
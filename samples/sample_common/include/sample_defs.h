@@ -103,6 +103,9 @@ enum LibVABackend
 #define MSDK_DEVICE_FREE_WAIT_INTERVAL 30000
 #define MSDK_WAIT_INTERVAL MSDK_DEC_WAIT_INTERVAL+3*MSDK_VPP_WAIT_INTERVAL+MSDK_ENC_WAIT_INTERVAL // an estimate for the longest pipeline we have in samples
 
+#define BITSTREAM_POOL_MIN_SIZE  (64 * 1024) // the smallest bitstream buffer, must be a power of two
+#define BITSTREAM_POOL_ALIGNMENT 64
+
 #define MSDK_INVALID_SURF_IDX 0xFFFF
 
 #define MSDK_MAX_FILENAME_LEN 1024
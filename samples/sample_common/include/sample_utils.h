@@ -24,6 +24,8 @@ or https://software.intel.com/en-us/media-client-solutions-support.
 #include <string>
 #include <sstream>
 #include <vector>
+#include <map>
+#include <deque>
 
 #include "mfxstructures.h"
 #include "mfxvideo.h"
@@ -35,6 +37,7 @@ or https://software.intel.com/en-us/media-client-solutions-support.
 #include "vm/file_defs.h"
 #include "vm/time_defs.h"
 #include "vm/atomic_defs.h"
+#include "vm/thread_defs.h"
 
 #include "sample_types.h"
 
@@ -43,6 +46,7 @@ or https://software.intel.com/en-us/media-client-solutions-support.
 #include "avc_spl.h"
 #include "avc_headers.h"
 #include "avc_nal_spl.h"
+#include "hevc_spl.h"
 
 // A macro to disallow the copy constructor and operator= functions
 // This should be used in the private: declarations for a class
@@ -97,6 +101,55 @@ bool IsDecodeCodecSupported(mfxU32 codecFormat);
 bool IsEncodeCodecSupported(mfxU32 codecFormat);
 bool IsPluginCodecSupported(mfxU32 codecFormat);
 
+// Reads fixed size raw frames from a file on a separate thread into a ring of
+// buffers, so that file I/O runs ahead of the consumer. Loaded buffers are passed
+// to the consumer through a single producer / single consumer queue.
+class CFramePrefetcher : private no_copy
+{
+public :
+
+    CFramePrefetcher();
+    virtual ~CFramePrefetcher();
+
+    mfxStatus Init(FILE* pFile, mfxU32 nFrameSize, mfxU32 nDepth);
+    void Close();
+
+    // returns next loaded frame, waits for the reader thread if the frame is not loaded yet;
+    // MFX_ERR_MORE_DATA means end of file
+    mfxStatus GetFrame(mfxU8** ppFrame);
+    // gives the frame returned by GetFrame back to the reader thread
+    void ReleaseFrame();
+
+    mfxU32 GetFrameSize() const { return m_nFrameSize; }
+    mfxU32 GetHits() const { return m_nHits; }
+    mfxU32 GetMisses() const { return m_nMisses; }
+
+protected:
+    static unsigned int MFX_STDCALL ReadThreadFunc(void* ctx);
+    void ReadLoop();
+    mfxU8* GetSlot(mfxU32 nIdx) { return m_pAlignedBuffer + (size_t)nIdx * m_nSlotSize; }
+
+    FILE* m_pFile;
+    mfxU32 m_nFrameSize;
+    mfxU32 m_nSlotSize; // frame size rounded up to keep every slot aligned
+    mfxU32 m_nDepth;
+    mfxU8* m_pBuffer;
+    mfxU8* m_pAlignedBuffer;
+
+    volatile mfxU16 m_nReady; // number of loaded frames, changed only with atomic operations
+    volatile bool m_bEndOfFile;
+    volatile bool m_bStop;
+    mfxU32 m_nWriteIdx; // used by the reader thread only
+    mfxU32 m_nReadIdx;  // used by the consumer only
+
+    MSDKEvent* m_pFrameReady;
+    MSDKEvent* m_pFrameFree;
+    MSDKThread* m_pThread;
+
+    mfxU32 m_nHits;   // frame was loaded when requested
+    mfxU32 m_nMisses; // consumer had to wait for the reader thread
+};
+
 class CSmplYUVReader
 {
 public :
@@ -110,11 +163,97 @@ public :
     mfxU32 m_ColorFormat; // color format of input YUV data, YUV420 or NV12
 
     void SetMultiView() { m_bIsMultiView = true; }
+    // Read input files through a memory mapping, must be called before Init.
+    // With bZeroCopy surfaces whose layout matches the file get their Data pointers
+    // set directly into the mapping, so use it only for system memory surfaces
+    // which are not locked/unlocked through an allocator and are never written to.
+    void SetMemoryMapped(bool bZeroCopy) { m_bMemoryMapped = true; m_bZeroCopy = bZeroCopy; }
+    // Load up to nDepth frames ahead on a separate thread, 0 disables read-ahead.
+    // Used for single view files read with stdio only.
+    void SetPrefetchDepth(mfxU32 nDepth) { m_nPrefetchDepth = nDepth; }
+    // returns false if read-ahead was not used
+    bool GetPrefetchStatistics(mfxU32& nHits, mfxU32& nMisses);
 
 protected:
+    struct sMappedFile
+    {
+        mfxU8* pData;
+        mfxU64 nSize;
+        mfxU64 nOffset; // position of the next frame
+    };
+
+    // returns 32-byte aligned staging buffer of at least nSize bytes, reused between frames
+    mfxU8* GetFrameBuffer(mfxU32 nSize);
+    mfxStatus OpenFile(const msdk_char *strFileName, FILE** ppFile);
+    bool IsMappedSurface(const mfxFrameData& data);
+    // points surface planes to the frame in the mapping, returns false if layouts differ
+    bool BindSurface(mfxFrameSurface1* pSurface, mfxU8* pFrame);
+    // gives back surface memory which was replaced by BindSurface
+    mfxStatus UnbindSurface(mfxFrameSurface1* pSurface);
+
     FILE* m_fSource, **m_fSourceMVC;
     bool m_bInited, m_bIsMultiView;
     mfxU32 m_numLoadedFiles;
+
+    // whole input frame is read into this buffer with a single fread and then scattered to the surface
+    mfxU8* m_pFrameBuffer;
+    mfxU32 m_nFrameBufferSize;
+
+    bool m_bMemoryMapped, m_bZeroCopy;
+    std::vector<sMappedFile> m_MappedFiles; // one per view
+    std::map<mfxFrameSurface1*, mfxFrameData> m_OriginalData; // surface pointers saved by BindSurface
+
+    mfxU32 m_nPrefetchDepth;
+    CFramePrefetcher* m_pPrefetcher; // created on the first frame when its size is known
+};
+
+// Output file with write-behind: data is copied into large buffers which are written
+// to the file by a separate thread once they are full. The caller blocks only when
+// all buffers are waiting for the I/O thread.
+class CWriteBehindFile : private no_copy
+{
+public :
+
+    CWriteBehindFile();
+    virtual ~CWriteBehindFile();
+
+    // bDirect opens the file with O_DIRECT where supported, nBufferSize must be a multiple of 4096 then
+    mfxStatus Init(const msdk_char *strFileName, mfxU32 nBuffers, mfxU32 nBufferSize, bool bDirect);
+    mfxStatus Write(const mfxU8* pData, mfxU32 nSize);
+    // flushes the last partially filled buffer and waits for the I/O thread
+    mfxStatus Close();
+
+protected:
+    struct sFilledBuffer
+    {
+        mfxU32 nIndex;
+        mfxU32 nSize;
+    };
+
+    static unsigned int MFX_STDCALL WriteThreadFunc(void* ctx);
+    void WriteLoop();
+    mfxStatus WriteToFile(const mfxU8* pData, mfxU32 nSize);
+    mfxStatus Submit();
+    mfxU8* GetBuffer(mfxU32 nIndex) { return m_pAlignedMemory + (size_t)nIndex * m_nBufferSize; }
+
+    FILE* m_pFile;
+    bool m_bDirect;
+    mfxU32 m_nBuffers;
+    mfxU32 m_nBufferSize;
+    mfxU8* m_pMemory;
+    mfxU8* m_pAlignedMemory;
+
+    mfxU32 m_nCurrent;      // buffer being filled by the caller, m_nBuffers if none
+    mfxU32 m_nCurrentSize;
+
+    MSDKMutex m_mutex;      // protects the two lists below
+    std::deque<sFilledBuffer> m_FilledBuffers;
+    std::vector<mfxU32> m_FreeBuffers;
+    MSDKSemaphore* m_pFilledCount;
+    MSDKSemaphore* m_pFreeCount;
+    MSDKThread* m_pThread;
+
+    volatile mfxStatus m_WriteStatus; // first error of the I/O thread
 };
 
 class CSmplBitstreamWriter
@@ -126,12 +265,27 @@ public :
 
     virtual mfxStatus Init(const msdk_char *strFileName);
     virtual mfxStatus WriteNextFrame(mfxBitstream *pMfxBitstream, bool isPrint = true);
-    virtual void Close();
+    // returns error if the data written behind or flushed on closing failed to be written
+    virtual mfxStatus Close();
     mfxU32 m_nProcessedFramesNum;
 
+    // Write output on a separate thread through nBuffers buffers of nBufferSize bytes,
+    // must be called before Init. 0 buffers means synchronous writing.
+    void SetWriteBehind(mfxU32 nBuffers, mfxU32 nBufferSize = 4 * 1024 * 1024, bool bDirect = false)
+    {
+        m_nWriteBehindBuffers = nBuffers;
+        m_nWriteBehindBufferSize = nBufferSize;
+        m_bDirectIO = bDirect;
+    }
+
 protected:
     FILE*       m_fSource;
     bool        m_bInited;
+
+    mfxU32      m_nWriteBehindBuffers;
+    mfxU32      m_nWriteBehindBufferSize;
+    bool        m_bDirectIO;
+    CWriteBehindFile* m_pWriteBehind;
 };
 
 class CSmplYUVWriter
@@ -152,6 +306,7 @@ protected:
     FILE         *m_fDest, **m_fDestMVC;
     bool         m_bInited, m_bIsMultiView;
     mfxU32       m_numCreatedFiles;
+    std::vector<mfxU8> m_ChromaBuffer; // U and V planes converted from NV12
 };
 
 class CSmplBitstreamReader
@@ -166,6 +321,9 @@ public :
     virtual void      Close();
     virtual mfxStatus Init(const msdk_char *strFileName);
     virtual mfxStatus ReadNextFrame(mfxBitstream *pBS);
+    // Same as ReadNextFrame, but a reader may return in *ppBS its own bitstream referring to
+    // the frame instead of copying it to pBS. Such bitstream is valid till the next call to the reader.
+    virtual mfxStatus ReadNextFrameNoCopy(mfxBitstream *pBS, mfxBitstream **ppBS);
 
 protected:
     FILE*     m_fSource;
@@ -180,38 +338,70 @@ public:
 
     /** Free resources.*/
     virtual void      Close();
+    virtual void      Reset();
     virtual mfxStatus Init(const msdk_char *strFileName);
     virtual mfxStatus ReadNextFrame(mfxBitstream *pBS);
+    // returns bitstream referring to the frame inside of the input window
+    virtual mfxStatus ReadNextFrameNoCopy(mfxBitstream *pBS, mfxBitstream **ppBS);
+
+protected:
+    // creates the splitter of the input stream into access units
+    virtual AbstractSplitter* CreateSplitter();
 
 private:
     mfxBitstream *m_processedBS;
-    // input bit stream
+    // input bit stream, the whole mapped file or a window refilled from the file
     std::auto_ptr<mfxBitstream>  m_originalBS;
+    mfxU8 *m_pMappedFile;
+    mfxU64 m_nMappedSize;
 
     mfxStatus PrepareNextFrame(mfxBitstream *in, mfxBitstream **out);
+    mfxStatus ReadInput();
+    mfxStatus ReadNextAccessUnit();
 
     // is stream ended
     bool m_isEndOfStream;
 
     std::auto_ptr<AbstractSplitter> m_pNALSplitter;
     FrameSplitterInfo *m_frame;
-    mfxU8 *m_plainBuffer;
-    mfxU32 m_plainBufferSize;
     mfxBitstream m_outBS;
 };
 
+//provides output bistream with complete H.265 frames
+class CHEVCFrameReader : public CH264FrameReader
+{
+protected:
+    virtual AbstractSplitter* CreateSplitter();
+};
+
 //provides output bistream with at least 1 frame, reports about error
+//the bitstream is extended if the frame does not fit into it
 class CJPEGFrameReader : public CSmplBitstreamReader
 {
+public:
     enum JPEGMarker
     {
         SOI=0xD8FF,
         EOI=0xD9FF
     };
-public:
+
+    // position of the picture parser, offsets are counted from the beginning of the data
+    // so they stay valid when the data is moved to refill the bitstream
+    struct ScanState
+    {
+        mfxU32 nOffset;         // next byte to parse
+        bool   bEntropyCoded;   // the byte is in entropy-coded data following SOS marker segment
+    };
+
     virtual mfxStatus ReadNextFrame(mfxBitstream *pBS);
-protected:
-    mfxU32 FindMarker(mfxBitstream *pBS,mfxU32 startOffset,JPEGMarker marker);
+
+    // returns offset of the marker in pBS->Data, 0xFFFFFFFF if it is not found
+    static mfxU32 FindMarker(mfxBitstream *pBS,mfxU32 startOffset,JPEGMarker marker);
+
+    // goes over marker segments of the picture by their lengths starting from state, which is
+    // {SOI offset + 2, false} for a new picture; returns offset of the byte following EOI marker
+    // or 0xFFFFFFFF if more data is needed, then state is where to continue with more data
+    static mfxU32 FindPictureEnd(const mfxU8 *pData, mfxU32 nSize, ScanState &state);
 };
 
 //appends output bistream with exactly 1 frame, reports about error
@@ -260,7 +450,7 @@ public:
     virtual mfxStatus InitDuplicate(const msdk_char *strFileName);
     virtual mfxStatus JoinDuplicate(CSmplBitstreamDuplicateWriter *pJoinee);
     virtual mfxStatus WriteNextFrame(mfxBitstream *pMfxBitstream, bool isPrint = true);
-    virtual void Close();
+    virtual mfxStatus Close();
 protected:
     FILE*     m_fSourceDuplicate;
     bool      m_bJoined;
@@ -468,14 +658,116 @@ mfxStatus ConvertFrameRate(mfxF64 dFrameRate, mfxU32* pnFrameRateExtN, mfxU32* p
 mfxF64 CalculateFrameRate(mfxU32 nFrameRateExtN, mfxU32 nFrameRateExtD);
 mfxU16 GetFreeSurfaceIndex(mfxFrameSurface1* pSurfacesPool, mfxU16 nPoolSize);
 mfxU16 GetFreeSurface(mfxFrameSurface1* pSurfacesPool, mfxU16 nPoolSize);
-mfxStatus InitMfxBitstream(mfxBitstream* pBitstream, mfxU32 nSize);
+// nNumaNode - NUMA node to place the buffer on, -1 - no preference
+mfxStatus InitMfxBitstream(mfxBitstream* pBitstream, mfxU32 nSize, mfxI32 nNumaNode = -1);
+
+/** \brief Pool of frame surfaces with an explicit list of free ones.
+ *
+ * A surface taken from the pool belongs to the caller till it is returned with Release(),
+ * which is done as soon as the surface is passed to Media SDK. Returned surfaces are kept in
+ * order of their return and the oldest one which Media SDK does not lock anymore is taken
+ * first, so the first checked surface is usually free. Media SDK unlocks surfaces when the tasks
+ * using them complete: a pipeline which finds no free surface completes its oldest task in flight
+ * and tries again. A thread waiting for surfaces released by other threads sleeps on an event
+ * which is signaled by Release() and NotifyRelease().
+ */
+class CSurfacePool : private no_copy
+{
+public:
+    CSurfacePool();
+    ~CSurfacePool();
+
+    mfxStatus Init(mfxFrameSurface1* pSurfaces, mfxU16 nCount);
+    mfxStatus Init(mfxFrameSurface1** ppSurfaces, mfxU16 nCount);
+    void Close();
+
+    // returns index of a free surface or MSDK_INVALID_SURF_IDX if nothing was released during nTimeout msec
+    mfxU16 GetFreeIndex(mfxU32 nTimeout);
+    // returns a free surface or NULL if nothing was released during nTimeout msec
+    mfxFrameSurface1* GetFree(mfxU32 nTimeout);
+    mfxU16 GetSize() { return (mfxU16)m_Surfaces.size(); }
+
+    // returns a surface to the pool, a surface which is in the pool already is ignored
+    void Release(mfxU16 nIndex);
+    void Release(mfxFrameSurface1* pSurface);
+    // wakes up a thread waiting for a free surface, call it when a task using surfaces of the pool completes
+    void NotifyRelease();
+
+protected:
+    mfxU16 TakeFree();
+
+    std::vector<mfxFrameSurface1*> m_Surfaces;
+    std::map<mfxFrameSurface1*, mfxU16> m_Indices;
+    std::deque<mfxU16> m_Free;  // returned surfaces in order of their return
+    std::vector<bool> m_bInPool;
+    MSDKMutex m_Mutex;
+    MSDKEvent* m_pReleased;
+};
 
 //performs copy to end if possible, also move data to buffer begin if necessary
 //shifts offset pointer in source bitstream in success case
 mfxStatus MoveMfxBitstream(mfxBitstream *pTarget, mfxBitstream *pSrc, mfxU32 nBytesToCopy);
-mfxStatus ExtendMfxBitstream(mfxBitstream* pBitstream, mfxU32 nSize);
+// nNumaNode - NUMA node to place the new buffer on, -1 - the node of the current buffer
+mfxStatus ExtendMfxBitstream(mfxBitstream* pBitstream, mfxU32 nSize, mfxI32 nNumaNode = -1);
 void WipeMfxBitstream(mfxBitstream* pBitstream);
 
+// returns size of a bitstream buffer sufficient for one encoded frame with the given parameters;
+// nCurrentSize - size of a buffer which has turned out to be insufficient (0 if none)
+mfxU32 GetSufficientBitstreamSize(const mfxVideoParam& par, mfxU32 nCurrentSize = 0);
+
+/** \brief Process-wide cache of bitstream buffers.
+ *
+ * InitMfxBitstream, ExtendMfxBitstream and WipeMfxBitstream take their buffers from this pool.
+ * Capacities are rounded up to a power of two (not less than BITSTREAM_POOL_MIN_SIZE), so
+ * a growing bitstream is reallocated a logarithmic number of times, and released buffers are
+ * kept for reuse by other bitstreams of the same size class, including ones of other sessions.
+ * Buffers requested for a NUMA node are bound to it when allocated and are cached separately,
+ * so they are reused only by requests for the same node.
+ * Buffers are aligned to BITSTREAM_POOL_ALIGNMENT bytes.
+ */
+class CBitstreamPool : private no_copy
+{
+public:
+    struct Statistics
+    {
+        mfxU64 nAllocations;    // buffers allocated from the heap
+        mfxU64 nReuses;         // requests served from the cache
+        mfxU64 nBytesAllocated; // total size of buffers allocated from the heap
+        mfxU64 nBytesInUse;     // total size of buffers currently attached to bitstreams
+        mfxU64 nPeakBytesInUse;
+    };
+
+    static CBitstreamPool& Instance();
+
+    // returns a buffer of at least nSize bytes placed on the NUMA node (-1 - no preference),
+    // its actual capacity is returned in *pnCapacity
+    mfxU8* Acquire(mfxU32 nSize, mfxU32* pnCapacity, mfxI32 nNode = -1);
+    void Release(mfxU8* pData);
+    // NUMA node the buffer was acquired for, -1 for no preference or no buffer
+    static mfxI32 GetNode(const mfxU8* pData);
+    // frees cached buffers which are not in use
+    void Trim();
+
+    Statistics GetStatistics();
+    void PrintStatistics();
+
+protected:
+    CBitstreamPool();
+    ~CBitstreamPool();
+
+    static mfxU32 GetSizeClass(mfxU32 nSize);
+
+    enum { SIZE_CLASSES = 16 };
+
+    MSDKMutex m_mutex;
+    // cached buffers by NUMA node
+    std::map<mfxI32, std::vector<mfxU8*> > m_FreeBuffers[SIZE_CLASSES];
+    Statistics m_Stat;
+};
+
+// true if both the CPU and the OS support AVX2, SIMD kernels are selected by it at startup
+bool IsAVX2Supported();
+
 mfxU16 CalculateDefaultBitrate(mfxU32 nCodecId, mfxU32 nTargetUsage, mfxU32 nWidth, mfxU32 nHeight, mfxF64 dFrameRate);
 
 //serialization fnc set
@@ -695,4 +987,29 @@ mfxI32 getMonitorType(msdk_char* str);
 
 void WaitForDeviceToBecomeFree(MFXVideoSession& session, mfxSyncPoint& syncPoint,mfxStatus& currentStatus);
 
+/** \brief Retry policy for calls which returned MFX_WRN_DEVICE_BUSY.
+ *
+ * Create one object per retry loop and call Wait() each time the device is busy. If a sync
+ * point of the oldest task in flight is given, Wait() syncs on it for a short time: completion
+ * of that task is what frees the device. On success the sync point is retired (set to NULL),
+ * so it should not be owned by anybody else. Otherwise the waiter backs off: it spins at first,
+ * then yields the processor and finally sleeps for a period growing up to nMaxSleep msec.
+ * Time spent inside Wait() calls is added to *pBusyTime (in ticks of msdk_time_get_tick()).
+ */
+class CDeviceBusyWaiter : private no_copy
+{
+public:
+    CDeviceBusyWaiter(msdk_tick* pBusyTime = NULL, mfxU32 nMaxSleep = 8);
+
+    mfxStatus Wait(MFXVideoSession* pSession = NULL, mfxSyncPoint* pSyncPoint = NULL);
+
+protected:
+    mfxStatus WaitOnce(MFXVideoSession* pSession, mfxSyncPoint* pSyncPoint);
+    void Backoff();
+
+    msdk_tick* m_pBusyTime;
+    mfxU32     m_nAttempt;
+    mfxU32     m_nMaxSleep;
+};
+
 #endif //__SAMPLE_UTILS_H__
@@ -39,8 +39,11 @@ struct sFrame
 struct SysMemAllocatorParams : mfxAllocatorParams
 {
     SysMemAllocatorParams()
-        : mfxAllocatorParams() { }
+        : mfxAllocatorParams()
+        , pBufferAllocator(NULL)
+        , nNumaNode(-1) { }
     MFXBufferAllocator *pBufferAllocator;
+    mfxI32 nNumaNode; // NUMA node to place frames on if own buffer allocator is used, -1 - no preference
 };
 
 class SysMemFrameAllocator: public BaseFrameAllocator
@@ -62,17 +65,21 @@ protected:
 
     MFXBufferAllocator *m_pBufferAllocator;
     bool m_bOwnBufferAllocator;
+    mfxI32 m_nNumaNode;
 };
 
 class SysMemBufferAllocator : public MFXBufferAllocator
 {
 public:
-    SysMemBufferAllocator();
+    SysMemBufferAllocator(mfxI32 nNumaNode = -1);
     virtual ~SysMemBufferAllocator();
     virtual mfxStatus AllocBuffer(mfxU32 nbytes, mfxU16 type, mfxMemId *mid);
     virtual mfxStatus LockBuffer(mfxMemId mid, mfxU8 **ptr);
     virtual mfxStatus UnlockBuffer(mfxMemId mid);
     virtual mfxStatus FreeBuffer(mfxMemId mid);
+
+protected:
+    mfxI32 m_nNumaNode;
 };
 
 #endif // __SYSMEM_ALLOCATOR_H__
\ No newline at end of file
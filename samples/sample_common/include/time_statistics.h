@@ -23,9 +23,141 @@ or https://software.intel.com/en-us/media-client-solutions-support.
 #include "vm/time_defs.h"
 #include "vm/strings_defs.h"
 #include "math.h"
+#include <string.h>
 
 #pragma warning(disable:4100)
 
+// Fixed size log-linear histogram of latencies in microseconds. Values below 2^HISTOGRAM_SUB_BITS
+// are counted exactly, larger ones fall into one of 2^HISTOGRAM_SUB_BITS linear sub-buckets of
+// their power of two range, so reported percentiles have relative error within 1/32.
+// Histograms collected by different threads are combined with Merge.
+#define HISTOGRAM_SUB_BITS 5
+#define HISTOGRAM_SUB_BUCKETS (1 << HISTOGRAM_SUB_BITS)
+#define HISTOGRAM_MAX_POWER 36 // values from 2^36 us (~19 hours) go to the last bucket
+#define HISTOGRAM_BUCKETS ((HISTOGRAM_MAX_POWER - HISTOGRAM_SUB_BITS + 1) * HISTOGRAM_SUB_BUCKETS)
+
+class CLatencyHistogram
+{
+public:
+    CLatencyHistogram()
+    {
+        Reset();
+    }
+
+    inline void Reset()
+    {
+        memset(counts, 0, sizeof(counts));
+        numValues = 0;
+        sumValues = 0;
+        minValue = 0;
+        maxValue = 0;
+    }
+
+    inline void AddValue(mfxU64 value)
+    {
+        counts[GetBucket(value)]++;
+        if (!numValues || value < minValue)
+            minValue = value;
+        if (value > maxValue)
+            maxValue = value;
+        numValues++;
+        sumValues += value;
+    }
+
+    inline void Merge(const CLatencyHistogram& other)
+    {
+        if (!other.numValues)
+            return;
+        for (mfxU32 i = 0; i < HISTOGRAM_BUCKETS; i++)
+            counts[i] += other.counts[i];
+        if (!numValues || other.minValue < minValue)
+            minValue = other.minValue;
+        if (other.maxValue > maxValue)
+            maxValue = other.maxValue;
+        numValues += other.numValues;
+        sumValues += other.sumValues;
+    }
+
+    inline mfxU64 GetNumValues() const
+    {
+        return numValues;
+    }
+
+    inline mfxU64 GetMin() const
+    {
+        return minValue;
+    }
+
+    inline mfxU64 GetMax() const
+    {
+        return maxValue;
+    }
+
+    inline mfxF64 GetMean() const
+    {
+        return numValues ? (mfxF64)sumValues / numValues : 0;
+    }
+
+    // returns value not exceeded by percent % of values, 0 if histogram is empty
+    inline mfxU64 GetPercentile(mfxF64 percent) const
+    {
+        if (!numValues)
+            return 0;
+
+        mfxU64 rank = (mfxU64)ceil(percent / 100 * numValues);
+        if (rank < 1)
+            return minValue;
+        if (rank >= numValues)
+            return maxValue;
+
+        mfxU64 sum = 0;
+        for (mfxU32 i = 0; i < HISTOGRAM_BUCKETS; i++)
+        {
+            sum += counts[i];
+            if (sum >= rank)
+            {
+                // middle of the bucket, but not outside of the range of observed values
+                mfxU64 value = GetBucketStart(i) + (GetBucketStart(i + 1) - GetBucketStart(i)) / 2;
+                return (value < minValue) ? minValue : (value > maxValue) ? maxValue : value;
+            }
+        }
+        return maxValue;
+    }
+
+protected:
+    static inline mfxU32 GetBucket(mfxU64 value)
+    {
+        if (value < HISTOGRAM_SUB_BUCKETS)
+            return (mfxU32)value;
+        if (value >> HISTOGRAM_MAX_POWER)
+            return HISTOGRAM_BUCKETS - 1;
+
+        mfxU32 power = HISTOGRAM_SUB_BITS;
+        while (value >> (power + 1))
+            power++;
+
+        // leading bit selects the range, the following HISTOGRAM_SUB_BITS bits select the sub-bucket
+        mfxU32 sub = (mfxU32)(value >> (power - HISTOGRAM_SUB_BITS)) & (HISTOGRAM_SUB_BUCKETS - 1);
+        return (power - HISTOGRAM_SUB_BITS + 1) * HISTOGRAM_SUB_BUCKETS + sub;
+    }
+
+    static inline mfxU64 GetBucketStart(mfxU32 bucket)
+    {
+        if (bucket < HISTOGRAM_SUB_BUCKETS)
+            return bucket;
+
+        mfxU32 range = bucket / HISTOGRAM_SUB_BUCKETS;
+        mfxU64 sub = bucket % HISTOGRAM_SUB_BUCKETS;
+        return (HISTOGRAM_SUB_BUCKETS + sub) << (range - 1);
+    }
+
+    mfxU64 counts[HISTOGRAM_BUCKETS];
+    mfxU64 numValues;
+    mfxU64 sumValues;
+    mfxU64 minValue;
+    mfxU64 maxValue;
+};
+
 class CTimeStatistics
 {
 public:
@@ -79,6 +211,7 @@ public:
             maxTime=delta;
         }
         numMeasurements++;
+        histogram.AddValue((mfxU64)(delta*1000000));
 #endif
     }
 
@@ -104,7 +237,37 @@ public:
     inline void PrintStatistics(const msdk_char* prefix)
     {
 #ifdef TIME_STATS
-        msdk_printf(MSDK_STRING("%s Total:%.3lf(%lld smpls),Avg %.3lf,StdDev:%.3lf,Min:%.3lf,Max:%.3lf\n"),prefix,totalTime*1000,numMeasurements,GetAvgTime()*1000,GetTimeStdDev()*1000,minTime*1000,maxTime*1000);
+        msdk_printf(MSDK_STRING("%s Total:%.3lf(%lld smpls),Avg %.3lf,StdDev:%.3lf,Min:%.3lf,Max:%.3lf,P50:%.3lf,P90:%.3lf,P99:%.3lf,P99.9:%.3lf\n"),prefix,totalTime*1000,numMeasurements,GetAvgTime()*1000,GetTimeStdDev()*1000,minTime*1000,maxTime*1000,
+            GetPercentile(50)*1000,GetPercentile(90)*1000,GetPercentile(99)*1000,GetPercentile(99.9)*1000);
+#endif
+    }
+
+    // merges measurements collected by another instance, e.g. by another thread
+    inline void MergeStatistics(const CTimeStatistics& other)
+    {
+#ifdef TIME_STATS
+        totalTime+=other.totalTime;
+        totalTimeSquares+=other.totalTimeSquares;
+        if(other.minTime<minTime)
+        {
+            minTime=other.minTime;
+        }
+        if(other.maxTime>maxTime)
+        {
+            maxTime=other.maxTime;
+        }
+        numMeasurements+=other.numMeasurements;
+        histogram.Merge(other.histogram);
+#endif
+    }
+
+    // returns time in seconds not exceeded by percent % of measurements
+    inline mfxF64 GetPercentile(mfxF64 percent)
+    {
+#ifdef TIME_STATS
+        return histogram.GetPercentile(percent)/1000000.;
+#else
+        return 0;
 #endif
     }
 
@@ -171,6 +334,7 @@ inline mfxF64 GetMaxTime()
         minTime=1E100;
         maxTime=-1;
         numMeasurements=0;
+        histogram.Reset();
 #endif
     }
 
@@ -183,5 +347,6 @@ protected:
     mfxF64 minTime;
     mfxF64 maxTime;
     mfxU64 numMeasurements;
+    CLatencyHistogram histogram;
 #endif
 };
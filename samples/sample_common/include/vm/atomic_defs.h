@@ -28,4 +28,16 @@ mfxU16 msdk_atomic_inc16(volatile mfxU16 *pVariable);
 /* Thread-safe 16-bit variable decrementing */
 mfxU16 msdk_atomic_dec16(volatile mfxU16 *pVariable);
 
+/* Thread-safe 32-bit compare-and-exchange, returns initial value of the variable */
+mfxU32 msdk_atomic_cas32(volatile mfxU32 *pVariable, mfxU32 value_to_exchange, mfxU32 value_to_compare);
+
+/* Thread-safe 64-bit compare-and-exchange, returns initial value of the variable */
+mfxU64 msdk_atomic_cas64(volatile mfxU64 *pVariable, mfxU64 value_to_exchange, mfxU64 value_to_compare);
+
+/* 32-bit load with acquire semantics */
+mfxU32 msdk_atomic_load32(volatile mfxU32 *pVariable);
+
+/* 32-bit store with release semantics */
+void msdk_atomic_store32(volatile mfxU32 *pVariable, mfxU32 value);
+
 #endif // #ifndef __ATOMIC_DEFS_H__
@@ -37,4 +37,17 @@ or https://software.intel.com/en-us/media-client-solutions-support.
 #define msdk_fgets  fgets
 #endif // #if defined(_WIN32) || defined(_WIN64)
 
+#include "strings_defs.h"
+
+/* Maps the whole file into memory for reading. Returns NULL on failure,
+   size of the mapped data is returned through 'size'. */
+mfxU8* msdk_file_map(const msdk_char *file_name, mfxU64 *size);
+void msdk_file_unmap(mfxU8 *data, mfxU64 size);
+
+/* Reads up to 'size' bytes at absolute 'offset' with one system call, the file position
+   is not used. Returns the number of bytes read. */
+mfxU32 msdk_file_read_at(FILE *file, mfxU8 *data, mfxU32 size, mfxU64 offset);
+/* Returns size of the opened file or 0 on failure. */
+mfxU64 msdk_file_get_size(FILE *file);
+
 #endif // #ifndef __FILE_DEFS_H__
@@ -52,6 +52,7 @@ typedef TCHAR msdk_char;
 #define msdk_atoi     _ttoi
 #define msdk_strtol   _tcstol
 #define msdk_strtod   _tcstod
+#define msdk_remove   _tremove
 #define msdk_strchr   _tcschr
 #define msdk_itoa_decimal(value, str)   _itow_s(value, str, 4, 10)
 #define msdk_strnlen(str,lenmax) strnlen_s(str,lenmax)
@@ -95,6 +96,7 @@ typedef char msdk_char;
 #define msdk_atoll    atoll
 #define msdk_strtol   strtol
 #define msdk_strtod   strtod
+#define msdk_remove   remove
 #define msdk_itoa_decimal(value, str) \
   snprintf(str, sizeof(str)/sizeof(str[0])-1, "%d", value)
 #define msdk_strnlen(str,maxlen) strlen(str)
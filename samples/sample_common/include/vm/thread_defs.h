@@ -20,6 +20,7 @@ or https://software.intel.com/en-us/media-client-solutions-support.
 #ifndef __THREAD_DEFS_H__
 #define __THREAD_DEFS_H__
 
+#include <vector>
 #include "mfxdefs.h"
 #include "vm/strings_defs.h"
 
@@ -190,5 +191,26 @@ private:
 mfxStatus msdk_setrlimit_vmem(mfxU64 size);
 mfxStatus msdk_thread_get_schedtype(const msdk_char*, mfxI32 &type);
 void msdk_thread_printf_scheduling_help();
+// number of logical processors available to the process
+mfxU32 msdk_thread_get_cpu_count();
+// CPU time consumed by the calling thread (sec)
+mfxF64 msdk_thread_get_cpu_time();
+
+// location of a logical processor
+struct msdkCpuInfo
+{
+    mfxU32 nCpu;  // logical processor number
+    mfxU32 nCore; // physical core, SMT siblings share it
+    mfxU32 nNode; // NUMA node
+};
+
+// logical processors available to the process
+mfxStatus msdk_thread_get_topology(std::vector<msdkCpuInfo> &cpus);
+// binds the calling thread to the logical processors
+mfxStatus msdk_thread_set_affinity(const std::vector<mfxU32> &cpus);
+// sets name of the calling thread seen by debuggers and profilers
+mfxStatus msdk_thread_set_name(const char *name);
+// pages of the memory range are placed on the NUMA node if possible, pages already touched are moved to it
+mfxStatus msdk_numa_bind_memory(void *ptr, size_t size, mfxU32 node);
 
 #endif //__THREAD_DEFS_H__
@@ -29,6 +29,8 @@ or https://software.intel.com/en-us/media-client-solutions-support.
 
 #define MSDK_SLEEP(msec) Sleep(msec)
 
+#define MSDK_YIELD() SwitchToThread()
+
 #define MSDK_USLEEP(usec) \
 { \
     LARGE_INTEGER due; \
@@ -42,6 +44,9 @@ or https://software.intel.com/en-us/media-client-solutions-support.
 #else // #if defined(_WIN32) || defined(_WIN64)
 
 #include <unistd.h>
+#include <sched.h>
+
+#define MSDK_YIELD() sched_yield()
 
 #define MSDK_SLEEP(msec) \
   do { \
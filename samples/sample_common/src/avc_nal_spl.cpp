@@ -20,6 +20,7 @@ or https://software.intel.com/en-us/media-client-solutions-support.
 #include "sample_defs.h"
 #include "avc_structures.h"
 #include "avc_nal_spl.h"
+#include "bitstream_scan.h"
 
 namespace ProtectedLibrary
 {
@@ -43,7 +44,8 @@ static mfxU8 start_code_prefix[] = {0, 0, 0, 1};
 
 enum
 {
-    AVC_NAL_UNITTYPE_BITS_MASK  = 0x1f
+    AVC_NAL_UNITTYPE_BITS_MASK  = 0x1f,
+    HEVC_NAL_UNITTYPE_BITS_MASK = 0x3f
 };
 
 
@@ -67,19 +69,18 @@ static mfxI32 FindStartCode(mfxU8 * (&pb), mfxU32 &nSize)
     if (nSize < 4)
         return 0;
 
-    // find start code
-    while ((4 <= nSize) && ((0 != pb[0]) ||
-                            (0 != pb[1]) ||
-                            (1 != pb[2])))
+    // find start code followed by one more byte
+    mfxU32 nOffset = (mfxU32)(FindStartCodePrefix(pb, pb + nSize - 1) - pb);
+    if (nOffset == nSize - 1)
     {
-        pb += 1;
-        nSize -= 1;
+        pb += nSize - 3;
+        nSize = 3;
+        return 0;
     }
 
-    if (4 <= nSize)
-        return ((pb[0] << 24) | (pb[1] << 16) | (pb[2] << 8) | (pb[3]));
-
-    return 0;
+    pb += nOffset;
+    nSize -= nOffset;
+    return ((pb[0] << 24) | (pb[1] << 16) | (pb[2] << 8) | (pb[3]));
 
 }
 
@@ -108,6 +109,7 @@ StartCodeIterator::StartCodeIterator()
     , m_pSourceBase(0)
     , m_nSourceBaseSize(0)
     , m_suggestedSize(10 * 1024)
+    , m_bHEVC(false)
 {
     Reset();
 }
@@ -282,46 +284,33 @@ mfxI32 StartCodeIterator::EndOfStream(mfxBitstream * dst)
 
 mfxI32 StartCodeIterator::FindStartCode(mfxU8 * (&pb), mfxU32 & size, mfxI32 & startCodeSize)
 {
-    mfxU32 zeroCount = 0;
+    mfxU8 * pEnd = pb + size;
+    mfxU8 * pCode = pb + (FindStartCodePrefix(pb, pEnd) - pb);
 
-    for (mfxU32 i = 0 ; i < (mfxU32)size; i++, pb++)
+    if (pCode == pEnd)
     {
-        switch(pb[0])
-        {
-        case 0x00:
+        // leave up to 3 trailing zeros, they may start a start code continued in the next portion of data
+        mfxU32 zeroCount = 0;
+        while (zeroCount < MSDK_MIN(size, 3) && 0 == pEnd[-1 - (mfxI32)zeroCount])
             zeroCount++;
-            break;
-        case 0x01:
-            if (zeroCount >= 2)
-            {
-                startCodeSize = MSDK_MIN(zeroCount + 1, 4);
-                size -= i + 1;
-                pb++; // remove 0x01 symbol
-                zeroCount = 0;
-                if (size >= 1)
-                {
-                    return pb[0] & AVC_NAL_UNITTYPE_BITS_MASK;
-                }
-                else
-                {
-                    pb -= startCodeSize;
-                    size += startCodeSize;
-                    startCodeSize = 0;
-                    return 0;
-                }
-            }
-            zeroCount = 0;
-            break;
-        default:
-            zeroCount = 0;
-            break;
-        }
+
+        pb = pEnd - zeroCount;
+        size = zeroCount;
+        startCodeSize = 0;
+        return 0;
     }
 
-    zeroCount = MSDK_MIN(zeroCount, 3);
-    pb -= zeroCount;
-    size += zeroCount;
-    zeroCount = 0;
+    // 4 byte start code has one more leading zero
+    startCodeSize = (pCode > pb && 0 == pCode[-1]) ? 4 : 3;
+    pb = pCode + 3; // remove 00 00 01 symbols
+    size = (mfxU32)(pEnd - pb);
+    if (size >= 1)
+    {
+        return m_bHEVC ? ((pb[0] >> 1) & HEVC_NAL_UNITTYPE_BITS_MASK) + 1 : pb[0] & AVC_NAL_UNITTYPE_BITS_MASK;
+    }
+
+    pb -= startCodeSize;
+    size += startCodeSize;
     startCodeSize = 0;
     return 0;
 }
@@ -374,159 +363,43 @@ mfxI32 NALUnitSplitter::GetNalUnits(mfxBitstream * source, mfxBitstream * &desti
     return iCode;
 }
 
-/* temporal class definition */
-class H264DwordPointer_
+void RemovePreventingBytes(mfxU8 *pDestination, mfxU32 &nDstSize, mfxU8 *pSource, mfxU32 nSrcSize)
 {
-public:
-    // Default constructor
-    H264DwordPointer_(void)
-    {
-        m_pDest = NULL;
-        m_nByteNum = 0;
-    }
+    mfxU8 *pSrc = pSource;
+    mfxU8 *pEnd = pSource + nSrcSize;
+    mfxU8 *pDst = pDestination;
 
-    H264DwordPointer_ operator = (void *pDest)
+    // copy runs of bytes between 00 00 03 sequences skipping the 03 bytes
+    for (;;)
     {
-        m_pDest = (mfxU32 *) pDest;
-        m_nByteNum = 0;
-        m_iCur = 0;
-
-        return *this;
-    }
-
-    // Increment operator
-    H264DwordPointer_ &operator ++ (void)
-    {
-        if (4 == ++m_nByteNum)
-        {
-            *m_pDest = m_iCur;
-            m_pDest += 1;
-            m_nByteNum = 0;
-            m_iCur = 0;
-        }
-        else
-            m_iCur <<= 8;
-
-        return *this;
-    }
-
-    mfxU8 operator = (mfxU8 nByte)
-    {
-        m_iCur = (m_iCur & ~0x0ff) | ((mfxU32) nByte);
-
-        return nByte;
-    }
-
-protected:
-    mfxU32 *m_pDest;                                            // pointer to destination buffer
-    mfxU32 m_nByteNum;                                          // number of current byte in dword
-    mfxU32 m_iCur;                                              // current dword
-};
-
-class H264SourcePointer_
-{
-public:
-    // Default constructor
-    H264SourcePointer_(void)
-    {
-        m_pSource = NULL;
-    }
-
-    H264SourcePointer_ &operator = (mfxU8 *pSource)
-    {
-        m_pSource = (mfxU8 *) pSource;
-
-        m_nZeros = 0;
-        m_nRemovedBytes = 0;
-
-        return *this;
-    }
-
-    H264SourcePointer_ &operator ++ (void)
-    {
-        mfxU8 bCurByte = m_pSource[0];
-
-        if (0 == bCurByte)
-            m_nZeros += 1;
-        else
-        {
-            if ((3 == bCurByte) && (2 <= m_nZeros))
-                m_nRemovedBytes += 1;
-            m_nZeros = 0;
-        }
-
-        m_pSource += 1;
-
-        return *this;
-    }
-
-    bool IsPrevent(void)
-    {
-        if ((3 == m_pSource[0]) && (2 <= m_nZeros))
-            return true;
-        else
-            return false;
-    }
-
-    operator mfxU8 (void)
-    {
-        return m_pSource[0];
-    }
+        mfxU8 *pPrevent = pSrc + (FindEmulationPreventionPrefix(pSrc, pEnd) - pSrc);
+        if (pPrevent == pEnd)
+            break;
 
-    mfxU32 GetRemovedBytes(void)
-    {
-        return m_nRemovedBytes;
+        pPrevent += 2;
+        memmove(pDst, pSrc, pPrevent - pSrc);
+        pDst += pPrevent - pSrc;
+        pSrc = pPrevent + 1;
     }
+    memmove(pDst, pSrc, pEnd - pSrc);
+    pDst += pEnd - pSrc;
 
-protected:
-    mfxU8 *m_pSource;                                           // pointer to destination buffer
-    mfxU32 m_nZeros;                                            // number of preceding zeros
-    mfxU32 m_nRemovedBytes;                                     // number of removed bytes
-};
+    nDstSize = (mfxU32)(pDst - pDestination);
+}
 
 void SwapMemoryAndRemovePreventingBytes(mfxU8 *pDestination, mfxU32 &nDstSize, mfxU8 *pSource, mfxU32 nSrcSize)
 {
-    H264DwordPointer_ pDst;
-    H264SourcePointer_ pSrc;
-    size_t i;
-
-    // DwordPointer object is swapping written bytes
-    // H264SourcePointer_ removes preventing start-code bytes
-
-    // reset pointer(s)
-    pSrc = pSource;
-    pDst = pDestination;
-
-    // first two bytes
-    i = 0;
-    while (i < (mfxU32) MSDK_MIN(2, nSrcSize))
-    {
-        pDst = (mfxU8) pSrc;
-        ++pDst;
-        ++pSrc;
-        ++i;
-    }
-
-    // do swapping
-    while (i < (mfxU32) nSrcSize)
-    {
-        if (false == pSrc.IsPrevent())
-        {
-            pDst = (mfxU8) pSrc;
-            ++pDst;
-        }
-        ++pSrc;
-        ++i;
-    }
+    RemovePreventingBytes(pDestination, nDstSize, pSource, nSrcSize);
 
     // write padding bytes
-    nDstSize = nSrcSize - pSrc.GetRemovedBytes();
     while (nDstSize & 3)
     {
-        pDst = (mfxU8) (0);
+        pDestination[nDstSize] = 0;
         ++nDstSize;
-        ++pDst;
     }
+
+    // bit reader takes data by dwords
+    SwapBytes32(pDestination, nDstSize / 4);
 }
 
 } // namespace ProtectedLibrary
@@ -43,6 +43,8 @@ AVC_Spl::AVC_Spl()
     , m_currentInfo(0)
     , m_pLastSlice(0)
     , m_lastNalUnit(0)
+    , m_pInputBegin(0)
+    , m_pInputEnd(0)
 {
     Init();
 }
@@ -68,6 +70,8 @@ mfxStatus AVC_Spl::Init()
     m_pLastSlice = 0;
     m_lastNalUnit = 0;
     m_currentInfo = 0;
+    m_pInputBegin = 0;
+    m_pInputEnd = 0;
 
     m_slices.resize(128);
     memset(&m_frame, 0, sizeof(m_frame));
@@ -91,6 +95,8 @@ mfxStatus AVC_Spl::Reset()
     m_lastNalUnit = 0;
     m_pLastSlice = 0;
     m_currentInfo = 0;
+    m_pInputBegin = 0;
+    m_pInputEnd = 0;
     return MFX_ERR_NONE;
 }
 
@@ -293,10 +299,12 @@ AVCSlice * AVC_Spl::DecodeSliceHeader(mfxBitstream * nalUnit)
     m_slicesStorage.push_back(AVCSlice());
     AVCSlice *pSlice = &m_slicesStorage.back();
 
-    mfxU32 swappingSize = nalUnit->DataLength;
+    // only the slice header is parsed, so the slice data is not swapped
+    mfxU32 headerSize = MSDK_MIN(nalUnit->DataLength, (mfxU32)SLICE_HEADER_MAX_SIZE);
+    mfxU32 swappingSize = headerSize;
     mfxU8 * swappingMemory = GetMemoryForSwapping(swappingSize);
 
-    BytesSwapper::SwapMemory(swappingMemory, swappingSize, nalUnit->Data + nalUnit->DataOffset, nalUnit->DataLength);
+    BytesSwapper::SwapMemory(swappingMemory, swappingSize, nalUnit->Data + nalUnit->DataOffset, headerSize);
 
     mfxI32 pps_pid = pSlice->RetrievePicParamSetNumber(swappingMemory, swappingSize);
     if (pps_pid == -1)
@@ -369,6 +377,7 @@ AVCFrameInfo * AVC_Spl::GetFreeFrame()
 
 void AVC_Spl::ResetCurrentState()
 {
+    m_frame.Data = &m_currentFrame[0];
     m_frame.DataLength = 0;
     m_frame.SliceNum = 0;
     m_frame.FirstFieldSliceNum = 0;
@@ -506,32 +515,109 @@ mfxStatus AVC_Spl::AddSlice(AVCSlice * pSlice)
     return MFX_ERR_MORE_DATA;
 }
 
-mfxStatus AVC_Spl::AddNalUnit(mfxBitstream * nalUnit)
+static const mfxU8 start_code_prefix[] = {0, 0, 1};
+
+bool AVC_Spl::IsInInput(mfxBitstream * nalUnit) const
+{
+    mfxU8 * nal = nalUnit->Data + nalUnit->DataOffset;
+
+    return m_pInputBegin && nal - sizeof(start_code_prefix) >= m_pInputBegin && nal + nalUnit->DataLength <= m_pInputEnd &&
+        !memcmp(nal - sizeof(start_code_prefix), start_code_prefix, sizeof(start_code_prefix));
+}
+
+void AVC_Spl::MaterializeFrame()
 {
-    static mfxU8 start_code_prefix[] = {0, 0, 1};
+    if (m_frame.Data == &m_currentFrame[0])
+        return;
+
+    if (m_currentFrame.size() < m_frame.DataLength)
+        m_currentFrame.resize(m_frame.DataLength);
+
+    MSDK_MEMCPY_BUF(&m_currentFrame[0], 0, m_currentFrame.size(), m_frame.Data, m_frame.DataLength);
+    m_frame.Data = &m_currentFrame[0];
+}
+
+void AVC_Spl::DetachInput()
+{
+    MaterializeFrame();
+
+    if (m_lastNalUnit && IsInInput(m_lastNalUnit))
+    {
+        mfxU8 * nal = m_lastNalUnit->Data + m_lastNalUnit->DataOffset;
+
+        m_lastNalData.assign(nal, nal + m_lastNalUnit->DataLength);
+        m_lastNalCopy = *m_lastNalUnit;
+        m_lastNalCopy.Data = &m_lastNalData[0];
+        m_lastNalCopy.DataOffset = 0;
+        m_lastNalCopy.MaxLength = m_lastNalCopy.DataLength;
+        m_lastNalUnit = &m_lastNalCopy;
+    }
+
+    m_pInputBegin = 0;
+    m_pInputEnd = 0;
+}
+
+mfxStatus AVC_Spl::AppendNalUnit(mfxBitstream * nalUnit, mfxU32 & offset)
+{
+    mfxU8 * nal = nalUnit->Data + nalUnit->DataOffset;
+    mfxU8 * nalStart = nal - sizeof(start_code_prefix);
+
+    if (IsInInput(nalUnit))
+    {
+        // the frame refers to the input while its NAL units follow each other there,
+        // the decoder accepts zero bytes between them
+        bool isFollowing = !m_frame.DataLength;
+        if (!isFollowing && m_frame.Data != &m_currentFrame[0] && nalStart >= m_frame.Data + m_frame.DataLength)
+        {
+            mfxU8 * gap = m_frame.Data + m_frame.DataLength;
+            while (gap < nalStart && !*gap)
+                gap++;
+            isFollowing = (gap == nalStart);
+        }
+
+        if (isFollowing)
+        {
+            if (!m_frame.DataLength)
+                m_frame.Data = nalStart;
+
+            offset = (mfxU32)(nalStart - m_frame.Data);
+            m_frame.DataLength = (mfxU32)(nal + nalUnit->DataLength - m_frame.Data);
+            return MFX_ERR_NONE;
+        }
+    }
+
+    MaterializeFrame();
 
-    if (m_frame.DataLength + nalUnit->DataLength + sizeof(start_code_prefix) >= BUFFER_SIZE)
-        return MFX_ERR_NOT_ENOUGH_BUFFER;
+    size_t frameSize = m_frame.DataLength + nalUnit->DataLength + sizeof(start_code_prefix);
+    if (m_currentFrame.size() < frameSize)
+    {
+        m_currentFrame.resize(MSDK_MAX(frameSize, 2 * m_currentFrame.size()));
+        m_frame.Data = &m_currentFrame[0];
+    }
 
-    MSDK_MEMCPY_BUF(m_frame.Data, m_frame.DataLength, BUFFER_SIZE, start_code_prefix, sizeof(start_code_prefix));
-    MSDK_MEMCPY_BUF(m_frame.Data, m_frame.DataLength + sizeof(start_code_prefix), BUFFER_SIZE, nalUnit->Data + nalUnit->DataOffset, nalUnit->DataLength);
+    MSDK_MEMCPY_BUF(m_frame.Data, m_frame.DataLength, m_currentFrame.size(), start_code_prefix, sizeof(start_code_prefix));
+    MSDK_MEMCPY_BUF(m_frame.Data, m_frame.DataLength + sizeof(start_code_prefix), m_currentFrame.size(), nal, nalUnit->DataLength);
 
+    offset = m_frame.DataLength;
     m_frame.DataLength += (mfxU32)(nalUnit->DataLength + sizeof(start_code_prefix));
 
     return MFX_ERR_NONE;
 }
 
-mfxStatus AVC_Spl::AddSliceNalUnit(mfxBitstream * nalUnit, AVCSlice * slice)
+mfxStatus AVC_Spl::AddNalUnit(mfxBitstream * nalUnit)
 {
-    static mfxU8 start_code_prefix[] = {0, 0, 1};
+    mfxU32 offset = 0;
+    return AppendNalUnit(nalUnit, offset);
+}
 
+mfxStatus AVC_Spl::AddSliceNalUnit(mfxBitstream * nalUnit, AVCSlice * slice)
+{
     mfxU32 sliceLength = (mfxU32)(nalUnit->DataLength + sizeof(start_code_prefix));
+    mfxU32 sliceOffset = 0;
 
-    if (m_frame.DataLength + sliceLength >= BUFFER_SIZE)
-        return MFX_ERR_NOT_ENOUGH_BUFFER;
-
-    MSDK_MEMCPY_BUF(m_frame.Data, m_frame.DataLength, BUFFER_SIZE, start_code_prefix, sizeof(start_code_prefix));
-    MSDK_MEMCPY_BUF(m_frame.Data, m_frame.DataLength + sizeof(start_code_prefix), BUFFER_SIZE, nalUnit->Data + nalUnit->DataOffset, nalUnit->DataLength);
+    mfxStatus sts = AppendNalUnit(nalUnit, sliceOffset);
+    if (sts != MFX_ERR_NONE)
+        return sts;
 
     if (!m_frame.SliceNum)
     {
@@ -564,7 +650,7 @@ mfxStatus AVC_Spl::AddSliceNalUnit(mfxBitstream * nalUnit, AVCSlice * slice)
     newSlice.HeaderLength += sizeof(start_code_prefix) + 1;
 
     newSlice.DataLength = sliceLength;
-    newSlice.DataOffset = m_frame.DataLength;
+    newSlice.DataOffset = sliceOffset;
     if(IS_I_SLICE(slice->GetSliceHeader()->slice_type))
         newSlice.SliceType = TYPE_I;
     else if(IS_P_SLICE(slice->GetSliceHeader()->slice_type))
@@ -572,8 +658,6 @@ mfxStatus AVC_Spl::AddSliceNalUnit(mfxBitstream * nalUnit, AVCSlice * slice)
     else if(IS_B_SLICE(slice->GetSliceHeader()->slice_type))
         newSlice.SliceType = TYPE_B;
 
-    m_frame.DataLength += sliceLength;
-
     if (!m_currentInfo->m_index)
         m_frame.FirstFieldSliceNum++;
 
@@ -659,6 +743,12 @@ mfxStatus AVC_Spl::GetFrame(mfxBitstream * bs_in, FrameSplitterInfo ** frame)
 {
     *frame = 0;
 
+    if (bs_in)
+    {
+        m_pInputBegin = bs_in->Data;
+        m_pInputEnd = bs_in->Data + bs_in->DataOffset + bs_in->DataLength;
+    }
+
     do
     {
         if (m_pLastSlice)
@@ -703,6 +793,7 @@ void AVCSlice::Reset()
     m_seqParamSet = 0;
     m_seqParamSetMvcEx = 0;
     m_seqParamSetEx = 0;
+    m_bHasMMCO5 = false;
 }
 
 AVCSliceHeader * AVCSlice::GetSliceHeader()
@@ -773,6 +864,7 @@ bool AVCSlice::DecodeHeader(mfxU8 *pSource, mfxU32 nSourceSize)
         RefPicListReorderInfo ReorderInfoL0;
         RefPicListReorderInfo ReorderInfoL1;
         AdaptiveMarkingInfo     m_AdaptiveMarkingInfo;
+        m_AdaptiveMarkingInfo.num_entries = 0;
 
         // decode second part of slice header
         umcRes = m_bitStream.GetSliceHeaderPart3(&m_sliceHeader,
@@ -787,6 +879,12 @@ bool AVCSlice::DecodeHeader(mfxU8 *pSource, mfxU32 nSourceSize)
         if (MFX_ERR_NONE != umcRes)
             return false;
 
+        for (mfxU32 i = 0; i < m_AdaptiveMarkingInfo.num_entries; i++)
+        {
+            if (m_AdaptiveMarkingInfo.mmco[i] == 5)
+                m_bHasMMCO5 = true;
+        }
+
         if (m_picParamSet->entropy_coding_mode)
             m_bitStream.AlignPointerRight();
     }
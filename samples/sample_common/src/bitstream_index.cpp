@@ -0,0 +1,864 @@
+/******************************************************************************\
+Copyright (c) 2005-2016, Intel Corporation
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without modification, are permitted provided that the following conditions are met:
+
+1. Redistributions of source code must retain the above copyright notice, this list of conditions and the following disclaimer.
+
+2. Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the following disclaimer in the documentation and/or other materials provided with the distribution.
+
+3. Neither the name of the copyright holder nor the names of its contributors may be used to endorse or promote products derived from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+This sample was distributed or derived from the Intel's Media Samples package.
+The original version of this sample may be obtained from https://software.intel.com/en-us/intel-media-server-studio
+or https://software.intel.com/en-us/media-client-solutions-support.
+\**********************************************************************************/
+
+#include "mfx_samples_config.h"
+
+#include <string.h>
+
+#include "bitstream_index.h"
+#include "sample_defs.h"
+#include "bitstream_scan.h"
+
+using namespace ProtectedLibrary;
+
+namespace
+{
+
+const mfxU32 INDEX_SIGNATURE = MFX_MAKEFOURCC('M','I','D','X');
+const mfxU16 INDEX_VERSION = 3;
+
+// mfxBitstream can not address the whole mapped stream, so it is parsed through windows of this size
+const mfxU32 SCAN_WINDOW_SIZE = 1 << 30;
+
+// header of the sidecar, it is followed by NumUnits AccessUnitInfo entries
+struct IndexFileHeader
+{
+    mfxU32 Signature;
+    mfxU16 Version;
+    mfxU16 EntrySize;
+    mfxU32 CodecId;
+    mfxU32 FrameRateExtN;
+    mfxU32 FrameRateExtD;
+    mfxU32 reserved;
+    mfxU64 StreamSize;      // the index is rebuilt if the stream size
+    mfxU64 StreamChecksum;  // or the checksum of its head and tail changes
+    mfxU64 NumUnits;
+};
+
+// number of bytes at each end of the stream covered by the checksum
+const mfxU64 CHECKSUM_SPAN = 64 * 1024;
+
+// FNV-1a of the head and the tail of the stream, it catches rewritten streams of the same size
+// without reading them whole
+mfxU64 GetStreamChecksum(const mfxU8 *pStream, mfxU64 nStreamSize)
+{
+    mfxU64 nHash = 14695981039346656037ULL;
+    mfxU64 nHead = MSDK_MIN(nStreamSize, CHECKSUM_SPAN);
+    mfxU64 nTail = MSDK_MIN(nStreamSize - nHead, CHECKSUM_SPAN);
+
+    for (mfxU64 i = 0; i < nHead; i++)
+        nHash = (nHash ^ pStream[i]) * 1099511628211ULL;
+    for (mfxU64 i = nStreamSize - nTail; i < nStreamSize; i++)
+        nHash = (nHash ^ pStream[i]) * 1099511628211ULL;
+
+    return nHash;
+}
+
+void SetWindow(mfxBitstream &window, mfxU8 *pStream, mfxU64 nStreamSize, mfxU64 nBase)
+{
+    window.Data = pStream + nBase;
+    window.DataOffset = 0;
+    window.DataLength = (mfxU32)MSDK_MIN(nStreamSize - nBase, (mfxU64)SCAN_WINDOW_SIZE);
+    window.MaxLength = window.DataLength;
+}
+
+// NAL units which may begin an access unit before its first slice, see 7.4.1.2.3 of H.264
+bool IsAccessUnitPrefix(mfxI32 nalType)
+{
+    return (nalType >= NAL_UT_SEI && nalType <= NAL_UT_AUD) ||
+        (nalType >= NAL_UT_SPS_EX && nalType <= 18);
+}
+
+// Runs the frame splitter over the stream and tracks where each access unit begins in the stream,
+// frame types and picture order counts are taken from the slice headers the splitter parses.
+class AVCIndexer : public AVC_Spl
+{
+public:
+    AVCIndexer(mfxU8 *pStream, mfxU64 nStreamSize);
+
+    mfxStatus Run(std::vector<AccessUnitInfo> &units);
+
+    mfxU32 m_nFrameRateExtN;
+    mfxU32 m_nFrameRateExtD;
+
+protected:
+    virtual mfxStatus ProcessNalUnit(mfxI32 nalType, mfxBitstream * nalUnit);
+
+    mfxU64 GetStartCodeOffset(mfxBitstream * nalUnit);
+    // is called for every picture in decoding order
+    mfxI32 GetPicOrderCnt(AVCSlice * pSlice);
+    AccessUnitInfo StartAccessUnit(mfxU64 offset, AVCSlice * pSlice);
+
+    mfxU8 *m_pStream;
+    mfxU64 m_nStreamSize;
+    mfxBitstream m_window;
+    mfxU64 m_nWindowBase;
+
+    static const mfxU64 NO_OFFSET = (mfxU64)-1;
+    mfxU64 m_nPrefixOffset;     // first NAL unit which can begin the next access unit
+    bool m_bPrefixHasParamSets; // SPS or PPS were met since the last slice
+    bool m_bHasUnit;
+    AccessUnitInfo m_unit;      // access unit the splitter is assembling
+    bool m_bHasNextUnit;
+    AccessUnitInfo m_nextUnit;  // access unit begun by the slice the splitter keeps for the next frame
+
+    // picture order count state of the previous pictures
+    mfxI32 m_prevPicOrderCntMsb;
+    mfxI32 m_prevPicOrderCntLsb;
+    mfxI32 m_prevFrameNum;
+    mfxI32 m_prevFrameNumOffset;
+};
+
+AVCIndexer::AVCIndexer(mfxU8 *pStream, mfxU64 nStreamSize)
+    : m_nFrameRateExtN(0)
+    , m_nFrameRateExtD(0)
+    , m_pStream(pStream)
+    , m_nStreamSize(nStreamSize)
+    , m_nWindowBase(0)
+    , m_nPrefixOffset(NO_OFFSET)
+    , m_bPrefixHasParamSets(false)
+    , m_bHasUnit(false)
+    , m_bHasNextUnit(false)
+    , m_prevPicOrderCntMsb(0)
+    , m_prevPicOrderCntLsb(0)
+    , m_prevFrameNum(0)
+    , m_prevFrameNumOffset(0)
+{
+    MSDK_ZERO_MEMORY(m_window);
+    MSDK_ZERO_MEMORY(m_unit);
+    MSDK_ZERO_MEMORY(m_nextUnit);
+}
+
+mfxU64 AVCIndexer::GetStartCodeOffset(mfxBitstream * nalUnit)
+{
+    mfxU8 *pNal = nalUnit->Data + nalUnit->DataOffset;
+    mfxU64 offset;
+
+    if (pNal >= m_pStream && pNal < m_pStream + m_nStreamSize)
+        offset = (mfxU64)(pNal - m_pStream);
+    else
+        // the splitter assembled the NAL unit crossing the window edge, it ends where the splitter stopped
+        offset = m_nWindowBase + m_window.DataOffset - nalUnit->DataLength;
+
+    // include the leading zero byte of 4 byte start codes
+    offset = (offset >= 3) ? offset - 3 : 0;
+    if (offset && !m_pStream[offset - 1])
+        offset--;
+
+    return offset;
+}
+
+mfxI32 AVCIndexer::GetPicOrderCnt(AVCSlice * pSlice)
+{
+    const AVCSliceHeader *hdr = pSlice->GetSliceHeader();
+    const AVCSeqParamSet *sps = pSlice->m_seqParamSet;
+    bool isRef = hdr->nal_ref_idc != 0;
+    bool isBottomField = hdr->field_pic_flag && hdr->bottom_field_flag;
+    mfxI32 top = 0, bottom = 0;
+
+    // 8.2.1 of H.264
+    if (sps->pic_order_cnt_type == 0)
+    {
+        if (hdr->IdrPicFlag)
+        {
+            m_prevPicOrderCntMsb = 0;
+            m_prevPicOrderCntLsb = 0;
+        }
+
+        mfxI32 maxLsb = 1 << sps->log2_max_pic_order_cnt_lsb;
+        mfxI32 lsb = hdr->pic_order_cnt_lsb;
+        mfxI32 msb = m_prevPicOrderCntMsb;
+
+        if (lsb < m_prevPicOrderCntLsb && m_prevPicOrderCntLsb - lsb >= maxLsb / 2)
+            msb += maxLsb;
+        else if (lsb > m_prevPicOrderCntLsb && lsb - m_prevPicOrderCntLsb > maxLsb / 2)
+            msb -= maxLsb;
+
+        top = bottom = msb + lsb;
+        if (!hdr->field_pic_flag)
+            bottom += hdr->delta_pic_order_cnt_bottom;
+
+        if (isRef)
+        {
+            m_prevPicOrderCntMsb = msb;
+            m_prevPicOrderCntLsb = lsb;
+        }
+    }
+    else
+    {
+        mfxI32 maxFrameNum = 1 << sps->log2_max_frame_num;
+        mfxI32 frameNumOffset = 0;
+
+        if (!hdr->IdrPicFlag)
+            frameNumOffset = m_prevFrameNumOffset + ((m_prevFrameNum > hdr->frame_num) ? maxFrameNum : 0);
+
+        if (sps->pic_order_cnt_type == 1)
+        {
+            mfxI32 cycleLength = sps->num_ref_frames_in_pic_order_cnt_cycle;
+            mfxI32 absFrameNum = cycleLength ? frameNumOffset + hdr->frame_num : 0;
+            if (!isRef && absFrameNum > 0)
+                absFrameNum--;
+
+            mfxI32 expected = 0;
+            if (absFrameNum > 0)
+            {
+                mfxI32 expectedDeltaPerCycle = 0;
+                for (mfxI32 i = 0; i < cycleLength; i++)
+                    expectedDeltaPerCycle += sps->poffset_for_ref_frame[i];
+
+                mfxI32 inCycle = (absFrameNum - 1) % cycleLength;
+                expected = ((absFrameNum - 1) / cycleLength) * expectedDeltaPerCycle;
+                for (mfxI32 i = 0; i <= inCycle; i++)
+                    expected += sps->poffset_for_ref_frame[i];
+            }
+            if (!isRef)
+                expected += sps->offset_for_non_ref_pic;
+
+            if (!hdr->field_pic_flag)
+            {
+                top = expected + hdr->delta_pic_order_cnt[0];
+                bottom = top + sps->offset_for_top_to_bottom_field + hdr->delta_pic_order_cnt[1];
+            }
+            else if (!isBottomField)
+                top = bottom = expected + hdr->delta_pic_order_cnt[0];
+            else
+                top = bottom = expected + sps->offset_for_top_to_bottom_field + hdr->delta_pic_order_cnt[0];
+        }
+        else
+        {
+            top = bottom = hdr->IdrPicFlag ? 0 : 2 * (frameNumOffset + hdr->frame_num) - (isRef ? 0 : 1);
+        }
+
+        m_prevFrameNum = hdr->frame_num;
+        m_prevFrameNumOffset = frameNumOffset;
+    }
+
+    mfxI32 poc = hdr->field_pic_flag ? (isBottomField ? bottom : top) : MSDK_MIN(top, bottom);
+
+    if (pSlice->m_bHasMMCO5)
+    {
+        // the picture is treated as if it were the first one after IDR
+        m_prevPicOrderCntMsb = 0;
+        m_prevPicOrderCntLsb = isBottomField ? 0 : top - poc;
+        m_prevFrameNum = 0;
+        m_prevFrameNumOffset = 0;
+    }
+
+    return poc;
+}
+
+AccessUnitInfo AVCIndexer::StartAccessUnit(mfxU64 offset, AVCSlice * pSlice)
+{
+    const AVCSliceHeader *hdr = pSlice->GetSliceHeader();
+    const AVCSeqParamSet *sps = pSlice->m_seqParamSet;
+
+    if (!m_nFrameRateExtN && sps->timing_info_present_flag && sps->num_units_in_tick && sps->time_scale)
+    {
+        m_nFrameRateExtN = sps->time_scale;
+        m_nFrameRateExtD = 2 * sps->num_units_in_tick;
+    }
+
+    AccessUnitInfo unit;
+    MSDK_ZERO_MEMORY(unit);
+    unit.Offset = offset;
+    unit.Timestamp = GetPicOrderCnt(pSlice);
+    if (hdr->IdrPicFlag)
+    {
+        unit.FrameType |= MFX_FRAMETYPE_IDR;
+        unit.Flags |= AU_FLAG_KEY_FRAME;
+    }
+    if (hdr->nal_ref_idc)
+        unit.FrameType |= MFX_FRAMETYPE_REF;
+
+    return unit;
+}
+
+mfxStatus AVCIndexer::ProcessNalUnit(mfxI32 nalType, mfxBitstream * nalUnit)
+{
+    if (!nalUnit)
+        return AVC_Spl::ProcessNalUnit(nalType, nalUnit);
+
+    mfxU64 offset = GetStartCodeOffset(nalUnit);
+    mfxU32 nSlices = m_frame.SliceNum;
+    mfxU32 nField = m_currentInfo ? m_currentInfo->m_index : 0;
+
+    mfxStatus sts = AVC_Spl::ProcessNalUnit(nalType, nalUnit);
+
+    if (nalType == NAL_UT_SLICE || nalType == NAL_UT_IDR_SLICE || nalType == NAL_UT_CODED_SLICE_EXTENSION)
+    {
+        mfxU64 unitOffset = (m_nPrefixOffset != NO_OFFSET) ? m_nPrefixOffset : offset;
+
+        AccessUnitInfo *pUnit = m_bHasUnit ? &m_unit : NULL;
+
+        if (MFX_ERR_NONE == sts && m_pLastSlice)
+        {
+            // the slice begins the next frame, the splitter adds it to the frame at the next call
+            m_nextUnit = StartAccessUnit(unitOffset, m_pLastSlice);
+            m_bHasNextUnit = true;
+            pUnit = &m_nextUnit;
+        }
+        else if (!nSlices && m_frame.SliceNum)
+        {
+            m_unit = StartAccessUnit(unitOffset, &m_slicesStorage.back());
+            m_bHasUnit = true;
+            pUnit = &m_unit;
+        }
+        else if (m_currentInfo && !nField && m_currentInfo->m_index)
+        {
+            // the second field of the frame
+            GetPicOrderCnt(&m_slicesStorage.back());
+        }
+
+        // parameter sets met between slices of a frame lie inside the current access unit
+        if (m_bPrefixHasParamSets && pUnit)
+            pUnit->Flags |= AU_FLAG_PARAM_SETS;
+
+        m_nPrefixOffset = NO_OFFSET;
+        m_bPrefixHasParamSets = false;
+    }
+    else
+    {
+        if (IsAccessUnitPrefix(nalType) && m_nPrefixOffset == NO_OFFSET)
+            m_nPrefixOffset = offset;
+        if (nalType == NAL_UT_SPS || nalType == NAL_UT_PPS)
+            m_bPrefixHasParamSets = true;
+    }
+
+    return sts;
+}
+
+mfxStatus AVCIndexer::Run(std::vector<AccessUnitInfo> &units)
+{
+    bool bEndOfStream = false;
+    SetWindow(m_window, m_pStream, m_nStreamSize, 0);
+
+    for (;;)
+    {
+        FrameSplitterInfo *pFrame = NULL;
+        mfxStatus sts = GetFrame(bEndOfStream ? NULL : &m_window, &pFrame);
+
+        if (MFX_ERR_MORE_DATA == sts)
+        {
+            if (bEndOfStream)
+                break;
+
+            mfxU64 nBase = m_nWindowBase + m_window.DataOffset;
+            if (nBase + m_window.DataLength >= m_nStreamSize)
+            {
+                bEndOfStream = true;
+                continue;
+            }
+
+            // the rest of the window is passed again as the beginning of the next one
+            DetachInput();
+            SetWindow(m_window, m_pStream, m_nStreamSize, nBase);
+            m_nWindowBase = nBase;
+            continue;
+        }
+        MSDK_CHECK_RESULT(sts, MFX_ERR_NONE, sts);
+
+        if (m_bHasUnit)
+        {
+            mfxU16 frameType = MFX_FRAMETYPE_I;
+            for (mfxU32 i = 0; i < pFrame->SliceNum; i++)
+            {
+                if (TYPE_B == pFrame->Slice[i].SliceType)
+                    frameType = MFX_FRAMETYPE_B;
+                else if (TYPE_P == pFrame->Slice[i].SliceType && MFX_FRAMETYPE_B != frameType)
+                    frameType = MFX_FRAMETYPE_P;
+            }
+            m_unit.FrameType |= frameType;
+
+            units.push_back(m_unit);
+        }
+        ResetCurrentState();
+
+        m_unit = m_nextUnit;
+        m_bHasUnit = m_bHasNextUnit;
+        m_bHasNextUnit = false;
+    }
+
+    // access units last till the next one
+    for (size_t i = 0; i < units.size(); i++)
+    {
+        mfxU64 end = (i + 1 < units.size()) ? units[i + 1].Offset : m_nStreamSize;
+        units[i].Size = (mfxU32)(end - units[i].Offset);
+    }
+
+    return MFX_ERR_NONE;
+}
+
+// Uses the frame reader to check the IVF header, frames are parsed in the mapped stream.
+class IVFIndexer : public CIVFFrameReader
+{
+public:
+    mfxStatus Run(const msdk_char *strFileName, const mfxU8 *pStream, mfxU64 nStreamSize, std::vector<AccessUnitInfo> &units);
+
+    mfxU32 m_nFrameRateExtN;
+    mfxU32 m_nFrameRateExtD;
+};
+
+mfxStatus IVFIndexer::Run(const msdk_char *strFileName, const mfxU8 *pStream, mfxU64 nStreamSize, std::vector<AccessUnitInfo> &units)
+{
+    mfxStatus sts = Init(strFileName);
+    MSDK_CHECK_RESULT(sts, MFX_ERR_NONE, sts);
+    Close();
+
+    m_nFrameRateExtN = m_hdr.frame_rate;
+    m_nFrameRateExtD = m_hdr.time_scale;
+
+    // each frame is preceded by 4 bytes of its size and 8 bytes of its timestamp
+    const mfxU32 FRAME_HEADER_SIZE = 12;
+
+    for (mfxU64 offset = m_hdr.header_len; offset + FRAME_HEADER_SIZE <= nStreamSize; )
+    {
+        mfxU32 nSize = 0;
+        mfxU64 nTimeStamp = 0;
+        memcpy(&nSize, pStream + offset, sizeof(nSize));
+        memcpy(&nTimeStamp, pStream + offset + sizeof(nSize), sizeof(nTimeStamp));
+        offset += FRAME_HEADER_SIZE;
+
+        if (!nSize || offset + nSize > nStreamSize)
+            break;
+
+        AccessUnitInfo unit;
+        MSDK_ZERO_MEMORY(unit);
+        unit.Offset = offset;
+        unit.Size = nSize;
+        unit.Timestamp = (mfxI64)nTimeStamp;
+
+        // the lowest bit of VP8 frame tag is 0 for key frames
+        if (!(pStream[offset] & 1))
+        {
+            unit.FrameType = MFX_FRAMETYPE_I | MFX_FRAMETYPE_IDR | MFX_FRAMETYPE_REF;
+            unit.Flags = AU_FLAG_KEY_FRAME;
+        }
+        else
+        {
+            unit.FrameType = MFX_FRAMETYPE_P | MFX_FRAMETYPE_REF;
+        }
+
+        units.push_back(unit);
+        offset += nSize;
+    }
+
+    return MFX_ERR_NONE;
+}
+
+// pictures are found by SOI and EOI markers the same way the JPEG frame reader does,
+// marker segments are skipped by their lengths
+mfxStatus BuildJPEGIndex(mfxU8 *pStream, mfxU64 nStreamSize, std::vector<AccessUnitInfo> &units)
+{
+    mfxBitstream window;
+    MSDK_ZERO_MEMORY(window);
+
+    mfxU64 nBase = 0;
+    while (nBase < nStreamSize)
+    {
+        SetWindow(window, pStream, nStreamSize, nBase);
+
+        mfxU32 nStart = CJPEGFrameReader::FindMarker(&window, 0, CJPEGFrameReader::SOI);
+        if (0xFFFFFFFF == nStart)
+            break;
+
+        CJPEGFrameReader::ScanState state;
+        state.nOffset = nStart + 2;
+        state.bEntropyCoded = false;
+        mfxU32 nEnd = CJPEGFrameReader::FindPictureEnd(window.Data, window.DataLength, state);
+        if (0xFFFFFFFF == nEnd)
+        {
+            // the last picture is incomplete or the picture does not fit into the window
+            if (!nStart || nBase + window.DataLength >= nStreamSize)
+                break;
+
+            nBase += nStart;
+            continue;
+        }
+
+        AccessUnitInfo unit;
+        MSDK_ZERO_MEMORY(unit);
+        unit.Offset = nBase + nStart;
+        unit.Size = nEnd - nStart;
+        unit.FrameType = MFX_FRAMETYPE_I | MFX_FRAMETYPE_IDR | MFX_FRAMETYPE_REF;
+        unit.Flags = AU_FLAG_KEY_FRAME;
+        unit.Timestamp = (mfxI64)units.size();
+        units.push_back(unit);
+
+        nBase += nEnd;
+    }
+
+    return MFX_ERR_NONE;
+}
+
+} // namespace
+
+CBitstreamIndex::CBitstreamIndex()
+{
+    Clear();
+}
+
+void CBitstreamIndex::Clear()
+{
+    m_nCodecId = 0;
+    m_nStreamSize = 0;
+    m_nStreamChecksum = 0;
+    m_nFrameRateExtN = 0;
+    m_nFrameRateExtD = 0;
+    m_units.clear();
+}
+
+bool CBitstreamIndex::IsCodecSupported(mfxU32 nCodecId)
+{
+    return MFX_CODEC_AVC == nCodecId || CODEC_VP8 == nCodecId || MFX_CODEC_JPEG == nCodecId;
+}
+
+msdk_tstring CBitstreamIndex::GetIndexName(const msdk_char *strFileName)
+{
+    return msdk_tstring(strFileName) + MSDK_STRING(".idx");
+}
+
+mfxStatus CBitstreamIndex::Open(const msdk_char *strFileName, mfxU32 nCodecId, bool bCreate)
+{
+    MSDK_CHECK_POINTER(strFileName, MFX_ERR_NULL_PTR);
+
+    // only the pages of the head and the tail are read
+    mfxU64 nStreamSize = 0;
+    mfxU8 *pStream = msdk_file_map(strFileName, &nStreamSize);
+    MSDK_CHECK_POINTER(pStream, MFX_ERR_NOT_FOUND);
+    mfxU64 nStreamChecksum = GetStreamChecksum(pStream, nStreamSize);
+    msdk_file_unmap(pStream, nStreamSize);
+
+    msdk_tstring strIndexName = GetIndexName(strFileName);
+
+    mfxStatus sts = Load(strIndexName.c_str(), nStreamSize, nStreamChecksum);
+    if (MFX_ERR_NONE == sts && (!nCodecId || nCodecId == m_nCodecId))
+        return MFX_ERR_NONE;
+
+    if (!bCreate)
+        return MFX_ERR_NOT_FOUND;
+
+    sts = Build(strFileName, nCodecId);
+    MSDK_CHECK_RESULT(sts, MFX_ERR_NONE, sts);
+
+    return Save(strIndexName.c_str());
+}
+
+mfxStatus CBitstreamIndex::Build(const msdk_char *strFileName, mfxU32 nCodecId)
+{
+    MSDK_CHECK_POINTER(strFileName, MFX_ERR_NULL_PTR);
+    MSDK_CHECK_ERROR(IsCodecSupported(nCodecId), false, MFX_ERR_UNSUPPORTED);
+
+    Clear();
+
+    mfxU64 nStreamSize = 0;
+    mfxU8 *pStream = msdk_file_map(strFileName, &nStreamSize);
+    MSDK_CHECK_POINTER(pStream, MFX_ERR_UNSUPPORTED);
+
+    mfxStatus sts = MFX_ERR_NONE;
+    switch (nCodecId)
+    {
+    case MFX_CODEC_AVC:
+        {
+            AVCIndexer indexer(pStream, nStreamSize);
+            sts = indexer.Run(m_units);
+            m_nFrameRateExtN = indexer.m_nFrameRateExtN;
+            m_nFrameRateExtD = indexer.m_nFrameRateExtD;
+        }
+        break;
+    case CODEC_VP8:
+        {
+            IVFIndexer indexer;
+            sts = indexer.Run(strFileName, pStream, nStreamSize, m_units);
+            m_nFrameRateExtN = indexer.m_nFrameRateExtN;
+            m_nFrameRateExtD = indexer.m_nFrameRateExtD;
+        }
+        break;
+    case MFX_CODEC_JPEG:
+        sts = BuildJPEGIndex(pStream, nStreamSize, m_units);
+        break;
+    }
+
+    mfxU64 nStreamChecksum = GetStreamChecksum(pStream, nStreamSize);
+    msdk_file_unmap(pStream, nStreamSize);
+    MSDK_CHECK_RESULT(sts, MFX_ERR_NONE, sts);
+
+    m_nCodecId = nCodecId;
+    m_nStreamSize = nStreamSize;
+    m_nStreamChecksum = nStreamChecksum;
+
+    return MFX_ERR_NONE;
+}
+
+mfxStatus CBitstreamIndex::Load(const msdk_char *strIndexName, mfxU64 nStreamSize, mfxU64 nStreamChecksum)
+{
+    MSDK_CHECK_POINTER(strIndexName, MFX_ERR_NULL_PTR);
+
+    Clear();
+
+    FILE *pFile = NULL;
+    MSDK_FOPEN(pFile, strIndexName, MSDK_STRING("rb"));
+    MSDK_CHECK_POINTER(pFile, MFX_ERR_NOT_FOUND);
+
+    mfxU64 nIndexSize = msdk_file_get_size(pFile);
+
+    IndexFileHeader header;
+    bool bValid = fread(&header, sizeof(header), 1, pFile) == 1 &&
+        INDEX_SIGNATURE == header.Signature &&
+        INDEX_VERSION == header.Version &&
+        sizeof(AccessUnitInfo) == header.EntrySize &&
+        nStreamSize == header.StreamSize &&
+        nStreamChecksum == header.StreamChecksum &&
+        nIndexSize == sizeof(header) + header.NumUnits * sizeof(AccessUnitInfo);
+
+    if (bValid && header.NumUnits)
+    {
+        m_units.resize((size_t)header.NumUnits);
+        bValid = fread(&m_units[0], sizeof(AccessUnitInfo), m_units.size(), pFile) == m_units.size();
+    }
+    fclose(pFile);
+
+    if (!bValid)
+    {
+        Clear();
+        return MFX_ERR_NOT_FOUND;
+    }
+
+    m_nCodecId = header.CodecId;
+    m_nStreamSize = header.StreamSize;
+    m_nStreamChecksum = header.StreamChecksum;
+    m_nFrameRateExtN = header.FrameRateExtN;
+    m_nFrameRateExtD = header.FrameRateExtD;
+
+    return MFX_ERR_NONE;
+}
+
+mfxStatus CBitstreamIndex::Save(const msdk_char *strIndexName) const
+{
+    MSDK_CHECK_POINTER(strIndexName, MFX_ERR_NULL_PTR);
+
+    IndexFileHeader header;
+    MSDK_ZERO_MEMORY(header);
+    header.Signature = INDEX_SIGNATURE;
+    header.Version = INDEX_VERSION;
+    header.EntrySize = sizeof(AccessUnitInfo);
+    header.CodecId = m_nCodecId;
+    header.FrameRateExtN = m_nFrameRateExtN;
+    header.FrameRateExtD = m_nFrameRateExtD;
+    header.StreamSize = m_nStreamSize;
+    header.StreamChecksum = m_nStreamChecksum;
+    header.NumUnits = m_units.size();
+
+    FILE *pFile = NULL;
+    MSDK_FOPEN(pFile, strIndexName, MSDK_STRING("wb"));
+    MSDK_CHECK_POINTER(pFile, MFX_ERR_NULL_PTR);
+
+    bool bWritten = fwrite(&header, sizeof(header), 1, pFile) == 1 &&
+        (m_units.empty() || fwrite(&m_units[0], sizeof(AccessUnitInfo), m_units.size(), pFile) == m_units.size());
+    bWritten = (0 == fclose(pFile)) && bWritten;
+    MSDK_CHECK_NOT_EQUAL(bWritten, true, MFX_ERR_UNDEFINED_BEHAVIOR);
+
+    return MFX_ERR_NONE;
+}
+
+mfxU32 CBitstreamIndex::FindKeyFrame(mfxU32 nFrame) const
+{
+    for (mfxU32 i = MSDK_MIN(nFrame, GetCount() - 1) + 1; i-- > 0; )
+    {
+        if (m_units[i].Flags & AU_FLAG_KEY_FRAME)
+            return i;
+    }
+    return GetCount();
+}
+
+mfxU32 CBitstreamIndex::FindNextKeyFrame(mfxU32 nFrame) const
+{
+    for (mfxU32 i = nFrame + 1; i < GetCount(); i++)
+    {
+        if (m_units[i].Flags & AU_FLAG_KEY_FRAME)
+            return i;
+    }
+    return GetCount();
+}
+
+mfxF64 CBitstreamIndex::GetDuration() const
+{
+    if (!m_nFrameRateExtN || !m_nFrameRateExtD)
+        return 0;
+
+    return (mfxF64)GetCount() * m_nFrameRateExtD / m_nFrameRateExtN;
+}
+
+CIndexedFrameReader::CIndexedFrameReader()
+    : m_nFirst(0)
+    , m_nEnd(0)
+    , m_nNext(0)
+{
+}
+
+mfxStatus CIndexedFrameReader::Init(const msdk_char *strFileName)
+{
+    return Init(strFileName, 0, false);
+}
+
+mfxStatus CIndexedFrameReader::Init(const msdk_char *strFileName, mfxU32 nCodecId, bool bCreateIndex)
+{
+    mfxStatus sts = m_index.Open(strFileName, nCodecId, bCreateIndex);
+    MSDK_CHECK_RESULT(sts, MFX_ERR_NONE, sts);
+
+    sts = CSmplBitstreamReader::Init(strFileName);
+    MSDK_CHECK_RESULT(sts, MFX_ERR_NONE, sts);
+
+    return SetRange(0, m_index.GetCount());
+}
+
+void CIndexedFrameReader::Reset()
+{
+    m_nNext = m_nFirst;
+}
+
+mfxStatus CIndexedFrameReader::SetRange(mfxU32 nFirst, mfxU32 nCount)
+{
+    MSDK_CHECK_ERROR(nFirst > m_index.GetCount(), true, MFX_ERR_INVALID_VIDEO_PARAM);
+
+    m_nFirst = nFirst;
+    m_nEnd = nFirst + MSDK_MIN(nCount, m_index.GetCount() - nFirst);
+    m_nNext = nFirst;
+
+    m_paramSets.clear();
+    if (MFX_CODEC_AVC == m_index.GetCodecId() && nFirst < m_nEnd && nFirst &&
+        !(m_index.GetUnit(nFirst).Flags & AU_FLAG_PARAM_SETS))
+    {
+        return CollectParamSets(nFirst);
+    }
+
+    return MFX_ERR_NONE;
+}
+
+mfxStatus CIndexedFrameReader::CollectParamSets(mfxU32 nFirst)
+{
+    // NAL units are kept in the order they were sent with their start codes, a repeated one is moved to the end,
+    // so the decoder ends up with the last version of each parameter set
+    std::vector< std::vector<mfxU8> > nalUnits;
+    std::vector<mfxU8> unitData;
+
+    for (mfxU32 i = 0; i < nFirst; i++)
+    {
+        const AccessUnitInfo &unit = m_index.GetUnit(i);
+        if (!(unit.Flags & AU_FLAG_PARAM_SETS) || !unit.Size)
+            continue;
+
+        unitData.resize(unit.Size);
+        mfxU32 nBytesRead = msdk_file_read_at(m_fSource, &unitData[0], unit.Size, unit.Offset);
+        MSDK_CHECK_NOT_EQUAL(nBytesRead, unit.Size, MFX_ERR_MORE_DATA);
+
+        const mfxU8 *pEnd = &unitData[0] + unit.Size;
+        const mfxU8 *pNal = FindStartCodePrefix(&unitData[0], pEnd);
+        while (pNal != pEnd)
+        {
+            pNal += 3;
+            const mfxU8 *pNext = FindStartCodePrefix(pNal, pEnd);
+            mfxI32 nalType = (pNal != pEnd) ? (*pNal & NAL_UNITTYPE_BITS) : 0;
+
+            if (nalType == NAL_UT_SPS || nalType == NAL_UT_PPS)
+            {
+                // zero bytes before the next start code are not a part of the NAL unit
+                const mfxU8 *pNalEnd = pNext;
+                while (pNalEnd > pNal && !pNalEnd[-1])
+                    pNalEnd--;
+
+                static const mfxU8 startCode[] = { 0, 0, 0, 1 };
+                std::vector<mfxU8> nalUnit(startCode, startCode + sizeof(startCode));
+                nalUnit.insert(nalUnit.end(), pNal, pNalEnd);
+
+                for (size_t j = 0; j < nalUnits.size(); j++)
+                {
+                    if (nalUnits[j] == nalUnit)
+                    {
+                        nalUnits.erase(nalUnits.begin() + j);
+                        break;
+                    }
+                }
+                nalUnits.push_back(nalUnit);
+            }
+            pNal = pNext;
+        }
+    }
+
+    for (size_t j = 0; j < nalUnits.size(); j++)
+        m_paramSets.insert(m_paramSets.end(), nalUnits[j].begin(), nalUnits[j].end());
+
+    return MFX_ERR_NONE;
+}
+
+mfxStatus CIndexedFrameReader::SeekFrame(mfxU32 nFrame, mfxU32 *pKeyFrame)
+{
+    mfxU32 nKeyFrame = m_index.FindKeyFrame(nFrame);
+    MSDK_CHECK_ERROR(nKeyFrame, m_index.GetCount(), MFX_ERR_NOT_FOUND);
+
+    if (pKeyFrame)
+        *pKeyFrame = nKeyFrame;
+
+    return SetRange(nKeyFrame, m_index.GetCount());
+}
+
+mfxStatus CIndexedFrameReader::ReadNextFrame(mfxBitstream *pBS)
+{
+    MSDK_CHECK_POINTER(pBS, MFX_ERR_NULL_PTR);
+    MSDK_CHECK_ERROR(m_bInited, false, MFX_ERR_NOT_INITIALIZED);
+
+    if (m_nNext >= m_nEnd)
+        return MFX_ERR_MORE_DATA;
+
+    const AccessUnitInfo &unit = m_index.GetUnit(m_nNext);
+
+    memmove(pBS->Data, pBS->Data + pBS->DataOffset, pBS->DataLength);
+    pBS->DataOffset = 0;
+
+    // the first frame of the range carries parameter sets sent earlier in the stream
+    mfxU32 nPrefixSize = (m_nNext == m_nFirst) ? (mfxU32)m_paramSets.size() : 0;
+
+    if (nPrefixSize + unit.Size > pBS->MaxLength - pBS->DataLength)
+    {
+        mfxStatus sts = ExtendMfxBitstream(pBS, pBS->DataLength + nPrefixSize + unit.Size);
+        MSDK_CHECK_RESULT(sts, MFX_ERR_NONE, sts);
+    }
+
+    mfxU32 nBytesRead = msdk_file_read_at(m_fSource, pBS->Data + pBS->DataLength + nPrefixSize, unit.Size, unit.Offset);
+    if (nBytesRead != unit.Size)
+        return MFX_ERR_MORE_DATA;
+
+    if (nPrefixSize)
+    {
+        // an access unit delimiter has to stay the first NAL unit of the access unit
+        mfxU8 *pUnit = pBS->Data + pBS->DataLength + nPrefixSize;
+        const mfxU8 *pNal = FindStartCodePrefix(pUnit, pUnit + unit.Size);
+        mfxU32 nDelimiterSize = 0;
+        if (pNal + 3 < pUnit + unit.Size && NAL_UT_AUD == (pNal[3] & NAL_UNITTYPE_BITS))
+            nDelimiterSize = (mfxU32)(FindStartCodePrefix(pNal + 3, pUnit + unit.Size) - pUnit);
+
+        memmove(pBS->Data + pBS->DataLength, pUnit, nDelimiterSize);
+        MSDK_MEMCPY_BUF(pBS->Data, pBS->DataLength + nDelimiterSize, pBS->MaxLength, &m_paramSets[0], nPrefixSize);
+    }
+
+    pBS->DataLength += nPrefixSize + unit.Size;
+    pBS->DataFlag = MFX_BITSTREAM_COMPLETE_FRAME;
+    m_nNext++;
+
+    return MFX_ERR_NONE;
+}
@@ -0,0 +1,228 @@
+/******************************************************************************\
+Copyright (c) 2005-2016, Intel Corporation
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without modification, are permitted provided that the following conditions are met:
+
+1. Redistributions of source code must retain the above copyright notice, this list of conditions and the following disclaimer.
+
+2. Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the following disclaimer in the documentation and/or other materials provided with the distribution.
+
+3. Neither the name of the copyright holder nor the names of its contributors may be used to endorse or promote products derived from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+This sample was distributed or derived from the Intel's Media Samples package.
+The original version of this sample may be obtained from https://software.intel.com/en-us/intel-media-server-studio
+or https://software.intel.com/en-us/media-client-solutions-support.
+\**********************************************************************************/
+
+#include "mfx_samples_config.h"
+
+#include <emmintrin.h>
+#include <immintrin.h>
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#define MSDK_TARGET_AVX2
+#else
+#define MSDK_TARGET_AVX2 __attribute__((target("avx2")))
+#endif
+
+#include "bitstream_scan.h"
+#include "sample_utils.h"
+
+namespace
+{
+    typedef const mfxU8* (*FindPrefixFunc)(const mfxU8* pBegin, const mfxU8* pEnd, mfxU8 nLast);
+    typedef const mfxU8* (*FindByteFunc)(const mfxU8* pBegin, const mfxU8* pEnd, mfxU8 nValue);
+    typedef void (*SwapBytes32Func)(mfxU8* pData, mfxU32 nCount);
+
+    struct ScanKernels
+    {
+        FindPrefixFunc  FindPrefix;
+        FindByteFunc    FindByte;
+        SwapBytes32Func SwapBytes32;
+    };
+
+    // index of the lowest set bit, nMask != 0
+    inline mfxU32 LowestBit(mfxU32 nMask)
+    {
+#if defined(_MSC_VER)
+        unsigned long nIndex;
+        _BitScanForward(&nIndex, nMask);
+        return nIndex;
+#else
+        return __builtin_ctz(nMask);
+#endif
+    }
+
+    // finds 00 00 nLast
+    const mfxU8* FindPrefix_C(const mfxU8* p, const mfxU8* pEnd, mfxU8 nLast)
+    {
+        for (; pEnd - p >= 3; p++)
+        {
+            if (0 == p[0] && 0 == p[1] && nLast == p[2])
+                return p;
+        }
+        return pEnd;
+    }
+
+    // a block is checked for zero bytes first: the prefix can start only at a zero byte,
+    // and blocks without zeros are the most common case in coded data
+    const mfxU8* FindPrefix_SSE2(const mfxU8* p, const mfxU8* pEnd, mfxU8 nLast)
+    {
+        const __m128i zero = _mm_setzero_si128();
+        const __m128i last = _mm_set1_epi8((char)nLast);
+
+        // a block of 16 candidate positions reads 2 bytes beyond it
+        for (; pEnd - p >= 18; p += 16)
+        {
+            __m128i b0 = _mm_cmpeq_epi8(_mm_loadu_si128((const __m128i*)p), zero);
+            if (!_mm_movemask_epi8(b0))
+                continue;
+
+            __m128i b1 = _mm_cmpeq_epi8(_mm_loadu_si128((const __m128i*)(p + 1)), zero);
+            __m128i b2 = _mm_cmpeq_epi8(_mm_loadu_si128((const __m128i*)(p + 2)), last);
+            mfxU32 nMask = _mm_movemask_epi8(_mm_and_si128(_mm_and_si128(b0, b1), b2));
+            if (nMask)
+                return p + LowestBit(nMask);
+        }
+        return FindPrefix_C(p, pEnd, nLast);
+    }
+
+    MSDK_TARGET_AVX2 const mfxU8* FindPrefix_AVX2(const mfxU8* p, const mfxU8* pEnd, mfxU8 nLast)
+    {
+        const __m256i zero = _mm256_setzero_si256();
+        const __m256i last = _mm256_set1_epi8((char)nLast);
+
+        for (; pEnd - p >= 34; p += 32)
+        {
+            __m256i b0 = _mm256_cmpeq_epi8(_mm256_loadu_si256((const __m256i*)p), zero);
+            if (!_mm256_movemask_epi8(b0))
+                continue;
+
+            __m256i b1 = _mm256_cmpeq_epi8(_mm256_loadu_si256((const __m256i*)(p + 1)), zero);
+            __m256i b2 = _mm256_cmpeq_epi8(_mm256_loadu_si256((const __m256i*)(p + 2)), last);
+            mfxU32 nMask = (mfxU32)_mm256_movemask_epi8(_mm256_and_si256(_mm256_and_si256(b0, b1), b2));
+            if (nMask)
+                return p + LowestBit(nMask);
+        }
+        return FindPrefix_SSE2(p, pEnd, nLast);
+    }
+
+    const mfxU8* FindByte_C(const mfxU8* p, const mfxU8* pEnd, mfxU8 nValue)
+    {
+        for (; p < pEnd; p++)
+        {
+            if (nValue == *p)
+                return p;
+        }
+        return pEnd;
+    }
+
+    const mfxU8* FindByte_SSE2(const mfxU8* p, const mfxU8* pEnd, mfxU8 nValue)
+    {
+        const __m128i value = _mm_set1_epi8((char)nValue);
+
+        for (; pEnd - p >= 16; p += 16)
+        {
+            mfxU32 nMask = _mm_movemask_epi8(_mm_cmpeq_epi8(_mm_loadu_si128((const __m128i*)p), value));
+            if (nMask)
+                return p + LowestBit(nMask);
+        }
+        return FindByte_C(p, pEnd, nValue);
+    }
+
+    MSDK_TARGET_AVX2 const mfxU8* FindByte_AVX2(const mfxU8* p, const mfxU8* pEnd, mfxU8 nValue)
+    {
+        const __m256i value = _mm256_set1_epi8((char)nValue);
+
+        for (; pEnd - p >= 32; p += 32)
+        {
+            mfxU32 nMask = (mfxU32)_mm256_movemask_epi8(_mm256_cmpeq_epi8(_mm256_loadu_si256((const __m256i*)p), value));
+            if (nMask)
+                return p + LowestBit(nMask);
+        }
+        return FindByte_SSE2(p, pEnd, nValue);
+    }
+
+    void SwapBytes32_C(mfxU8* p, mfxU32 nCount)
+    {
+        for (mfxU32 i = 0; i < nCount; i++, p += 4)
+        {
+            mfxU8 b0 = p[0], b1 = p[1];
+            p[0] = p[3];
+            p[1] = p[2];
+            p[2] = b1;
+            p[3] = b0;
+        }
+    }
+
+    void SwapBytes32_SSE2(mfxU8* p, mfxU32 nCount)
+    {
+        mfxU32 i = 0;
+        for (; i + 4 <= nCount; i += 4, p += 16)
+        {
+            __m128i v = _mm_loadu_si128((const __m128i*)p);
+            // swap bytes in words, then words in dwords
+            v = _mm_or_si128(_mm_slli_epi16(v, 8), _mm_srli_epi16(v, 8));
+            v = _mm_shufflehi_epi16(_mm_shufflelo_epi16(v, _MM_SHUFFLE(2, 3, 0, 1)), _MM_SHUFFLE(2, 3, 0, 1));
+            _mm_storeu_si128((__m128i*)p, v);
+        }
+        SwapBytes32_C(p, nCount - i);
+    }
+
+    MSDK_TARGET_AVX2 void SwapBytes32_AVX2(mfxU8* p, mfxU32 nCount)
+    {
+        const __m256i shuffle = _mm256_setr_epi8(3, 2, 1, 0, 7, 6, 5, 4, 11, 10, 9, 8, 15, 14, 13, 12,
+                                                 3, 2, 1, 0, 7, 6, 5, 4, 11, 10, 9, 8, 15, 14, 13, 12);
+        mfxU32 i = 0;
+        for (; i + 8 <= nCount; i += 8, p += 32)
+        {
+            __m256i v = _mm256_loadu_si256((const __m256i*)p);
+            _mm256_storeu_si256((__m256i*)p, _mm256_shuffle_epi8(v, shuffle));
+        }
+        SwapBytes32_SSE2(p, nCount - i);
+    }
+
+    ScanKernels SelectKernels()
+    {
+        ScanKernels k;
+        if (IsAVX2Supported())
+        {
+            k.FindPrefix  = FindPrefix_AVX2;
+            k.FindByte    = FindByte_AVX2;
+            k.SwapBytes32 = SwapBytes32_AVX2;
+        }
+        else
+        {
+            k.FindPrefix  = FindPrefix_SSE2;
+            k.FindByte    = FindByte_SSE2;
+            k.SwapBytes32 = SwapBytes32_SSE2;
+        }
+        return k;
+    }
+
+    const ScanKernels g_Kernels = SelectKernels();
+}
+
+const mfxU8* FindStartCodePrefix(const mfxU8* pBegin, const mfxU8* pEnd)
+{
+    return g_Kernels.FindPrefix(pBegin, pEnd, 1);
+}
+
+const mfxU8* FindEmulationPreventionPrefix(const mfxU8* pBegin, const mfxU8* pEnd)
+{
+    return g_Kernels.FindPrefix(pBegin, pEnd, 3);
+}
+
+const mfxU8* FindByte(const mfxU8* pBegin, const mfxU8* pEnd, mfxU8 nValue)
+{
+    return g_Kernels.FindByte(pBegin, pEnd, nValue);
+}
+
+void SwapBytes32(mfxU8* pData, mfxU32 nCount)
+{
+    g_Kernels.SwapBytes32(pData, nCount);
+}
@@ -0,0 +1,313 @@
+/******************************************************************************\
+Copyright (c) 2005-2016, Intel Corporation
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without modification, are permitted provided that the following conditions are met:
+
+1. Redistributions of source code must retain the above copyright notice, this list of conditions and the following disclaimer.
+
+2. Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the following disclaimer in the documentation and/or other materials provided with the distribution.
+
+3. Neither the name of the copyright holder nor the names of its contributors may be used to endorse or promote products derived from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+This sample was distributed or derived from the Intel's Media Samples package.
+The original version of this sample may be obtained from https://software.intel.com/en-us/intel-media-server-studio
+or https://software.intel.com/en-us/media-client-solutions-support.
+\**********************************************************************************/
+
+#include "mfx_samples_config.h"
+
+#include <emmintrin.h>
+#include <immintrin.h>
+#include <string.h>
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#define MSDK_TARGET_AVX2
+#else
+#define MSDK_TARGET_AVX2 __attribute__((target("avx2")))
+#endif
+
+#include "chroma_conversion.h"
+#include "sample_utils.h"
+
+namespace
+{
+    // scalar versions, they also process tails of rows in SIMD versions
+    void Interleave_C(const mfxU8* pA, const mfxU8* pB, mfxU8* pDst, mfxU32 nCount)
+    {
+        for (mfxU32 i = 0; i < nCount; i++)
+        {
+            pDst[2 * i]     = pA[i];
+            pDst[2 * i + 1] = pB[i];
+        }
+    }
+
+    void Deinterleave_C(const mfxU8* pSrc, mfxU8* pA, mfxU8* pB, mfxU32 nCount)
+    {
+        for (mfxU32 i = 0; i < nCount; i++)
+        {
+            pA[i] = pSrc[2 * i];
+            pB[i] = pSrc[2 * i + 1];
+        }
+    }
+
+    void Interleave16_C(const mfxU16* pA, const mfxU16* pB, mfxU16* pDst, mfxU32 nCount)
+    {
+        for (mfxU32 i = 0; i < nCount; i++)
+        {
+            pDst[2 * i]     = pA[i];
+            pDst[2 * i + 1] = pB[i];
+        }
+    }
+
+    void Deinterleave16_C(const mfxU16* pSrc, mfxU16* pA, mfxU16* pB, mfxU32 nCount)
+    {
+        for (mfxU32 i = 0; i < nCount; i++)
+        {
+            pA[i] = pSrc[2 * i];
+            pB[i] = pSrc[2 * i + 1];
+        }
+    }
+
+    void Interleave_SSE2(const mfxU8* pA, const mfxU8* pB, mfxU8* pDst, mfxU32 nCount)
+    {
+        mfxU32 i = 0;
+        for (; i + 16 <= nCount; i += 16)
+        {
+            __m128i a = _mm_loadu_si128((const __m128i*)(pA + i));
+            __m128i b = _mm_loadu_si128((const __m128i*)(pB + i));
+            _mm_storeu_si128((__m128i*)(pDst + 2 * i),      _mm_unpacklo_epi8(a, b));
+            _mm_storeu_si128((__m128i*)(pDst + 2 * i + 16), _mm_unpackhi_epi8(a, b));
+        }
+        Interleave_C(pA + i, pB + i, pDst + 2 * i, nCount - i);
+    }
+
+    void Deinterleave_SSE2(const mfxU8* pSrc, mfxU8* pA, mfxU8* pB, mfxU32 nCount)
+    {
+        const __m128i mask = _mm_set1_epi16(0x00ff);
+        mfxU32 i = 0;
+        for (; i + 16 <= nCount; i += 16)
+        {
+            __m128i s0 = _mm_loadu_si128((const __m128i*)(pSrc + 2 * i));
+            __m128i s1 = _mm_loadu_si128((const __m128i*)(pSrc + 2 * i + 16));
+            _mm_storeu_si128((__m128i*)(pA + i), _mm_packus_epi16(_mm_and_si128(s0, mask), _mm_and_si128(s1, mask)));
+            _mm_storeu_si128((__m128i*)(pB + i), _mm_packus_epi16(_mm_srli_epi16(s0, 8), _mm_srli_epi16(s1, 8)));
+        }
+        Deinterleave_C(pSrc + 2 * i, pA + i, pB + i, nCount - i);
+    }
+
+    void Interleave16_SSE2(const mfxU16* pA, const mfxU16* pB, mfxU16* pDst, mfxU32 nCount)
+    {
+        mfxU32 i = 0;
+        for (; i + 8 <= nCount; i += 8)
+        {
+            __m128i a = _mm_loadu_si128((const __m128i*)(pA + i));
+            __m128i b = _mm_loadu_si128((const __m128i*)(pB + i));
+            _mm_storeu_si128((__m128i*)(pDst + 2 * i),     _mm_unpacklo_epi16(a, b));
+            _mm_storeu_si128((__m128i*)(pDst + 2 * i + 8), _mm_unpackhi_epi16(a, b));
+        }
+        Interleave16_C(pA + i, pB + i, pDst + 2 * i, nCount - i);
+    }
+
+    // a0 b0 a1 b1 a2 b2 a3 b3 -> a0 a1 a2 a3 b0 b1 b2 b3
+    inline __m128i GroupPairs16_SSE2(__m128i x)
+    {
+        x = _mm_shufflelo_epi16(x, _MM_SHUFFLE(3, 1, 2, 0));
+        x = _mm_shufflehi_epi16(x, _MM_SHUFFLE(3, 1, 2, 0));
+        return _mm_shuffle_epi32(x, _MM_SHUFFLE(3, 1, 2, 0));
+    }
+
+    void Deinterleave16_SSE2(const mfxU16* pSrc, mfxU16* pA, mfxU16* pB, mfxU32 nCount)
+    {
+        mfxU32 i = 0;
+        for (; i + 8 <= nCount; i += 8)
+        {
+            __m128i s0 = GroupPairs16_SSE2(_mm_loadu_si128((const __m128i*)(pSrc + 2 * i)));
+            __m128i s1 = GroupPairs16_SSE2(_mm_loadu_si128((const __m128i*)(pSrc + 2 * i + 8)));
+            _mm_storeu_si128((__m128i*)(pA + i), _mm_unpacklo_epi64(s0, s1));
+            _mm_storeu_si128((__m128i*)(pB + i), _mm_unpackhi_epi64(s0, s1));
+        }
+        Deinterleave16_C(pSrc + 2 * i, pA + i, pB + i, nCount - i);
+    }
+
+    // AVX2 unpack and pack instructions work within 128-bit lanes, so results are permuted back
+    MSDK_TARGET_AVX2 void Interleave_AVX2(const mfxU8* pA, const mfxU8* pB, mfxU8* pDst, mfxU32 nCount)
+    {
+        mfxU32 i = 0;
+        for (; i + 32 <= nCount; i += 32)
+        {
+            __m256i a  = _mm256_loadu_si256((const __m256i*)(pA + i));
+            __m256i b  = _mm256_loadu_si256((const __m256i*)(pB + i));
+            __m256i lo = _mm256_unpacklo_epi8(a, b);
+            __m256i hi = _mm256_unpackhi_epi8(a, b);
+            _mm256_storeu_si256((__m256i*)(pDst + 2 * i),      _mm256_permute2x128_si256(lo, hi, 0x20));
+            _mm256_storeu_si256((__m256i*)(pDst + 2 * i + 32), _mm256_permute2x128_si256(lo, hi, 0x31));
+        }
+        Interleave_SSE2(pA + i, pB + i, pDst + 2 * i, nCount - i);
+    }
+
+    MSDK_TARGET_AVX2 void Deinterleave_AVX2(const mfxU8* pSrc, mfxU8* pA, mfxU8* pB, mfxU32 nCount)
+    {
+        const __m256i mask = _mm256_set1_epi16(0x00ff);
+        mfxU32 i = 0;
+        for (; i + 32 <= nCount; i += 32)
+        {
+            __m256i s0 = _mm256_loadu_si256((const __m256i*)(pSrc + 2 * i));
+            __m256i s1 = _mm256_loadu_si256((const __m256i*)(pSrc + 2 * i + 32));
+            __m256i a  = _mm256_packus_epi16(_mm256_and_si256(s0, mask), _mm256_and_si256(s1, mask));
+            __m256i b  = _mm256_packus_epi16(_mm256_srli_epi16(s0, 8), _mm256_srli_epi16(s1, 8));
+            _mm256_storeu_si256((__m256i*)(pA + i), _mm256_permute4x64_epi64(a, _MM_SHUFFLE(3, 1, 2, 0)));
+            _mm256_storeu_si256((__m256i*)(pB + i), _mm256_permute4x64_epi64(b, _MM_SHUFFLE(3, 1, 2, 0)));
+        }
+        Deinterleave_SSE2(pSrc + 2 * i, pA + i, pB + i, nCount - i);
+    }
+
+    MSDK_TARGET_AVX2 void Interleave16_AVX2(const mfxU16* pA, const mfxU16* pB, mfxU16* pDst, mfxU32 nCount)
+    {
+        mfxU32 i = 0;
+        for (; i + 16 <= nCount; i += 16)
+        {
+            __m256i a  = _mm256_loadu_si256((const __m256i*)(pA + i));
+            __m256i b  = _mm256_loadu_si256((const __m256i*)(pB + i));
+            __m256i lo = _mm256_unpacklo_epi16(a, b);
+            __m256i hi = _mm256_unpackhi_epi16(a, b);
+            _mm256_storeu_si256((__m256i*)(pDst + 2 * i),      _mm256_permute2x128_si256(lo, hi, 0x20));
+            _mm256_storeu_si256((__m256i*)(pDst + 2 * i + 16), _mm256_permute2x128_si256(lo, hi, 0x31));
+        }
+        Interleave16_SSE2(pA + i, pB + i, pDst + 2 * i, nCount - i);
+    }
+
+    MSDK_TARGET_AVX2 void Deinterleave16_AVX2(const mfxU16* pSrc, mfxU16* pA, mfxU16* pB, mfxU32 nCount)
+    {
+        // a0 b0 a1 b1 a2 b2 a3 b3 -> a0 a1 a2 a3 b0 b1 b2 b3 in each lane
+        const __m256i shuffle = _mm256_setr_epi8(0, 1, 4, 5, 8, 9, 12, 13, 2, 3, 6, 7, 10, 11, 14, 15,
+                                                 0, 1, 4, 5, 8, 9, 12, 13, 2, 3, 6, 7, 10, 11, 14, 15);
+        mfxU32 i = 0;
+        for (; i + 16 <= nCount; i += 16)
+        {
+            __m256i s0 = _mm256_shuffle_epi8(_mm256_loadu_si256((const __m256i*)(pSrc + 2 * i)), shuffle);
+            __m256i s1 = _mm256_shuffle_epi8(_mm256_loadu_si256((const __m256i*)(pSrc + 2 * i + 16)), shuffle);
+            s0 = _mm256_permute4x64_epi64(s0, _MM_SHUFFLE(3, 1, 2, 0));
+            s1 = _mm256_permute4x64_epi64(s1, _MM_SHUFFLE(3, 1, 2, 0));
+            _mm256_storeu_si256((__m256i*)(pA + i), _mm256_permute2x128_si256(s0, s1, 0x20));
+            _mm256_storeu_si256((__m256i*)(pB + i), _mm256_permute2x128_si256(s0, s1, 0x31));
+        }
+        Deinterleave16_SSE2(pSrc + 2 * i, pA + i, pB + i, nCount - i);
+    }
+
+    const ChromaKernels g_KernelsC    = { Interleave_C,    Deinterleave_C,    Interleave16_C,    Deinterleave16_C,    "C" };
+    const ChromaKernels g_KernelsSSE2 = { Interleave_SSE2, Deinterleave_SSE2, Interleave16_SSE2, Deinterleave16_SSE2, "SSE2" };
+    const ChromaKernels g_KernelsAVX2 = { Interleave_AVX2, Deinterleave_AVX2, Interleave16_AVX2, Deinterleave16_AVX2, "AVX2" };
+
+    ChromaKernels SelectKernels()
+    {
+        return IsAVX2Supported() ? g_KernelsAVX2 : g_KernelsSSE2;
+    }
+
+    const ChromaKernels g_Kernels = SelectKernels();
+}
+
+void InterleaveRow(const mfxU8* pA, const mfxU8* pB, mfxU8* pDst, mfxU32 nCount)
+{
+    g_Kernels.Interleave(pA, pB, pDst, nCount);
+}
+
+void DeinterleaveRow(const mfxU8* pSrc, mfxU8* pA, mfxU8* pB, mfxU32 nCount)
+{
+    g_Kernels.Deinterleave(pSrc, pA, pB, nCount);
+}
+
+void InterleaveRow16(const mfxU16* pA, const mfxU16* pB, mfxU16* pDst, mfxU32 nCount)
+{
+    g_Kernels.Interleave16(pA, pB, pDst, nCount);
+}
+
+void DeinterleaveRow16(const mfxU16* pSrc, mfxU16* pA, mfxU16* pB, mfxU32 nCount)
+{
+    g_Kernels.Deinterleave16(pSrc, pA, pB, nCount);
+}
+
+void ConvertPlanarToNV12(const mfxU8* pU, mfxU32 nPitchU, const mfxU8* pV, mfxU32 nPitchV,
+                         mfxU8* pUV, mfxU32 nPitchUV, mfxU32 nWidth, mfxU32 nHeight)
+{
+    for (mfxU32 i = 0; i < nHeight; i++)
+    {
+        g_Kernels.Interleave(pU + i * nPitchU, pV + i * nPitchV, pUV + i * nPitchUV, nWidth);
+    }
+}
+
+void ConvertNV12ToPlanar(const mfxU8* pUV, mfxU32 nPitchUV,
+                         mfxU8* pU, mfxU32 nPitchU, mfxU8* pV, mfxU32 nPitchV, mfxU32 nWidth, mfxU32 nHeight)
+{
+    for (mfxU32 i = 0; i < nHeight; i++)
+    {
+        g_Kernels.Deinterleave(pUV + i * nPitchUV, pU + i * nPitchU, pV + i * nPitchV, nWidth);
+    }
+}
+
+void ConvertPlanarToP010(const mfxU16* pU, mfxU32 nPitchU, const mfxU16* pV, mfxU32 nPitchV,
+                         mfxU16* pUV, mfxU32 nPitchUV, mfxU32 nWidth, mfxU32 nHeight)
+{
+    for (mfxU32 i = 0; i < nHeight; i++)
+    {
+        g_Kernels.Interleave16((const mfxU16*)((const mfxU8*)pU + i * nPitchU),
+                               (const mfxU16*)((const mfxU8*)pV + i * nPitchV),
+                               (mfxU16*)((mfxU8*)pUV + i * nPitchUV), nWidth);
+    }
+}
+
+void ConvertP010ToPlanar(const mfxU16* pUV, mfxU32 nPitchUV,
+                         mfxU16* pU, mfxU32 nPitchU, mfxU16* pV, mfxU32 nPitchV, mfxU32 nWidth, mfxU32 nHeight)
+{
+    for (mfxU32 i = 0; i < nHeight; i++)
+    {
+        g_Kernels.Deinterleave16((const mfxU16*)((const mfxU8*)pUV + i * nPitchUV),
+                                 (mfxU16*)((mfxU8*)pU + i * nPitchU),
+                                 (mfxU16*)((mfxU8*)pV + i * nPitchV), nWidth);
+    }
+}
+
+void ConvertYUY2ToNV12(const mfxU8* pSrc, mfxU32 nPitchSrc,
+                       mfxU8* pY, mfxU32 nPitchY, mfxU8* pUV, mfxU32 nPitchUV, mfxU32 nWidth, mfxU32 nHeight)
+{
+    // YUY2 row is Y0 U0 Y1 V0 ..., its odd bytes form a UV row of NV12
+    for (mfxU32 i = 0; i < nHeight; i++)
+    {
+        // the bottom row of a pair goes first, so the top row's chroma overwrites its one
+        mfxU32 nRow = i ^ 1;
+        if (nRow >= nHeight)
+            nRow = i;
+
+        g_Kernels.Deinterleave(pSrc + nRow * nPitchSrc, pY + nRow * nPitchY, pUV + (nRow / 2) * nPitchUV, nWidth);
+    }
+}
+
+void ConvertNV12ToYUY2(const mfxU8* pY, mfxU32 nPitchY, const mfxU8* pUV, mfxU32 nPitchUV,
+                       mfxU8* pDst, mfxU32 nPitchDst, mfxU32 nWidth, mfxU32 nHeight)
+{
+    for (mfxU32 i = 0; i < nHeight; i++)
+    {
+        g_Kernels.Interleave(pY + i * nPitchY, pUV + (i / 2) * nPitchUV, pDst + i * nPitchDst, nWidth);
+    }
+}
+
+const char* GetChromaConversionIsa()
+{
+    return g_Kernels.szIsa;
+}
+
+const ChromaKernels* GetChromaKernels(const char* szIsa)
+{
+    if (!szIsa)
+        return NULL;
+    if (!strcmp(szIsa, g_KernelsC.szIsa))
+        return &g_KernelsC;
+    if (!strcmp(szIsa, g_KernelsSSE2.szIsa))
+        return &g_KernelsSSE2;
+    if (!strcmp(szIsa, g_KernelsAVX2.szIsa) && IsAVX2Supported())
+        return &g_KernelsAVX2;
+    return NULL;
+}
@@ -0,0 +1,178 @@
+/******************************************************************************\
+Copyright (c) 2005-2016, Intel Corporation
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without modification, are permitted provided that the following conditions are met:
+
+1. Redistributions of source code must retain the above copyright notice, this list of conditions and the following disclaimer.
+
+2. Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the following disclaimer in the documentation and/or other materials provided with the distribution.
+
+3. Neither the name of the copyright holder nor the names of its contributors may be used to endorse or promote products derived from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+This sample was distributed or derived from the Intel's Media Samples package.
+The original version of this sample may be obtained from https://software.intel.com/en-us/intel-media-server-studio
+or https://software.intel.com/en-us/media-client-solutions-support.
+\**********************************************************************************/
+
+#include "mfx_samples_config.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <set>
+#if !defined(_WIN32) && !defined(_WIN64)
+#include <signal.h>
+#endif
+
+#include "frame_tracer.h"
+#include "vm/atomic_defs.h"
+
+#if defined(_WIN32) || defined(_WIN64)
+#define TRACE_THREAD_LOCAL __declspec(thread)
+#else
+#define TRACE_THREAD_LOCAL __thread
+#endif
+
+static const char* const g_StageNames[TRACE_STAGE_COUNT] =
+{
+    "read", "decode", "sync", "vpp", "encode", "write"
+};
+
+// buffer of the calling thread, created on its first event
+static TRACE_THREAD_LOCAL TraceBuffer* t_pTraceBuffer = NULL;
+
+// set by SIGUSR1 handler, the trace is written by the next thread adding an event
+static volatile int g_bDumpRequested = 0;
+
+#if !defined(_WIN32) && !defined(_WIN64)
+static void OnDumpSignal(int)
+{
+    g_bDumpRequested = 1;
+}
+#endif
+
+CFrameTracer& CFrameTracer::Instance()
+{
+    static CFrameTracer tracer;
+    return tracer;
+}
+
+CFrameTracer::CFrameTracer()
+    : m_bEnabled(false)
+    , m_nStartTick(msdk_time_get_tick())
+{
+    const char* strFileName = getenv("MSDK_TRACE_FILE");
+
+    if (strFileName && *strFileName)
+    {
+        m_FileName.assign(strFileName, strFileName + strlen(strFileName) + 1);
+        m_bEnabled = true;
+#if !defined(_WIN32) && !defined(_WIN64)
+        signal(SIGUSR1, OnDumpSignal);
+#endif
+    }
+}
+
+CFrameTracer::~CFrameTracer()
+{
+    if (m_bEnabled)
+    {
+        Dump();
+    }
+
+    for (size_t i = 0; i < m_Buffers.size(); i++)
+    {
+        MSDK_SAFE_DELETE(m_Buffers[i]);
+    }
+}
+
+TraceBuffer* CFrameTracer::GetThreadBuffer()
+{
+    if (!t_pTraceBuffer)
+    {
+        AutomaticMutex guard(m_mutex);
+
+        // buffers of finished threads are kept till exit, so their events get to the trace
+        t_pTraceBuffer = new TraceBuffer((mfxU32)m_Buffers.size());
+        m_Buffers.push_back(t_pTraceBuffer);
+    }
+    return t_pTraceBuffer;
+}
+
+void CFrameTracer::AddEvent(mfxU32 nStage, mfxU32 nSession, mfxU32 nFrame, msdk_tick nStart, msdk_tick nEnd)
+{
+    if (!m_bEnabled)
+        return;
+
+    TraceBuffer* pBuffer = GetThreadBuffer();
+    mfxU32 nCount = pBuffer->nCount;
+
+    // the oldest event is overwritten when the ring is full
+    TraceEvent& event = pBuffer->Events[nCount % TRACE_BUFFER_SIZE];
+    event.nStart = nStart;
+    event.nEnd = nEnd;
+    event.nSession = nSession;
+    event.nFrame = nFrame;
+    event.nStage = nStage;
+    msdk_atomic_store32(&pBuffer->nCount, nCount + 1);
+
+    if (g_bDumpRequested)
+    {
+        g_bDumpRequested = 0;
+        Dump();
+    }
+}
+
+mfxStatus CFrameTracer::Dump()
+{
+    if (!m_bEnabled)
+        return MFX_ERR_NOT_INITIALIZED;
+
+    AutomaticMutex guard(m_mutex);
+
+    FILE* pFile = fopen(&m_FileName[0], "w");
+    MSDK_CHECK_POINTER(pFile, MFX_ERR_NULL_PTR);
+
+    // event times are in microseconds since the tracer start
+    mfxF64 fTickToUs = 1000000. / (mfxF64)msdk_time_get_frequency();
+    std::set<mfxU32> sessions;
+    bool bFirst = true;
+
+    fprintf(pFile, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[");
+
+    for (size_t i = 0; i < m_Buffers.size(); i++)
+    {
+        TraceBuffer* pBuffer = m_Buffers[i];
+        // events recorded after this point are not written
+        mfxU32 nCount = msdk_atomic_load32(&pBuffer->nCount);
+        mfxU32 nFirst = (nCount > TRACE_BUFFER_SIZE) ? nCount - TRACE_BUFFER_SIZE : 0;
+
+        for (mfxU32 j = nFirst; j < nCount; j++)
+        {
+            const TraceEvent& event = pBuffer->Events[j % TRACE_BUFFER_SIZE];
+            const char* strStage = (event.nStage < TRACE_STAGE_COUNT) ? g_StageNames[event.nStage] : "unknown";
+
+            fprintf(pFile, "%s\n{\"name\":\"%s\",\"cat\":\"frame\",\"ph\":\"X\",\"ts\":%.3f,\"dur\":%.3f,\"pid\":%u,\"tid\":%u,\"args\":{\"frame\":%u}}",
+                bFirst ? "" : ",", strStage,
+                (event.nStart - m_nStartTick) * fTickToUs, (event.nEnd - event.nStart) * fTickToUs,
+                event.nSession, pBuffer->nThreadIdx, event.nFrame);
+            bFirst = false;
+            sessions.insert(event.nSession);
+        }
+    }
+
+    for (std::set<mfxU32>::iterator it = sessions.begin(); it != sessions.end(); ++it)
+    {
+        fprintf(pFile, "%s\n{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":%u,\"args\":{\"name\":\"session %u\"}}",
+            bFirst ? "" : ",", *it, *it);
+        bFirst = false;
+    }
+
+    fprintf(pFile, "\n]}\n");
+    fclose(pFile);
+
+    return MFX_ERR_NONE;
+}
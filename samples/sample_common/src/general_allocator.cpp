@@ -69,7 +69,8 @@ mfxStatus GeneralAllocator::Init(mfxAllocatorParams *pParams)
     }
 
     m_SYSAllocator.reset(new SysMemFrameAllocator);
-    sts = m_SYSAllocator.get()->Init(0);
+    // system memory parameters (NUMA node) are used by the system memory allocator only
+    sts = m_SYSAllocator.get()->Init(dynamic_cast<SysMemAllocatorParams*>(pParams));
     MSDK_CHECK_RESULT(sts, MFX_ERR_NONE, sts);
 
     return sts;
@@ -0,0 +1,442 @@
+/******************************************************************************\
+Copyright (c) 2005-2016, Intel Corporation
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without modification, are permitted provided that the following conditions are met:
+
+1. Redistributions of source code must retain the above copyright notice, this list of conditions and the following disclaimer.
+
+2. Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the following disclaimer in the documentation and/or other materials provided with the distribution.
+
+3. Neither the name of the copyright holder nor the names of its contributors may be used to endorse or promote products derived from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+This sample was distributed or derived from the Intel's Media Samples package.
+The original version of this sample may be obtained from https://software.intel.com/en-us/intel-media-server-studio
+or https://software.intel.com/en-us/media-client-solutions-support.
+\**********************************************************************************/
+
+#include "hevc_spl.h"
+#include "avc_structures.h"
+#include "sample_defs.h"
+
+namespace ProtectedLibrary
+{
+
+static const mfxU8 start_code_prefix[] = {0, 0, 1};
+
+enum
+{
+    HEVC_NAL_HEADER_SIZE = 2,
+    // enough for the slice segment header fields up to slice_type
+    HEVC_SLICE_HEADER_PART_SIZE = 64,
+    // the bitstream reader may read a few dwords beyond the data
+    BITSTREAM_PADDING = 16
+};
+
+inline mfxI32 GetNalUnitType(mfxBitstream * nalUnit)
+{
+    return (nalUnit->Data[nalUnit->DataOffset] >> 1) & 0x3f;
+}
+
+inline bool IsVCL(mfxI32 nalType)
+{
+    return nalType <= HEVC_NAL_UT_RESERVED_VCL31;
+}
+
+inline mfxU32 CeilLog2(mfxU32 x)
+{
+    mfxU32 log2 = 0;
+    while ((1u << log2) < x)
+        log2++;
+    return log2;
+}
+
+inline void SkipBits(AVCBaseBitstream & bs, mfxU32 nbits)
+{
+    for (; nbits > 16; nbits -= 16)
+        bs.GetBits(16);
+    if (nbits)
+        bs.GetBits(nbits);
+}
+
+// profile_tier_level() with profilePresentFlag equal to 1, see 7.3.3 of H.265
+static void SkipProfileTierLevel(AVCBaseBitstream & bs, mfxU32 maxNumSubLayersMinus1)
+{
+    // general profile fields take 88 bits followed by general_level_idc
+    SkipBits(bs, 88 + 8);
+
+    mfxU32 subLayerProfilePresent[8] = {0};
+    mfxU32 subLayerLevelPresent[8] = {0};
+    for (mfxU32 i = 0; i < maxNumSubLayersMinus1; i++)
+    {
+        subLayerProfilePresent[i] = bs.Get1Bit();
+        subLayerLevelPresent[i] = bs.Get1Bit();
+    }
+    if (maxNumSubLayersMinus1)
+        SkipBits(bs, 2 * (8 - maxNumSubLayersMinus1));
+
+    for (mfxU32 i = 0; i < maxNumSubLayersMinus1; i++)
+    {
+        if (subLayerProfilePresent[i])
+            SkipBits(bs, 88);
+        if (subLayerLevelPresent[i])
+            SkipBits(bs, 8);
+    }
+}
+
+HEVC_Spl::HEVC_Spl()
+    : m_bHasVCL(false)
+    , m_pendingNalType(0)
+    , m_pendingTimeStamp(0)
+{
+    m_NALSplitter.Init();
+    m_NALSplitter.SetHEVC(true);
+
+    m_currentFrame.resize(1024 * 1024);
+    m_slices.resize(128);
+
+    memset(&m_frame, 0, sizeof(m_frame));
+    m_frame.Data = &m_currentFrame[0];
+    m_frame.Slice = &m_slices[0];
+
+    Reset();
+}
+
+HEVC_Spl::~HEVC_Spl()
+{
+}
+
+mfxStatus HEVC_Spl::Reset()
+{
+    m_NALSplitter.Reset();
+
+    memset(m_sps, 0, sizeof(m_sps));
+    memset(m_pps, 0, sizeof(m_pps));
+
+    m_pendingNal.clear();
+    ResetCurrentState();
+
+    return MFX_ERR_NONE;
+}
+
+void HEVC_Spl::ResetCurrentState()
+{
+    // the frame data stays valid till the next GetFrame()
+    m_frame.DataLength = 0;
+    m_frame.SliceNum = 0;
+    m_frame.FirstFieldSliceNum = 0;
+    m_bHasVCL = false;
+}
+
+mfxStatus HEVC_Spl::PostProcessing(FrameSplitterInfo *, mfxU32)
+{
+    return MFX_ERR_NONE;
+}
+
+void HEVC_Spl::InitBitstream(mfxBitstream * nalUnit, mfxU32 nMaxSize)
+{
+    mfxU32 nSize = MSDK_MIN(nalUnit->DataLength, nMaxSize);
+
+    if (m_swappingMemory.size() < nSize + BITSTREAM_PADDING)
+        m_swappingMemory.resize(nSize + BITSTREAM_PADDING);
+
+    mfxU32 nSwappedSize = nSize;
+    SwapMemoryAndRemovePreventingBytes(&m_swappingMemory[0], nSwappedSize, nalUnit->Data + nalUnit->DataOffset, nSize);
+    memset(&m_swappingMemory[0] + nSwappedSize, 0, BITSTREAM_PADDING);
+
+    m_bitStream.Reset(&m_swappingMemory[0], nSwappedSize);
+    // skip NAL unit header
+    m_bitStream.GetBits(16);
+}
+
+mfxStatus HEVC_Spl::DecodeSeqParamSet(mfxBitstream * nalUnit)
+{
+    InitBitstream(nalUnit, nalUnit->DataLength);
+
+    try
+    {
+        m_bitStream.GetBits(4);  // sps_video_parameter_set_id
+        mfxU32 maxSubLayersMinus1 = m_bitStream.GetBits(3);
+        m_bitStream.Get1Bit();   // sps_temporal_id_nesting_flag
+        SkipProfileTierLevel(m_bitStream, maxSubLayersMinus1);
+
+        mfxU32 id = (mfxU32)m_bitStream.GetVLCElement(false);
+        if (id >= MSDK_ARRAY_LEN(m_sps))
+            return MFX_ERR_UNDEFINED_BEHAVIOR;
+
+        mfxU32 chromaFormatIdc = (mfxU32)m_bitStream.GetVLCElement(false);
+        if (chromaFormatIdc == 3)
+            m_bitStream.Get1Bit(); // separate_colour_plane_flag
+
+        mfxU32 width = (mfxU32)m_bitStream.GetVLCElement(false);
+        mfxU32 height = (mfxU32)m_bitStream.GetVLCElement(false);
+
+        if (m_bitStream.Get1Bit()) // conformance_window_flag
+        {
+            for (mfxU32 i = 0; i < 4; i++)
+                m_bitStream.GetVLCElement(false);
+        }
+
+        mfxU32 bitDepthLuma = (mfxU32)m_bitStream.GetVLCElement(false) + 8;
+        m_bitStream.GetVLCElement(false); // bit_depth_chroma_minus8
+        m_bitStream.GetVLCElement(false); // log2_max_pic_order_cnt_lsb_minus4
+
+        mfxU32 subLayerOrderingInfoPresent = m_bitStream.Get1Bit();
+        for (mfxU32 i = subLayerOrderingInfoPresent ? 0 : maxSubLayersMinus1; i <= maxSubLayersMinus1; i++)
+        {
+            m_bitStream.GetVLCElement(false); // sps_max_dec_pic_buffering_minus1
+            m_bitStream.GetVLCElement(false); // sps_max_num_reorder_pics
+            m_bitStream.GetVLCElement(false); // sps_max_latency_increase_plus1
+        }
+
+        mfxU32 log2MinCbSize = (mfxU32)m_bitStream.GetVLCElement(false) + 3;
+        mfxU32 log2CtbSize = log2MinCbSize + (mfxU32)m_bitStream.GetVLCElement(false);
+        if (log2CtbSize > 6 || !width || !height)
+            return MFX_ERR_UNDEFINED_BEHAVIOR;
+
+        mfxU32 ctbSize = 1 << log2CtbSize;
+        m_sps[id].PicSizeInCtbsY = ((width + ctbSize - 1) >> log2CtbSize) * ((height + ctbSize - 1) >> log2CtbSize);
+        m_sps[id].bValid = true;
+
+        // the same upper bound of a coded picture size as for H.264
+        mfxU32 size = width * height * (bitDepthLuma > 8 ? 2 : 1);
+        size = chromaFormatIdc == 0 ? size : chromaFormatIdc == 1 ? size * 3 / 2 : chromaFormatIdc == 2 ? size * 2 : size * 3;
+        m_NALSplitter.SetSuggestedSize(size);
+    }
+    catch(...)
+    {
+        return MFX_ERR_UNDEFINED_BEHAVIOR;
+    }
+
+    return MFX_ERR_NONE;
+}
+
+mfxStatus HEVC_Spl::DecodePicParamSet(mfxBitstream * nalUnit)
+{
+    InitBitstream(nalUnit, HEVC_SLICE_HEADER_PART_SIZE);
+
+    try
+    {
+        mfxU32 id = (mfxU32)m_bitStream.GetVLCElement(false);
+        mfxU32 spsId = (mfxU32)m_bitStream.GetVLCElement(false);
+        if (id >= MSDK_ARRAY_LEN(m_pps) || spsId >= MSDK_ARRAY_LEN(m_sps))
+            return MFX_ERR_UNDEFINED_BEHAVIOR;
+
+        HEVCPicParamSet & pps = m_pps[id];
+        pps.seq_parameter_set_id = spsId;
+        pps.dependent_slice_segments_enabled_flag = (mfxU8)m_bitStream.Get1Bit();
+        m_bitStream.Get1Bit(); // output_flag_present_flag
+        pps.num_extra_slice_header_bits = (mfxU8)m_bitStream.GetBits(3);
+        pps.bValid = true;
+    }
+    catch(...)
+    {
+        return MFX_ERR_UNDEFINED_BEHAVIOR;
+    }
+
+    return MFX_ERR_NONE;
+}
+
+mfxStatus HEVC_Spl::DecodeSliceHeader(mfxI32 nalType, mfxBitstream * nalUnit, SliceSplitterInfo & slice)
+{
+    // a dependent slice segment has the type of the preceding slice
+    slice.SliceType = m_frame.SliceNum ? m_slices[m_frame.SliceNum - 1].SliceType : TYPE_UNKNOWN;
+    slice.HeaderLength = 0;
+
+    InitBitstream(nalUnit, HEVC_SLICE_HEADER_PART_SIZE);
+
+    try
+    {
+        mfxU32 firstSliceSegmentInPic = m_bitStream.Get1Bit();
+        if (nalType >= HEVC_NAL_UT_CODED_SLICE_BLA_W_LP && nalType <= HEVC_NAL_UT_RESERVED_IRAP_VCL23)
+            m_bitStream.Get1Bit(); // no_output_of_prior_pics_flag
+
+        mfxU32 ppsId = (mfxU32)m_bitStream.GetVLCElement(false);
+        if (ppsId >= MSDK_ARRAY_LEN(m_pps) || !m_pps[ppsId].bValid || !m_sps[m_pps[ppsId].seq_parameter_set_id].bValid)
+            return MFX_ERR_UNDEFINED_BEHAVIOR;
+
+        const HEVCPicParamSet & pps = m_pps[ppsId];
+        const HEVCSeqParamSet & sps = m_sps[pps.seq_parameter_set_id];
+
+        mfxU32 dependentSliceSegment = 0;
+        if (!firstSliceSegmentInPic)
+        {
+            if (pps.dependent_slice_segments_enabled_flag)
+                dependentSliceSegment = m_bitStream.Get1Bit();
+            SkipBits(m_bitStream, CeilLog2(sps.PicSizeInCtbsY)); // slice_segment_address
+        }
+
+        if (!dependentSliceSegment)
+        {
+            SkipBits(m_bitStream, pps.num_extra_slice_header_bits);
+
+            switch (m_bitStream.GetVLCElement(false))
+            {
+            case 0:
+                slice.SliceType = TYPE_B;
+                break;
+            case 1:
+                slice.SliceType = TYPE_P;
+                break;
+            case 2:
+                slice.SliceType = TYPE_I;
+                break;
+            default:
+                return MFX_ERR_UNDEFINED_BEHAVIOR;
+            }
+        }
+
+        // only the beginning of the header is parsed
+        slice.HeaderLength = m_bitStream.BytesDecoded();
+    }
+    catch(...)
+    {
+        return MFX_ERR_UNDEFINED_BEHAVIOR;
+    }
+
+    // add number of 003 sequence to HeaderLength
+    mfxU8 *pData = nalUnit->Data + nalUnit->DataOffset;
+    for (mfxU8 *ptr = pData; ptr + 2 < pData + nalUnit->DataLength && ptr < pData + slice.HeaderLength; ptr++)
+    {
+        if (ptr[0] == 0 && ptr[1] == 0 && ptr[2] == 3)
+        {
+            slice.HeaderLength++;
+        }
+    }
+
+    slice.HeaderLength += sizeof(start_code_prefix);
+
+    return MFX_ERR_NONE;
+}
+
+bool HEVC_Spl::IsFirstNalUnitOfAU(mfxI32 nalType, mfxBitstream * nalUnit)
+{
+    // NAL units following the last VCL NAL unit of the access unit which begin the next one
+    if (IsVCL(nalType))
+        return nalUnit->DataLength > HEVC_NAL_HEADER_SIZE && (nalUnit->Data[nalUnit->DataOffset + HEVC_NAL_HEADER_SIZE] & 0x80); // first_slice_segment_in_pic_flag
+
+    return (nalType >= HEVC_NAL_UT_VPS && nalType <= HEVC_NAL_UT_AU_DELIMITER) ||
+        nalType == HEVC_NAL_UT_SEI_PREFIX ||
+        (nalType >= HEVC_NAL_UT_RESERVED_NVCL41 && nalType <= HEVC_NAL_UT_RESERVED_NVCL44) ||
+        (nalType >= HEVC_NAL_UT_UNSPECIFIED48 && nalType <= HEVC_NAL_UT_UNSPECIFIED55);
+}
+
+mfxStatus HEVC_Spl::AddNalUnit(mfxI32 nalType, mfxBitstream * nalUnit)
+{
+    SliceSplitterInfo slice;
+    bool bSlice = IsVCL(nalType);
+
+    switch (nalType)
+    {
+    case HEVC_NAL_UT_SPS:
+        DecodeSeqParamSet(nalUnit);
+        break;
+    case HEVC_NAL_UT_PPS:
+        DecodePicParamSet(nalUnit);
+        break;
+    case HEVC_NAL_UT_FILLER_DATA:
+        return MFX_ERR_NONE;
+    default:
+        break;
+    }
+
+    // slices which can't be parsed are passed to the decoder as they are
+    if (bSlice && MFX_ERR_NONE != DecodeSliceHeader(nalType, nalUnit, slice))
+    {
+        slice.SliceType = TYPE_UNKNOWN;
+        slice.HeaderLength = (mfxU32)sizeof(start_code_prefix) + HEVC_NAL_HEADER_SIZE;
+    }
+
+    mfxU32 nSize = (mfxU32)sizeof(start_code_prefix) + nalUnit->DataLength;
+    if (m_currentFrame.size() < m_frame.DataLength + nSize)
+    {
+        m_currentFrame.resize(MSDK_MAX(m_frame.DataLength + nSize, (mfxU32)m_currentFrame.size() * 2));
+        m_frame.Data = &m_currentFrame[0];
+    }
+
+    mfxU32 nOffset = m_frame.DataLength;
+    memcpy(m_frame.Data + nOffset, start_code_prefix, sizeof(start_code_prefix));
+    memcpy(m_frame.Data + nOffset + sizeof(start_code_prefix), nalUnit->Data + nalUnit->DataOffset, nalUnit->DataLength);
+    m_frame.DataLength += nSize;
+
+    if (nOffset == 0)
+        m_frame.TimeStamp = nalUnit->TimeStamp;
+
+    if (bSlice)
+    {
+        if (m_slices.size() <= m_frame.SliceNum)
+        {
+            m_slices.resize(m_frame.SliceNum + 10);
+            m_frame.Slice = &m_slices[0];
+        }
+
+        slice.DataOffset = nOffset;
+        slice.DataLength = nSize;
+        m_slices[m_frame.SliceNum++] = slice;
+        m_frame.FirstFieldSliceNum = m_frame.SliceNum;
+        m_bHasVCL = true;
+    }
+
+    return MFX_ERR_NONE;
+}
+
+mfxStatus HEVC_Spl::ProcessNalUnit(mfxI32 nalType, mfxBitstream * nalUnit)
+{
+    if (!nalUnit)
+        return MFX_ERR_MORE_DATA;
+
+    if (nalUnit->DataLength < HEVC_NAL_HEADER_SIZE)
+        return MFX_ERR_MORE_DATA;
+
+    if (m_bHasVCL && IsFirstNalUnitOfAU(nalType, nalUnit))
+    {
+        // keep the NAL unit for the next frame, the input may change before that
+        m_pendingNal.assign(nalUnit->Data + nalUnit->DataOffset, nalUnit->Data + nalUnit->DataOffset + nalUnit->DataLength);
+        m_pendingNalType = nalType;
+        m_pendingTimeStamp = nalUnit->TimeStamp;
+        return MFX_ERR_NONE;
+    }
+
+    AddNalUnit(nalType, nalUnit);
+
+    return MFX_ERR_MORE_DATA;
+}
+
+mfxStatus HEVC_Spl::GetFrame(mfxBitstream * bs_in, FrameSplitterInfo ** frame)
+{
+    *frame = 0;
+
+    // the previous frame is taken, start the next one with the kept NAL unit
+    if (m_pendingNal.size() && !m_frame.DataLength)
+    {
+        mfxBitstream pending;
+        MSDK_ZERO_MEMORY(pending);
+        pending.Data = &m_pendingNal[0];
+        pending.DataLength = (mfxU32)m_pendingNal.size();
+        pending.MaxLength = pending.DataLength;
+        pending.TimeStamp = m_pendingTimeStamp;
+
+        AddNalUnit(m_pendingNalType, &pending);
+        m_pendingNal.clear();
+    }
+
+    do
+    {
+        mfxBitstream * destination;
+        mfxI32 nalCode = m_NALSplitter.GetNalUnits(bs_in, destination);
+        mfxStatus sts = ProcessNalUnit(nalCode - 1, destination);
+
+        if (sts == MFX_ERR_NONE || (!bs_in && m_frame.SliceNum))
+        {
+            *frame = &m_frame;
+            return MFX_ERR_NONE;
+        }
+
+    } while (bs_in && bs_in->DataLength > MINIMAL_DATA_SIZE);
+
+    return MFX_ERR_MORE_DATA;
+}
+
+} // namespace ProtectedLibrary
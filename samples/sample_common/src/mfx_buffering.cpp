@@ -28,11 +28,13 @@ CBuffering::CBuffering():
     m_OutputSurfacesNumber(0),
     m_pSurfaces(NULL),
     m_pVppSurfaces(NULL),
+    m_bLockFree(false),
     m_FreeSurfacesPool(&m_Mutex),
     m_FreeVppSurfacesPool(&m_Mutex),
     m_UsedSurfacesPool(&m_Mutex),
     m_UsedVppSurfacesPool(&m_Mutex),
     m_pFreeOutputSurfaces(NULL),
+    m_pOutputSurfaces(NULL),
     m_OutputSurfacesPool(&m_Mutex),
     m_DeliveredSurfacesPool(&m_Mutex)
 {
@@ -43,10 +45,16 @@ CBuffering::~CBuffering()
 }
 
 mfxStatus
-CBuffering::AllocBuffers(mfxU32 SurfaceNumber)
+CBuffering::AllocBuffers(mfxU32 SurfaceNumber, bool bLockFree)
 {
     if (!SurfaceNumber) return MFX_ERR_MEMORY_ALLOC;
 
+    m_bLockFree = bLockFree;
+    m_FreeSurfacesPool.m_bLockFree = bLockFree;
+    m_FreeVppSurfacesPool.m_bLockFree = bLockFree;
+    m_OutputSurfacesPool.m_bLockFree = bLockFree;
+    m_DeliveredSurfacesPool.m_bLockFree = bLockFree;
+
     if (!m_OutputSurfacesNumber) { // true - if Vpp isn't enabled
         m_OutputSurfacesNumber = SurfaceNumber;
     }
@@ -55,6 +63,34 @@ CBuffering::AllocBuffers(mfxU32 SurfaceNumber)
     m_pSurfaces = (msdkFrameSurface*)calloc(m_SurfacesNumber, sizeof(msdkFrameSurface));
     if (!m_pSurfaces) return MFX_ERR_MEMORY_ALLOC;
 
+    if (m_bLockFree) {
+        // each output surface in flight holds its own frame surface, plus one more
+        // is held by the decoding loop while it waits for the output
+        mfxU32 capacity = 1;
+        while (capacity < m_OutputSurfacesNumber + 1) {
+            capacity <<= 1;
+        }
+        m_pOutputSurfaces = (msdkOutputSurface*)calloc(capacity, sizeof(msdkOutputSurface));
+        if (!m_pOutputSurfaces) return MFX_ERR_MEMORY_ALLOC;
+
+        if (!m_OutputSurfacesPool.m_LockFreeSurfaces.Alloc(capacity) ||
+            !m_DeliveredSurfacesPool.m_LockFreeSurfaces.Alloc(capacity)) {
+            return MFX_ERR_MEMORY_ALLOC;
+        }
+
+        m_FreeOutputSurfacesStack.Reset(m_pOutputSurfaces);
+        for (mfxU32 i = capacity; i > 0; --i) {
+            m_FreeOutputSurfacesStack.Push(&m_pOutputSurfaces[i-1]);
+        }
+
+        ResetBuffers();
+        if (m_pVppSurfaces) {
+            // vpp surfaces were put to the free pool before the mode was known
+            ResetVppBuffers();
+        }
+        return MFX_ERR_NONE;
+    }
+
     msdkOutputSurface* p = NULL;
     msdkOutputSurface* tail = NULL;
 
@@ -116,6 +152,14 @@ CBuffering::FreeBuffers()
         m_pVppSurfaces = NULL;
     }
 
+    if (m_pOutputSurfaces) {
+        free(m_pOutputSurfaces);
+        m_pOutputSurfaces = NULL;
+    }
+    m_FreeOutputSurfacesStack.Reset(NULL);
+    m_OutputSurfacesPool.m_LockFreeSurfaces.Free();
+    m_DeliveredSurfacesPool.m_LockFreeSurfaces.Free();
+
     FreeList(m_pFreeOutputSurfaces);
     FreeList(m_OutputSurfacesPool.m_pSurfacesHead);
     FreeList(m_DeliveredSurfacesPool.m_pSurfacesHead);
@@ -127,12 +171,24 @@ CBuffering::FreeBuffers()
 
     m_FreeSurfacesPool.m_pSurfaces = NULL;
     m_FreeVppSurfacesPool.m_pSurfaces = NULL;
+    m_FreeSurfacesPool.m_LockFreeSurfaces.Reset(NULL);
+    m_FreeVppSurfacesPool.m_LockFreeSurfaces.Reset(NULL);
 }
 
 void
 CBuffering::ResetBuffers()
 {
     mfxU32 i;
+
+    if (m_bLockFree) {
+        m_FreeSurfacesPool.m_LockFreeSurfaces.Reset(m_pSurfaces);
+        for (i = m_SurfacesNumber; i > 0; --i) {
+            m_pSurfaces[i-1].prev = m_pSurfaces[i-1].next = NULL;
+            m_FreeSurfacesPool.AddSurfaceUnsafe(&m_pSurfaces[i-1]);
+        }
+        return;
+    }
+
     msdkFrameSurface* pFreeSurf = m_FreeSurfacesPool.m_pSurfaces = m_pSurfaces;
 
     for (i = 0; i < m_SurfacesNumber; ++i) {
@@ -147,6 +203,17 @@ void
 CBuffering::ResetVppBuffers()
 {
     mfxU32 i;
+
+    if (m_bLockFree) {
+        m_FreeVppSurfacesPool.m_pSurfaces = NULL;
+        m_FreeVppSurfacesPool.m_LockFreeSurfaces.Reset(m_pVppSurfaces);
+        for (i = m_OutputSurfacesNumber; i > 0; --i) {
+            m_pVppSurfaces[i-1].prev = m_pVppSurfaces[i-1].next = NULL;
+            m_FreeVppSurfacesPool.AddSurfaceUnsafe(&m_pVppSurfaces[i-1]);
+        }
+        return;
+    }
+
     msdkFrameSurface* pFreeVppSurf = m_FreeVppSurfacesPool.m_pSurfaces = m_pVppSurfaces;
 
     for (i = 0; i < m_OutputSurfacesNumber; ++i) {
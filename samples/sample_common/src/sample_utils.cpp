@@ -21,15 +21,25 @@ or https://software.intel.com/en-us/media-client-solutions-support.
 
 #include <math.h>
 #include <iostream>
+#include <emmintrin.h>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
 
 #include "vm/strings_defs.h"
 #include "time_statistics.h"
 #include "sample_defs.h"
 #include "sample_utils.h"
+#include "chroma_conversion.h"
+#include "bitstream_scan.h"
 #include "mfxcommon.h"
 #include "mfxjpeg.h"
 #include "mfxvp8.h"
 
+#if !defined(_WIN32) && !defined(_WIN64)
+#include <fcntl.h>
+#endif
+
 #pragma warning( disable : 4748 )
 
 msdk_tick CTimer::frequency = 0;
@@ -65,6 +75,159 @@ mfxStatus CopyBitstream2(mfxBitstream *dest, mfxBitstream *src)
 }
 
 
+CFramePrefetcher::CFramePrefetcher()
+{
+    m_pFile = NULL;
+    m_nFrameSize = 0;
+    m_nSlotSize = 0;
+    m_nDepth = 0;
+    m_pBuffer = NULL;
+    m_pAlignedBuffer = NULL;
+    m_nReady = 0;
+    m_bEndOfFile = false;
+    m_bStop = false;
+    m_nWriteIdx = 0;
+    m_nReadIdx = 0;
+    m_pFrameReady = NULL;
+    m_pFrameFree = NULL;
+    m_pThread = NULL;
+    m_nHits = 0;
+    m_nMisses = 0;
+}
+
+CFramePrefetcher::~CFramePrefetcher()
+{
+    Close();
+}
+
+mfxStatus CFramePrefetcher::Init(FILE* pFile, mfxU32 nFrameSize, mfxU32 nDepth)
+{
+    MSDK_CHECK_POINTER(pFile, MFX_ERR_NULL_PTR);
+    MSDK_CHECK_ERROR(nFrameSize, 0, MFX_ERR_NOT_INITIALIZED);
+    MSDK_CHECK_ERROR(nDepth, 0, MFX_ERR_NOT_INITIALIZED);
+
+    Close();
+
+    // the buffer of all slots is limited to 1 GB, so the depth is reduced for large frames
+    const size_t nMaxBufferSize = (size_t)1 << 30;
+    MSDK_CHECK_ERROR(nFrameSize > 0xFFFFFFFF - 31, true, MFX_ERR_UNSUPPORTED);
+
+    m_pFile = pFile;
+    m_nFrameSize = nFrameSize;
+    m_nSlotSize = MSDK_ALIGN32(nFrameSize);
+    // ready counter is 16-bit
+    m_nDepth = MSDK_MIN(nDepth, 0xFFFF);
+    m_nDepth = (mfxU32)MSDK_MIN((size_t)m_nDepth, MSDK_MAX(nMaxBufferSize / m_nSlotSize, (size_t)1));
+    if (m_nDepth < nDepth)
+    {
+        msdk_printf(MSDK_STRING("WARNING: prefetch depth is reduced to %u frames\n"), m_nDepth);
+    }
+    m_nReady = 0;
+    m_bEndOfFile = false;
+    m_bStop = false;
+    m_nWriteIdx = m_nReadIdx = 0;
+    m_nHits = m_nMisses = 0;
+
+    m_pBuffer = new mfxU8[(size_t)m_nDepth * m_nSlotSize + 31];
+    MSDK_CHECK_POINTER(m_pBuffer, MFX_ERR_MEMORY_ALLOC);
+    m_pAlignedBuffer = (mfxU8*)(((size_t)m_pBuffer + 31) & ~((size_t)31));
+
+    mfxStatus sts = MFX_ERR_NONE;
+    m_pFrameReady = new MSDKEvent(sts, false, false);
+    MSDK_CHECK_RESULT(sts, MFX_ERR_NONE, sts);
+    m_pFrameFree = new MSDKEvent(sts, false, false);
+    MSDK_CHECK_RESULT(sts, MFX_ERR_NONE, sts);
+
+    m_pThread = new MSDKThread(sts, ReadThreadFunc, this);
+    MSDK_CHECK_RESULT(sts, MFX_ERR_NONE, sts);
+
+    return MFX_ERR_NONE;
+}
+
+void CFramePrefetcher::Close()
+{
+    if (m_pThread)
+    {
+        m_bStop = true;
+        m_pFrameFree->Signal();
+        m_pThread->Wait();
+    }
+
+    MSDK_SAFE_DELETE(m_pThread);
+    MSDK_SAFE_DELETE(m_pFrameReady);
+    MSDK_SAFE_DELETE(m_pFrameFree);
+    MSDK_SAFE_DELETE_ARRAY(m_pBuffer);
+    m_pAlignedBuffer = NULL;
+    m_pFile = NULL;
+}
+
+unsigned int MFX_STDCALL CFramePrefetcher::ReadThreadFunc(void* ctx)
+{
+    ((CFramePrefetcher*)ctx)->ReadLoop();
+    return 0;
+}
+
+void CFramePrefetcher::ReadLoop()
+{
+    while (!m_bStop)
+    {
+        if (m_nReady == m_nDepth)
+        {
+            // ring is full, wait until the consumer releases a frame
+            m_pFrameFree->Wait();
+            continue;
+        }
+
+        if (m_nFrameSize != (mfxU32)fread(GetSlot(m_nWriteIdx), 1, m_nFrameSize, m_pFile))
+        {
+            m_bEndOfFile = true;
+            m_pFrameReady->Signal();
+            break;
+        }
+
+        m_nWriteIdx = (m_nWriteIdx + 1) % m_nDepth;
+        // publishes the slot to the consumer, atomic operation is a full barrier
+        msdk_atomic_inc16(&m_nReady);
+        m_pFrameReady->Signal();
+    }
+}
+
+mfxStatus CFramePrefetcher::GetFrame(mfxU8** ppFrame)
+{
+    MSDK_CHECK_POINTER(ppFrame, MFX_ERR_NULL_PTR);
+    MSDK_CHECK_POINTER(m_pThread, MFX_ERR_NOT_INITIALIZED);
+
+    if (m_nReady)
+    {
+        m_nHits++;
+    }
+    else
+    {
+        m_nMisses++;
+        while (!m_nReady)
+        {
+            // end of file flag is set after the last frame was published
+            if (m_bEndOfFile)
+            {
+                if (!m_nReady)
+                    return MFX_ERR_MORE_DATA;
+                break;
+            }
+            m_pFrameReady->Wait();
+        }
+    }
+
+    *ppFrame = GetSlot(m_nReadIdx);
+    return MFX_ERR_NONE;
+}
+
+void CFramePrefetcher::ReleaseFrame()
+{
+    m_nReadIdx = (m_nReadIdx + 1) % m_nDepth;
+    msdk_atomic_dec16(&m_nReady);
+    m_pFrameFree->Signal();
+}
+
 CSmplYUVReader::CSmplYUVReader()
 {
     m_bInited = false;
@@ -73,6 +236,41 @@ CSmplYUVReader::CSmplYUVReader()
     m_fSourceMVC = NULL;
     m_numLoadedFiles = 0;
     m_ColorFormat = MFX_FOURCC_YV12;
+    m_pFrameBuffer = NULL;
+    m_nFrameBufferSize = 0;
+    m_bMemoryMapped = false;
+    m_bZeroCopy = false;
+    m_nPrefetchDepth = 0;
+    m_pPrefetcher = NULL;
+}
+
+bool CSmplYUVReader::GetPrefetchStatistics(mfxU32& nHits, mfxU32& nMisses)
+{
+    if (!m_pPrefetcher)
+        return false;
+
+    nHits = m_pPrefetcher->GetHits();
+    nMisses = m_pPrefetcher->GetMisses();
+    return true;
+}
+
+mfxStatus CSmplYUVReader::OpenFile(const msdk_char *strFileName, FILE** ppFile)
+{
+    if (m_bMemoryMapped)
+    {
+        sMappedFile file;
+        file.nOffset = 0;
+        file.pData = msdk_file_map(strFileName, &file.nSize);
+        MSDK_CHECK_POINTER(file.pData, MFX_ERR_NULL_PTR);
+
+        m_MappedFiles.push_back(file);
+        *ppFile = NULL;
+        return MFX_ERR_NONE;
+    }
+
+    MSDK_FOPEN(*ppFile, strFileName, MSDK_STRING("rb"));
+    MSDK_CHECK_POINTER(*ppFile, MFX_ERR_NULL_PTR);
+    return MFX_ERR_NONE;
 }
 
 mfxStatus CSmplYUVReader::Init(const msdk_char *strFileName, const mfxU32 ColorFormat, const mfxU32 numViews, std::vector<msdk_char*> srcFileBuff)
@@ -82,11 +280,13 @@ mfxStatus CSmplYUVReader::Init(const msdk_char *strFileName, const mfxU32 ColorF
 
     Close();
 
+    mfxStatus sts = MFX_ERR_NONE;
+
     //open source YUV file
     if (!m_bIsMultiView)
     {
-        MSDK_FOPEN(m_fSource, strFileName, MSDK_STRING("rb"));
-        MSDK_CHECK_POINTER(m_fSource, MFX_ERR_NULL_PTR);
+        sts = OpenFile(strFileName, &m_fSource);
+        MSDK_CHECK_RESULT(sts, MFX_ERR_NONE, sts);
         ++m_numLoadedFiles;
     }
     else if (m_bIsMultiView)
@@ -100,8 +300,12 @@ mfxStatus CSmplYUVReader::Init(const msdk_char *strFileName, const mfxU32 ColorF
             m_fSourceMVC = new FILE*[numViews];
             for (i = 0; i < numViews; ++i)
             {
-                MSDK_FOPEN(m_fSourceMVC[i], srcFileBuff.at(i), MSDK_STRING("rb"));
-                MSDK_CHECK_POINTER(m_fSourceMVC[i], MFX_ERR_NULL_PTR);
+                m_fSourceMVC[i] = NULL;
+            }
+            for (i = 0; i < numViews; ++i)
+            {
+                sts = OpenFile(srcFileBuff.at(i), &m_fSourceMVC[i]);
+                MSDK_CHECK_RESULT(sts, MFX_ERR_NONE, sts);
                 ++m_numLoadedFiles;
             }
         }
@@ -141,6 +345,9 @@ CSmplYUVReader::~CSmplYUVReader()
 
 void CSmplYUVReader::Close()
 {
+    // reader thread uses the source file, so stop it first
+    MSDK_SAFE_DELETE(m_pPrefetcher);
+
     if (m_fSource)
     {
         fclose(m_fSource);
@@ -161,27 +368,174 @@ void CSmplYUVReader::Close()
         }
     }
 
+    MSDK_SAFE_DELETE_ARRAY(m_pFrameBuffer);
+    m_nFrameBufferSize = 0;
+
+    for (size_t i = 0; i < m_MappedFiles.size(); ++i)
+    {
+        msdk_file_unmap(m_MappedFiles[i].pData, m_MappedFiles[i].nSize);
+    }
+    m_MappedFiles.clear();
+    m_OriginalData.clear();
+
     m_numLoadedFiles = 0;
     m_bInited = false;
 }
 
+// copies nRows rows of nRowSize bytes between buffers with different pitches
+static void CopyPlane(mfxU8* pDst, mfxU32 nDstPitch, const mfxU8* pSrc, mfxU32 nSrcPitch, mfxU32 nRowSize, mfxU32 nRows)
+{
+    for (mfxU32 i = 0; i < nRows; i++)
+    {
+        MSDK_MEMCPY(pDst + i * nDstPitch, pSrc + i * nSrcPitch, nRowSize);
+    }
+}
+
+mfxU8* CSmplYUVReader::GetFrameBuffer(mfxU32 nSize)
+{
+    if (nSize > m_nFrameBufferSize)
+    {
+        MSDK_SAFE_DELETE_ARRAY(m_pFrameBuffer);
+        m_nFrameBufferSize = 0;
+
+        // reserve extra space to align the working pointer to 32 bytes
+        m_pFrameBuffer = new mfxU8[nSize + 31];
+        if (!m_pFrameBuffer)
+            return NULL;
+
+        m_nFrameBufferSize = nSize;
+    }
+
+    return (mfxU8*)(((size_t)m_pFrameBuffer + 31) & ~((size_t)31));
+}
+
+bool CSmplYUVReader::IsMappedSurface(const mfxFrameData& data)
+{
+    // R shares the pointer with Y and B with V, so these two cover all supported formats
+    for (size_t i = 0; i < m_MappedFiles.size(); ++i)
+    {
+        const mfxU8* pBegin = m_MappedFiles[i].pData;
+        const mfxU8* pEnd = pBegin + m_MappedFiles[i].nSize;
+
+        if ((data.Y >= pBegin && data.Y < pEnd) || (data.V >= pBegin && data.V < pEnd))
+            return true;
+    }
+    return false;
+}
+
+bool CSmplYUVReader::BindSurface(mfxFrameSurface1* pSurface, mfxU8* pFrame)
+{
+    mfxFrameInfo& info = pSurface->Info;
+    mfxFrameData& data = pSurface->Data;
+    mfxU32 w = info.Width, h = info.Height;
+    mfxU32 pitch;
+
+    // surface must cover exactly one frame of the file, otherwise
+    // the library may touch data of neighbouring frames or beyond the mapping
+    if (info.FourCC != m_ColorFormat || info.CropX || info.CropY ||
+        (info.CropW && info.CropW != w) || (info.CropH && info.CropH != h))
+        return false;
+
+    switch (info.FourCC)
+    {
+    case MFX_FOURCC_NV12:
+    case MFX_FOURCC_YV12:
+        pitch = w;
+        break;
+    case MFX_FOURCC_YUY2:
+        pitch = 2 * w;
+        break;
+    case MFX_FOURCC_RGB4:
+    case MFX_FOURCC_BGR4:
+        pitch = 4 * w;
+        break;
+    default:
+        return false;
+    }
+
+    if (pitch > 0xFFFF)
+        return false;
+
+    if (!IsMappedSurface(data))
+    {
+        m_OriginalData[pSurface] = data;
+    }
+
+    data.Pitch = (mfxU16)pitch;
+    data.A = NULL;
+
+    switch (info.FourCC)
+    {
+    case MFX_FOURCC_NV12:
+        data.Y = pFrame;
+        data.U = data.Y + w * h;
+        data.V = data.U + 1;
+        break;
+    case MFX_FOURCC_YV12: // chroma planes in the file are stored U first
+        data.Y = pFrame;
+        data.U = data.Y + w * h;
+        data.V = data.U + (w / 2) * (h / 2);
+        break;
+    case MFX_FOURCC_YUY2:
+        data.Y = pFrame;
+        data.U = data.Y + 1;
+        data.V = data.Y + 3;
+        break;
+    case MFX_FOURCC_RGB4:
+        data.B = pFrame;
+        data.G = data.B + 1;
+        data.R = data.B + 2;
+        data.A = data.B + 3;
+        break;
+    case MFX_FOURCC_BGR4:
+        data.R = pFrame;
+        data.G = data.R + 1;
+        data.B = data.R + 2;
+        data.A = data.R + 3;
+        break;
+    }
+
+    return true;
+}
+
+mfxStatus CSmplYUVReader::UnbindSurface(mfxFrameSurface1* pSurface)
+{
+    mfxFrameData& data = pSurface->Data;
+
+    if (!IsMappedSurface(data))
+        return MFX_ERR_NONE;
+
+    std::map<mfxFrameSurface1*, mfxFrameData>::iterator it = m_OriginalData.find(pSurface);
+    if (it == m_OriginalData.end())
+        return MFX_ERR_UNDEFINED_BEHAVIOR;
+
+    data.Y = it->second.Y;
+    data.U = it->second.U;
+    data.V = it->second.V;
+    data.A = it->second.A;
+    data.Pitch = it->second.Pitch;
+
+    return MFX_ERR_NONE;
+}
+
 mfxStatus CSmplYUVReader::LoadNextFrame(mfxFrameSurface1* pSurface)
 {
     // check if reader is initialized
     MSDK_CHECK_ERROR(m_bInited, false, MFX_ERR_NOT_INITIALIZED);
     MSDK_CHECK_POINTER(pSurface, MFX_ERR_NULL_PTR);
 
-    mfxU32 nBytesRead;
-    mfxU16 w, h, i, pitch;
-    mfxU8 *ptr, *ptr2;
+    mfxU32 w, h, pitch, nFrameSize;
+    mfxU8 *ptr, *ptr2, *pFrame;
+    bool bPrefetched = false;
     mfxFrameInfo& pInfo = pSurface->Info;
     mfxFrameData& pData = pSurface->Data;
 
     mfxU32 vid = pInfo.FrameId.ViewId;
+    bool bPacked = (MFX_FOURCC_YUY2 == pInfo.FourCC || MFX_FOURCC_RGB4 == pInfo.FourCC || MFX_FOURCC_BGR4 == pInfo.FourCC);
 
     // this reader supports only NV12 mfx surfaces for code transparency,
     // other formats may be added if application requires such functionality
-    if (MFX_FOURCC_NV12 != pInfo.FourCC && MFX_FOURCC_YV12 != pInfo.FourCC && MFX_FOURCC_YUY2 != pInfo.FourCC && MFX_FOURCC_RGB4 != pInfo.FourCC && MFX_FOURCC_BGR4 != pInfo.FourCC)
+    if (MFX_FOURCC_NV12 != pInfo.FourCC && MFX_FOURCC_YV12 != pInfo.FourCC && !bPacked)
     {
         return MFX_ERR_UNSUPPORTED;
     }
@@ -197,208 +551,377 @@ mfxStatus CSmplYUVReader::LoadNextFrame(mfxFrameSurface1* pSurface)
         h = pInfo.Height;
     }
 
+    // size of one frame in the input file, rows are tightly packed there
+    switch (m_ColorFormat)
+    {
+    case MFX_FOURCC_RGB4:
+    case MFX_FOURCC_BGR4:
+        if (!bPacked || m_bIsMultiView)
+            return MFX_ERR_UNSUPPORTED;
+        nFrameSize = 4 * w * h;
+        break;
+    case MFX_FOURCC_YUY2:
+        if (!bPacked || m_bIsMultiView)
+            return MFX_ERR_UNSUPPORTED;
+        nFrameSize = 2 * w * h;
+        break;
+    case MFX_FOURCC_NV12:
+        if (bPacked)
+            return MFX_ERR_UNSUPPORTED;
+        nFrameSize = w * h + w * (h / 2);
+        break;
+    case MFX_FOURCC_YV12: // YUV420 is implied
+        if (bPacked || (MFX_FOURCC_NV12 != pInfo.FourCC && MFX_FOURCC_YV12 != pInfo.FourCC))
+            return MFX_ERR_UNSUPPORTED;
+        nFrameSize = w * h + 2 * (w / 2) * (h / 2);
+        break;
+    default:
+        return MFX_ERR_UNSUPPORTED;
+    }
+
+    if (m_bMemoryMapped)
+    {
+        mfxU32 nFile = m_bIsMultiView ? vid : 0;
+        MSDK_CHECK_ERROR(nFile < m_MappedFiles.size(), false, MFX_ERR_UNSUPPORTED);
+
+        sMappedFile& file = m_MappedFiles[nFile];
+        if (file.nOffset + nFrameSize > file.nSize)
+        {
+            return MFX_ERR_MORE_DATA;
+        }
+        pFrame = file.pData + file.nOffset;
+        file.nOffset += nFrameSize;
+
+        if (m_bZeroCopy && BindSurface(pSurface, pFrame))
+        {
+            return MFX_ERR_NONE;
+        }
+
+        // surface is going to be written, so it must not point into the mapping anymore
+        mfxStatus sts = UnbindSurface(pSurface);
+        MSDK_CHECK_RESULT(sts, MFX_ERR_NONE, sts);
+    }
+    else if (m_nPrefetchDepth && !m_bIsMultiView)
+    {
+        mfxStatus sts = MFX_ERR_NONE;
+
+        if (!m_pPrefetcher)
+        {
+            m_pPrefetcher = new CFramePrefetcher;
+            MSDK_CHECK_POINTER(m_pPrefetcher, MFX_ERR_MEMORY_ALLOC);
+
+            sts = m_pPrefetcher->Init(m_fSource, nFrameSize, m_nPrefetchDepth);
+            MSDK_CHECK_RESULT(sts, MFX_ERR_NONE, sts);
+        }
+        // frames already loaded ahead have the size of the first surface
+        MSDK_CHECK_NOT_EQUAL(m_pPrefetcher->GetFrameSize(), nFrameSize, MFX_ERR_UNSUPPORTED);
+
+        sts = m_pPrefetcher->GetFrame(&pFrame);
+        if (MFX_ERR_NONE != sts)
+        {
+            return sts;
+        }
+        bPrefetched = true;
+    }
+    else
+    {
+        pFrame = GetFrameBuffer(nFrameSize);
+        MSDK_CHECK_POINTER(pFrame, MFX_ERR_MEMORY_ALLOC);
+
+        // read the whole frame at once and scatter it to the surface planes afterwards
+        if (nFrameSize != (mfxU32)fread(pFrame, 1, nFrameSize, m_bIsMultiView ? m_fSourceMVC[vid] : m_fSource))
+        {
+            return MFX_ERR_MORE_DATA;
+        }
+    }
+
+    pitch = pData.Pitch;
 
-    if (MFX_FOURCC_YUY2 == pInfo.FourCC || MFX_FOURCC_RGB4 == pInfo.FourCC || MFX_FOURCC_BGR4 == pInfo.FourCC)
+    if (bPacked)
     {
         //Packed format: Luminance and chrominance are on the same plane
         switch (m_ColorFormat)
         {
         case MFX_FOURCC_RGB4:
         case MFX_FOURCC_BGR4:
-
-            pitch = pData.Pitch;
             ptr = MSDK_MIN( MSDK_MIN(pData.R, pData.G), pData.B);
-            ptr = ptr + pInfo.CropX + pInfo.CropY * pData.Pitch;
-
-            for(i = 0; i < h; i++)
-            {
-                if (!m_bIsMultiView)
-                {
-                    nBytesRead = (mfxU32)fread(ptr + i * pitch, 1, 4*w, m_fSource);
-                }
-                else
-                {
-                    return MFX_ERR_UNSUPPORTED;
-                }
-                if (pitch != nBytesRead)
-                {
-                    return MFX_ERR_MORE_DATA;
-                }
-            }
+            ptr = ptr + pInfo.CropX + pInfo.CropY * pitch;
+            CopyPlane(ptr, pitch, pFrame, 4 * w, 4 * w, h);
             break;
         case MFX_FOURCC_YUY2:
-            pitch = pData.Pitch;
-            ptr = pData.Y + pInfo.CropX + pInfo.CropY * pData.Pitch;
-
-            for(i = 0; i < h; i++)
-            {
-                if (!m_bIsMultiView)
-                {
-                    nBytesRead = (mfxU32)fread(ptr + i * pitch, 1, 2*w, m_fSource);
-                }
-                else
-                {
-                    return MFX_ERR_UNSUPPORTED;
-                }
-                if ((mfxU32)2*w != nBytesRead)
-                {
-                    return MFX_ERR_MORE_DATA;
-                }
-            }
+            ptr = pData.Y + pInfo.CropX + pInfo.CropY * pitch;
+            CopyPlane(ptr, pitch, pFrame, 2 * w, 2 * w, h);
             break;
-        default:
-            return MFX_ERR_UNSUPPORTED;
         }
     }
-    else if (MFX_FOURCC_NV12 == pInfo.FourCC || MFX_FOURCC_YV12 == pInfo.FourCC)
+    else
     {
-        pitch = pData.Pitch;
-        ptr = pData.Y + pInfo.CropX + pInfo.CropY * pData.Pitch;
+        // luminance plane
+        ptr = pData.Y + pInfo.CropX + pInfo.CropY * pitch;
+        CopyPlane(ptr, pitch, pFrame, w, w, h);
+        pFrame += w * h;
 
-        // read luminance plane
-        for(i = 0; i < h; i++)
+        // chroma planes
+        switch (m_ColorFormat) // color format of data in the input file
         {
-            if (!m_bIsMultiView)
+        case MFX_FOURCC_YV12:
+            w /= 2;
+            h /= 2;
+            if (MFX_FOURCC_NV12 == pInfo.FourCC)
             {
-                nBytesRead = (mfxU32)fread(ptr + i * pitch, 1, w, m_fSource);
+                const mfxU8* pU = pFrame;
+                const mfxU8* pV = pFrame + w * h;
+                ptr = pData.UV + pInfo.CropX + (pInfo.CropY / 2) * pitch;
+
+                ConvertPlanarToNV12(pU, w, pV, w, ptr, pitch, w, h);
             }
             else
             {
-                nBytesRead = (mfxU32)fread(ptr + i * pitch, 1, w, m_fSourceMVC[vid]);
-            }
-            if (w != nBytesRead)
-            {
-                return MFX_ERR_MORE_DATA;
+                pitch /= 2;
+                ptr  = pData.U + (pInfo.CropX / 2) + (pInfo.CropY / 2) * pitch;
+                ptr2 = pData.V + (pInfo.CropX / 2) + (pInfo.CropY / 2) * pitch;
+
+                CopyPlane(ptr,  pitch, pFrame,         w, w, h);
+                CopyPlane(ptr2, pitch, pFrame + w * h, w, w, h);
             }
+            break;
+        case MFX_FOURCC_NV12:
+            ptr = pData.UV + pInfo.CropX + (pInfo.CropY / 2) * pitch;
+            CopyPlane(ptr, pitch, pFrame, w, w, h / 2);
+            break;
         }
+    }
 
-        // read chroma planes
-        switch (m_ColorFormat) // color format of data in the input file
+    if (bPrefetched)
+    {
+        m_pPrefetcher->ReleaseFrame();
+    }
+
+    return MFX_ERR_NONE;
+}
+
+// alignment of write-behind buffers, suitable for O_DIRECT
+#define MSDK_WRITE_BEHIND_ALIGNMENT 4096
+
+CWriteBehindFile::CWriteBehindFile()
+{
+    m_pFile = NULL;
+    m_bDirect = false;
+    m_nBuffers = 0;
+    m_nBufferSize = 0;
+    m_pMemory = NULL;
+    m_pAlignedMemory = NULL;
+    m_nCurrent = 0;
+    m_nCurrentSize = 0;
+    m_pFilledCount = NULL;
+    m_pFreeCount = NULL;
+    m_pThread = NULL;
+    m_WriteStatus = MFX_ERR_NONE;
+}
+
+CWriteBehindFile::~CWriteBehindFile()
+{
+    Close();
+}
+
+mfxStatus CWriteBehindFile::Init(const msdk_char *strFileName, mfxU32 nBuffers, mfxU32 nBufferSize, bool bDirect)
+{
+    MSDK_CHECK_POINTER(strFileName, MFX_ERR_NULL_PTR);
+    MSDK_CHECK_ERROR(nBuffers, 0, MFX_ERR_NOT_INITIALIZED);
+    MSDK_CHECK_ERROR(nBufferSize, 0, MFX_ERR_NOT_INITIALIZED);
+
+    Close();
+
+#if !defined(_WIN32) && !defined(_WIN64)
+    if (bDirect)
+    {
+        // direct I/O needs aligned sizes, the tail of the file is written with O_DIRECT cleared
+        MSDK_CHECK_NOT_EQUAL(nBufferSize % MSDK_WRITE_BEHIND_ALIGNMENT, 0, MFX_ERR_UNSUPPORTED);
+
+        int fd = open(strFileName, O_WRONLY | O_CREAT | O_TRUNC | O_DIRECT, 0644);
+        if (fd >= 0)
         {
-        case MFX_FOURCC_YV12: // YUV420 is implied
-            switch (pInfo.FourCC)
-            {
-            case MFX_FOURCC_NV12:
+            m_pFile = fdopen(fd, "wb");
+            if (!m_pFile)
+                close(fd);
+        }
+        MSDK_CHECK_POINTER(m_pFile, MFX_ERR_NULL_PTR);
+    }
+    else
+#endif
+    {
+        // direct I/O is not supported on other platforms, the file is just opened unbuffered
+        MSDK_FOPEN(m_pFile, strFileName, MSDK_STRING("wb"));
+        MSDK_CHECK_POINTER(m_pFile, MFX_ERR_NULL_PTR);
+        bDirect = false;
+    }
+    // buffers are already large, every write goes directly to the file
+    setvbuf(m_pFile, NULL, _IONBF, 0);
+
+    m_bDirect = bDirect;
+    m_nBuffers = nBuffers;
+    m_nBufferSize = nBufferSize;
+    m_nCurrent = m_nBuffers;
+    m_nCurrentSize = 0;
+    m_WriteStatus = MFX_ERR_NONE;
+
+    m_pMemory = new mfxU8[(size_t)m_nBuffers * m_nBufferSize + MSDK_WRITE_BEHIND_ALIGNMENT - 1];
+    MSDK_CHECK_POINTER(m_pMemory, MFX_ERR_MEMORY_ALLOC);
+    m_pAlignedMemory = (mfxU8*)(((size_t)m_pMemory + MSDK_WRITE_BEHIND_ALIGNMENT - 1) & ~((size_t)MSDK_WRITE_BEHIND_ALIGNMENT - 1));
+
+    for (mfxU32 i = 0; i < m_nBuffers; i++)
+    {
+        m_FreeBuffers.push_back(i);
+    }
+
+    mfxStatus sts = MFX_ERR_NONE;
+    m_pFilledCount = new MSDKSemaphore(sts, 0);
+    MSDK_CHECK_RESULT(sts, MFX_ERR_NONE, sts);
+    m_pFreeCount = new MSDKSemaphore(sts, m_nBuffers);
+    MSDK_CHECK_RESULT(sts, MFX_ERR_NONE, sts);
+
+    m_pThread = new MSDKThread(sts, WriteThreadFunc, this);
+    MSDK_CHECK_RESULT(sts, MFX_ERR_NONE, sts);
+
+    return MFX_ERR_NONE;
+}
+
+mfxStatus CWriteBehindFile::Close()
+{
+    mfxStatus sts = MFX_ERR_NONE;
+
+    if (m_pThread)
+    {
+        if (m_nCurrent != m_nBuffers && m_nCurrentSize)
+        {
+            Submit();
+        }
+
+        // empty buffer tells the I/O thread to finish
+        sFilledBuffer last = { m_nBuffers, 0 };
+        m_mutex.Lock();
+        m_FilledBuffers.push_back(last);
+        m_mutex.Unlock();
+        m_pFilledCount->Post();
+
+        m_pThread->Wait();
+        sts = m_WriteStatus;
+    }
+
+    MSDK_SAFE_DELETE(m_pThread);
+    MSDK_SAFE_DELETE(m_pFilledCount);
+    MSDK_SAFE_DELETE(m_pFreeCount);
+    MSDK_SAFE_DELETE_ARRAY(m_pMemory);
+    m_pAlignedMemory = NULL;
+    m_FilledBuffers.clear();
+    m_FreeBuffers.clear();
+    m_nBuffers = 0;
+
+    if (m_pFile)
+    {
+        fclose(m_pFile);
+        m_pFile = NULL;
+    }
+
+    return sts;
+}
+
+mfxStatus CWriteBehindFile::Write(const mfxU8* pData, mfxU32 nSize)
+{
+    MSDK_CHECK_POINTER(m_pThread, MFX_ERR_NOT_INITIALIZED);
+
+    while (nSize)
+    {
+        if (m_nCurrent == m_nBuffers)
+        {
+            // blocks only if all buffers are queued for writing
+            m_pFreeCount->Wait();
+
+            AutomaticMutex guard(m_mutex);
+            m_nCurrent = m_FreeBuffers.back();
+            m_FreeBuffers.pop_back();
+            m_nCurrentSize = 0;
+        }
+
+        // buffers are always filled up completely, so all but the last write are aligned
+        mfxU32 nCopy = MSDK_MIN(nSize, m_nBufferSize - m_nCurrentSize);
+        MSDK_MEMCPY(GetBuffer(m_nCurrent) + m_nCurrentSize, pData, nCopy);
+        m_nCurrentSize += nCopy;
+        pData += nCopy;
+        nSize -= nCopy;
+
+        if (m_nCurrentSize == m_nBufferSize)
+        {
+            Submit();
+        }
+    }
+
+    return m_WriteStatus;
+}
 
-                mfxU8 buf[2048]; // maximum supported chroma width for nv12
-                mfxU32 j;
-                w /= 2;
-                h /= 2;
-                ptr = pData.UV + pInfo.CropX + (pInfo.CropY / 2) * pitch;
-                if (w > 2048)
-                {
-                    return MFX_ERR_UNSUPPORTED;
-                }
-                // load U
-                for (i = 0; i < h; i++)
-                {
-                    if (!m_bIsMultiView)
-                    {
-                        nBytesRead = (mfxU32)fread(buf, 1, w, m_fSource);
-                    }
-                    else
-                    {
-                        nBytesRead = (mfxU32)fread(buf, 1, w, m_fSourceMVC[vid]);
-                    }
-                    if (w != nBytesRead)
-                    {
-                        return MFX_ERR_MORE_DATA;
-                    }
-                    for (j = 0; j < w; j++)
-                    {
-                        ptr[i * pitch + j * 2] = buf[j];
-                    }
-        }
-                // load V
-                for (i = 0; i < h; i++)
-                {
-                    if (!m_bIsMultiView)
-                    {
-                        nBytesRead = (mfxU32)fread(buf, 1, w, m_fSource);
-                    }
-                    else
-                    {
-                        nBytesRead = (mfxU32)fread(buf, 1, w, m_fSourceMVC[vid]);
-                    }
-                    if (w != nBytesRead)
-                    {
-                        return MFX_ERR_MORE_DATA;
-                    }
-                    for (j = 0; j < w; j++)
-                    {
-                        ptr[i * pitch + j * 2 + 1] = buf[j];
-                    }
-                }
+mfxStatus CWriteBehindFile::Submit()
+{
+    sFilledBuffer buffer = { m_nCurrent, m_nCurrentSize };
+    m_nCurrent = m_nBuffers;
+    m_nCurrentSize = 0;
 
-                break;
-            case MFX_FOURCC_YV12:
-                w /= 2;
-                h /= 2;
-                pitch /= 2;
+    {
+        AutomaticMutex guard(m_mutex);
+        m_FilledBuffers.push_back(buffer);
+    }
+    return m_pFilledCount->Post();
+}
 
-                ptr  = pData.U + (pInfo.CropX / 2) + (pInfo.CropY / 2) * pitch;
-                ptr2 = pData.V + (pInfo.CropX / 2) + (pInfo.CropY / 2) * pitch;
+unsigned int MFX_STDCALL CWriteBehindFile::WriteThreadFunc(void* ctx)
+{
+    ((CWriteBehindFile*)ctx)->WriteLoop();
+    return 0;
+}
 
-                for(i = 0; i < h; i++)
-                {
-                    if (!m_bIsMultiView)
-                    {
-                        nBytesRead = (mfxU32)fread(ptr + i * pitch, 1, w, m_fSource);
-                    }
-                    else
-                    {
-                        nBytesRead = (mfxU32)fread(ptr + i * pitch, 1, w, m_fSourceMVC[vid]);
-                    }
-                    if (w != nBytesRead)
-                    {
-                        return MFX_ERR_MORE_DATA;
-                    }
-                }
-                for(i = 0; i < h; i++)
-                {
-                    if (!m_bIsMultiView)
-                    {
-                        nBytesRead = (mfxU32)fread(ptr2 + i * pitch, 1, w, m_fSource);
-                    }
-                    else
-                    {
-                        nBytesRead = (mfxU32)fread(ptr2 + i * pitch, 1, w, m_fSourceMVC[vid]);
-                    }
-                    if (w != nBytesRead)
-                    {
-                        return MFX_ERR_MORE_DATA;
-                    }
-                }
+void CWriteBehindFile::WriteLoop()
+{
+    for (;;)
+    {
+        m_pFilledCount->Wait();
 
-                break;
-            default:
-                return MFX_ERR_UNSUPPORTED;
-            }
-            break;
-        case MFX_FOURCC_NV12:
-            h /= 2;
-            ptr  = pData.UV + pInfo.CropX + (pInfo.CropY / 2) * pitch;
-            for(i = 0; i < h; i++)
-            {
-                if (!m_bIsMultiView)
-                {
-                    nBytesRead = (mfxU32)fread(ptr + i * pitch, 1, w, m_fSource);
-                }
-                else
-                {
-                    nBytesRead = (mfxU32)fread(ptr + i * pitch, 1, w, m_fSourceMVC[vid]);
-                }
-                if (w != nBytesRead)
-                {
-                    return MFX_ERR_MORE_DATA;
-                }
-            }
+        sFilledBuffer buffer;
+        {
+            AutomaticMutex guard(m_mutex);
+            buffer = m_FilledBuffers.front();
+            m_FilledBuffers.pop_front();
+        }
 
+        if (buffer.nIndex == m_nBuffers)
             break;
-        default:
-            return MFX_ERR_UNSUPPORTED;
+
+        // after an error data is dropped, but buffers still go around so the caller does not block
+        if (MFX_ERR_NONE == m_WriteStatus)
+        {
+            m_WriteStatus = WriteToFile(GetBuffer(buffer.nIndex), buffer.nSize);
+        }
+
+        {
+            AutomaticMutex guard(m_mutex);
+            m_FreeBuffers.push_back(buffer.nIndex);
         }
+        m_pFreeCount->Post();
+    }
+}
+
+mfxStatus CWriteBehindFile::WriteToFile(const mfxU8* pData, mfxU32 nSize)
+{
+#if !defined(_WIN32) && !defined(_WIN64)
+    if (m_bDirect && (nSize % MSDK_WRITE_BEHIND_ALIGNMENT))
+    {
+        // only the last buffer may be partially filled
+        int fd = fileno(m_pFile);
+        fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) & ~O_DIRECT);
+        m_bDirect = false;
     }
+#endif
+
+    mfxU32 nBytesWritten = (mfxU32)fwrite(pData, 1, nSize, m_pFile);
+    MSDK_CHECK_NOT_EQUAL(nBytesWritten, nSize, MFX_ERR_UNDEFINED_BEHAVIOR);
 
     return MFX_ERR_NONE;
 }
@@ -408,6 +931,10 @@ CSmplBitstreamWriter::CSmplBitstreamWriter()
     m_fSource = NULL;
     m_bInited = false;
     m_nProcessedFramesNum = 0;
+    m_nWriteBehindBuffers = 0;
+    m_nWriteBehindBufferSize = 0;
+    m_bDirectIO = false;
+    m_pWriteBehind = NULL;
 }
 
 CSmplBitstreamWriter::~CSmplBitstreamWriter()
@@ -415,16 +942,33 @@ CSmplBitstreamWriter::~CSmplBitstreamWriter()
     Close();
 }
 
-void CSmplBitstreamWriter::Close()
+mfxStatus CSmplBitstreamWriter::Close()
 {
+    mfxStatus sts = MFX_ERR_NONE;
+
     if (m_fSource)
     {
-        fclose(m_fSource);
+        if (fclose(m_fSource))
+            sts = MFX_ERR_UNDEFINED_BEHAVIOR;
         m_fSource = NULL;
     }
 
+    if (m_pWriteBehind)
+    {
+        // writes the remaining data
+        sts = m_pWriteBehind->Close();
+        MSDK_SAFE_DELETE(m_pWriteBehind);
+    }
+
+    if (MFX_ERR_NONE != sts)
+    {
+        msdk_printf(MSDK_STRING("ERROR: failed to write the output file, it may be incomplete\n"));
+    }
+
     m_bInited = false;
     m_nProcessedFramesNum = 0;
+
+    return sts;
 }
 
 mfxStatus CSmplBitstreamWriter::Init(const msdk_char *strFileName)
@@ -434,9 +978,20 @@ mfxStatus CSmplBitstreamWriter::Init(const msdk_char *strFileName)
 
     Close();
 
-    //init file to write encoded data
-    MSDK_FOPEN(m_fSource, strFileName, MSDK_STRING("wb+"));
-    MSDK_CHECK_POINTER(m_fSource, MFX_ERR_NULL_PTR);
+    if (m_nWriteBehindBuffers)
+    {
+        m_pWriteBehind = new CWriteBehindFile;
+        MSDK_CHECK_POINTER(m_pWriteBehind, MFX_ERR_MEMORY_ALLOC);
+
+        mfxStatus sts = m_pWriteBehind->Init(strFileName, m_nWriteBehindBuffers, m_nWriteBehindBufferSize, m_bDirectIO);
+        MSDK_CHECK_RESULT(sts, MFX_ERR_NONE, sts);
+    }
+    else
+    {
+        //init file to write encoded data
+        MSDK_FOPEN(m_fSource, strFileName, MSDK_STRING("wb+"));
+        MSDK_CHECK_POINTER(m_fSource, MFX_ERR_NULL_PTR);
+    }
 
     //set init state to true in case of success
     m_bInited = true;
@@ -449,10 +1004,16 @@ mfxStatus CSmplBitstreamWriter::WriteNextFrame(mfxBitstream *pMfxBitstream, bool
     MSDK_CHECK_ERROR(m_bInited, false, MFX_ERR_NOT_INITIALIZED);
     MSDK_CHECK_POINTER(pMfxBitstream, MFX_ERR_NULL_PTR);
 
-    mfxU32 nBytesWritten = 0;
-
-    nBytesWritten = (mfxU32)fwrite(pMfxBitstream->Data + pMfxBitstream->DataOffset, 1, pMfxBitstream->DataLength, m_fSource);
-    MSDK_CHECK_NOT_EQUAL(nBytesWritten, pMfxBitstream->DataLength, MFX_ERR_UNDEFINED_BEHAVIOR);
+    if (m_pWriteBehind)
+    {
+        mfxStatus sts = m_pWriteBehind->Write(pMfxBitstream->Data + pMfxBitstream->DataOffset, pMfxBitstream->DataLength);
+        MSDK_CHECK_RESULT(sts, MFX_ERR_NONE, sts);
+    }
+    else
+    {
+        mfxU32 nBytesWritten = (mfxU32)fwrite(pMfxBitstream->Data + pMfxBitstream->DataOffset, 1, pMfxBitstream->DataLength, m_fSource);
+        MSDK_CHECK_NOT_EQUAL(nBytesWritten, pMfxBitstream->DataLength, MFX_ERR_UNDEFINED_BEHAVIOR);
+    }
 
     // mark that we don't need bit stream data any more
     pMfxBitstream->DataLength = 0;
@@ -518,17 +1079,22 @@ mfxStatus CSmplBitstreamDuplicateWriter::WriteNextFrame(mfxBitstream *pMfxBitstr
     return MFX_ERR_NONE;
 }
 
-void CSmplBitstreamDuplicateWriter::Close()
+mfxStatus CSmplBitstreamDuplicateWriter::Close()
 {
+    mfxStatus sts = MFX_ERR_NONE;
+
     if (m_fSourceDuplicate && !m_bJoined)
     {
-        fclose(m_fSourceDuplicate);
+        if (fclose(m_fSourceDuplicate))
+            sts = MFX_ERR_UNDEFINED_BEHAVIOR;
     }
 
     m_fSourceDuplicate = NULL;
     m_bJoined = false;
 
-    CSmplBitstreamWriter::Close();
+    mfxStatus stsClose = CSmplBitstreamWriter::Close();
+
+    return MFX_ERR_NONE != stsClose ? stsClose : sts;
 }
 
 CSmplBitstreamReader::CSmplBitstreamReader()
@@ -594,38 +1160,162 @@ mfxStatus CSmplBitstreamReader::ReadNextFrame(mfxBitstream *pBS)
     return MFX_ERR_NONE;
 }
 
+mfxStatus CSmplBitstreamReader::ReadNextFrameNoCopy(mfxBitstream *pBS, mfxBitstream **ppBS)
+{
+    MSDK_CHECK_POINTER(ppBS, MFX_ERR_NULL_PTR);
+
+    *ppBS = pBS;
+    return ReadNextFrame(pBS);
+}
+
 
 mfxU32 CJPEGFrameReader::FindMarker(mfxBitstream *pBS,mfxU32 startOffset,CJPEGFrameReader::JPEGMarker marker)
 {
-    for (mfxU32 i = startOffset; i + sizeof(mfxU16) <= pBS->DataLength; i++)
+    if (pBS->DataLength < sizeof(mfxU16))
+        return 0xFFFFFFFF;
+
+    // the second byte of the marker is checked at each 0xFF byte
+    const mfxU8 *pEnd = pBS->Data + pBS->DataOffset + pBS->DataLength - 1;
+    for (const mfxU8 *p = pBS->Data + startOffset; p < pEnd; p++)
+    {
+        p = FindByte(p, pEnd, 0xFF);
+        if (p < pEnd && p[1] == (mfxU8)(marker >> 8))
+        {
+            return (mfxU32)(p - pBS->Data);
+        }
+    }
+    return 0xFFFFFFFF;
+}
+
+mfxU32 CJPEGFrameReader::FindPictureEnd(const mfxU8 *pData, mfxU32 nSize, CJPEGFrameReader::ScanState &state)
+{
+    enum
+    {
+        TEM = 0x01,
+        RST0 = 0xD0,
+        RST7 = 0xD7,
+        SOI_CODE = 0xD8,
+        EOI_CODE = 0xD9,
+        SOS = 0xDA,
+        FILL = 0xFF
+    };
+
+    mfxU32 nOffset = state.nOffset;
+
+    while (nOffset < nSize)
     {
-        if ( *(mfxU16*)(pBS->Data + i)==(mfxU16)marker)
+        if (state.bEntropyCoded)
+        {
+            // a marker can begin only at 0xFF byte, so the whole segment is searched for it
+            nOffset = (mfxU32)(FindByte(pData + nOffset, pData + nSize, 0xFF) - pData);
+            if (nOffset + 1 >= nSize)
+                break;
+
+            mfxU8 code = pData[nOffset + 1];
+            if (0 == code || (code >= RST0 && code <= RST7))
+            {
+                // stuffed zero byte or restart marker inside of the segment
+                nOffset += 2;
+                continue;
+            }
+            state.bEntropyCoded = false;
+        }
+
+        if (nOffset + 1 >= nSize)
+            break;
+
+        if (0xFF != pData[nOffset])
+        {
+            // broken marker segment length, look for the next marker
+            state.bEntropyCoded = true;
+            continue;
+        }
+
+        mfxU8 code = pData[nOffset + 1];
+        if (FILL == code)
+        {
+            nOffset++;
+            continue;
+        }
+        if (EOI_CODE == code)
+        {
+            state.nOffset = nOffset + 2;
+            return nOffset + 2;
+        }
+        if (TEM == code || SOI_CODE == code || (code >= RST0 && code <= RST7))
+        {
+            // markers without segment
+            nOffset += 2;
+            continue;
+        }
+
+        if (nOffset + 4 > nSize)
+            break;
+
+        mfxU32 length = (pData[nOffset + 2] << 8) | pData[nOffset + 3];
+        if (length < 2)
         {
-            return i;
+            nOffset += 2;
+            state.bEntropyCoded = true;
+            continue;
         }
+
+        nOffset += 2 + length;
+        state.bEntropyCoded = (SOS == code);
     }
+
+    state.nOffset = nOffset;
     return 0xFFFFFFFF;
 }
 
 mfxStatus CJPEGFrameReader::ReadNextFrame(mfxBitstream *pBS)
 {
+    MSDK_CHECK_POINTER(pBS, MFX_ERR_NULL_PTR);
+
     mfxStatus sts = MFX_ERR_NONE;
-    mfxU32 offsetSOI=0xFFFFFFFF;
+    // offsets from the beginning of the data, refill moves the data to the beginning of the buffer
+    mfxU32 offsetSOI = 0xFFFFFFFF;
+    mfxU32 nScanned = 0;
+    ScanState state;
 
     pBS->DataFlag = MFX_BITSTREAM_COMPLETE_FRAME;
 
-    while ((offsetSOI = FindMarker(pBS,pBS->DataOffset,CJPEGFrameReader::SOI))==0xFFFFFFFF && sts == MFX_ERR_NONE)
+    for (;;)
     {
-        sts = CSmplBitstreamReader::ReadNextFrame(pBS);
-    }
+        if (0xFFFFFFFF == offsetSOI)
+        {
+            offsetSOI = FindMarker(pBS, pBS->DataOffset + nScanned, CJPEGFrameReader::SOI);
+            if (0xFFFFFFFF != offsetSOI)
+            {
+                offsetSOI -= pBS->DataOffset;
+                state.nOffset = offsetSOI + 2;
+                state.bEntropyCoded = false;
+            }
+            else if (pBS->DataLength)
+            {
+                // the last byte may be the first one of the marker
+                nScanned = pBS->DataLength - 1;
+            }
+        }
+
+        //--- Finding EOI of frame, to make sure that it is complete
+        if (0xFFFFFFFF != offsetSOI &&
+            0xFFFFFFFF != FindPictureEnd(pBS->Data + pBS->DataOffset, pBS->DataLength, state))
+        {
+            return MFX_ERR_NONE;
+        }
+
+        // the frame is larger than the bitstream
+        if (pBS->DataLength == pBS->MaxLength)
+        {
+            sts = ExtendMfxBitstream(pBS, pBS->MaxLength * 2);
+            MSDK_CHECK_RESULT(sts, MFX_ERR_NONE, sts);
+        }
 
-    //--- Finding EOI of frame, to make sure that it is complete
-    while (FindMarker(pBS,offsetSOI,CJPEGFrameReader::EOI)==0xFFFFFFFF && sts == MFX_ERR_NONE)
-    {
         sts = CSmplBitstreamReader::ReadNextFrame(pBS);
+        if (MFX_ERR_NONE != sts)
+            return sts;
     }
-
-    return sts;
 }
 
 CIVFFrameReader::CIVFFrameReader()
@@ -960,7 +1650,7 @@ mfxStatus CSmplYUVWriter::WriteNextFrameI420(mfxFrameSurface1 *pSurface)
     mfxFrameInfo &pInfo = pSurface->Info;
     mfxFrameData &pData = pSurface->Data;
 
-    mfxU32 i, j, h, w;
+    mfxU32 i, h, w;
     mfxU32 vid = pInfo.FrameId.ViewId;
 
     if (!m_bIsMultiView)
@@ -1043,43 +1733,20 @@ mfxStatus CSmplYUVWriter::WriteNextFrameI420(mfxFrameSurface1 *pSurface)
         case MFX_FOURCC_NV12:
         {
             h = pInfo.CropH / 2;
-            w = pInfo.CropW;
-            for (i = 0; i < h; i++)
-            {
-                for (j = 0; j < w; j += 2)
-                {
-                    if (!m_bIsMultiView)
-                    {
-                        MSDK_CHECK_NOT_EQUAL(
-                            fwrite(pData.UV + (pInfo.CropY * pData.Pitch / 2 + pInfo.CropX) + i * pData.Pitch + j, 1, 1, m_fDest),
-                            1, MFX_ERR_UNDEFINED_BEHAVIOR);
-                    }
-                    else
-                    {
-                        MSDK_CHECK_NOT_EQUAL(
-                            fwrite(pData.UV + (pInfo.CropY * pData.Pitch / 2 + pInfo.CropX) + i * pData.Pitch + j, 1, 1, m_fDestMVC[vid]),
-                            1, MFX_ERR_UNDEFINED_BEHAVIOR);
-                    }
-                }
-            }
-            for (i = 0; i < h; i++)
-            {
-                for (j = 1; j < w; j += 2)
-                {
-                    if (!m_bIsMultiView)
-                    {
-                        MSDK_CHECK_NOT_EQUAL(
-                            fwrite(pData.UV + (pInfo.CropY * pData.Pitch / 2 + pInfo.CropX)+ i * pData.Pitch + j, 1, 1, m_fDest),
-                            1, MFX_ERR_UNDEFINED_BEHAVIOR);
-                    }
-                    else
-                    {
-                        MSDK_CHECK_NOT_EQUAL(
-                            fwrite(pData.UV + (pInfo.CropY * pData.Pitch / 2 + pInfo.CropX)+ i * pData.Pitch + j, 1, 1, m_fDestMVC[vid]),
-                            1, MFX_ERR_UNDEFINED_BEHAVIOR);
-                    }
-                }
-            }
+            w = pInfo.CropW / 2;
+
+            // split UV plane to U and V planes and write them at once
+            m_ChromaBuffer.resize(2 * w * h);
+            if (m_ChromaBuffer.empty())
+                break;
+
+            mfxU8* pU = &m_ChromaBuffer[0];
+            mfxU8* pV = pU + w * h;
+            ConvertNV12ToPlanar(pData.UV + (pInfo.CropY * pData.Pitch / 2 + pInfo.CropX), pData.Pitch, pU, w, pV, w, w, h);
+
+            MSDK_CHECK_NOT_EQUAL(
+                fwrite(pU, 1, 2 * w * h, m_bIsMultiView ? m_fDestMVC[vid] : m_fDest),
+                2 * w * h, MFX_ERR_UNDEFINED_BEHAVIOR);
             break;
         }
         default:
@@ -1112,73 +1779,226 @@ mfxStatus ConvertFrameRate(mfxF64 dFrameRate, mfxU32* pnFrameRateExtN, mfxU32* p
 
     if (fabs(fr * 1000 - dFrameRate * 1001) < 10)
     {
-        *pnFrameRateExtN = fr * 1000;
-        *pnFrameRateExtD = 1001;
-        return MFX_ERR_NONE;
+        *pnFrameRateExtN = fr * 1000;
+        *pnFrameRateExtD = 1001;
+        return MFX_ERR_NONE;
+    }
+
+    *pnFrameRateExtN = (mfxU32)(dFrameRate * 10000 + .5);
+    *pnFrameRateExtD = 10000;
+
+    return MFX_ERR_NONE;
+}
+
+mfxF64 CalculateFrameRate(mfxU32 nFrameRateExtN, mfxU32 nFrameRateExtD)
+{
+    if (nFrameRateExtN && nFrameRateExtD)
+        return (mfxF64)nFrameRateExtN / nFrameRateExtD;
+    else
+        return 0;
+}
+
+mfxU16 GetFreeSurfaceIndex(mfxFrameSurface1* pSurfacesPool, mfxU16 nPoolSize)
+{
+    if (pSurfacesPool)
+    {
+        for (mfxU16 i = 0; i < nPoolSize; i++)
+        {
+            if (0 == pSurfacesPool[i].Data.Locked)
+            {
+                return i;
+            }
+        }
+    }
+
+    return MSDK_INVALID_SURF_IDX;
+}
+
+mfxU16 GetFreeSurface(mfxFrameSurface1* pSurfacesPool, mfxU16 nPoolSize)
+{
+    mfxU32 SleepInterval = 10; // milliseconds
+
+    mfxU16 idx = MSDK_INVALID_SURF_IDX;
+
+    CTimer t;
+    t.Start();
+    //wait if there's no free surface
+    do
+    {
+        idx = GetFreeSurfaceIndex(pSurfacesPool, nPoolSize);
+
+        if (MSDK_INVALID_SURF_IDX != idx)
+        {
+            break;
+        }
+        else
+        {
+            MSDK_SLEEP(SleepInterval);
+        }
+    } while ( t.GetTime() < MSDK_SURFACE_WAIT_INTERVAL / 1000 );
+
+    if(idx==MSDK_INVALID_SURF_IDX)
+    {
+        msdk_printf(MSDK_STRING("ERROR: No free surfaces in pool (during long period)\n"));
+    }
+
+    return idx;
+}
+
+CSurfacePool::CSurfacePool()
+    : m_pReleased(NULL)
+{
+}
+
+CSurfacePool::~CSurfacePool()
+{
+    Close();
+}
+
+mfxStatus CSurfacePool::Init(mfxFrameSurface1* pSurfaces, mfxU16 nCount)
+{
+    MSDK_CHECK_POINTER(pSurfaces, MFX_ERR_NULL_PTR);
+
+    if (!nCount)
+    {
+        Close();
+        return MFX_ERR_NONE;
+    }
+
+    std::vector<mfxFrameSurface1*> surfaces(nCount);
+    for (mfxU16 i = 0; i < nCount; i++)
+    {
+        surfaces[i] = &pSurfaces[i];
+    }
+    return Init(&surfaces[0], nCount);
+}
+
+mfxStatus CSurfacePool::Init(mfxFrameSurface1** ppSurfaces, mfxU16 nCount)
+{
+    MSDK_CHECK_POINTER(ppSurfaces, MFX_ERR_NULL_PTR);
+    if (MSDK_INVALID_SURF_IDX == nCount)
+        return MFX_ERR_UNSUPPORTED;
+
+    Close();
+
+    mfxStatus sts = MFX_ERR_NONE;
+    m_pReleased = new MSDKEvent(sts, false, false);
+    MSDK_CHECK_RESULT(sts, MFX_ERR_NONE, sts);
+
+    AutomaticMutex lock(m_Mutex);
+    m_Surfaces.assign(ppSurfaces, ppSurfaces + nCount);
+    m_bInPool.assign(nCount, true);
+    for (mfxU16 i = 0; i < nCount; i++)
+    {
+        m_Indices[ppSurfaces[i]] = i;
+        m_Free.push_back(i);
     }
 
-    *pnFrameRateExtN = (mfxU32)(dFrameRate * 10000 + .5);
-    *pnFrameRateExtD = 10000;
-
     return MFX_ERR_NONE;
 }
 
-mfxF64 CalculateFrameRate(mfxU32 nFrameRateExtN, mfxU32 nFrameRateExtD)
+void CSurfacePool::Close()
 {
-    if (nFrameRateExtN && nFrameRateExtD)
-        return (mfxF64)nFrameRateExtN / nFrameRateExtD;
-    else
-        return 0;
+    MSDK_SAFE_DELETE(m_pReleased);
+
+    AutomaticMutex lock(m_Mutex);
+    m_Surfaces.clear();
+    m_Indices.clear();
+    m_Free.clear();
+    m_bInPool.clear();
 }
 
-mfxU16 GetFreeSurfaceIndex(mfxFrameSurface1* pSurfacesPool, mfxU16 nPoolSize)
+mfxU16 CSurfacePool::TakeFree()
 {
-    if (pSurfacesPool)
+    AutomaticMutex lock(m_Mutex);
+
+    for (std::deque<mfxU16>::iterator it = m_Free.begin(); it != m_Free.end(); ++it)
     {
-        for (mfxU16 i = 0; i < nPoolSize; i++)
+        mfxU16 idx = *it;
+        if (0 == m_Surfaces[idx]->Data.Locked)
         {
-            if (0 == pSurfacesPool[i].Data.Locked)
-            {
-                return i;
-            }
+            m_Free.erase(it);
+            m_bInPool[idx] = false;
+            return idx;
         }
     }
-
     return MSDK_INVALID_SURF_IDX;
 }
 
-mfxU16 GetFreeSurface(mfxFrameSurface1* pSurfacesPool, mfxU16 nPoolSize)
+mfxU16 CSurfacePool::GetFreeIndex(mfxU32 nTimeout)
 {
-    mfxU32 SleepInterval = 10; // milliseconds
-
-    mfxU16 idx = MSDK_INVALID_SURF_IDX;
+    mfxU16 idx = TakeFree();
+    if (MSDK_INVALID_SURF_IDX != idx || !nTimeout || !m_pReleased)
+    {
+        return idx;
+    }
 
     CTimer t;
     t.Start();
-    //wait if there's no free surface
-    do
+    // each release wakes the waiting thread up to check the returned surfaces again
+    for (;;)
     {
-        idx = GetFreeSurfaceIndex(pSurfacesPool, nPoolSize);
+        mfxU32 nElapsed = (mfxU32)(t.GetTime() * 1000);
+        if (nElapsed >= nTimeout)
+        {
+            break;
+        }
+        m_pReleased->TimedWait(nTimeout - nElapsed);
 
+        idx = TakeFree();
         if (MSDK_INVALID_SURF_IDX != idx)
         {
-            break;
+            return idx;
         }
-        else
+    }
+
+    // Media SDK may unlock surfaces without notifying the application
+    return TakeFree();
+}
+
+mfxFrameSurface1* CSurfacePool::GetFree(mfxU32 nTimeout)
+{
+    mfxU16 idx = GetFreeIndex(nTimeout);
+    return (MSDK_INVALID_SURF_IDX != idx) ? m_Surfaces[idx] : NULL;
+}
+
+void CSurfacePool::Release(mfxU16 nIndex)
+{
+    {
+        AutomaticMutex lock(m_Mutex);
+        if (nIndex >= m_Surfaces.size() || m_bInPool[nIndex])
         {
-            MSDK_SLEEP(SleepInterval);
+            return;
         }
-    } while ( t.GetTime() < MSDK_SURFACE_WAIT_INTERVAL / 1000 );
+        m_bInPool[nIndex] = true;
+        m_Free.push_back(nIndex);
+    }
+    NotifyRelease();
+}
 
-    if(idx==MSDK_INVALID_SURF_IDX)
+void CSurfacePool::Release(mfxFrameSurface1* pSurface)
+{
+    mfxU16 nIndex = MSDK_INVALID_SURF_IDX;
     {
-        msdk_printf(MSDK_STRING("ERROR: No free surfaces in pool (during long period)\n"));
+        AutomaticMutex lock(m_Mutex);
+        std::map<mfxFrameSurface1*, mfxU16>::const_iterator it = m_Indices.find(pSurface);
+        if (it != m_Indices.end())
+        {
+            nIndex = it->second;
+        }
     }
+    Release(nIndex);
+}
 
-    return idx;
+void CSurfacePool::NotifyRelease()
+{
+    if (m_pReleased)
+    {
+        m_pReleased->Signal();
+    }
 }
 
-mfxStatus InitMfxBitstream(mfxBitstream* pBitstream, mfxU32 nSize)
+mfxStatus InitMfxBitstream(mfxBitstream* pBitstream, mfxU32 nSize, mfxI32 nNumaNode)
 {
     //check input params
     MSDK_CHECK_POINTER(pBitstream, MFX_ERR_NULL_PTR);
@@ -1188,21 +2008,28 @@ mfxStatus InitMfxBitstream(mfxBitstream* pBitstream, mfxU32 nSize)
     WipeMfxBitstream(pBitstream);
 
     //prepare buffer
-    pBitstream->Data = new mfxU8[nSize];
+    mfxU32 nCapacity = 0;
+    pBitstream->Data = CBitstreamPool::Instance().Acquire(nSize, &nCapacity, nNumaNode);
     MSDK_CHECK_POINTER(pBitstream->Data, MFX_ERR_MEMORY_ALLOC);
 
-    pBitstream->MaxLength = nSize;
+    pBitstream->MaxLength = nCapacity;
 
     return MFX_ERR_NONE;
 }
 
-mfxStatus ExtendMfxBitstream(mfxBitstream* pBitstream, mfxU32 nSize)
+mfxStatus ExtendMfxBitstream(mfxBitstream* pBitstream, mfxU32 nSize, mfxI32 nNumaNode)
 {
     MSDK_CHECK_POINTER(pBitstream, MFX_ERR_NULL_PTR);
 
     MSDK_CHECK_ERROR(nSize <= pBitstream->MaxLength, true, MFX_ERR_UNSUPPORTED);
 
-    mfxU8* pData = new mfxU8[nSize];
+    if (nNumaNode < 0)
+    {
+        nNumaNode = CBitstreamPool::GetNode(pBitstream->Data);
+    }
+
+    mfxU32 nCapacity = 0;
+    mfxU8* pData = CBitstreamPool::Instance().Acquire(nSize, &nCapacity, nNumaNode);
     MSDK_CHECK_POINTER(pData, MFX_ERR_MEMORY_ALLOC);
 
     memmove(pData, pBitstream->Data + pBitstream->DataOffset, pBitstream->DataLength);
@@ -1211,7 +2038,7 @@ mfxStatus ExtendMfxBitstream(mfxBitstream* pBitstream, mfxU32 nSize)
 
     pBitstream->Data       = pData;
     pBitstream->DataOffset = 0;
-    pBitstream->MaxLength  = nSize;
+    pBitstream->MaxLength  = nCapacity;
 
     return MFX_ERR_NONE;
 }
@@ -1220,8 +2047,182 @@ void WipeMfxBitstream(mfxBitstream* pBitstream)
 {
     MSDK_CHECK_POINTER(pBitstream);
 
-    //free allocated memory
-    MSDK_SAFE_DELETE_ARRAY(pBitstream->Data);
+    //return buffer to the pool
+    CBitstreamPool::Instance().Release(pBitstream->Data);
+    pBitstream->Data = NULL;
+}
+
+mfxU32 GetSufficientBitstreamSize(const mfxVideoParam& par, mfxU32 nCurrentSize)
+{
+    mfxU32 nMultiplier = MSDK_MAX(par.mfx.BRCParamMultiplier, 1);
+    mfxU32 nSize = 0;
+
+    if (MFX_CODEC_JPEG != par.mfx.CodecId && par.mfx.BufferSizeInKB)
+    {
+        // a frame can't be bigger than HRD buffer
+        nSize = par.mfx.BufferSizeInKB * 1000 * nMultiplier;
+    }
+    else if (MFX_CODEC_JPEG != par.mfx.CodecId &&
+        (MFX_RATECONTROL_CBR == par.mfx.RateControlMethod || MFX_RATECONTROL_VBR == par.mfx.RateControlMethod))
+    {
+        // one second of the stream
+        nSize = MSDK_MAX(par.mfx.TargetKbps, par.mfx.MaxKbps) * 1000 / 8 * nMultiplier;
+    }
+
+    if (0 == nSize)
+    {
+        // no rate information (e.g. for JPEG or CQP), use size of uncompressed frame with a margin
+        nSize = 4 + (par.mfx.FrameInfo.Width * par.mfx.FrameInfo.Height * 3 + 1023);
+    }
+
+    // encoder has reported that the current buffer is not enough
+    if (nSize <= nCurrentSize)
+    {
+        nSize = 2 * nCurrentSize;
+    }
+
+    return nSize;
+}
+
+namespace
+{
+    // stored right before the aligned buffer returned by CBitstreamPool
+    struct BitstreamBufferHeader
+    {
+        mfxU8* pAllocated;
+        mfxU32 nCapacity;
+        mfxI32 nNode;
+    };
+}
+
+CBitstreamPool& CBitstreamPool::Instance()
+{
+    static CBitstreamPool pool;
+    return pool;
+}
+
+CBitstreamPool::CBitstreamPool()
+{
+    MSDK_ZERO_MEMORY(m_Stat);
+}
+
+CBitstreamPool::~CBitstreamPool()
+{
+    Trim();
+}
+
+mfxU32 CBitstreamPool::GetSizeClass(mfxU32 nSize)
+{
+    mfxU32 nClass = 0;
+    while (nClass < SIZE_CLASSES && ((mfxU32)BITSTREAM_POOL_MIN_SIZE << nClass) < nSize)
+    {
+        nClass++;
+    }
+    return nClass;
+}
+
+mfxU8* CBitstreamPool::Acquire(mfxU32 nSize, mfxU32* pnCapacity, mfxI32 nNode)
+{
+    MSDK_CHECK_POINTER(pnCapacity, NULL);
+
+    mfxU32 nClass = GetSizeClass(nSize);
+    if (nClass >= SIZE_CLASSES)
+        return NULL;
+
+    mfxU32 nCapacity = (mfxU32)BITSTREAM_POOL_MIN_SIZE << nClass;
+    mfxU8* pData = NULL;
+
+    AutomaticMutex guard(m_mutex);
+
+    nNode = MSDK_MAX(nNode, -1);
+    std::vector<mfxU8*>& freeBuffers = m_FreeBuffers[nClass][nNode];
+
+    if (!freeBuffers.empty())
+    {
+        pData = freeBuffers.back();
+        freeBuffers.pop_back();
+        m_Stat.nReuses++;
+    }
+    else
+    {
+        size_t nHeaderSize = sizeof(BitstreamBufferHeader);
+        mfxU8* pAllocated = new mfxU8[(size_t)nCapacity + nHeaderSize + BITSTREAM_POOL_ALIGNMENT];
+        MSDK_CHECK_POINTER(pAllocated, NULL);
+
+        pData = (mfxU8*)(((size_t)pAllocated + nHeaderSize + BITSTREAM_POOL_ALIGNMENT - 1) & ~((size_t)BITSTREAM_POOL_ALIGNMENT - 1));
+
+        BitstreamBufferHeader* pHeader = (BitstreamBufferHeader*)pData - 1;
+        pHeader->pAllocated = pAllocated;
+        pHeader->nCapacity  = nCapacity;
+        pHeader->nNode      = nNode;
+
+        // before the session writes to the buffer; without NUMA support the buffer stays where it is
+        if (nNode >= 0)
+        {
+            msdk_numa_bind_memory(pData, nCapacity, (mfxU32)nNode);
+        }
+
+        m_Stat.nAllocations++;
+        m_Stat.nBytesAllocated += nCapacity;
+    }
+
+    m_Stat.nBytesInUse += nCapacity;
+    m_Stat.nPeakBytesInUse = MSDK_MAX(m_Stat.nPeakBytesInUse, m_Stat.nBytesInUse);
+
+    *pnCapacity = nCapacity;
+    return pData;
+}
+
+void CBitstreamPool::Release(mfxU8* pData)
+{
+    if (!pData)
+        return;
+
+    BitstreamBufferHeader* pHeader = (BitstreamBufferHeader*)pData - 1;
+
+    AutomaticMutex guard(m_mutex);
+
+    m_FreeBuffers[GetSizeClass(pHeader->nCapacity)][pHeader->nNode].push_back(pData);
+    m_Stat.nBytesInUse -= pHeader->nCapacity;
+}
+
+mfxI32 CBitstreamPool::GetNode(const mfxU8* pData)
+{
+    return pData ? ((const BitstreamBufferHeader*)pData - 1)->nNode : -1;
+}
+
+void CBitstreamPool::Trim()
+{
+    AutomaticMutex guard(m_mutex);
+
+    for (mfxU32 i = 0; i < SIZE_CLASSES; i++)
+    {
+        std::map<mfxI32, std::vector<mfxU8*> >::iterator it;
+        for (it = m_FreeBuffers[i].begin(); it != m_FreeBuffers[i].end(); ++it)
+        {
+            for (size_t j = 0; j < it->second.size(); j++)
+            {
+                BitstreamBufferHeader* pHeader = (BitstreamBufferHeader*)it->second[j] - 1;
+                delete[] pHeader->pAllocated;
+            }
+        }
+        m_FreeBuffers[i].clear();
+    }
+}
+
+CBitstreamPool::Statistics CBitstreamPool::GetStatistics()
+{
+    AutomaticMutex guard(m_mutex);
+    return m_Stat;
+}
+
+void CBitstreamPool::PrintStatistics()
+{
+    Statistics stat = GetStatistics();
+
+    msdk_printf(MSDK_STRING("Bitstream buffers: %llu allocated (%.2f MB), %llu reused, peak in use %.2f MB\n"),
+        (unsigned long long)stat.nAllocations, stat.nBytesAllocated / (1024. * 1024.),
+        (unsigned long long)stat.nReuses, stat.nPeakBytesInUse / (1024. * 1024.));
 }
 
 std::basic_string<msdk_char> CodecIdToStr(mfxU32 nFourCC)
@@ -1336,6 +2337,25 @@ mfxF64 PartiallyLinearFNC::at(mfxF64 x)
     return (x - m_pX[minx])*(m_pY[maxx] - m_pY[minx]) / (m_pX[maxx] - m_pX[minx]) + m_pY[minx];
 }
 
+bool IsAVX2Supported()
+{
+#if defined(_MSC_VER)
+    int info[4];
+    __cpuid(info, 0);
+    if (info[0] < 7)
+        return false;
+    __cpuid(info, 1);
+    // OS has to save YMM registers on context switch
+    if (!(info[2] & (1 << 27)) || (_xgetbv(0) & 6) != 6)
+        return false;
+    __cpuidex(info, 7, 0);
+    return 0 != (info[1] & (1 << 5));
+#else
+    __builtin_cpu_init();
+    return 0 != __builtin_cpu_supports("avx2");
+#endif
+}
+
 mfxU16 CalculateDefaultBitrate(mfxU32 nCodecId, mfxU32 nTargetUsage, mfxU32 nWidth, mfxU32 nHeight, mfxF64 dFrameRate)
 {
     PartiallyLinearFNC fnc;
@@ -2021,28 +3041,48 @@ mfxI32 getMonitorType(msdk_char* str)
 CH264FrameReader::CH264FrameReader()
 : CSmplBitstreamReader()
 , m_processedBS(0)
+, m_pMappedFile(0)
+, m_nMappedSize(0)
 , m_isEndOfStream(false)
 , m_frame(0)
-, m_plainBuffer(0)
-, m_plainBufferSize(0)
 {
+    MSDK_ZERO_MEMORY(m_outBS);
 }
 
 CH264FrameReader::~CH264FrameReader()
 {
+    Close();
 }
 
 void CH264FrameReader::Close()
 {
+    if (m_pMappedFile)
+    {
+        msdk_file_unmap(m_pMappedFile, m_nMappedSize);
+        m_pMappedFile = NULL;
+        m_nMappedSize = 0;
+        m_originalBS.reset();
+    }
     WipeMfxBitstream(m_originalBS.get());
     CSmplBitstreamReader::Close();
+}
 
-    if (NULL != m_plainBuffer)
-    {
-        free(m_plainBuffer);
-        m_plainBuffer = NULL;
-        m_plainBufferSize = 0;
-    }
+void CH264FrameReader::Reset()
+{
+    // the input bitstream and the splitter exist only while the reader is initialized
+    if (!m_bInited)
+        return;
+
+    CSmplBitstreamReader::Reset();
+
+    m_originalBS->DataOffset = 0;
+    m_originalBS->DataLength = m_pMappedFile ? (mfxU32)m_nMappedSize : 0;
+
+    m_pNALSplitter->Reset();
+    m_pNALSplitter->ResetCurrentState();
+    m_frame = NULL;
+    m_processedBS = NULL;
+    m_isEndOfStream = false;
 }
 
 mfxStatus CH264FrameReader::Init(const msdk_char *strFileName)
@@ -2057,27 +3097,67 @@ mfxStatus CH264FrameReader::Init(const msdk_char *strFileName)
     m_processedBS = NULL;
 
     m_originalBS.reset(new mfxBitstream());
-    sts = InitMfxBitstream(m_originalBS.get(), 1024 * 1024);
-    if (sts != MFX_ERR_NONE)
-        return sts;
+    MSDK_ZERO_MEMORY(*m_originalBS);
+
+    // frames are handed out straight from the input, so the whole file is mapped when it fits
+    // into mfxBitstream, otherwise it is read to a large window and only frames crossing
+    // the window edge are copied
+    m_pMappedFile = msdk_file_map(strFileName, &m_nMappedSize);
+    if (m_pMappedFile && m_nMappedSize > 0xFFFFFFFF)
+    {
+        msdk_file_unmap(m_pMappedFile, m_nMappedSize);
+        m_pMappedFile = NULL;
+    }
+
+    if (m_pMappedFile)
+    {
+        m_originalBS->Data = m_pMappedFile;
+        m_originalBS->DataLength = (mfxU32)m_nMappedSize;
+        m_originalBS->MaxLength = (mfxU32)m_nMappedSize;
+    }
+    else
+    {
+        m_nMappedSize = 0;
+        sts = InitMfxBitstream(m_originalBS.get(), 8 * 1024 * 1024);
+        if (sts != MFX_ERR_NONE)
+            return sts;
+    }
 
-    m_pNALSplitter.reset(new ProtectedLibrary::AVC_Spl());
+    m_pNALSplitter.reset(CreateSplitter());
 
     m_frame = 0;
-    m_plainBuffer = 0;
-    m_plainBufferSize = 0;
 
     return sts;
 }
 
-mfxStatus CH264FrameReader::ReadNextFrame(mfxBitstream *pBS)
+AbstractSplitter* CH264FrameReader::CreateSplitter()
+{
+    return new ProtectedLibrary::AVC_Spl();
+}
+
+AbstractSplitter* CHEVCFrameReader::CreateSplitter()
+{
+    return new ProtectedLibrary::HEVC_Spl();
+}
+
+mfxStatus CH264FrameReader::ReadInput()
+{
+    // the whole file is available already
+    if (m_pMappedFile)
+        return MFX_ERR_MORE_DATA;
+
+    // refill moves the data the splitter may refer to
+    m_pNALSplitter->DetachInput();
+    return CSmplBitstreamReader::ReadNextFrame(m_originalBS.get());
+}
+
+mfxStatus CH264FrameReader::ReadNextAccessUnit()
 {
     mfxStatus sts = MFX_ERR_NONE;
-    pBS->DataFlag = MFX_BITSTREAM_COMPLETE_FRAME;
     //read bit stream from source
     while (!m_originalBS->DataLength)
     {
-        sts = CSmplBitstreamReader::ReadNextFrame(m_originalBS.get());
+        sts = ReadInput();
         if (sts != MFX_ERR_NONE && sts != MFX_ERR_MORE_DATA)
             return sts;
         if (sts == MFX_ERR_MORE_DATA)
@@ -2098,9 +3178,13 @@ mfxStatus CH264FrameReader::ReadNextFrame(mfxBitstream *pBS)
                 break;
             }
 
-            sts = CSmplBitstreamReader::ReadNextFrame(m_originalBS.get());
+            // the frame is not ready yet even if the input was refilled
+            sts = ReadInput();
             if (sts == MFX_ERR_MORE_DATA)
                 m_isEndOfStream = true;
+            else if (sts != MFX_ERR_NONE)
+                return sts;
+            sts = MFX_ERR_MORE_DATA;
             continue;
         }
         else if (MFX_ERR_NONE != sts)
@@ -2108,6 +3192,15 @@ mfxStatus CH264FrameReader::ReadNextFrame(mfxBitstream *pBS)
 
     } while (MFX_ERR_NONE != sts);
 
+    return sts;
+}
+
+mfxStatus CH264FrameReader::ReadNextFrame(mfxBitstream *pBS)
+{
+    pBS->DataFlag = MFX_BITSTREAM_COMPLETE_FRAME;
+
+    mfxStatus sts = ReadNextAccessUnit();
+
     // get output stream
     if (NULL != m_processedBS)
     {
@@ -2122,6 +3215,24 @@ mfxStatus CH264FrameReader::ReadNextFrame(mfxBitstream *pBS)
     return sts;
 }
 
+mfxStatus CH264FrameReader::ReadNextFrameNoCopy(mfxBitstream *pBS, mfxBitstream **ppBS)
+{
+    MSDK_CHECK_POINTER(pBS, MFX_ERR_NULL_PTR);
+    MSDK_CHECK_POINTER(ppBS, MFX_ERR_NULL_PTR);
+
+    pBS->DataFlag = MFX_BITSTREAM_COMPLETE_FRAME;
+
+    mfxStatus sts = ReadNextAccessUnit();
+
+    if (NULL != m_processedBS)
+    {
+        *ppBS = m_processedBS;
+        m_processedBS = NULL;
+    }
+
+    return sts;
+}
+
 mfxStatus CH264FrameReader::PrepareNextFrame(mfxBitstream *in, mfxBitstream **out)
 {
     mfxStatus sts = MFX_ERR_NONE;
@@ -2139,24 +3250,9 @@ mfxStatus CH264FrameReader::PrepareNextFrame(mfxBitstream *in, mfxBitstream **ou
             return sts;
     }
 
-    if (m_plainBufferSize < m_frame->DataLength)
-    {
-        if (NULL != m_plainBuffer)
-        {
-            free(m_plainBuffer);
-            m_plainBuffer = NULL;
-            m_plainBufferSize = 0;
-        }
-        m_plainBuffer = (mfxU8*)malloc(m_frame->DataLength);
-        if (NULL == m_plainBuffer)
-            return MFX_ERR_MEMORY_ALLOC;
-        m_plainBufferSize = m_frame->DataLength;
-    }
-
-    MSDK_MEMCPY_BUF(m_plainBuffer, 0, m_plainBufferSize, m_frame->Data, m_frame->DataLength);
-
+    // the frame stays either in the input or in the splitter buffer till the next GetFrame()
     memset(&m_outBS, 0, sizeof(mfxBitstream));
-    m_outBS.Data = m_plainBuffer;
+    m_outBS.Data = m_frame->Data;
     m_outBS.DataOffset = 0;
     m_outBS.DataLength = m_frame->DataLength;
     m_outBS.MaxLength = m_frame->DataLength;
@@ -2191,3 +3287,73 @@ void WaitForDeviceToBecomeFree(MFXVideoSession& session, mfxSyncPoint& syncPoint
         MSDK_SLEEP(DEVICE_WAIT_TIME);
     }
 }
+
+CDeviceBusyWaiter::CDeviceBusyWaiter(msdk_tick* pBusyTime, mfxU32 nMaxSleep)
+    : m_pBusyTime(pBusyTime)
+    , m_nAttempt(0)
+    , m_nMaxSleep(nMaxSleep ? nMaxSleep : 1)
+{
+}
+
+mfxStatus CDeviceBusyWaiter::Wait(MFXVideoSession* pSession, mfxSyncPoint* pSyncPoint)
+{
+    // only the waits are accounted, not the work the caller does between them
+    msdk_tick nStart = m_pBusyTime ? msdk_time_get_tick() : 0;
+
+    mfxStatus sts = WaitOnce(pSession, pSyncPoint);
+
+    if (m_pBusyTime)
+    {
+        *m_pBusyTime += msdk_time_get_tick() - nStart;
+    }
+    return sts;
+}
+
+mfxStatus CDeviceBusyWaiter::WaitOnce(MFXVideoSession* pSession, mfxSyncPoint* pSyncPoint)
+{
+    m_nAttempt++;
+
+    if (pSession && pSyncPoint && *pSyncPoint)
+    {
+        mfxStatus sts = pSession->SyncOperation(*pSyncPoint, DEVICE_WAIT_TIME);
+        if (MFX_ERR_NONE == sts)
+        {
+            // retire completed sync point (otherwise we may start active polling)
+            *pSyncPoint = NULL;
+        }
+        else if (sts < 0)
+        {
+            return sts;
+        }
+        return MFX_ERR_NONE;
+    }
+
+    Backoff();
+    return MFX_ERR_NONE;
+}
+
+// number of attempts to spin and to yield before falling asleep
+#define BUSY_SPIN_ATTEMPTS  4
+#define BUSY_YIELD_ATTEMPTS 4
+#define BUSY_SPIN_COUNT     256u
+
+void CDeviceBusyWaiter::Backoff()
+{
+    if (m_nAttempt <= BUSY_SPIN_ATTEMPTS)
+    {
+        for (mfxU32 i = 0; i < (BUSY_SPIN_COUNT << m_nAttempt); i++)
+        {
+            _mm_pause();
+        }
+    }
+    else if (m_nAttempt <= BUSY_SPIN_ATTEMPTS + BUSY_YIELD_ATTEMPTS)
+    {
+        MSDK_YIELD();
+    }
+    else
+    {
+        mfxU32 nShift = MSDK_MIN(m_nAttempt - BUSY_SPIN_ATTEMPTS - BUSY_YIELD_ATTEMPTS - 1, 16u);
+        mfxU32 nSleep = MSDK_MIN((mfxU32)DEVICE_WAIT_TIME << nShift, m_nMaxSleep);
+        MSDK_SLEEP(nSleep);
+    }
+}
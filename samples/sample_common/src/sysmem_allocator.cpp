@@ -18,6 +18,7 @@ or https://software.intel.com/en-us/media-client-solutions-support.
 \**********************************************************************************/
 
 #include "sysmem_allocator.h"
+#include "vm/thread_defs.h"
 
 #define MSDK_ALIGN32(X) (((mfxU32)((X)+31)) & (~ (mfxU32)31))
 #define ID_BUFFER MFX_MAKEFOURCC('B','U','F','F')
@@ -26,7 +27,7 @@ or https://software.intel.com/en-us/media-client-solutions-support.
 #pragma warning(disable : 4100)
 
 SysMemFrameAllocator::SysMemFrameAllocator()
-: m_pBufferAllocator(0), m_bOwnBufferAllocator(false)
+: m_pBufferAllocator(0), m_bOwnBufferAllocator(false), m_nNumaNode(-1)
 {
 }
 
@@ -47,12 +48,13 @@ mfxStatus SysMemFrameAllocator::Init(mfxAllocatorParams *pParams)
 
         m_pBufferAllocator = pSysMemParams->pBufferAllocator;
         m_bOwnBufferAllocator = false;
+        m_nNumaNode = pSysMemParams->nNumaNode;
     }
 
     // if buffer allocator wasn't passed from application create own
     if (!m_pBufferAllocator)
     {
-        m_pBufferAllocator = new SysMemBufferAllocator;
+        m_pBufferAllocator = new SysMemBufferAllocator(m_nNumaNode);
         if (!m_pBufferAllocator)
             return MFX_ERR_MEMORY_ALLOC;
 
@@ -311,7 +313,8 @@ mfxStatus SysMemFrameAllocator::ReleaseResponse(mfxFrameAllocResponse *response)
     return sts;
 }
 
-SysMemBufferAllocator::SysMemBufferAllocator()
+SysMemBufferAllocator::SysMemBufferAllocator(mfxI32 nNumaNode)
+: m_nNumaNode(nNumaNode)
 {
 
 }
@@ -335,6 +338,11 @@ mfxStatus SysMemBufferAllocator::AllocBuffer(mfxU32 nbytes, mfxU16 type, mfxMemI
     if (!buffer_ptr)
         return MFX_ERR_MEMORY_ALLOC;
 
+    // large buffers are mapped on demand, so the pages are not touched yet and can be placed
+    // on the node; failure isn't fatal, the memory just stays where the first touch puts it
+    if (m_nNumaNode >= 0)
+        msdk_numa_bind_memory(buffer_ptr, header_size + nbytes + 32, (mfxU32)m_nNumaNode);
+
     sBuffer *bs = (sBuffer *)buffer_ptr;
     bs->id = ID_BUFFER;
     bs->type = type;
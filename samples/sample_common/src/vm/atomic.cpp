@@ -32,6 +32,9 @@ or https://software.intel.com/en-us/media-client-solutions-support.
 #undef _interlockedbittestandreset64
 #pragma intrinsic (_InterlockedIncrement16)
 #pragma intrinsic (_InterlockedDecrement16)
+#pragma intrinsic (_InterlockedCompareExchange)
+#pragma intrinsic (_InterlockedCompareExchange64)
+#pragma intrinsic (_ReadWriteBarrier)
 
 mfxU16 msdk_atomic_inc16(volatile mfxU16 *pVariable)
 {
@@ -44,4 +47,27 @@ mfxU16 msdk_atomic_dec16(volatile mfxU16 *pVariable)
     return _InterlockedDecrement16((volatile short*)pVariable);
 }
 
+mfxU32 msdk_atomic_cas32(volatile mfxU32 *pVariable, mfxU32 value_to_exchange, mfxU32 value_to_compare)
+{
+    return _InterlockedCompareExchange((volatile long*)pVariable, value_to_exchange, value_to_compare);
+}
+
+mfxU64 msdk_atomic_cas64(volatile mfxU64 *pVariable, mfxU64 value_to_exchange, mfxU64 value_to_compare)
+{
+    return _InterlockedCompareExchange64((volatile __int64*)pVariable, value_to_exchange, value_to_compare);
+}
+
+mfxU32 msdk_atomic_load32(volatile mfxU32 *pVariable)
+{
+    mfxU32 value = *pVariable;
+    _ReadWriteBarrier();
+    return value;
+}
+
+void msdk_atomic_store32(volatile mfxU32 *pVariable, mfxU32 value)
+{
+    _ReadWriteBarrier();
+    *pVariable = value;
+}
+
 #endif // #if defined(_WIN32) || defined(_WIN64)
@@ -38,7 +38,30 @@ mfxU16 msdk_atomic_inc16(volatile mfxU16 *pVariable)
 /* Thread-safe 16-bit variable decrementing */
 mfxU16 msdk_atomic_dec16(volatile mfxU16 *pVariable)
 {
-    return msdk_atomic_add16(pVariable, (mfxU16)-1) + 1;
+    return msdk_atomic_add16(pVariable, (mfxU16)-1) - 1;
+}
+
+mfxU32 msdk_atomic_cas32(volatile mfxU32 *pVariable, mfxU32 value_to_exchange, mfxU32 value_to_compare)
+{
+    return __sync_val_compare_and_swap(pVariable, value_to_compare, value_to_exchange);
+}
+
+mfxU64 msdk_atomic_cas64(volatile mfxU64 *pVariable, mfxU64 value_to_exchange, mfxU64 value_to_compare)
+{
+    return __sync_val_compare_and_swap(pVariable, value_to_compare, value_to_exchange);
+}
+
+mfxU32 msdk_atomic_load32(volatile mfxU32 *pVariable)
+{
+    mfxU32 value = *pVariable;
+    asm volatile ("" ::: "memory");
+    return value;
+}
+
+void msdk_atomic_store32(volatile mfxU32 *pVariable, mfxU32 value)
+{
+    asm volatile ("" ::: "memory");
+    *pVariable = value;
 }
 
 #endif // #if !defined(_WIN32) && !defined(_WIN64)
@@ -0,0 +1,91 @@
+/******************************************************************************\
+Copyright (c) 2005-2016, Intel Corporation
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without modification, are permitted provided that the following conditions are met:
+
+1. Redistributions of source code must retain the above copyright notice, this list of conditions and the following disclaimer.
+
+2. Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the following disclaimer in the documentation and/or other materials provided with the distribution.
+
+3. Neither the name of the copyright holder nor the names of its contributors may be used to endorse or promote products derived from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+This sample was distributed or derived from the Intel's Media Samples package.
+The original version of this sample may be obtained from https://software.intel.com/en-us/intel-media-server-studio
+or https://software.intel.com/en-us/media-client-solutions-support.
+\**********************************************************************************/
+
+#include "mfx_samples_config.h"
+
+#if defined(_WIN32) || defined(_WIN64)
+
+#include "vm/file_defs.h"
+
+#include <windows.h>
+#include <io.h>
+
+mfxU8* msdk_file_map(const msdk_char *file_name, mfxU64 *size)
+{
+    if (!file_name || !size) return NULL;
+
+    HANDLE hFile = CreateFile((LPCTSTR)file_name, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+    if (INVALID_HANDLE_VALUE == hFile) return NULL;
+
+    LARGE_INTEGER fileSize;
+    if (!GetFileSizeEx(hFile, &fileSize) || !fileSize.QuadPart || (mfxU64)fileSize.QuadPart > (size_t)-1)
+    {
+        CloseHandle(hFile);
+        return NULL;
+    }
+
+    HANDLE hMapping = CreateFileMapping(hFile, NULL, PAGE_READONLY, 0, 0, NULL);
+    CloseHandle(hFile);
+    if (!hMapping) return NULL;
+
+    // the view keeps the mapping object alive, so the handle is not needed anymore
+    void *data = MapViewOfFile(hMapping, FILE_MAP_READ, 0, 0, 0);
+    CloseHandle(hMapping);
+    if (!data) return NULL;
+
+    *size = (mfxU64)fileSize.QuadPart;
+    return (mfxU8*)data;
+}
+
+void msdk_file_unmap(mfxU8 *data, mfxU64 /*size*/)
+{
+    if (!data) return;
+    UnmapViewOfFile(data);
+}
+
+mfxU32 msdk_file_read_at(FILE *file, mfxU8 *data, mfxU32 size, mfxU64 offset)
+{
+    if (!file || !data) return 0;
+
+    HANDLE hFile = (HANDLE)_get_osfhandle(_fileno(file));
+    if (INVALID_HANDLE_VALUE == hFile) return 0;
+
+    OVERLAPPED overlapped;
+    ZeroMemory(&overlapped, sizeof(overlapped));
+    overlapped.Offset = (DWORD)offset;
+    overlapped.OffsetHigh = (DWORD)(offset >> 32);
+
+    DWORD read = 0;
+    if (!ReadFile(hFile, data, size, &read, &overlapped)) return 0;
+
+    return (mfxU32)read;
+}
+
+mfxU64 msdk_file_get_size(FILE *file)
+{
+    if (!file) return 0;
+
+    HANDLE hFile = (HANDLE)_get_osfhandle(_fileno(file));
+    LARGE_INTEGER fileSize;
+    if (INVALID_HANDLE_VALUE == hFile || !GetFileSizeEx(hFile, &fileSize)) return 0;
+
+    return (mfxU64)fileSize.QuadPart;
+}
+
+#endif // #if defined(_WIN32) || defined(_WIN64)
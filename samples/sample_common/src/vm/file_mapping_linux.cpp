@@ -0,0 +1,75 @@
+/******************************************************************************\
+Copyright (c) 2005-2016, Intel Corporation
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without modification, are permitted provided that the following conditions are met:
+
+1. Redistributions of source code must retain the above copyright notice, this list of conditions and the following disclaimer.
+
+2. Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the following disclaimer in the documentation and/or other materials provided with the distribution.
+
+3. Neither the name of the copyright holder nor the names of its contributors may be used to endorse or promote products derived from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+This sample was distributed or derived from the Intel's Media Samples package.
+The original version of this sample may be obtained from https://software.intel.com/en-us/intel-media-server-studio
+or https://software.intel.com/en-us/media-client-solutions-support.
+\**********************************************************************************/
+
+#if !defined(_WIN32) && !defined(_WIN64)
+
+#include "vm/file_defs.h"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+mfxU8* msdk_file_map(const msdk_char *file_name, mfxU64 *size)
+{
+    if (!file_name || !size) return NULL;
+
+    int fd = open(file_name, O_RDONLY);
+    if (fd < 0) return NULL;
+
+    struct stat st;
+    if (fstat(fd, &st) || st.st_size <= 0 || (mfxU64)st.st_size > (size_t)-1)
+    {
+        close(fd);
+        return NULL;
+    }
+
+    // shared read-only mapping lets all processes reading the same file use the same page cache pages
+    void *data = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (MAP_FAILED == data) return NULL;
+
+    madvise(data, (size_t)st.st_size, MADV_SEQUENTIAL);
+
+    *size = (mfxU64)st.st_size;
+    return (mfxU8*)data;
+}
+
+void msdk_file_unmap(mfxU8 *data, mfxU64 size)
+{
+    if (!data) return;
+    munmap(data, (size_t)size);
+}
+
+mfxU32 msdk_file_read_at(FILE *file, mfxU8 *data, mfxU32 size, mfxU64 offset)
+{
+    if (!file || !data) return 0;
+
+    ssize_t read = pread(fileno(file), data, size, (off_t)offset);
+    return (read > 0) ? (mfxU32)read : 0;
+}
+
+mfxU64 msdk_file_get_size(FILE *file)
+{
+    struct stat st;
+    if (!file || fstat(fileno(file), &st) || st.st_size < 0) return 0;
+
+    return (mfxU64)st.st_size;
+}
+
+#endif // #if !defined(_WIN32) && !defined(_WIN64)
@@ -22,6 +22,11 @@ or https://software.intel.com/en-us/media-client-solutions-support.
 #include <new> // std::bad_alloc
 #include <stdio.h> // setrlimit
 #include <sched.h>
+#include <unistd.h> // sysconf
+#include <time.h> // clock_gettime
+#include <string.h>
+#include <dirent.h>
+#include <sys/syscall.h> // mbind
 
 #include "vm/thread_defs.h"
 #include "sample_utils.h"
@@ -266,6 +271,124 @@ mfxStatus msdk_setrlimit_vmem(mfxU64 size)
     return MFX_ERR_NONE;
 }
 
+mfxU32 msdk_thread_get_cpu_count()
+{
+    long count = sysconf(_SC_NPROCESSORS_ONLN);
+    return (count > 0) ? (mfxU32)count : 1;
+}
+
+mfxF64 msdk_thread_get_cpu_time()
+{
+    struct timespec ts;
+    if (clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts))
+        return 0;
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static bool read_sysfs_value(const char *path, mfxU32 &value)
+{
+    FILE *file = fopen(path, "r");
+    if (!file) return false;
+
+    bool res = (1 == fscanf(file, "%u", &value));
+    fclose(file);
+    return res;
+}
+
+// returns node of the processor, the node is linked from the processor's sysfs directory
+static mfxU32 get_cpu_node(mfxU32 cpu)
+{
+    char path[64];
+    snprintf(path, sizeof(path), "/sys/devices/system/cpu/cpu%u", cpu);
+
+    DIR *dir = opendir(path);
+    if (!dir) return 0;
+
+    mfxU32 node = 0;
+    struct dirent *entry;
+    while ((entry = readdir(dir)) != NULL) {
+        if (1 == sscanf(entry->d_name, "node%u", &node)) break;
+    }
+    closedir(dir);
+    return node;
+}
+
+mfxStatus msdk_thread_get_topology(std::vector<msdkCpuInfo> &cpus)
+{
+    cpu_set_t set;
+    if (sched_getaffinity(0, sizeof(set), &set)) return MFX_ERR_UNKNOWN;
+
+    cpus.clear();
+    for (mfxU32 cpu = 0; cpu < CPU_SETSIZE; ++cpu) {
+        if (!CPU_ISSET(cpu, &set)) continue;
+
+        char path[128];
+        mfxU32 core = cpu, package = 0;
+        snprintf(path, sizeof(path), "/sys/devices/system/cpu/cpu%u/topology/core_id", cpu);
+        read_sysfs_value(path, core);
+        snprintf(path, sizeof(path), "/sys/devices/system/cpu/cpu%u/topology/physical_package_id", cpu);
+        read_sysfs_value(path, package);
+
+        msdkCpuInfo info;
+        info.nCpu = cpu;
+        // core ids are unique within a package only
+        info.nCore = (package << 16) | core;
+        info.nNode = get_cpu_node(cpu);
+        cpus.push_back(info);
+    }
+    return cpus.empty() ? MFX_ERR_UNKNOWN : MFX_ERR_NONE;
+}
+
+mfxStatus msdk_thread_set_affinity(const std::vector<mfxU32> &cpus)
+{
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    for (size_t i = 0; i < cpus.size(); ++i) {
+        if (cpus[i] >= CPU_SETSIZE) return MFX_ERR_UNSUPPORTED;
+        CPU_SET(cpus[i], &set);
+    }
+    return pthread_setaffinity_np(pthread_self(), sizeof(set), &set) ? MFX_ERR_UNKNOWN : MFX_ERR_NONE;
+}
+
+mfxStatus msdk_thread_set_name(const char *name)
+{
+    if (!name) return MFX_ERR_NULL_PTR;
+
+    // names are limited by 16 bytes including the terminating zero
+    char buf[16];
+    strncpy(buf, name, sizeof(buf) - 1);
+    buf[sizeof(buf) - 1] = 0;
+    return pthread_setname_np(pthread_self(), buf) ? MFX_ERR_UNKNOWN : MFX_ERR_NONE;
+}
+
+mfxStatus msdk_numa_bind_memory(void *ptr, size_t size, mfxU32 node)
+{
+#if defined(SYS_mbind)
+    const int MSDK_MPOL_PREFERRED = 1;      // from numaif.h, libnuma is not required
+    const unsigned MSDK_MPOL_MF_MOVE = 1 << 1;
+    const size_t bits = 8 * sizeof(unsigned long);
+    unsigned long nodemask[1024 / (8 * sizeof(unsigned long))] = {0};
+
+    if (!ptr) return MFX_ERR_NULL_PTR;
+    if (node >= sizeof(nodemask) * 8) return MFX_ERR_UNSUPPORTED;
+
+    // only the pages which lie entirely within the range are bound
+    size_t page = (size_t)sysconf(_SC_PAGESIZE);
+    size_t start = ((size_t)ptr + page - 1) & ~(page - 1);
+    size_t end = ((size_t)ptr + size) & ~(page - 1);
+    if (end <= start) return MFX_ERR_NONE;
+
+    nodemask[node / bits] = 1UL << (node % bits);
+    // pages reused from the heap may be resident already, they are moved
+    if (syscall(SYS_mbind, start, end - start, MSDK_MPOL_PREFERRED, nodemask, sizeof(nodemask) * 8, MSDK_MPOL_MF_MOVE)) {
+        return MFX_ERR_UNKNOWN;
+    }
+    return MFX_ERR_NONE;
+#else
+    return MFX_ERR_UNSUPPORTED;
+#endif
+}
+
 mfxStatus msdk_thread_get_schedtype(const msdk_char* str, mfxI32 &type)
 {
     if (!msdk_strcmp(str, MSDK_STRING("fifo"))) {
@@ -163,4 +163,53 @@ mfxStatus MSDKThread::GetExitCode()
     return mfx_res;
 }
 
+mfxU32 msdk_thread_get_cpu_count()
+{
+    SYSTEM_INFO info;
+    GetSystemInfo(&info);
+    return info.dwNumberOfProcessors ? (mfxU32)info.dwNumberOfProcessors : 1;
+}
+
+mfxF64 msdk_thread_get_cpu_time()
+{
+    FILETIME creationTime, exitTime, kernelTime, userTime;
+    if (!GetThreadTimes(GetCurrentThread(), &creationTime, &exitTime, &kernelTime, &userTime))
+        return 0;
+    // FILETIME is in 100 ns units
+    ULARGE_INTEGER kernel, user;
+    kernel.LowPart = kernelTime.dwLowDateTime;
+    kernel.HighPart = kernelTime.dwHighDateTime;
+    user.LowPart = userTime.dwLowDateTime;
+    user.HighPart = userTime.dwHighDateTime;
+    return (kernel.QuadPart + user.QuadPart) / 1e7;
+}
+
+mfxStatus msdk_thread_get_topology(std::vector<msdkCpuInfo> &cpus)
+{
+    return MFX_ERR_UNSUPPORTED;
+}
+
+mfxStatus msdk_thread_set_affinity(const std::vector<mfxU32> &cpus)
+{
+    DWORD_PTR mask = 0;
+    for (size_t i = 0; i < cpus.size(); ++i)
+    {
+        // processor groups are not supported
+        if (cpus[i] >= 8 * sizeof(mask))
+            return MFX_ERR_UNSUPPORTED;
+        mask |= (DWORD_PTR)1 << cpus[i];
+    }
+    return SetThreadAffinityMask(GetCurrentThread(), mask) ? MFX_ERR_NONE : MFX_ERR_UNKNOWN;
+}
+
+mfxStatus msdk_thread_set_name(const char *name)
+{
+    return MFX_ERR_UNSUPPORTED;
+}
+
+mfxStatus msdk_numa_bind_memory(void *ptr, size_t size, mfxU32 node)
+{
+    return MFX_ERR_UNSUPPORTED;
+}
+
 #endif // #if defined(_WIN32) || defined(_WIN64)
@@ -20,21 +20,87 @@ or https://software.intel.com/en-us/media-client-solutions-support.
 #if !defined(_WIN32) && !defined(_WIN64)
 
 #include "vm/time_defs.h"
-#include <sys/time.h>
+#include <stdlib.h>
+#include <time.h>
+#if defined(__i386__) || defined(__x86_64__)
+#include <cpuid.h>
+#endif
 
-#define MSDK_TIME_MHZ 1000000
+#define MSDK_TIME_NSEC 1000000000
+// time stamp counter is calibrated against the monotonic clock during this interval
+#define MSDK_TSC_CALIBRATION_NSEC 20000000
 
-msdk_tick msdk_time_get_tick(void)
+// Ticks are taken from CLOCK_MONOTONIC_RAW which has nanosecond resolution and isn't
+// adjusted by NTP. On CPUs with invariant time stamp counter the counter is read instead:
+// it runs at constant rate and is much cheaper to read. Its frequency is calibrated once
+// at startup, setting MSDK_TIME_NO_TSC environment variable disables this path.
+
+static msdk_tick clock_get_nsec(void)
+{
+    struct timespec ts;
+
+#ifdef CLOCK_MONOTONIC_RAW
+    if (0 != clock_gettime(CLOCK_MONOTONIC_RAW, &ts))
+#endif
+        clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (msdk_tick)ts.tv_sec * (msdk_tick)MSDK_TIME_NSEC + (msdk_tick)ts.tv_nsec;
+}
+
+static bool has_invariant_tsc(void)
+{
+#if defined(__i386__) || defined(__x86_64__)
+    unsigned int eax = 0, ebx = 0, ecx = 0, edx = 0;
+
+    if (!__get_cpuid(0x80000000, &eax, &ebx, &ecx, &edx) || eax < 0x80000007)
+        return false;
+    __get_cpuid(0x80000007, &eax, &ebx, &ecx, &edx);
+    return (edx & (1 << 8)) ? true : false;
+#else
+    return false;
+#endif
+}
+
+// returns frequency of time stamp counter or 0 if the counter shouldn't be used
+static msdk_tick calibrate_tsc(void)
 {
-    struct timeval tv;
+    if (getenv("MSDK_TIME_NO_TSC") || !has_invariant_tsc())
+        return 0;
 
-    gettimeofday(&tv, NULL);
-    return (msdk_tick)tv.tv_sec * (msdk_tick)MSDK_TIME_MHZ + (msdk_tick)tv.tv_usec;
+    msdk_tick clock_start = clock_get_nsec();
+    mfxU64 tsc_start = rdtsc();
+    msdk_tick clock_end = clock_start;
+    mfxU64 tsc_end = tsc_start;
+
+    while (clock_end - clock_start < MSDK_TSC_CALIBRATION_NSEC)
+    {
+        tsc_end = rdtsc();
+        clock_end = clock_get_nsec();
+    }
+
+    if (tsc_end <= tsc_start)
+        return 0;
+    return (msdk_tick)((mfxF64)(tsc_end - tsc_start) * MSDK_TIME_NSEC / (clock_end - clock_start));
+}
+
+static msdk_tick get_tsc_frequency(void)
+{
+    // calibrated on the first call, so callers from static initializers get consistent ticks
+    static const msdk_tick frequency = calibrate_tsc();
+    return frequency;
+}
+
+// forces calibration at startup rather than inside the first measured interval
+static const msdk_tick g_TscFrequency = get_tsc_frequency();
+
+msdk_tick msdk_time_get_tick(void)
+{
+    return get_tsc_frequency() ? (msdk_tick)rdtsc() : clock_get_nsec();
 }
 
 msdk_tick msdk_time_get_frequency(void)
 {
-    return (msdk_tick)MSDK_TIME_MHZ;
+    msdk_tick frequency = get_tsc_frequency();
+    return frequency ? frequency : (msdk_tick)MSDK_TIME_NSEC;
 }
 
 mfxU64 rdtsc(void){
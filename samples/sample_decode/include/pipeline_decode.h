@@ -35,6 +35,8 @@ or https://software.intel.com/en-us/media-client-solutions-support.
 #include <memory>
 
 #include "sample_utils.h"
+#include "bitstream_index.h"
+#include "time_statistics.h"
 #include "sample_params.h"
 #include "base_allocator.h"
 
@@ -69,6 +71,8 @@ struct sInputParams
     bool    bIsMVC; // true if Multi-View Codec is in use
     bool    bLowLat; // low latency mode
     bool    bCalLat; // latency calculation
+    bool    bLockFree; // use lock-free surface pools
+    bool    bIndex; // create access unit index of the input stream if it is missing
     bool    bUseFullColorRange; //whether to use full color range
     mfxU32  nMaxFPS; //rendering limited by certain fps
     mfxU32  nWallCell;
@@ -247,6 +251,7 @@ protected: // variables
     bool                    m_bIsCompleteFrame;
     mfxU32                  m_fourcc; // color format of vpp out, i420 by default
     bool                    m_bPrintLatency;
+    bool                    m_bLockFreeBuffering; // use lock-free free surface pools and output FIFOs
     bool                    m_bOutI420;
 
     mfxU16                  m_vppOutWidth;
@@ -259,7 +264,7 @@ protected: // variables
     mfxU16                  m_diMode;
     bool                    m_bVppIsUsed;
     bool                    m_bVppFullColorRange;
-    std::vector<msdk_tick>  m_vLatency;
+    CLatencyHistogram       m_LatencyHistogram; // frame latencies in microseconds
 
     mfxExtVPPDoNotUse       m_VppDoNotUse;      // for disabling VPP algorithms
     mfxExtVPPDeinterlacing  m_VppDeinterlacing;
@@ -30,6 +30,7 @@ or https://software.intel.com/en-us/media-client-solutions-support.
 #include <algorithm>
 #include "pipeline_decode.h"
 #include "sysmem_allocator.h"
+#include "frame_tracer.h"
 
 #if defined(_WIN32) || defined(_WIN64)
 #include "d3d_allocator.h"
@@ -101,8 +102,6 @@ CDecodingPipeline::CDecodingPipeline()
     m_nRenderWinX = 0;
     m_nRenderWinY = 0;
 
-    m_vLatency.reserve(1000); // reserve some space to reduce dynamic reallocation impact on pipeline execution
-
     MSDK_ZERO_MEMORY(m_VppDoNotUse);
     m_VppDoNotUse.Header.BufferId = MFX_EXTBUFF_VPP_DONOTUSE;
     m_VppDoNotUse.Header.BufferSz = sizeof(m_VppDoNotUse);
@@ -117,6 +116,7 @@ CDecodingPipeline::CDecodingPipeline()
     m_hwdev = NULL;
 
     m_bOutI420 = false;
+    m_bLockFreeBuffering = false;
 
 #ifdef LIBVA_SUPPORT
     m_export_mode = vaapiAllocatorParams::DONOT_EXPORT;
@@ -151,6 +151,11 @@ mfxStatus CDecodingPipeline::Init(sInputParams *pParams)
             m_bIsCompleteFrame = true;
             m_bPrintLatency = pParams->bCalLat;
             break;
+        case MFX_CODEC_HEVC:
+            m_FileReader.reset(new CHEVCFrameReader());
+            m_bIsCompleteFrame = true;
+            m_bPrintLatency = pParams->bCalLat;
+            break;
         case MFX_CODEC_JPEG:
             m_FileReader.reset(new CJPEGFrameReader());
             m_bIsCompleteFrame = true;
@@ -162,7 +167,7 @@ mfxStatus CDecodingPipeline::Init(sInputParams *pParams)
             m_bPrintLatency = pParams->bCalLat;
             break;
         default:
-            return MFX_ERR_UNSUPPORTED; // latency mode is supported only for H.264 and JPEG codecs
+            return MFX_ERR_UNSUPPORTED; // latency mode is supported only for H.264, H.265, JPEG and VP8 codecs
         }
     }
     else
@@ -181,6 +186,8 @@ mfxStatus CDecodingPipeline::Init(sInputParams *pParams)
     if (pParams->fourcc)
         m_fourcc = pParams->fourcc;
 
+    m_bLockFreeBuffering = pParams->bLockFree;
+
 #ifdef LIBVA_SUPPORT
     if(pParams->bPerfMode)
         m_bPerfMode = true;
@@ -201,8 +208,35 @@ mfxStatus CDecodingPipeline::Init(sInputParams *pParams)
 
     if (MFX_CODEC_CAPTURE != pParams->videoType)
     {
-        sts = m_FileReader->Init(pParams->strSrcFile);
-        MSDK_CHECK_RESULT(sts, MFX_ERR_NONE, sts);
+        bool bIndexed = false;
+
+        // stream with access unit index is read frame by frame without parsing,
+        // the sidecar is used only if it is asked for or frames are read whole anyway
+        if (CBitstreamIndex::IsCodecSupported(pParams->videoType) && (pParams->bIndex || m_bIsCompleteFrame))
+        {
+            std::auto_ptr<CIndexedFrameReader> pIndexedReader(new CIndexedFrameReader());
+            sts = pIndexedReader->Init(pParams->strSrcFile, pParams->videoType, pParams->bIndex);
+            if (MFX_ERR_NONE == sts)
+            {
+                const CBitstreamIndex &index = pIndexedReader->GetIndex();
+                msdk_printf(MSDK_STRING("Input index: %u frames, %.2f sec\n"), index.GetCount(), index.GetDuration());
+
+                m_FileReader.reset(pIndexedReader.release());
+                m_bIsCompleteFrame = true;
+                bIndexed = true;
+            }
+            else if (pParams->bIndex)
+            {
+                msdk_printf(MSDK_STRING("error: failed to index input stream\n"));
+                return sts;
+            }
+        }
+
+        if (!bIndexed)
+        {
+            sts = m_FileReader->Init(pParams->strSrcFile);
+            MSDK_CHECK_RESULT(sts, MFX_ERR_NONE, sts);
+        }
     }
 
     mfxInitParam initPar;
@@ -1050,7 +1084,7 @@ mfxStatus CDecodingPipeline::AllocFrames()
     // prepare mfxFrameSurface1 array for decoder
     nSurfNum = m_mfxResponse.NumFrameActual;
 
-    sts = AllocBuffers(nSurfNum);
+    sts = AllocBuffers(nSurfNum, m_bLockFreeBuffering);
     MSDK_CHECK_RESULT(sts, MFX_ERR_NONE, sts);
 
     for (int i = 0; i < nSurfNum; i++)
@@ -1217,10 +1251,15 @@ mfxStatus CDecodingPipeline::CreateAllocator()
 
 void CDecodingPipeline::DeleteFrames()
 {
+    // return the surface to the pool: it may be a part of the array in lock-free mode
+    if (m_pCurrentFreeOutputSurface) {
+        AddFreeOutputSurface(m_pCurrentFreeOutputSurface);
+        m_pCurrentFreeOutputSurface = NULL;
+    }
+
     FreeBuffers();
 
     m_pCurrentFreeSurface = NULL;
-    MSDK_SAFE_FREE(m_pCurrentFreeOutputSurface);
 
     m_pCurrentFreeVppSurface = NULL;
 
@@ -1378,6 +1417,7 @@ mfxStatus CDecodingPipeline::ResetDecoder(sInputParams *pParams)
 mfxStatus CDecodingPipeline::DeliverOutput(mfxFrameSurface1* frame)
 {
     CAutoTimer timer_fwrite(m_tick_fwrite);
+    MSDK_TRACE_SCOPE(TRACE_STAGE_WRITE, 0, m_output_count);
 
     mfxStatus res = MFX_ERR_NONE, sts = MFX_ERR_NONE;
 
@@ -1487,7 +1527,11 @@ mfxStatus CDecodingPipeline::SyncOutputSurface(mfxU32 wait)
         return MFX_ERR_MORE_DATA;
     }
 
-    mfxStatus sts = m_mfxSession.SyncOperation(m_pCurrentOutputSurface->syncp, wait);
+    mfxStatus sts = MFX_ERR_NONE;
+    {
+        MSDK_TRACE_SCOPE(TRACE_STAGE_SYNC, 0, m_synced_count);
+        sts = m_mfxSession.SyncOperation(m_pCurrentOutputSurface->syncp, wait);
+    }
 
     if (MFX_WRN_IN_EXECUTION == sts) {
         return sts;
@@ -1496,7 +1540,7 @@ mfxStatus CDecodingPipeline::SyncOutputSurface(mfxU32 wait)
         // we got completely decoded frame - pushing it to the delivering thread...
         ++m_synced_count;
         if (m_bPrintLatency) {
-            m_vLatency.push_back(m_timer_overall.Sync() - m_pCurrentOutputSurface->surface->submit);
+            m_LatencyHistogram.AddValue((mfxU64)(CTimer::ConvertToSeconds(m_timer_overall.Sync() - m_pCurrentOutputSurface->surface->submit)*1000000));
         }
         else {
             PrintPerFrameStat();
@@ -1546,6 +1590,7 @@ mfxStatus CDecodingPipeline::RunDecoding()
     CTimeInterval<>     decodeTimer(m_bIsCompleteFrame);
     time_t start_time = time(0);
     MSDKThread * pDeliverThread = NULL;
+    mfxU32              nDecodedFrames = 0; // frame order for tracing
 
     if (m_eWorkMode == MODE_RENDERING) {
         m_pDeliverOutputSemaphore = new MSDKSemaphore(sts);
@@ -1571,7 +1616,13 @@ mfxStatus CDecodingPipeline::RunDecoding()
         }
         if (pBitstream && ((MFX_ERR_MORE_DATA == sts) || (m_bIsCompleteFrame && !pBitstream->DataLength))) {
             CAutoTimer timer_fread(m_tick_fread);
-            sts = m_FileReader->ReadNextFrame(pBitstream); // read more data to input bit stream
+            MSDK_TRACE_SCOPE(TRACE_STAGE_READ, 0, nDecodedFrames);
+            if (m_bIsCompleteFrame) {
+                // complete frames can be decoded right from the reader memory
+                sts = m_FileReader->ReadNextFrameNoCopy(&m_mfxBS, &pBitstream);
+            } else {
+                sts = m_FileReader->ReadNextFrame(pBitstream); // read more data to input bit stream
+            }
 
             if (MFX_ERR_MORE_DATA == sts) {
                 if (!m_bIsVideoWall) {
@@ -1656,8 +1707,11 @@ mfxStatus CDecodingPipeline::RunDecoding()
             }
             pOutSurface = NULL;
             do {
-                sts = m_pmfxDEC->DecodeFrameAsync(pBitstream, &(m_pCurrentFreeSurface->frame), &pOutSurface, &(m_pCurrentFreeOutputSurface->syncp));
-                if (pBitstream && MFX_ERR_MORE_DATA == sts && pBitstream->MaxLength == pBitstream->DataLength)
+                {
+                    MSDK_TRACE_SCOPE(TRACE_STAGE_DECODE, 0, nDecodedFrames);
+                    sts = m_pmfxDEC->DecodeFrameAsync(pBitstream, &(m_pCurrentFreeSurface->frame), &pOutSurface, &(m_pCurrentFreeOutputSurface->syncp));
+                }
+                if (pBitstream == &m_mfxBS && MFX_ERR_MORE_DATA == sts && pBitstream->MaxLength == pBitstream->DataLength)
                 {
                     mfxStatus status = ExtendMfxBitstream(pBitstream, pBitstream->MaxLength * 2);
                     MSDK_CHECK_RESULT_SAFE(status, MFX_ERR_NONE, status, MSDK_SAFE_DELETE(pDeliverThread));
@@ -1716,6 +1770,18 @@ mfxStatus CDecodingPipeline::RunDecoding()
                 break;
             } else if (MFX_ERR_INCOMPATIBLE_VIDEO_PARAM == sts) {
                 bErrIncompatibleVideoParams = true;
+                // the frame which caused the reset is decoded after it, so it is moved out of the reader memory
+                if (pBitstream && pBitstream != &m_mfxBS) {
+                    if (m_mfxBS.MaxLength < pBitstream->DataLength) {
+                        mfxStatus status = ExtendMfxBitstream(&m_mfxBS, pBitstream->DataLength);
+                        MSDK_CHECK_RESULT_SAFE(status, MFX_ERR_NONE, status, MSDK_SAFE_DELETE(pDeliverThread));
+                    }
+                    MSDK_MEMCPY_BITSTREAM(m_mfxBS, 0, pBitstream->Data + pBitstream->DataOffset, pBitstream->DataLength);
+                    m_mfxBS.DataOffset = 0;
+                    m_mfxBS.DataLength = pBitstream->DataLength;
+                    m_mfxBS.DataFlag = pBitstream->DataFlag;
+                    m_mfxBS.TimeStamp = pBitstream->TimeStamp;
+                }
                 // need to go to the buffering loop prior to reset procedure
                 pBitstream = NULL;
                 sts = MFX_ERR_NONE;
@@ -1731,8 +1797,10 @@ mfxStatus CDecodingPipeline::RunDecoding()
             }
         }
         if (MFX_ERR_NONE == sts) {
+            ++nDecodedFrames;
             if (m_bVppIsUsed)
             {
+                CDeviceBusyWaiter busyWaiter;
                 do {
                     if ((m_pCurrentFreeVppSurface->frame.Info.CropW == 0) ||
                         (m_pCurrentFreeVppSurface->frame.Info.CropH == 0)) {
@@ -1751,10 +1819,13 @@ mfxStatus CDecodingPipeline::RunDecoding()
                     if (m_diMode && m_pCurrentFreeVppSurface)
                         m_pCurrentFreeVppSurface->frame.Info.PicStruct = MFX_PICSTRUCT_PROGRESSIVE;
 
-                    sts = m_pmfxVPP->RunFrameVPPAsync(pOutSurface, &(m_pCurrentFreeVppSurface->frame), NULL, &(m_pCurrentFreeOutputSurface->syncp));
+                    {
+                        MSDK_TRACE_SCOPE(TRACE_STAGE_VPP, 0, nDecodedFrames - 1);
+                        sts = m_pmfxVPP->RunFrameVPPAsync(pOutSurface, &(m_pCurrentFreeVppSurface->frame), NULL, &(m_pCurrentFreeOutputSurface->syncp));
+                    }
 
                     if (MFX_WRN_DEVICE_BUSY == sts) {
-                        MSDK_SLEEP(1); // just wait and then repeat the same call to RunFrameVPPAsync
+                        busyWaiter.Wait(); // just wait and then repeat the same call to RunFrameVPPAsync
                     }
                 } while (MFX_WRN_DEVICE_BUSY == sts);
 
@@ -1790,19 +1861,17 @@ mfxStatus CDecodingPipeline::RunDecoding()
 
     PrintPerFrameStat(true);
 
-    if (m_bPrintLatency && m_vLatency.size() > 0) {
-        unsigned int frame_idx = 0;
-        msdk_tick sum = 0;
-        for (std::vector<msdk_tick>::iterator it = m_vLatency.begin(); it != m_vLatency.end(); ++it)
-        {
-            sum += *it;
-            msdk_printf(MSDK_STRING("Frame %4d, latency=%5.5f ms\n"), ++frame_idx, CTimer::ConvertToSeconds(*it)*1000);
-        }
-        msdk_printf(MSDK_STRING("\nLatency summary:\n"));
+    if (m_bPrintLatency && m_LatencyHistogram.GetNumValues() > 0) {
+        msdk_printf(MSDK_STRING("\nLatency summary (%llu frames):\n"), (unsigned long long)m_LatencyHistogram.GetNumValues());
         msdk_printf(MSDK_STRING("\nAVG=%5.5f ms, MAX=%5.5f ms, MIN=%5.5f ms"),
-            CTimer::ConvertToSeconds((msdk_tick)((mfxF64)sum/m_vLatency.size()))*1000,
-            CTimer::ConvertToSeconds(*std::max_element(m_vLatency.begin(), m_vLatency.end()))*1000,
-            CTimer::ConvertToSeconds(*std::min_element(m_vLatency.begin(), m_vLatency.end()))*1000);
+            m_LatencyHistogram.GetMean()/1000.,
+            m_LatencyHistogram.GetMax()/1000.,
+            m_LatencyHistogram.GetMin()/1000.);
+        msdk_printf(MSDK_STRING("\nP50=%5.5f ms, P90=%5.5f ms, P99=%5.5f ms, P99.9=%5.5f ms"),
+            m_LatencyHistogram.GetPercentile(50)/1000.,
+            m_LatencyHistogram.GetPercentile(90)/1000.,
+            m_LatencyHistogram.GetPercentile(99)/1000.,
+            m_LatencyHistogram.GetPercentile(99.9)/1000.);
     }
 
     if (m_eWorkMode == MODE_RENDERING) {
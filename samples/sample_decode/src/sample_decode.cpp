@@ -96,8 +96,12 @@ void PrintHelp(msdk_char *strAppName, const msdk_char *strErrorMessage)
     msdk_printf(MSDK_STRING("   [-rdrm]                   - render decoded data in a thru DRM frame buffer\n"));
     msdk_printf(MSDK_STRING("   [-window x y w h]         - set render window position and size\n"));
 #endif
-    msdk_printf(MSDK_STRING("   [-low_latency]            - configures decoder for low latency mode (supported only for H.264 and JPEG codec)\n"));
-    msdk_printf(MSDK_STRING("   [-calc_latency]           - calculates latency during decoding and prints log (supported only for H.264 and JPEG codec)\n"));
+    msdk_printf(MSDK_STRING("   [-low_latency]            - configures decoder for low latency mode (supported only for H.264, H.265 and JPEG codecs)\n"));
+    msdk_printf(MSDK_STRING("   [-calc_latency]           - calculates latency during decoding and prints log (supported only for H.264, H.265 and JPEG codecs)\n"));
+    msdk_printf(MSDK_STRING("   [-lock_free]              - use lock-free surface pools between decoding and rendering threads\n"));
+    msdk_printf(MSDK_STRING("   [-index]                  - read input frame by frame using <input>.idx access unit index (H.264, VP8 and JPEG),\n"));
+    msdk_printf(MSDK_STRING("                               the index is created if it is missing or stale; -low_latency and -calc_latency\n"));
+    msdk_printf(MSDK_STRING("                               use an existing valid index too\n"));
     msdk_printf(MSDK_STRING("   [-async]                  - depth of asynchronous pipeline. default value is 4. must be between 1 and 20\n"));
     msdk_printf(MSDK_STRING("   [-gpucopy::<on,off>] Enable or disable GPU copy mode\n"));
 #if !defined(_WIN32) && !defined(_WIN64)
@@ -283,7 +287,7 @@ mfxStatus ParseInputString(msdk_char* strInput[], mfxU8 nArgNum, sInputParams* p
                 }
                 default:
                 {
-                     PrintHelp(strInput[0], MSDK_STRING("-low_latency mode is suppoted only for H.264 and JPEG codecs"));
+                     PrintHelp(strInput[0], MSDK_STRING("-low_latency mode is suppoted only for H.264, H.265 and JPEG codecs"));
                      return MFX_ERR_UNSUPPORTED;
                 }
             }
@@ -306,6 +310,14 @@ mfxStatus ParseInputString(msdk_char* strInput[], mfxU8 nArgNum, sInputParams* p
                 return MFX_ERR_UNSUPPORTED;
             }
         }
+        else if (0 == msdk_strcmp(strInput[i], MSDK_STRING("-lock_free")))
+        {
+            pParams->bLockFree = true;
+        }
+        else if (0 == msdk_strcmp(strInput[i], MSDK_STRING("-index")))
+        {
+            pParams->bIndex = true;
+        }
         else if (0 == msdk_strcmp(strInput[i], MSDK_STRING("-calc_latency")))
         {
             switch (pParams->videoType)
@@ -320,7 +332,7 @@ mfxStatus ParseInputString(msdk_char* strInput[], mfxU8 nArgNum, sInputParams* p
                 }
                 default:
                 {
-                     PrintHelp(strInput[0], MSDK_STRING("-calc_latency mode is suppoted only for H.264 and JPEG codecs"));
+                     PrintHelp(strInput[0], MSDK_STRING("-calc_latency mode is suppoted only for H.264, H.265 and JPEG codecs"));
                      return MFX_ERR_UNSUPPORTED;
                 }
             }
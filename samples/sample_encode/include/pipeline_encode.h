@@ -100,7 +100,8 @@ struct sInputParams
     std::vector<msdk_char*> dstFileBuff;
 
     mfxU32  HEVCPluginVersion;
-    mfxU8 nRotationAngle; // if specified, enables rotation plugin in mfx pipeline
+    mfxU16 nRotationAngle; // if specified, enables rotation plugin in mfx pipeline
+    mfxU16 nMirror; // mirroring by rotation plugin, 1 - horizontal, 2 - vertical
     msdk_char strPluginDLLPath[MSDK_MAX_FILENAME_LEN]; // plugin dll path and name
 
     mfxU16 nAsyncDepth; // depth of asynchronous pipeline, this number can be tuned to achieve better performance
@@ -119,6 +120,10 @@ struct sInputParams
     bool UseRegionEncode;
 
     bool isV4L2InputEnabled;
+    bool bMemoryMappedInput; // read input YUV file through memory mapping
+    mfxU16 nPrefetchDepth; // number of input frames loaded ahead by a separate thread, 0 - disabled
+    mfxU16 nWriteBehindBuffers; // number of output buffers written by a separate thread, 0 - synchronous writing
+    bool bDirectIO; // write output bypassing page cache (with write-behind only)
 
 #if defined (ENABLE_V4L2_SUPPORT)
     msdk_char DeviceName[MSDK_MAX_FILENAME_LEN];
@@ -152,7 +157,9 @@ public:
 
     virtual mfxStatus Init(MFXVideoSession* pmfxSession, CSmplBitstreamWriter* pWriter, mfxU32 nPoolSize, mfxU32 nBufferSize, CSmplBitstreamWriter *pOtherWriter = NULL);
     virtual mfxStatus GetFreeTask(sTask **ppTask);
-    virtual mfxStatus SynchronizeFirstTask();
+    // completes the oldest task in flight, time spent waiting for it is added to *pSyncTime
+    virtual mfxStatus SynchronizeFirstTask(msdk_tick* pSyncTime = NULL);
+    bool HasTasksInFlight() const { return m_pTasks && NULL != m_pTasks[m_nTaskBufferStart].EncSyncP; }
 
     virtual CTimeStatistics& GetOverallStatistics() { return m_statOverall;}
     virtual CTimeStatistics& GetFileStatistics() { return m_statFile;}
@@ -161,6 +168,7 @@ protected:
     sTask* m_pTasks;
     mfxU32 m_nPoolSize;
     mfxU32 m_nTaskBufferStart;
+    mfxU32 m_nSyncedTasks; // frame order for tracing
 
     MFXVideoSession* m_pmfxSession;
 
@@ -219,6 +227,8 @@ protected:
 
     mfxFrameSurface1* m_pEncSurfaces; // frames array for encoder input (vpp output)
     mfxFrameSurface1* m_pVppSurfaces; // frames array for vpp input
+    CSurfacePool m_EncSurfacePool; // tracks free surfaces of m_pEncSurfaces
+    CSurfacePool m_VppSurfacePool; // tracks free surfaces of m_pVppSurfaces
     mfxFrameAllocResponse m_EncResponse;  // memory allocation response for encoder
     mfxFrameAllocResponse m_VppResponse;  // memory allocation response for vpp
 
@@ -226,6 +236,11 @@ protected:
 
     mfxU32 m_nFramesToProcess; // number of frames to process
 
+    mfxU16 m_nWriteBehindBuffers;
+    bool m_bDirectIO;
+
+    msdk_tick m_nBusyTime; // time spent in waits for busy device
+
     // for disabling VPP algorithms
     mfxExtVPPDoNotUse m_VppDoNotUse;
     // for MVC encoder and VPP configuration
@@ -269,8 +284,15 @@ protected:
     virtual void DeleteFrames();
 
     virtual mfxStatus AllocateSufficientBuffer(mfxBitstream* pBS);
+    mfxU32 GetEncodedDataBufferSize();
 
     virtual mfxStatus GetFreeTask(sTask **ppTask);
+    // completes the oldest encoding task in flight, MFX_ERR_NOT_FOUND if there is none
+    virtual mfxStatus SynchronizeFirstTask();
+    // takes a free surface of the pool, completing tasks in flight if all surfaces are locked by them
+    mfxStatus GetFreeSurfaceIndex(CSurfacePool& pool, sTask* pCurrentTask, mfxU16* pIdx);
+    // is called when the encoder returned MFX_WRN_DEVICE_BUSY
+    mfxStatus WaitForEncoder(CDeviceBusyWaiter& waiter);
     virtual MFXVideoSession& GetFirstSession(){return m_mfxSession;}
     virtual MFXVideoENCODE* GetFirstEncoder(){return m_pmfxENC;}
 };
@@ -61,6 +61,10 @@ public:
     mfxStatus CreatePlugins(mfxPluginUID pluginGUID, mfxChar* pluginPath);
 
     mfxStatus GetFreeTask(int resourceNum, sTask **ppTask);
+    // completes the first task of every pool, MFX_ERR_NOT_FOUND if there are none in flight
+    mfxStatus SynchronizeFirstTasks(msdk_tick* pSyncTime = NULL);
+    // is called when the encoder of resourceNum returned MFX_WRN_DEVICE_BUSY, sync time is added to *pBusyTime
+    mfxStatus WaitForEncoder(int resourceNum, CDeviceBusyWaiter& waiter, msdk_tick* pBusyTime);
     void CloseAndDeleteEverything();
 
 protected:
@@ -98,6 +102,7 @@ protected:
     virtual mfxStatus InitMfxEncParams(sInputParams *pParams);
 
     virtual mfxStatus CreateAllocator();
+    virtual mfxStatus SynchronizeFirstTask() { return m_resources.SynchronizeFirstTasks(); }
 
     virtual MFXVideoSession& GetFirstSession(){return m_resources[0].Session;}
     virtual MFXVideoENCODE* GetFirstEncoder(){return m_resources[0].pEncoder;}
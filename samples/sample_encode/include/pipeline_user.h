@@ -44,6 +44,7 @@ protected:
     msdk_so_handle          m_PluginModule;
     MFXGenericPlugin*       m_pusrPlugin;
     mfxFrameSurface1*       m_pPluginSurfaces; // frames array for rotate input
+    CSurfacePool            m_PluginSurfacePool; // tracks free surfaces of m_pPluginSurfaces
     mfxFrameAllocResponse   m_PluginResponse;  // memory allocation response for rotate plugin
 
     mfxVideoParam                   m_pluginVideoParams;
@@ -21,6 +21,7 @@ or https://software.intel.com/en-us/media-client-solutions-support.
 
 #include "pipeline_encode.h"
 #include "sysmem_allocator.h"
+#include "frame_tracer.h"
 
 #if D3D_SURFACES_SUPPORT
 #include "d3d_allocator.h"
@@ -71,6 +72,7 @@ CEncTaskPool::CEncTaskPool()
     m_pmfxSession       = NULL;
     m_nTaskBufferStart  = 0;
     m_nPoolSize         = 0;
+    m_nSyncedTasks      = 0;
 }
 
 CEncTaskPool::~CEncTaskPool()
@@ -119,7 +121,7 @@ mfxStatus CEncTaskPool::Init(MFXVideoSession* pmfxSession, CSmplBitstreamWriter*
     return MFX_ERR_NONE;
 }
 
-mfxStatus CEncTaskPool::SynchronizeFirstTask()
+mfxStatus CEncTaskPool::SynchronizeFirstTask(msdk_tick* pSyncTime)
 {
     m_statOverall.StartTimeMeasurement();
     MSDK_CHECK_POINTER(m_pTasks, MFX_ERR_NOT_INITIALIZED);
@@ -130,14 +132,24 @@ mfxStatus CEncTaskPool::SynchronizeFirstTask()
     // non-null sync point indicates that task is in execution
     if (NULL != m_pTasks[m_nTaskBufferStart].EncSyncP)
     {
-        sts = m_pmfxSession->SyncOperation(m_pTasks[m_nTaskBufferStart].EncSyncP, MSDK_WAIT_INTERVAL);
+        {
+            MSDK_TRACE_SCOPE(TRACE_STAGE_SYNC, 0, m_nSyncedTasks);
+            msdk_tick nStart = pSyncTime ? msdk_time_get_tick() : 0;
+            sts = m_pmfxSession->SyncOperation(m_pTasks[m_nTaskBufferStart].EncSyncP, MSDK_WAIT_INTERVAL);
+            if (pSyncTime)
+                *pSyncTime += msdk_time_get_tick() - nStart;
+        }
 
         if (MFX_ERR_NONE == sts)
         {
             m_statFile.StartTimeMeasurement();
-            sts = m_pTasks[m_nTaskBufferStart].WriteBitstream();
+            {
+                MSDK_TRACE_SCOPE(TRACE_STAGE_WRITE, 0, m_nSyncedTasks);
+                sts = m_pTasks[m_nTaskBufferStart].WriteBitstream();
+            }
             m_statFile.StopTimeMeasurement();
             MSDK_CHECK_RESULT(sts, MFX_ERR_NONE, sts);
+            m_nSyncedTasks++;
 
             sts = m_pTasks[m_nTaskBufferStart].Reset();
             MSDK_CHECK_RESULT(sts, MFX_ERR_NONE, sts);
@@ -173,13 +185,14 @@ mfxStatus CEncTaskPool::SynchronizeFirstTask()
             }
         }
 
+        // latency of task completion including bitstream writing
+        m_statOverall.StopTimeMeasurement();
         return sts;
     }
     else
     {
         sts = MFX_ERR_NOT_FOUND; // no tasks left in task buffer
     }
-    m_statOverall.StopTimeMeasurement();
     return sts;
 }
 
@@ -734,8 +747,14 @@ mfxStatus CEncodingPipeline::AllocFrames()
                 MSDK_CHECK_RESULT(sts, MFX_ERR_NONE, sts);
             }
         }
+
+        sts = m_VppSurfacePool.Init(m_pVppSurfaces, m_VppResponse.NumFrameActual);
+        MSDK_CHECK_RESULT(sts, MFX_ERR_NONE, sts);
     }
 
+    sts = m_EncSurfacePool.Init(m_pEncSurfaces, m_EncResponse.NumFrameActual);
+    MSDK_CHECK_RESULT(sts, MFX_ERR_NONE, sts);
+
     return MFX_ERR_NONE;
 }
 
@@ -871,6 +890,9 @@ mfxStatus CEncodingPipeline::CreateAllocator()
 
 void CEncodingPipeline::DeleteFrames()
 {
+    m_EncSurfacePool.Close();
+    m_VppSurfacePool.Close();
+
     // delete surfaces array
     MSDK_SAFE_DELETE_ARRAY(m_pEncSurfaces);
     MSDK_SAFE_DELETE_ARRAY(m_pVppSurfaces);
@@ -946,6 +968,9 @@ CEncodingPipeline::CEncodingPipeline()
     isV4L2InputEnabled = false;
 
     m_nFramesToProcess = 0;
+    m_nWriteBehindBuffers = 0;
+    m_nBusyTime = 0;
+    m_bDirectIO = false;
 }
 
 CEncodingPipeline::~CEncodingPipeline()
@@ -965,6 +990,7 @@ mfxStatus CEncodingPipeline::InitFileWriter(CSmplBitstreamWriter **ppWriter, con
     MSDK_SAFE_DELETE(*ppWriter);
     *ppWriter = new CSmplBitstreamWriter;
     MSDK_CHECK_POINTER(*ppWriter, MFX_ERR_MEMORY_ALLOC);
+    (*ppWriter)->SetWriteBehind(m_nWriteBehindBuffers, 4 * 1024 * 1024, m_bDirectIO);
     mfxStatus sts = (*ppWriter)->Init(filename);
     MSDK_CHECK_RESULT(sts, MFX_ERR_NONE, sts);
 
@@ -977,6 +1003,9 @@ mfxStatus CEncodingPipeline::InitFileWriters(sInputParams *pParams)
 
     mfxStatus sts = MFX_ERR_NONE;
 
+    m_nWriteBehindBuffers = pParams->nWriteBehindBuffers;
+    m_bDirectIO = pParams->bDirectIO;
+
     // prepare output file writers
 
     // ViewOutput mode: output in single bitstream
@@ -1003,6 +1032,7 @@ mfxStatus CEncodingPipeline::InitFileWriters(sInputParams *pParams)
 
         // init first duplicate writer
         MSDK_CHECK_POINTER(first.get(), MFX_ERR_MEMORY_ALLOC);
+        first->SetWriteBehind(m_nWriteBehindBuffers, 4 * 1024 * 1024, m_bDirectIO);
         sts = first->Init(pParams->dstFileBuff[0]);
         MSDK_CHECK_RESULT(sts, MFX_ERR_NONE, sts);
         sts = first->InitDuplicate(pParams->dstFileBuff[2]);
@@ -1011,6 +1041,7 @@ mfxStatus CEncodingPipeline::InitFileWriters(sInputParams *pParams)
         // init second duplicate writer
         std::auto_ptr<CSmplBitstreamDuplicateWriter> second(new CSmplBitstreamDuplicateWriter);
         MSDK_CHECK_POINTER(second.get(), MFX_ERR_MEMORY_ALLOC);
+        second->SetWriteBehind(m_nWriteBehindBuffers, 4 * 1024 * 1024, m_bDirectIO);
         sts = second->Init(pParams->dstFileBuff[1]);
         MSDK_CHECK_RESULT(sts, MFX_ERR_NONE, sts);
         sts = second->JoinDuplicate(first.get());
@@ -1041,6 +1072,11 @@ mfxStatus CEncodingPipeline::Init(sInputParams *pParams)
 
     if (!isV4L2InputEnabled)
     {
+        // system memory surfaces are locked only once at allocation, so the reader may point them into the mapped file
+        if (pParams->bMemoryMappedInput)
+            m_FileReader.SetMemoryMapped(SYSTEM_MEMORY == pParams->memType);
+        m_FileReader.SetPrefetchDepth(pParams->nPrefetchDepth);
+
         // prepare input file reader
         sts = m_FileReader.Init(pParams->strSrcFile,
             pParams->ColorFormat,
@@ -1259,9 +1295,22 @@ void CEncodingPipeline::Close()
 #ifdef TIME_STATS
         mfxF64 ProcDeltaTime = m_statOverall.GetDeltaTime() - m_statFile.GetDeltaTime() - m_TaskPool.GetFileStatistics().GetDeltaTime();
         msdk_printf(MSDK_STRING("Encoding fps: %.0f"), m_FileWriters.first->m_nProcessedFramesNum / ProcDeltaTime);
+        m_TaskPool.GetOverallStatistics().PrintStatistics(MSDK_STRING("\nTask synchronization, ms:"));
 #endif
     }
 
+    mfxU32 nPrefetchHits = 0, nPrefetchMisses = 0;
+    if (m_FileReader.GetPrefetchStatistics(nPrefetchHits, nPrefetchMisses))
+    {
+        msdk_printf(MSDK_STRING("\nInput prefetch: %u hits, %u misses\n"), nPrefetchHits, nPrefetchMisses);
+    }
+
+    if (m_nBusyTime)
+    {
+        msdk_printf(MSDK_STRING("\nDevice busy waits: %.3f sec\n"), MSDK_GET_TIME(m_nBusyTime, 0, msdk_time_get_frequency()));
+        m_nBusyTime = 0;
+    }
+
     MSDK_SAFE_DELETE(m_pmfxENC);
     MSDK_SAFE_DELETE(m_pmfxVPP);
 
@@ -1344,7 +1393,7 @@ mfxStatus CEncodingPipeline::ResetMFXComponents(sInputParams* pParams)
         MSDK_CHECK_RESULT(sts, MFX_ERR_NONE, sts);
     }
 
-    mfxU32 nEncodedDataBufferSize = m_mfxEncParams.mfx.FrameInfo.Width * m_mfxEncParams.mfx.FrameInfo.Height * 4;
+    mfxU32 nEncodedDataBufferSize = GetEncodedDataBufferSize();
     sts = m_TaskPool.Init(&m_mfxSession, m_FileWriters.first, m_mfxEncParams.AsyncDepth, nEncodedDataBufferSize, m_FileWriters.second);
     MSDK_CHECK_RESULT(sts, MFX_ERR_NONE, sts);
 
@@ -1364,12 +1413,26 @@ mfxStatus CEncodingPipeline::AllocateSufficientBuffer(mfxBitstream* pBS)
     MSDK_CHECK_RESULT(sts, MFX_ERR_NONE, sts);
 
     // reallocate bigger buffer for output
-    sts = ExtendMfxBitstream(pBS, par.mfx.BufferSizeInKB * 1000);
+    sts = ExtendMfxBitstream(pBS, GetSufficientBitstreamSize(par, pBS->MaxLength));
     MSDK_CHECK_RESULT_SAFE(sts, MFX_ERR_NONE, sts, WipeMfxBitstream(pBS));
 
     return MFX_ERR_NONE;
 }
 
+mfxU32 CEncodingPipeline::GetEncodedDataBufferSize()
+{
+    mfxVideoParam par;
+    MSDK_ZERO_MEMORY(par);
+
+    // initialized encoder reports the actual HRD buffer size
+    if (GetFirstEncoder() && MFX_ERR_NONE <= GetFirstEncoder()->GetVideoParam(&par))
+    {
+        return GetSufficientBitstreamSize(par);
+    }
+
+    return m_mfxEncParams.mfx.FrameInfo.Width * m_mfxEncParams.mfx.FrameInfo.Height * 4;
+}
+
 mfxStatus CEncodingPipeline::GetFreeTask(sTask **ppTask)
 {
     mfxStatus sts = MFX_ERR_NONE;
@@ -1387,6 +1450,55 @@ mfxStatus CEncodingPipeline::GetFreeTask(sTask **ppTask)
     return sts;
 }
 
+mfxStatus CEncodingPipeline::SynchronizeFirstTask()
+{
+    if (!m_TaskPool.HasTasksInFlight())
+        return MFX_ERR_NOT_FOUND;
+
+    return m_TaskPool.SynchronizeFirstTask();
+}
+
+mfxStatus CEncodingPipeline::GetFreeSurfaceIndex(CSurfacePool& pool, sTask* pCurrentTask, mfxU16* pIdx)
+{
+    MSDK_CHECK_POINTER(pIdx, MFX_ERR_NULL_PTR);
+    mfxStatus sts = MFX_ERR_NONE;
+
+    // Media SDK unlocks surfaces when the tasks using them complete, so the tasks in flight
+    // are completed (and their output written) one by one, the oldest first
+    *pIdx = pool.GetFreeIndex(0);
+    while (MSDK_INVALID_SURF_IDX == *pIdx && MFX_ERR_NONE == (sts = SynchronizeFirstTask()))
+    {
+        *pIdx = pool.GetFreeIndex(0);
+    }
+    MSDK_IGNORE_MFX_STS(sts, MFX_ERR_NOT_FOUND);
+    MSDK_CHECK_RESULT(sts, MFX_ERR_NONE, sts);
+
+    // preprocessing for the current task has no encoding task to complete yet
+    if (MSDK_INVALID_SURF_IDX == *pIdx && pCurrentTask && !pCurrentTask->DependentVppTasks.empty())
+    {
+        sts = GetFirstSession().SyncOperation(pCurrentTask->DependentVppTasks.back(), MSDK_WAIT_INTERVAL);
+        MSDK_CHECK_RESULT(sts, MFX_ERR_NONE, sts);
+        *pIdx = pool.GetFreeIndex(0);
+    }
+
+    if (MSDK_INVALID_SURF_IDX == *pIdx)
+    {
+        *pIdx = pool.GetFreeIndex(MSDK_SURFACE_WAIT_INTERVAL);
+    }
+    MSDK_CHECK_ERROR(*pIdx, MSDK_INVALID_SURF_IDX, MFX_ERR_MEMORY_ALLOC);
+
+    return MFX_ERR_NONE;
+}
+
+mfxStatus CEncodingPipeline::WaitForEncoder(CDeviceBusyWaiter& waiter)
+{
+    // completion of the oldest task in flight is what frees the device, its output is written meanwhile
+    if (m_TaskPool.HasTasksInFlight())
+        return m_TaskPool.SynchronizeFirstTask(&m_nBusyTime);
+
+    return waiter.Wait();
+}
+
 mfxStatus CEncodingPipeline::Run()
 {
     m_statOverall.StartTimeMeasurement();
@@ -1434,13 +1546,17 @@ mfxStatus CEncodingPipeline::Run()
             break;
         }
 #endif
+        // surfaces of the previous frame are passed to Media SDK, it unlocks them when done
+        m_EncSurfacePool.Release(nEncSurfIdx);
+        m_VppSurfacePool.Release(nVppSurfIdx);
+
         // get a pointer to a free task (bit stream and sync point for encoder)
         sts = GetFreeTask(&pCurrentTask);
         MSDK_BREAK_ON_ERROR(sts);
 
         // find free surface for encoder input
-        nEncSurfIdx = GetFreeSurface(m_pEncSurfaces, m_EncResponse.NumFrameActual);
-        MSDK_CHECK_ERROR(nEncSurfIdx, MSDK_INVALID_SURF_IDX, MFX_ERR_MEMORY_ALLOC);
+        sts = GetFreeSurfaceIndex(m_EncSurfacePool, pCurrentTask, &nEncSurfIdx);
+        MSDK_CHECK_RESULT(sts, MFX_ERR_NONE, sts);
 
         // point pSurf to encoder surface
         pSurf = &m_pEncSurfaces[nEncSurfIdx];
@@ -1455,8 +1571,8 @@ mfxStatus CEncodingPipeline::Run()
                     nVppSurfIdx = v4l2Pipeline.GetOffQ();
                 }
 #else
-                nVppSurfIdx = GetFreeSurface(m_pVppSurfaces, m_VppResponse.NumFrameActual);
-                MSDK_CHECK_ERROR(nVppSurfIdx, MSDK_INVALID_SURF_IDX, MFX_ERR_MEMORY_ALLOC);
+                sts = GetFreeSurfaceIndex(m_VppSurfacePool, pCurrentTask, &nVppSurfIdx);
+                MSDK_CHECK_RESULT(sts, MFX_ERR_NONE, sts);
 #endif
 
                 pSurf = &m_pVppSurfaces[nVppSurfIdx];
@@ -1476,6 +1592,7 @@ mfxStatus CEncodingPipeline::Run()
 
             if (!isV4L2InputEnabled)
             {
+                MSDK_TRACE_SCOPE(TRACE_STAGE_READ, 0, nFramesProcessed);
                 sts = m_FileReader.LoadNextFrame(pSurf);
                 MSDK_BREAK_ON_ERROR(sts);
             }
@@ -1495,6 +1612,8 @@ mfxStatus CEncodingPipeline::Run()
         if (m_pmfxVPP)
         {
             bVppMultipleOutput = false; // reset the flag before a call to VPP
+            CDeviceBusyWaiter vppBusyWaiter(&m_nBusyTime);
+            MSDK_TRACE_SCOPE(TRACE_STAGE_VPP, 0, nFramesProcessed);
             for (;;)
             {
                 sts = m_pmfxVPP->RunFrameVPPAsync(&m_pVppSurfaces[nVppSurfIdx], &m_pEncSurfaces[nEncSurfIdx],
@@ -1503,7 +1622,7 @@ mfxStatus CEncodingPipeline::Run()
                 if (MFX_ERR_NONE < sts && !VppSyncPoint) // repeat the call if warning and no output
                 {
                     if (MFX_WRN_DEVICE_BUSY == sts)
-                        MSDK_SLEEP(1); // wait if device is busy
+                        vppBusyWaiter.Wait(); // wait if device is busy
                 }
                 else if (MFX_ERR_NONE < sts && VppSyncPoint)
                 {
@@ -1536,6 +1655,8 @@ mfxStatus CEncodingPipeline::Run()
             VppSyncPoint = NULL;
         }
 
+        CDeviceBusyWaiter encBusyWaiter(&m_nBusyTime);
+        MSDK_TRACE_SCOPE(TRACE_STAGE_ENCODE, 0, nFramesProcessed);
         for (;;)
         {
             // at this point surface for encoder contains either a frame from file or a frame processed by vpp
@@ -1544,7 +1665,10 @@ mfxStatus CEncodingPipeline::Run()
             if (MFX_ERR_NONE < sts && !pCurrentTask->EncSyncP) // repeat the call if warning and no output
             {
                 if (MFX_WRN_DEVICE_BUSY == sts)
-                    MSDK_SLEEP(1); // wait if device is busy
+                {
+                    sts = WaitForEncoder(encBusyWaiter);
+                    MSDK_BREAK_ON_ERROR(sts);
+                }
             }
             else if (MFX_ERR_NONE < sts && pCurrentTask->EncSyncP)
             {
@@ -1567,6 +1691,9 @@ mfxStatus CEncodingPipeline::Run()
         nFramesProcessed++;
     }
 
+    m_EncSurfacePool.Release(nEncSurfIdx);
+    m_VppSurfacePool.Release(nVppSurfIdx);
+
     // means that the input file has ended, need to go to buffering loops
     MSDK_IGNORE_MFX_STS(sts, MFX_ERR_MORE_DATA);
     // exit in case of other errors
@@ -1579,10 +1706,12 @@ mfxStatus CEncodingPipeline::Run()
             // MFX_ERR_MORE_SURFACE can be returned only by RunFrameVPPAsync
             // MFX_ERR_MORE_DATA is accepted only from EncodeFrameAsync
         {
-            // find free surface for encoder input (vpp output)
-            nEncSurfIdx = GetFreeSurface(m_pEncSurfaces, m_EncResponse.NumFrameActual);
-            MSDK_CHECK_ERROR(nEncSurfIdx, MSDK_INVALID_SURF_IDX, MFX_ERR_MEMORY_ALLOC);
+            // find free surface for encoder input (vpp output), the previous one is passed to Media SDK
+            m_EncSurfacePool.Release(nEncSurfIdx);
+            sts = GetFreeSurfaceIndex(m_EncSurfacePool, pCurrentTask, &nEncSurfIdx);
+            MSDK_CHECK_RESULT(sts, MFX_ERR_NONE, sts);
 
+            CDeviceBusyWaiter vppBusyWaiter(&m_nBusyTime);
             for (;;)
             {
                 sts = m_pmfxVPP->RunFrameVPPAsync(NULL, &m_pEncSurfaces[nEncSurfIdx], NULL, &VppSyncPoint);
@@ -1590,7 +1719,7 @@ mfxStatus CEncodingPipeline::Run()
                 if (MFX_ERR_NONE < sts && !VppSyncPoint) // repeat the call if warning and no output
                 {
                     if (MFX_WRN_DEVICE_BUSY == sts)
-                        MSDK_SLEEP(1); // wait if device is busy
+                        vppBusyWaiter.Wait(); // wait if device is busy
                 }
                 else if (MFX_ERR_NONE < sts && VppSyncPoint)
                 {
@@ -1621,6 +1750,7 @@ mfxStatus CEncodingPipeline::Run()
                 VppSyncPoint = NULL;
             }
 
+            CDeviceBusyWaiter encBusyWaiter(&m_nBusyTime);
             for (;;)
             {
                 sts = m_pmfxENC->EncodeFrameAsync(NULL, &m_pEncSurfaces[nEncSurfIdx], &pCurrentTask->mfxBS, &pCurrentTask->EncSyncP);
@@ -1628,7 +1758,10 @@ mfxStatus CEncodingPipeline::Run()
                 if (MFX_ERR_NONE < sts && !pCurrentTask->EncSyncP) // repeat the call if warning and no output
                 {
                     if (MFX_WRN_DEVICE_BUSY == sts)
-                        MSDK_SLEEP(1); // wait if device is busy
+                    {
+                        sts = WaitForEncoder(encBusyWaiter);
+                        MSDK_BREAK_ON_ERROR(sts);
+                    }
                 }
                 else if (MFX_ERR_NONE < sts && pCurrentTask->EncSyncP)
                 {
@@ -1649,6 +1782,8 @@ mfxStatus CEncodingPipeline::Run()
             }
         }
 
+        m_EncSurfacePool.Release(nEncSurfIdx);
+
         // MFX_ERR_MORE_DATA is the correct status to exit buffering loop with
         // indicates that there are no more buffered frames
         MSDK_IGNORE_MFX_STS(sts, MFX_ERR_MORE_DATA);
@@ -1663,6 +1798,7 @@ mfxStatus CEncodingPipeline::Run()
         sts = GetFreeTask(&pCurrentTask);
         MSDK_BREAK_ON_ERROR(sts);
 
+        CDeviceBusyWaiter encBusyWaiter(&m_nBusyTime);
         for (;;)
         {
             sts = m_pmfxENC->EncodeFrameAsync(NULL, NULL, &pCurrentTask->mfxBS, &pCurrentTask->EncSyncP);
@@ -1670,7 +1806,10 @@ mfxStatus CEncodingPipeline::Run()
             if (MFX_ERR_NONE < sts && !pCurrentTask->EncSyncP) // repeat the call if warning and no output
             {
                 if (MFX_WRN_DEVICE_BUSY == sts)
-                    MSDK_SLEEP(1); // wait if device is busy
+                {
+                    sts = WaitForEncoder(encBusyWaiter);
+                    MSDK_BREAK_ON_ERROR(sts);
+                }
             }
             else if (MFX_ERR_NONE < sts && pCurrentTask->EncSyncP)
             {
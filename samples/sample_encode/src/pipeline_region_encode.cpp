@@ -57,6 +57,31 @@ mfxStatus CResourcesPool::GetFreeTask(int resourceNum,sTask **ppTask)
     return sts;
 }
 
+mfxStatus CResourcesPool::SynchronizeFirstTasks(msdk_tick* pSyncTime)
+{
+    // Regions are written in order, so the first tasks of all pools are completed together. All pools have
+    // a task of the same frame in flight if the first one has: the pools are always synchronized together.
+    if (!size || !m_resources[0].TaskPool.HasTasksInFlight())
+        return MFX_ERR_NOT_FOUND;
+
+    for (int i = 0; i < size; i++)
+    {
+        mfxStatus sts = m_resources[i].TaskPool.SynchronizeFirstTask(pSyncTime);
+        MSDK_CHECK_RESULT(sts, MFX_ERR_NONE, sts);
+    }
+
+    return MFX_ERR_NONE;
+}
+
+mfxStatus CResourcesPool::WaitForEncoder(int resourceNum, CDeviceBusyWaiter& waiter, msdk_tick* pBusyTime)
+{
+    // the pools of the regions encoded before the busy one have a task of the current frame
+    if (!m_resources[resourceNum].TaskPool.HasTasksInFlight())
+        return waiter.Wait();
+
+    return SynchronizeFirstTasks(pBusyTime);
+}
+
 mfxStatus CResourcesPool::Init(int size,mfxIMPL impl, mfxVersion *pVer)
 {
     MSDK_CHECK_NOT_EQUAL(m_resources, NULL , MFX_ERR_INVALID_HANDLE);
@@ -314,6 +339,10 @@ mfxStatus CRegionEncodingPipeline::Init(sInputParams *pParams)
     mfxStatus sts = MFX_ERR_NONE;
 
     // prepare input file reader
+    if (pParams->bMemoryMappedInput)
+        m_FileReader.SetMemoryMapped(false);
+    m_FileReader.SetPrefetchDepth(pParams->nPrefetchDepth);
+
     sts = m_FileReader.Init(pParams->strSrcFile,
                             pParams->ColorFormat,
                             pParams->numViews,
@@ -529,7 +558,7 @@ mfxStatus CRegionEncodingPipeline::ResetMFXComponents(sInputParams* pParams)
         MSDK_CHECK_RESULT(sts, MFX_ERR_NONE, sts);
     }
 
-    mfxU32 nEncodedDataBufferSize = m_mfxEncParams.mfx.FrameInfo.Width * m_mfxEncParams.mfx.FrameInfo.Height * 4;
+    mfxU32 nEncodedDataBufferSize = GetEncodedDataBufferSize();
 
     sts = m_resources.InitTaskPools(m_FileWriters.first, m_mfxEncParams.AsyncDepth, nEncodedDataBufferSize, m_FileWriters.second);
     MSDK_CHECK_RESULT(sts, MFX_ERR_NONE, sts);
@@ -565,9 +594,10 @@ mfxStatus CRegionEncodingPipeline::Run()
     // main loop, preprocessing and encoding
     while (MFX_ERR_NONE <= sts || MFX_ERR_MORE_DATA == sts)
     {
-        // find free surface for encoder input
-        nEncSurfIdx = GetFreeSurface(m_pEncSurfaces, m_EncResponse.NumFrameActual);
-        MSDK_CHECK_ERROR(nEncSurfIdx, MSDK_INVALID_SURF_IDX, MFX_ERR_MEMORY_ALLOC);
+        // find free surface for encoder input, the previous one is passed to Media SDK
+        m_EncSurfacePool.Release(nEncSurfIdx);
+        sts = GetFreeSurfaceIndex(m_EncSurfacePool, NULL, &nEncSurfIdx);
+        MSDK_CHECK_RESULT(sts, MFX_ERR_NONE, sts);
 
         // point pSurf to encoder surface
         pSurf = &m_pEncSurfaces[nEncSurfIdx];
@@ -602,6 +632,7 @@ mfxStatus CRegionEncodingPipeline::Run()
             sts = m_resources.GetFreeTask(regId, &pCurrentTask);
             MSDK_CHECK_RESULT(sts, MFX_ERR_NONE, sts);
 
+            CDeviceBusyWaiter encBusyWaiter(&m_nBusyTime);
             for (;;)
             {
                 timeCurStart = time_get_tick();
@@ -611,7 +642,10 @@ mfxStatus CRegionEncodingPipeline::Run()
                 if (MFX_ERR_NONE < sts && !pCurrentTask->EncSyncP) // repeat the call if warning and no output
                 {
                     if (MFX_WRN_DEVICE_BUSY == sts)
-                        MSDK_SLEEP(1); // wait if device is busy
+                    {
+                        sts = m_resources.WaitForEncoder(regId, encBusyWaiter, &m_nBusyTime);
+                        MSDK_CHECK_RESULT(sts, MFX_ERR_NONE, sts);
+                    }
                 }
                 else if (MFX_ERR_NONE < sts && pCurrentTask->EncSyncP)
                 {
@@ -657,6 +691,7 @@ mfxStatus CRegionEncodingPipeline::Run()
             sts = m_resources.GetFreeTask(regId, &pCurrentTask);
             MSDK_CHECK_RESULT(sts, MFX_ERR_NONE, sts);
 
+            CDeviceBusyWaiter encBusyWaiter(&m_nBusyTime);
             for (;;)
             {
                 timeCurStart = time_get_tick();
@@ -665,7 +700,10 @@ mfxStatus CRegionEncodingPipeline::Run()
                 if (MFX_ERR_NONE < sts && !pCurrentTask->EncSyncP) // repeat the call if warning and no output
                 {
                     if (MFX_WRN_DEVICE_BUSY == sts)
-                        MSDK_SLEEP(1); // wait if device is busy
+                    {
+                        sts = m_resources.WaitForEncoder(regId, encBusyWaiter, &m_nBusyTime);
+                        MSDK_CHECK_RESULT(sts, MFX_ERR_NONE, sts);
+                    }
                 }
                 else if (MFX_ERR_NONE < sts && pCurrentTask->EncSyncP)
                 {
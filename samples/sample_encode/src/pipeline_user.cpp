@@ -33,12 +33,14 @@ mfxStatus CUserPipeline::InitRotateParam(sInputParams *pInParams)
     m_pluginVideoParams.vpp.In.Width = m_pluginVideoParams.vpp.In.CropW = pInParams->nWidth;
     m_pluginVideoParams.vpp.In.Height = m_pluginVideoParams.vpp.In.CropH = pInParams->nHeight;
     m_pluginVideoParams.vpp.Out.FourCC = MFX_FOURCC_NV12;
-    m_pluginVideoParams.vpp.Out.Width = m_pluginVideoParams.vpp.Out.CropW = pInParams->nWidth;
-    m_pluginVideoParams.vpp.Out.Height = m_pluginVideoParams.vpp.Out.CropH = pInParams->nHeight;
+    // destination size is the source one, swapped for 90 and 270 degrees
+    m_pluginVideoParams.vpp.Out.Width = m_pluginVideoParams.vpp.Out.CropW = pInParams->nDstWidth;
+    m_pluginVideoParams.vpp.Out.Height = m_pluginVideoParams.vpp.Out.CropH = pInParams->nDstHeight;
     if (pInParams->memType != SYSTEM_MEMORY)
         m_pluginVideoParams.IOPattern = MFX_IOPATTERN_IN_VIDEO_MEMORY | MFX_IOPATTERN_OUT_VIDEO_MEMORY;
 
     m_RotateParams.Angle = pInParams->nRotationAngle;
+    m_RotateParams.Mirror = pInParams->nMirror;
 
     return MFX_ERR_NONE;
 }
@@ -133,11 +135,18 @@ mfxStatus CUserPipeline::AllocFrames()
         }
     }
 
+    sts = m_EncSurfacePool.Init(m_pEncSurfaces, nEncSurfNum);
+    MSDK_CHECK_RESULT(sts, MFX_ERR_NONE, sts);
+
+    sts = m_PluginSurfacePool.Init(m_pPluginSurfaces, nRotateSurfNum);
+    MSDK_CHECK_RESULT(sts, MFX_ERR_NONE, sts);
+
     return MFX_ERR_NONE;
 }
 
 void CUserPipeline::DeleteFrames()
 {
+    m_PluginSurfacePool.Close();
     MSDK_SAFE_DELETE_ARRAY(m_pPluginSurfaces);
 
     CEncodingPipeline::DeleteFrames();
@@ -174,6 +183,10 @@ mfxStatus CUserPipeline::Init(sInputParams *pParams)
     MSDK_CHECK_POINTER(m_pusrPlugin, MFX_ERR_NOT_FOUND);
 
     // prepare input file reader
+    if (pParams->bMemoryMappedInput)
+        m_FileReader.SetMemoryMapped(false);
+    m_FileReader.SetPrefetchDepth(pParams->nPrefetchDepth);
+
     sts = m_FileReader.Init(pParams->strSrcFile,
                             pParams->ColorFormat,
                             pParams->numViews,
@@ -296,7 +309,7 @@ mfxStatus CUserPipeline::ResetMFXComponents(sInputParams* pParams)
     sts = m_pmfxENC->Init(&m_mfxEncParams);
     MSDK_CHECK_RESULT(sts, MFX_ERR_NONE, sts);
 
-    mfxU32 nEncodedDataBufferSize = m_mfxEncParams.mfx.FrameInfo.Width * m_mfxEncParams.mfx.FrameInfo.Height * 4;
+    mfxU32 nEncodedDataBufferSize = GetEncodedDataBufferSize();
     sts = m_TaskPool.Init(&m_mfxSession, m_FileWriters.first, m_mfxEncParams.AsyncDepth, nEncodedDataBufferSize, m_FileWriters.second);
     MSDK_CHECK_RESULT(sts, MFX_ERR_NONE, sts);
 
@@ -321,12 +334,16 @@ mfxStatus CUserPipeline::Run()
     // main loop, preprocessing and encoding
     while (MFX_ERR_NONE <= sts || MFX_ERR_MORE_DATA == sts)
     {
+        // surfaces of the previous frame are passed to Media SDK, it unlocks them when done
+        m_PluginSurfacePool.Release(nRotateSurfIdx);
+        m_EncSurfacePool.Release(nEncSurfIdx);
+
         // get a pointer to a free task (bit stream and sync point for encoder)
         sts = GetFreeTask(&pCurrentTask);
         MSDK_BREAK_ON_ERROR(sts);
 
-        nRotateSurfIdx = GetFreeSurface(m_pPluginSurfaces, m_PluginResponse.NumFrameActual);
-        MSDK_CHECK_ERROR(nRotateSurfIdx, MSDK_INVALID_SURF_IDX, MFX_ERR_MEMORY_ALLOC);
+        sts = GetFreeSurfaceIndex(m_PluginSurfacePool, pCurrentTask, &nRotateSurfIdx);
+        MSDK_CHECK_RESULT(sts, MFX_ERR_NONE, sts);
 
         mfxFrameSurface1 *rot_surf = &m_pPluginSurfaces[nRotateSurfIdx];
         if (SYSTEM_MEMORY != m_memType)
@@ -346,10 +363,11 @@ mfxStatus CUserPipeline::Run()
             MSDK_BREAK_ON_ERROR(sts);
         }
 
-        nEncSurfIdx = GetFreeSurface(m_pEncSurfaces, m_EncResponse.NumFrameActual);
-        MSDK_CHECK_ERROR(nEncSurfIdx, MSDK_INVALID_SURF_IDX, MFX_ERR_MEMORY_ALLOC);
+        sts = GetFreeSurfaceIndex(m_EncSurfacePool, pCurrentTask, &nEncSurfIdx);
+        MSDK_CHECK_RESULT(sts, MFX_ERR_NONE, sts);
 
         // rotation
+        CDeviceBusyWaiter userBusyWaiter(&m_nBusyTime);
         for(;;)
         {
             mfxHDL h1, h2;
@@ -359,7 +377,7 @@ mfxStatus CUserPipeline::Run()
 
             if (MFX_WRN_DEVICE_BUSY == sts)
             {
-                MSDK_SLEEP(1); // just wait and then repeat the same call
+                userBusyWaiter.Wait(); // just wait and then repeat the same call
             }
             else
             {
@@ -376,6 +394,7 @@ mfxStatus CUserPipeline::Run()
             RotateSyncPoint = NULL;
         }
 
+        CDeviceBusyWaiter encBusyWaiter(&m_nBusyTime);
         for (;;)
         {
             sts = m_pmfxENC->EncodeFrameAsync(NULL, &m_pEncSurfaces[nEncSurfIdx], &pCurrentTask->mfxBS, &pCurrentTask->EncSyncP);
@@ -383,7 +402,10 @@ mfxStatus CUserPipeline::Run()
             if (MFX_ERR_NONE < sts && !pCurrentTask->EncSyncP) // repeat the call if warning and no output
             {
                 if (MFX_WRN_DEVICE_BUSY == sts)
-                    MSDK_SLEEP(1); // wait if device is busy
+                {
+                    sts = WaitForEncoder(encBusyWaiter);
+                    MSDK_BREAK_ON_ERROR(sts);
+                }
             }
             else if (MFX_ERR_NONE < sts && pCurrentTask->EncSyncP)
             {
@@ -415,6 +437,7 @@ mfxStatus CUserPipeline::Run()
         sts = GetFreeTask(&pCurrentTask);
         MSDK_BREAK_ON_ERROR(sts);
 
+        CDeviceBusyWaiter encBusyWaiter(&m_nBusyTime);
         for (;;)
         {
             sts = m_pmfxENC->EncodeFrameAsync(NULL, NULL, &pCurrentTask->mfxBS, &pCurrentTask->EncSyncP);
@@ -422,7 +445,10 @@ mfxStatus CUserPipeline::Run()
             if (MFX_ERR_NONE < sts && !pCurrentTask->EncSyncP) // repeat the call if warning and no output
             {
                 if (MFX_WRN_DEVICE_BUSY == sts)
-                    MSDK_SLEEP(1); // wait if device is busy
+                {
+                    sts = WaitForEncoder(encBusyWaiter);
+                    MSDK_BREAK_ON_ERROR(sts);
+                }
             }
             else if (MFX_ERR_NONE < sts && pCurrentTask->EncSyncP)
             {
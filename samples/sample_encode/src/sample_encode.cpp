@@ -102,6 +102,11 @@ void PrintHelp(msdk_char *strAppName, const msdk_char *strErrorMessage, ...)
     msdk_printf(MSDK_STRING("                              If num_slice equals zero, the encoder may choose any slice partitioning allowed by the codec standard.\n"));
     msdk_printf(MSDK_STRING("   [-mss]                   - maximum slice size in bytes. Supported only with -hw and h264 codec. This option is not compatible with -num_slice option.\n"));
     msdk_printf(MSDK_STRING("   [-re]                    - enable region encode mode. Works only with h265 encoder\n"));
+    msdk_printf(MSDK_STRING("   [-mmap]                  - read input file through memory mapping. With system memory surfaces\n"));
+    msdk_printf(MSDK_STRING("                              frames matching the surface layout are passed to the encoder without copying\n"));
+    msdk_printf(MSDK_STRING("   [-prefetch depth]        - read up to depth input frames ahead on a separate thread\n"));
+    msdk_printf(MSDK_STRING("   [-write_behind num]      - collect output in num 4MB buffers which are written to file by a separate thread\n"));
+    msdk_printf(MSDK_STRING("   [-direct_io]             - together with -write_behind, write output bypassing page cache (Linux only)\n"));
     msdk_printf(MSDK_STRING("Example: %s h265 -i InputYUVFile -o OutputEncodedFile -w width -h height -hw -p 2fca99749fdb49aeb121a5b63ef568f7\n"), strAppName);
 #if D3D_SURFACES_SUPPORT
     msdk_printf(MSDK_STRING("   [-d3d] - work with d3d surfaces\n"));
@@ -129,8 +134,10 @@ void PrintHelp(msdk_char *strAppName, const msdk_char *strErrorMessage, ...)
     msdk_printf(MSDK_STRING("Example: %s mvc -i InputYUVFile_1 -i InputYUVFile_2 -o OutputEncodedFile_1 -o OutputEncodedFile_2 -viewoutput -w width -h height \n"), strAppName);
     // user module options
     msdk_printf(MSDK_STRING("User module options: \n"));
-    msdk_printf(MSDK_STRING("   [-angle 180] - enables 180 degrees picture rotation before encoding, CPU implementation by default. Rotation requires NV12 input. Options -tff|bff, -dstw, -dsth, -d3d are not effective together with this one, -nv12 is required.\n"));
-    msdk_printf(MSDK_STRING("   [-opencl] - rotation implementation through OPENCL\n"));
+    msdk_printf(MSDK_STRING("   [-angle 90|180|270] - enables clockwise picture rotation before encoding, CPU implementation by default. Rotation requires NV12 input. Options -tff|bff, -dstw, -dsth, -d3d are not effective together with this one, -nv12 is required.\n"));
+    msdk_printf(MSDK_STRING("                   Width and height of encoded picture are swapped for 90 and 270 degrees.\n"));
+    msdk_printf(MSDK_STRING("   [-mirror h|v] - mirrors picture horizontally or vertically before rotation, CPU implementation only. Same restrictions as for -angle apply.\n"));
+    msdk_printf(MSDK_STRING("   [-opencl] - rotation implementation through OPENCL, 180 degrees only\n"));
     msdk_printf(MSDK_STRING("Example: %s h264|h265|mpeg2|mvc|jpeg -i InputYUVFile -o OutputEncodedFile -w width -h height -angle 180 -opencl \n"), strAppName);
 
     msdk_printf(MSDK_STRING("\n"));
@@ -255,6 +262,24 @@ mfxStatus ParseInputString(msdk_char* strInput[], mfxU8 nArgNum, sInputParams* p
                 return MFX_ERR_UNSUPPORTED;
             }
         }
+        else if (0 == msdk_strcmp(strInput[i], MSDK_STRING("-mirror")))
+        {
+            VAL_CHECK(i+1 >= nArgNum, i, strInput[i]);
+            i++;
+            if (0 == msdk_strcmp(strInput[i], MSDK_STRING("h")))
+            {
+                pParams->nMirror = 1;
+            }
+            else if (0 == msdk_strcmp(strInput[i], MSDK_STRING("v")))
+            {
+                pParams->nMirror = 2;
+            }
+            else
+            {
+                PrintHelp(strInput[0], MSDK_STRING("Mirror mode is invalid"));
+                return MFX_ERR_UNSUPPORTED;
+            }
+        }
         else if (0 == msdk_strcmp(strInput[i], MSDK_STRING("-opencl")))
         {
             msdk_opt_read(MSDK_OCL_ROTATE_PLUGIN, pParams->strPluginDLLPath);
@@ -388,6 +413,34 @@ mfxStatus ParseInputString(msdk_char* strInput[], mfxU8 nArgNum, sInputParams* p
         {
             pParams->UseRegionEncode = true;
         }
+        else if (0 == msdk_strcmp(strInput[i], MSDK_STRING("-mmap")))
+        {
+            pParams->bMemoryMappedInput = true;
+        }
+        else if (0 == msdk_strcmp(strInput[i], MSDK_STRING("-write_behind")))
+        {
+            VAL_CHECK(i+1 >= nArgNum, i, strInput[i]);
+
+            if (MFX_ERR_NONE != msdk_opt_read(strInput[++i], pParams->nWriteBehindBuffers))
+            {
+                PrintHelp(strInput[0], MSDK_STRING("Number of write-behind buffers is invalid"));
+                return MFX_ERR_UNSUPPORTED;
+            }
+        }
+        else if (0 == msdk_strcmp(strInput[i], MSDK_STRING("-direct_io")))
+        {
+            pParams->bDirectIO = true;
+        }
+        else if (0 == msdk_strcmp(strInput[i], MSDK_STRING("-prefetch")))
+        {
+            VAL_CHECK(i+1 >= nArgNum, i, strInput[i]);
+
+            if (MFX_ERR_NONE != msdk_opt_read(strInput[++i], pParams->nPrefetchDepth))
+            {
+                PrintHelp(strInput[0], MSDK_STRING("Prefetch depth is invalid"));
+                return MFX_ERR_UNSUPPORTED;
+            }
+        }
         MOD_ENC_PARSE_INPUT
 #if defined (ENABLE_V4L2_SUPPORT)
         else if (0 == msdk_strcmp(strInput[i], MSDK_STRING("-d")))
@@ -664,10 +717,19 @@ mfxStatus ParseInputString(msdk_char* strInput[], mfxU8 nArgNum, sInputParams* p
     }
 
     // check parameters validity
-    if (pParams->nRotationAngle != 0 && pParams->nRotationAngle != 180)
+    if (pParams->nRotationAngle != 0 && pParams->nRotationAngle != 90 &&
+        pParams->nRotationAngle != 180 && pParams->nRotationAngle != 270)
     {
-        PrintHelp(strInput[0], MSDK_STRING("Angles other than 180 degrees are not supported."));
-        return MFX_ERR_UNSUPPORTED; // other than 180 are not supported
+        PrintHelp(strInput[0], MSDK_STRING("Angles other than 90, 180 and 270 degrees are not supported."));
+        return MFX_ERR_UNSUPPORTED;
+    }
+
+    // OpenCL plugin implements 180 degrees rotation only
+    if (0 == msdk_strcmp(pParams->strPluginDLLPath, MSDK_OCL_ROTATE_PLUGIN) &&
+        (pParams->nRotationAngle != 180 || pParams->nMirror))
+    {
+        PrintHelp(strInput[0], MSDK_STRING("Only 180 degrees rotation is supported with -opencl."));
+        return MFX_ERR_UNSUPPORTED;
     }
 
     if (pParams->nQuality && (MFX_CODEC_JPEG != pParams->CodecId))
@@ -711,15 +773,18 @@ mfxStatus ParseInputString(msdk_char* strInput[], mfxU8 nArgNum, sInputParams* p
         pParams->dFrameRate = 30;
     }
 
+    // rotation plugin swaps width and height for 90 and 270 degrees
+    bool bTranspose = (90 == pParams->nRotationAngle || 270 == pParams->nRotationAngle);
+
     // if no destination picture width or height wasn't specified set it to the source picture size
     if (pParams->nDstWidth == 0)
     {
-        pParams->nDstWidth = pParams->nWidth;
+        pParams->nDstWidth = bTranspose ? pParams->nHeight : pParams->nWidth;
     }
 
     if (pParams->nDstHeight == 0)
     {
-        pParams->nDstHeight = pParams->nHeight;
+        pParams->nDstHeight = bTranspose ? pParams->nWidth : pParams->nHeight;
     }
 
     // calculate default bitrate based on the resolution (a parameter for encoder, so Dst resolution is used)
@@ -780,10 +845,10 @@ mfxStatus ParseInputString(msdk_char* strInput[], mfxU8 nArgNum, sInputParams* p
     }
 
     // not all options are supported if rotate plugin is enabled
-    if (pParams->nRotationAngle == 180 && (
+    if ((pParams->nRotationAngle || pParams->nMirror) && (
         MFX_PICSTRUCT_PROGRESSIVE != pParams->nPicStruct ||
-        pParams->nDstWidth != pParams->nWidth ||
-        pParams->nDstHeight != pParams->nHeight ||
+        pParams->nDstWidth != (bTranspose ? pParams->nHeight : pParams->nWidth) ||
+        pParams->nDstHeight != (bTranspose ? pParams->nWidth : pParams->nHeight) ||
         MVC_ENABLED & pParams->MVC_flags ||
         pParams->nRateControlMethod == MFX_RATECONTROL_LA))
     {
@@ -816,7 +881,7 @@ mfxStatus ParseInputString(msdk_char* strInput[], mfxU8 nArgNum, sInputParams* p
         }
         if (pParams->nWidth  != pParams->nDstWidth ||
             pParams->nHeight != pParams->nDstHeight ||
-            pParams->nRotationAngle!=0)
+            pParams->nRotationAngle!=0 || pParams->nMirror!=0)
 
         {
             msdk_printf(MSDK_STRING("Region encode option is not compatible with VPP processing.\nRegion encoding is disabled\n"));
@@ -835,7 +900,7 @@ CEncodingPipeline* CreatePipeline(const sInputParams& params)
     {
         return new CRegionEncodingPipeline;
     }
-    else if(params.nRotationAngle)
+    else if(params.nRotationAngle || params.nMirror)
     {
         return new CUserPipeline;
     }
@@ -909,6 +974,8 @@ int main(int argc, char *argv[])
 
     pPipeline->Close();
 
+    CBitstreamPool::Instance().PrintStatistics();
+
     msdk_printf(MSDK_STRING("\nProcessing finished\n"));
 
     return 0;
@@ -35,6 +35,7 @@ or https://software.intel.com/en-us/media-client-solutions-support.
 
 #include "sample_defs.h"
 #include "sample_utils.h"
+#include "bitstream_index.h"
 #include "sample_params.h"
 #include "base_allocator.h"
 #include "sysmem_allocator.h"
@@ -70,6 +71,7 @@ or https://software.intel.com/en-us/media-client-solutions-support.
 
 #define MFX_FOURCC_DUMP MFX_MAKEFOURCC('D','U','M','P')
 #define MAX_PREF_LEN    256
+#define MAX_AFFINITY_CPUS 256
 
 namespace TranscodingSample
 {
@@ -158,6 +160,7 @@ namespace TranscodingSample
         mfxU32 numViews; // number of views for Multi-View-Codec
 
         mfxU16 nRotationAngle; // if specified, enables rotation plugin in mfx pipeline
+        mfxU16 nMirror; // if specified, enables rotation plugin mirroring, 1 - horizontal, 2 - vertical
         msdk_char strVPPPluginDLLPath[MSDK_MAX_FILENAME_LEN]; // plugin dll path and name
 
         sPluginParams decoderPluginParams;
@@ -166,7 +169,21 @@ namespace TranscodingSample
         mfxU32 nTimeout; // how long transcoding works in seconds
         mfxU32 nFPS; // limit transcoding to the number of frames per second
 
+        mfxU16 nWriteBehindBuffers; // number of output buffers written by a separate thread, 0 - synchronous writing
+        bool bDirectIO; // write output bypassing page cache, with write-behind only
+        bool bCompleteFrame; // split H.264 and H.265 input into access units, decoder gets complete frames
+
+        bool bAutoAffinity; // bind session thread to a physical core, cores of different NUMA nodes go in turn
+        mfxU32 nAffinityCPUs; // number of logical processors the session thread is bound to, 0 - no binding
+        mfxU32 AffinityCPUs[MAX_AFFINITY_CPUS];
+        mfxI32 nNumaNode; // node to place system memory surfaces and bitstreams on, -1 - no preference
+
+        mfxU32 nSegments; // number of segments the input is split into at key frames, segments are transcoded in parallel
+        mfxU32 nSegmentFirstFrame; // first input frame of the segment
+        mfxU32 nSegmentFrames; // number of input frames of the segment, 0 - session is not a segment
+
         mfxU32 statisticsWindowSize;
+        bool bPerfReport; // collect statistics for the report file
 
         bool bLABRC; // use look ahead bitrate control algorithm
         mfxU16 nLADepth; // depth of the look ahead bitrate control  algorithm
@@ -234,6 +251,25 @@ namespace TranscodingSample
         mfxSyncPoint      Syncp;
     };
 
+    // state of Transcode() loop kept between steps
+    struct TranscodeState
+    {
+        ExtendedSurface DecExtSurface;
+        ExtendedSurface VppExtSurface;
+        bool bNeedDecodedFrames; // indicates if we need to decode frames
+        bool bEndOfFile;
+        bool bLastCycle;
+        bool bInsertIDR;
+        bool shouldReadNextFrame;
+        bool bFlushing; // all frames are encoded, buffered bitstreams are written
+        bool bNonBlocking; // the step returns MFX_WRN_IN_EXECUTION instead of waiting
+        bool bEncodePending; // the encoder was busy, the next step starts from encoding of the frame
+        mfxSyncPoint *pWaitSyncp; // task the parked step waits for, see WaitStep
+        msdk_tick nStepStart;
+        PreEncAuxBuffer encAuxCtrl;
+        time_t start;
+    };
+
     struct ExtendedBS
     {
         ExtendedBS(): IsFree(true), Syncp(NULL), pCtrl(NULL)
@@ -267,11 +303,29 @@ namespace TranscodingSample
 
             inline void PrintStatistics(mfxU32 numPipelineid)
             {
-                msdk_printf(MSDK_STRING("stat[%llu]: %s=%d;Total=%.3lf;Samples=%lld;StdDev=%.3lf;Min=%.3lf;Max=%.3lf;Avg=%.3lf\n"),
-                    rdtsc(),bufDir,numPipelineid,totalTime*1000,numMeasurements,GetTimeStdDev()*1000,minTime*1000,maxTime*1000,GetAvgTime()*1000);
+                // monotonic time stamp in microseconds
+                msdk_printf(MSDK_STRING("stat[%llu]: %s=%d;Total=%.3lf;Samples=%lld;StdDev=%.3lf;Min=%.3lf;Max=%.3lf;Avg=%.3lf;P50=%.3lf;P90=%.3lf;P99=%.3lf;P99.9=%.3lf\n"),
+                    (unsigned long long)(MSDK_GET_TIME(msdk_time_get_tick(), 0, GetFrequency())*1000000),bufDir,numPipelineid,totalTime*1000,numMeasurements,GetTimeStdDev()*1000,minTime*1000,maxTime*1000,GetAvgTime()*1000,
+                    GetPercentile(50)*1000,GetPercentile(90)*1000,GetPercentile(99)*1000,GetPercentile(99.9)*1000);
+            }
+
+            // measurements of the statistics windows are kept for the whole run statistics
+            inline void ResetStatistics()
+            {
+                overallStatistics.MergeStatistics(*this);
+                CTimeStatistics::ResetStatistics();
+            }
+
+            // statistics since the start of transcoding
+            inline CTimeStatistics GetOverallStatistics()
+            {
+                CTimeStatistics total = overallStatistics;
+                total.MergeStatistics(*this);
+                return total;
             }
         protected:
             msdk_char bufDir[MAX_PREF_LEN];
+            CTimeStatistics overallStatistics;
     };
 
 
@@ -285,7 +339,7 @@ namespace TranscodingSample
         virtual ~ExtendedBSStore()
         {
             for (mfxU32 i=0; i < m_pExtBS.size(); i++)
-                MSDK_SAFE_DELETE_ARRAY(m_pExtBS[i].Bitstream.Data);
+                WipeMfxBitstream(&m_pExtBS[i].Bitstream);
             m_pExtBS.clear();
 
         }
@@ -321,37 +375,89 @@ namespace TranscodingSample
     };
 
     class CTranscodingPipeline;
-    // thread safety buffer heterogeneous pipeline
-    // only for join sessions
-    class SafetySurfaceBuffer
+    // bounded ring of surfaces published by a decoding session (producer) for joined sessions (consumers),
+    // each surface is stored once and read by every consumer through its own cursor;
+    // a slot is recycled when its last consumer releases it, all counters are lock-free
+    class SurfaceRing
     {
     public:
-        struct SurfaceDescriptor
+        // nCapacity is rounded up to a power of 2
+        SurfaceRing(mfxU32 nCapacity, mfxU32 nConsumers);
+        virtual ~SurfaceRing();
+
+        // producer side
+        mfxU32            GetLength();
+        // waits for a free slot if the ring is full
+        mfxStatus         AddSurface(const ExtendedSurface& Surf);
+        // returns the oldest surface not released by all consumers yet
+        mfxStatus         GetOldestSurface(ExtendedSurface &Surf);
+        mfxStatus         WaitForSurfaceRelease(mfxU32 msec);
+        // pool which owns the buffered surfaces, it's notified each time a surface is released
+        void              AddReleaseListener(CSurfacePool* pPool);
+
+        // consumer side, surfaces are read and released in the order of insertion
+        mfxStatus         GetSurface(mfxU32 nConsumer, ExtendedSurface &Surf);
+        mfxStatus         ReleaseSurface(mfxU32 nConsumer, mfxFrameSurface1* pSurf);
+        mfxStatus         WaitForSurfaceInsertion(mfxU32 nConsumer, mfxU32 msec);
+        // releases all surfaces held by the consumer, after that the producer releases new surfaces on its behalf
+        void              CancelBuffering(mfxU32 nConsumer);
+
+    protected:
+        struct Slot
         {
             ExtendedSurface   ExtSurface;
-            mfxU32            Locked;
+            volatile mfxU16   nRefs; // consumers which haven't released the surface yet
+        };
+
+        struct Consumer
+        {
+            volatile mfxU32   nCursor;   // next slot to read, owned by the producer after detaching
+            volatile mfxU32   bDetached;
+            volatile mfxU32   bWaiting;  // set while waiting for insertion, the producer signals only waiting consumers
+            MSDKEvent*        pInserted;
+            mfxU8             reserved[64]; // keeps cursors of different consumers in different cache lines
         };
 
-        SafetySurfaceBuffer(SafetySurfaceBuffer *pNext);
+        // producer: releases surfaces on behalf of detached consumers and moves the tail over free slots
+        void              Reclaim();
+        void              ReleaseSlot(Slot& slot);
+
+        std::vector<Slot>          m_Slots;
+        std::vector<Consumer>      m_Consumers;
+        mfxU32                     m_nMask;
+        volatile mfxU32            m_nHead;  // number of published surfaces, written by the producer only
+        mfxU32                     m_nTail;  // oldest slot in use, producer only
+        volatile mfxU32            m_bProducerWaiting;
+        MSDKEvent*                 m_pReleased;
+        std::vector<CSurfacePool*> m_ReleaseListeners;
+    private:
+        DISALLOW_COPY_AND_ASSIGN(SurfaceRing);
+    };
+
+    // consumer's view of a surface ring, producer calls are forwarded to the ring as is
+    // only for join sessions
+    class SafetySurfaceBuffer
+    {
+    public:
+        // pNext chains views of different rings in N_to_1 mode, a composing session walks all of them
+        SafetySurfaceBuffer(SurfaceRing *pRing, mfxU32 nConsumer, SafetySurfaceBuffer *pNext);
         virtual ~SafetySurfaceBuffer();
 
         mfxU32            GetLength();
         mfxStatus         WaitForSurfaceRelease(mfxU32 msec);
         mfxStatus         WaitForSurfaceInsertion(mfxU32 msec);
-        void              AddSurface(ExtendedSurface Surf);
+        mfxStatus         AddSurface(const ExtendedSurface& Surf);
+        mfxStatus         GetOldestSurface(ExtendedSurface &Surf);
         mfxStatus         GetSurface(ExtendedSurface &Surf);
         mfxStatus         ReleaseSurface(mfxFrameSurface1* pSurf);
         void              CancelBuffering();
+        void              AddReleaseListener(CSurfacePool* pPool);
 
         SafetySurfaceBuffer               *m_pNext;
 
     protected:
-
-        MSDKMutex                 m_mutex;
-        std::list<SurfaceDescriptor>       m_SList;
-        bool m_IsBufferingAllowed;
-        MSDKEvent* pRelEvent;
-        MSDKEvent* pInsEvent;
+        SurfaceRing                       *m_pRing;
+        mfxU32                             m_nConsumer;
     private:
         DISALLOW_COPY_AND_ASSIGN(SafetySurfaceBuffer);
     };
@@ -365,6 +471,11 @@ namespace TranscodingSample
         virtual mfxStatus PrepareBitstream() = 0;
         virtual mfxStatus GetInputBitstream(mfxBitstream **pBitstream) = 0;
         virtual mfxStatus ProcessOutputBitstream(mfxBitstream* pBitstream) = 0;
+        // makes room for more data in the bitstream returned by GetInputBitstream, may replace it
+        virtual mfxStatus ExtendInputBitstream(mfxBitstream **pBitstream)
+        {
+            return ExtendMfxBitstream(*pBitstream, (*pBitstream)->MaxLength * 2);
+        }
     };
 
     class FileBitstreamProcessor : public BitstreamProcessor
@@ -376,12 +487,30 @@ namespace TranscodingSample
         virtual mfxStatus PrepareBitstream() {return MFX_ERR_NONE;}
         virtual mfxStatus GetInputBitstream(mfxBitstream **pBitstream);
         virtual mfxStatus ProcessOutputBitstream(mfxBitstream* pBitstream);
+        virtual mfxStatus ExtendInputBitstream(mfxBitstream **pBitstream);
+        // must be called before Init
+        void SetWriteBehind(mfxU32 nBuffers, bool bDirectIO) { m_nWriteBehindBuffers = nBuffers; m_bDirectIO = bDirectIO; }
+        // writes the remaining output and closes the output file
+        mfxStatus CloseOutput() { return m_pFileWriter.get() ? m_pFileWriter->Close() : MFX_ERR_NONE; }
+        // input of the codec is read by complete frames, must be called before Init
+        void SetCompleteFrame(mfxU32 nCodecId) { m_nCompleteFrameCodecId = nCodecId; }
+        // the input bitstream is placed on the NUMA node of the session, must be called before Init
+        void SetNumaNode(mfxI32 nNode) { m_nNumaNode = nNode; }
 
     protected:
+        // creates the reader splitting input into frames if it is set up and supported for the codec
+        CSmplBitstreamReader* CreateReader();
+        // appends data of the bitstream to m_Bitstream
+        mfxStatus AppendInput(mfxBitstream *pBitstream);
+
         std::auto_ptr<CSmplBitstreamReader> m_pFileReader;
         // for performance options can be zero
         std::auto_ptr<CSmplBitstreamWriter> m_pFileWriter;
         mfxBitstream m_Bitstream;
+        mfxU32 m_nWriteBehindBuffers;
+        bool m_bDirectIO;
+        mfxU32 m_nCompleteFrameCodecId; // 0 - input is read by blocks
+        mfxI32 m_nNumaNode; // -1 - no preference
     private:
         DISALLOW_COPY_AND_ASSIGN(FileBitstreamProcessor);
     };
@@ -398,6 +527,19 @@ namespace TranscodingSample
         std::vector<msdk_char> m_pDstFile;
     };
 
+    // Reads a range of frames of the input using its access unit index,
+    // so segments of one stream can be transcoded by different sessions
+    class SegmentBitstreamProcessor : public FileBitstreamProcessor
+    {
+    public:
+        SegmentBitstreamProcessor(mfxU32 nCodecId, mfxU32 nFirstFrame, mfxU32 nFrames);
+        virtual mfxStatus Init(msdk_char *pStrSrcFile, msdk_char *pStrDstFile);
+    protected:
+        mfxU32 m_nCodecId;
+        mfxU32 m_nFirstFrame;
+        mfxU32 m_nFrames;
+    };
+
     // Bitstream is external via BitstreamProcessor
     class CTranscodingPipeline
     {
@@ -419,7 +561,25 @@ namespace TranscodingSample
         virtual mfxStatus Run();
         virtual mfxStatus FlushLastFrames(){return MFX_ERR_NONE;}
 
+        // transcoding by steps, each step processes one frame (used by session scheduler)
+        bool      IsStepSupported();
+        mfxStatus StartTranscode();
+        // returns MFX_ERR_NONE if more steps are needed, MFX_WRN_IN_EXECUTION if non-blocking step
+        // has to wait for a task of the session (the step is parked), other statuses mean the end of transcoding
+        mfxStatus TranscodeStep(bool bNonBlocking);
+        // waits up to nTimeout ms for the task the parked step waits for
+        mfxStatus WaitStep(mfxU32 nTimeout);
+
         mfxU32 GetProcessFrames() {return m_nProcessedFramesNum;}
+        // time spent in waits for busy device (sec)
+        mfxF64 GetBusyTime() {return MSDK_GET_TIME(m_nBusyTime, 0, msdk_time_get_frequency());}
+        // intervals between decoded frames and between written output frames, whole run
+        CTimeStatistics GetInputStatistics() {return inputStatistics.GetOverallStatistics();}
+        CTimeStatistics GetOutputStatistics() {return outputStatistics.GetOverallStatistics();}
+        // maximal size of frame surfaces allocated by the pipeline (bytes)
+        mfxU64 GetPeakSurfaceMemory() {return m_nPeakSurfaceMemory;}
+        // parameters of the encoder, or of decoder and VPP if the session doesn't encode
+        mfxVideoParam GetOutputParam() {return m_bEncodeEnable ? m_mfxEncParams : GetDecodeParam();}
 
         bool   GetJoiningFlag() {return m_bIsJoinSession;}
 
@@ -465,8 +625,9 @@ namespace TranscodingSample
 
         void      FreePreEncAuxPool();
 
-        mfxFrameSurface1* GetFreeSurface(bool isDec, mfxU64 timeout);
-        mfxU32 GetFreeSurfacesCount(bool isDec);
+        // completes own tasks in flight if all surfaces are locked by them, then waits for surfaces released by other sessions,
+        // non-blocking step is parked instead
+        mfxStatus GetFreeSurface(bool isDec, mfxU64 timeout, mfxFrameSurface1** ppSurface);
         PreEncAuxBuffer*  GetFreePreEncAuxBuffer();
         void SetSurfaceAuxIDR(ExtendedSurface& extSurface, PreEncAuxBuffer* encAuxCtrl, bool bInsertIDR);
 
@@ -486,6 +647,13 @@ namespace TranscodingSample
 
         mfxStatus AllocateSufficientBuffer(mfxBitstream* pBS);
         mfxStatus PutBS();
+        bool      IsFirstBSReady();
+        mfxStatus FinishTranscode();
+        mfxStatus EncodeStepFrame(bool bNonBlocking);
+        // parks non-blocking step till the task completes, the oldest task of the session if pSyncPoint is not set
+        mfxStatus ParkStep(mfxSyncPoint *pSyncPoint);
+        // the oldest task of the session to wait for when the device is busy
+        mfxSyncPoint* GetOldestSyncPoint();
 
         mfxStatus Surface2BS(ExtendedSurface* pSurf,mfxBitstream* pBS, mfxU32 fourCC);
         mfxStatus NV12toBS(mfxFrameSurface1* pSurface,mfxBitstream* pBS);
@@ -534,6 +702,8 @@ namespace TranscodingSample
         typedef std::vector<mfxFrameSurface1*> SurfPointersArray;
         SurfPointersArray  m_pSurfaceDecPool;
         SurfPointersArray  m_pSurfaceEncPool;
+        CSurfacePool       m_DecSurfacePool; // tracks free surfaces of m_pSurfaceDecPool
+        CSurfacePool       m_EncSurfacePool; // tracks free surfaces of m_pSurfaceEncPool
         mfxU16 m_EncSurfaceType; // actual type of encoder surface pool
         mfxU16 m_DecSurfaceType; // actual type of decoder surface pool
 
@@ -599,6 +769,10 @@ namespace TranscodingSample
         bool           m_bUseOpaqueMemory; // indicates if opaque memory is used in the pipeline
 
         mfxSyncPoint   m_LastDecSyncPoint;
+        msdk_tick      m_nBusyTime; // time spent in waits for busy device
+        mfxU64         m_nSurfaceMemory; // size of currently allocated surfaces
+        mfxU64         m_nPeakSurfaceMemory;
+        mfxI32         m_nNumaNode; // node to place output bitstreams on, -1 - no preference
 
         SafetySurfaceBuffer   *m_pBuffer;
         CTranscodingPipeline  *m_pParentPipeline;
@@ -620,11 +794,14 @@ namespace TranscodingSample
         msdk_tick m_nReqFrameTime; // time required to transcode one frame
 
         int       statisticsWindowSize; // Sliding window size for Statistics
+        bool      m_bCollectStatistics; // input and output statistics are needed for -stat or -report
         mfxU32    m_nOutputFramesNum;
 
         CIOStat inputStatistics;
         CIOStat outputStatistics;
 
+        TranscodeState m_TranscodeState;
+
         bool shouldUseGreedyFormula;
     private:
         DISALLOW_COPY_AND_ASSIGN(CTranscodingPipeline);
@@ -647,6 +824,12 @@ namespace TranscodingSample
 
         // Number of processed frames
         mfxU32 numTransFrames;
+        // Time spent in waits for busy device
+        mfxF64 busy_time;
+        // CPU time of the session's thread
+        mfxF64 cpu_time;
+        // logical processors to bind the session's thread to, empty - no binding
+        std::vector<mfxU32> affinity;
         // Status of the finished session
         mfxStatus transcodingSts;
     };
@@ -22,6 +22,7 @@ or https://software.intel.com/en-us/media-client-solutions-support.
 
 #include "transcode_utils.h"
 #include "pipeline_transcode.h"
+#include "session_scheduler.h"
 #include "sample_utils.h"
 
 #include "d3d_allocator.h"
@@ -52,6 +53,14 @@ namespace TranscodingSample
     protected:
         virtual mfxStatus VerifyCrossSessionsOptions();
         virtual mfxStatus CreateSafetyBuffers();
+        // selects processors and NUMA nodes for -affinity sessions
+        virtual void AssignAffinity();
+        // writes per session statistics to the -report file
+        virtual void WriteReport();
+        // replaces -segments sessions by sessions transcoding segments of their input
+        virtual mfxStatus SplitSegments();
+        // appends outputs of segments to the output of the first one
+        virtual void JoinSegments();
 
         virtual void Close();
 
@@ -61,6 +70,8 @@ namespace TranscodingSample
         std::vector<ThreadTranscodeContext*> m_pSessionArray;
         // handles
         std::vector<MSDKThread*>             m_HDLArray;
+        // runs sessions by a pool of threads in -workers mode
+        std::auto_ptr<CSessionScheduler>     m_pScheduler;
         // allocator for each session
         std::vector<GeneralAllocator*>       m_pAllocArray;
         // input parameters for each session
@@ -68,6 +79,8 @@ namespace TranscodingSample
         // safety buffers
         // needed for heterogeneous pipeline
         std::vector<SafetySurfaceBuffer*>    m_pBufferArray;
+        // surface rings the buffers read from
+        std::vector<SurfaceRing*>            m_pRingArray;
 
         std::vector<FileBitstreamProcessor*> m_pExtBSProcArray;
         std::auto_ptr<mfxAllocatorParams>    m_pAllocParam;
@@ -78,6 +91,14 @@ namespace TranscodingSample
 
         std::vector<sVppCompDstRect>         m_VppDstRects;
 
+        // sessions transcoding segments of one input
+        struct SegmentGroup
+        {
+            mfxU32 nFirstSession;
+            mfxU32 nSessions;
+        };
+        std::vector<SegmentGroup>            m_SegmentGroups;
+
     private:
         DISALLOW_COPY_AND_ASSIGN(Launcher);
 
@@ -0,0 +1,101 @@
+/******************************************************************************\
+Copyright (c) 2005-2015, Intel Corporation
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without modification, are permitted provided that the following conditions are met:
+
+1. Redistributions of source code must retain the above copyright notice, this list of conditions and the following disclaimer.
+
+2. Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the following disclaimer in the documentation and/or other materials provided with the distribution.
+
+3. Neither the name of the copyright holder nor the names of its contributors may be used to endorse or promote products derived from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+This sample was distributed or derived from the Intel's Media Samples package.
+The original version of this sample may be obtained from https://software.intel.com/en-us/intel-media-server-studio
+or https://software.intel.com/en-us/media-client-solutions-support.
+\**********************************************************************************/
+
+#ifndef __SESSION_SCHEDULER_H__
+#define __SESSION_SCHEDULER_H__
+
+#include <vector>
+#include <deque>
+
+#include "pipeline_transcode.h"
+
+namespace TranscodingSample
+{
+    // Runs transcoding sessions by a fixed number of threads instead of a thread per session.
+    // Sessions are processed one frame (step) at a time and go back to the end of the queue of
+    // the thread, so sessions of a thread take turns. A thread which has nothing to do takes
+    // sessions from the other threads. A step which has to wait for a task of the session
+    // (output, decoding, free surface or busy device) is parked: the session is skipped until
+    // the task is complete. When all sessions of the thread are parked, the thread waits for
+    // the task of one of them by SyncOperation. A thread without sessions waits for a session
+    // it can take.
+    class CSessionScheduler
+    {
+    public:
+        CSessionScheduler();
+        virtual ~CSessionScheduler();
+
+        // session should support steps, see CTranscodingPipeline::IsStepSupported
+        void AddSession(ThreadTranscodeContext *pContext);
+        // starts nThreads threads, 0 - thread per logical processor
+        mfxStatus Start(mfxU32 nThreads);
+        // waits for all sessions to finish
+        void Wait();
+
+    protected:
+        struct Task
+        {
+            ThreadTranscodeContext *pContext;
+            mfxF64 cpu_time; // CPU time of the steps
+            msdk_tick nParkedSince; // 0 if the last step was done
+        };
+
+        struct Worker
+        {
+            Worker() : pThread(NULL), nIdleSteps(0) {}
+
+            MSDKMutex mutex; // protects tasks
+            std::deque<Task*> tasks;
+            MSDKThread *pThread;
+            size_t nIdleSteps; // steps in a row which found sessions waiting, used by the worker only
+        };
+
+        struct WorkerArg
+        {
+            CSessionScheduler *pScheduler;
+            mfxU32 nIndex;
+        };
+
+        static mfxU32 MFX_STDCALL WorkerRoutine(void *pObj);
+        void RunWorker(mfxU32 nIndex);
+
+        // takes the first task of the worker or the last task of other worker
+        Task* GetTask(mfxU32 nIndex);
+        // returns number of tasks of the worker
+        size_t PutTask(mfxU32 nIndex, Task *pTask);
+        size_t GetTaskCount(mfxU32 nIndex);
+        void  FinishTask(Task *pTask, mfxStatus sts);
+        // fails the session parked for too long, if bWait waits for the task the session is parked for
+        mfxStatus WaitParked(Task *pTask, bool bWait);
+
+        std::vector<Task*>      m_Tasks;
+        std::vector<Worker*>    m_Workers;
+        std::vector<WorkerArg>  m_WorkerArgs;
+
+        MSDKMutex               m_mutex; // protects m_nActiveTasks changes
+        volatile mfxU32         m_nActiveTasks;
+        MSDKEvent              *m_pTaskAvailable; // a session can be taken from other thread or a session is finished
+        msdk_tick               m_StartTime;
+
+    private:
+        DISALLOW_COPY_AND_ASSIGN(CSessionScheduler);
+    };
+}
+
+#endif // __SESSION_SCHEDULER_H__
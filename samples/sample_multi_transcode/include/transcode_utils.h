@@ -105,6 +105,10 @@ namespace TranscodingSample
         mfxStatus ParseCmdLine(int argc, msdk_char *argv[]);
         bool GetNextSessionParams(TranscodingSample::sInputParams &InputParams);
         FILE*     GetPerformanceFile() {return m_PerfFILE;};
+        FILE*     GetReportFile() {return m_ReportFILE;};
+        bool      IsReportCSV() {return m_bReportCSV;};
+        bool      IsSchedulerMode() {return m_bSchedulerMode;};
+        mfxU32    GetWorkerThreads() {return m_nWorkerThreads;};
         void      PrintParFileName();
     protected:
         mfxStatus ParseParFile(FILE* file);
@@ -118,6 +122,10 @@ namespace TranscodingSample
         std::map<mfxU32, sPluginParams>              m_decoderPlugins;
         std::map<mfxU32, sPluginParams>              m_encoderPlugins;
         FILE                                         *m_PerfFILE;
+        FILE                                         *m_ReportFILE;
+        bool                                         m_bReportCSV;
+        bool                                         m_bSchedulerMode;
+        mfxU32                                       m_nWorkerThreads;
         msdk_char                                    *m_parName;
         mfxU32                                       statisticsWindowSize;
         mfxU32                                       m_nTimeout;
@@ -26,8 +26,10 @@ or https://software.intel.com/en-us/media-client-solutions-support.
 #include "pipeline_transcode.h"
 #include "transcode_utils.h"
 #include "sample_utils.h"
+#include "chroma_conversion.h"
 #include "mfx_vpp_plugin.h"
 #include "mfx_itt_trace.h"
+#include "frame_tracer.h"
 #include <algorithm>
 
 #include "plugin_loader.h"
@@ -42,6 +44,16 @@ mfxU32 MFX_STDCALL TranscodingSample::ThranscodeRoutine(void   *pObj)
     mfxU64 start = TranscodingSample::GetTick();
     ThreadTranscodeContext *pContext = (ThreadTranscodeContext*)pObj;
     pContext->transcodingSts = MFX_ERR_NONE;
+
+    char threadName[32];
+    sprintf(threadName, "transcode %u", pContext->pPipeline->GetPipelineID());
+    msdk_thread_set_name(threadName);
+
+    // memory first touched by the thread will be allocated on the node of its processors
+    if (pContext->affinity.size() && MFX_ERR_NONE != msdk_thread_set_affinity(pContext->affinity))
+    {
+        msdk_printf(MSDK_STRING("WARNING: failed to set affinity of session %d\n"), pContext->pPipeline->GetPipelineID());
+    }
     for(;;)
     {
         while (MFX_ERR_NONE == pContext->transcodingSts)
@@ -72,6 +84,8 @@ mfxU32 MFX_STDCALL TranscodingSample::ThranscodeRoutine(void   *pObj)
 
     pContext->working_time = TranscodingSample::GetTime(start);
     pContext->numTransFrames = pContext->pPipeline->GetProcessFrames();
+    pContext->busy_time = pContext->pPipeline->GetBusyTime();
+    pContext->cpu_time = msdk_thread_get_cpu_time();
 
     return 0;
 } // mfxU32 __stdcall ThranscodeRoutine(void   *pObj)
@@ -93,6 +107,7 @@ void sInputParams::Reset()
     m_hwdev = NULL;
     DenoiseLevel=-1;
     DetailLevel=-1;
+    nNumaNode = -1;
 }
 
 CTranscodingPipeline::CTranscodingPipeline():
@@ -123,6 +138,10 @@ CTranscodingPipeline::CTranscodingPipeline():
     m_pBSProcessor(NULL),
     m_nReqFrameTime(0),
     m_LastDecSyncPoint(0),
+    m_nBusyTime(0),
+    m_nSurfaceMemory(0),
+    m_nPeakSurfaceMemory(0),
+    m_nNumaNode(-1),
     m_NumFramesForReset(0),
     shouldUseGreedyFormula(false)
 {
@@ -320,7 +339,7 @@ mfxStatus CTranscodingPipeline::VPPPreInit(sInputParams *pParams)
             MSDK_CHECK_RESULT(sts, MFX_ERR_NONE, sts);
         }
 
-        if (pParams->nRotationAngle) // plugin was requested
+        if (pParams->nRotationAngle || pParams->nMirror) // plugin was requested
         {
             m_bIsPlugin = true;
             sts = InitPluginMfxParams(pParams);
@@ -333,6 +352,7 @@ mfxStatus CTranscodingPipeline::VPPPreInit(sInputParams *pParams)
             MSDK_CHECK_RESULT(sts, MFX_ERR_NONE, sts);
 
             m_RotateParam.Angle = pParams->nRotationAngle;
+            m_RotateParam.Mirror = pParams->nMirror;
             sts = pVPPPlugin->SetAuxParam(&m_RotateParam, sizeof(m_RotateParam));
             MSDK_CHECK_RESULT(sts, MFX_ERR_NONE, sts);
 
@@ -468,6 +488,30 @@ mfxVideoParam CTranscodingPipeline::GetDecodeParam() {
 
      return m_mfxDecParams;
  };
+// size of a frame in bytes, for the surface memory statistics
+static mfxU64 GetFrameSize(const mfxFrameInfo& info)
+{
+    mfxU64 nPixels = (mfxU64)info.Width * info.Height;
+    switch (info.FourCC)
+    {
+    case MFX_FOURCC_NV12:
+    case MFX_FOURCC_YV12:
+        return nPixels * 3 / 2;
+    case MFX_FOURCC_NV16:
+    case MFX_FOURCC_YUY2:
+    case MFX_FOURCC_UYVY:
+        return nPixels * 2;
+    case MFX_FOURCC_P010:
+    case MFX_FOURCC_RGB3:
+        return nPixels * 3;
+    case MFX_FOURCC_ARGB16:
+    case MFX_FOURCC_ABGR16:
+        return nPixels * 8;
+    default:
+        return nPixels * 4;
+    }
+}
+
 // 1 ms provides better result in range [0..5] ms
 enum
 {
@@ -477,40 +521,42 @@ enum
 mfxStatus CTranscodingPipeline::DecodeOneFrame(ExtendedSurface *pExtSurface)
 {
     MFX_ITT_TASK("DecodeOneFrame");
+    MSDK_TRACE_SCOPE(TRACE_STAGE_DECODE, GetPipelineID(), m_nProcessedFramesNum);
     MSDK_CHECK_POINTER(pExtSurface,  MFX_ERR_NULL_PTR);
 
     mfxStatus sts = MFX_ERR_MORE_SURFACE;
     mfxFrameSurface1    *pmfxSurface = NULL;
     pExtSurface->pSurface = NULL;
 
-    //--- Time measurements
-    if (statisticsWindowSize)
-    {
-        inputStatistics.StopTimeMeasurementWithCheck();
-        inputStatistics.StartTimeMeasurement();
-    }
-
     CTimer DevBusyTimer;
     DevBusyTimer.Start();
+    CDeviceBusyWaiter busyWaiter(&m_nBusyTime);
     while (MFX_ERR_MORE_DATA == sts || MFX_ERR_MORE_SURFACE == sts || MFX_ERR_NONE < sts)
     {
         if (MFX_WRN_DEVICE_BUSY == sts)
         {
-            WaitForDeviceToBecomeFree(*m_pmfxSession,m_LastDecSyncPoint,sts);
+            // the last decoding task should complete first
+            if (m_TranscodeState.bNonBlocking)
+                return ParkStep(&m_LastDecSyncPoint);
+            sts = busyWaiter.Wait(m_pmfxSession.get(), &m_LastDecSyncPoint);
+            MSDK_BREAK_ON_ERROR(sts);
         }
         else if (MFX_ERR_MORE_DATA == sts)
         {
+            MSDK_TRACE_SCOPE(TRACE_STAGE_READ, GetPipelineID(), m_nProcessedFramesNum);
             sts = m_pBSProcessor->GetInputBitstream(&m_pmfxBS); // read more data to input bit stream
             MSDK_BREAK_ON_ERROR(sts);
         }
         else if (MFX_ERR_MORE_SURFACE == sts)
         {
             // Find new working surface
-            pmfxSurface = GetFreeSurface(true, MSDK_SURFACE_WAIT_INTERVAL);
-            MSDK_CHECK_POINTER_SAFE(pmfxSurface, MFX_ERR_MEMORY_ALLOC, msdk_printf(MSDK_STRING("ERROR: No free surfaces in decoder pool (during long period)\n"))); // return an error if a free surface wasn't found
+            sts = GetFreeSurface(true, MSDK_SURFACE_WAIT_INTERVAL, &pmfxSurface);
+            MSDK_CHECK_RESULT(sts, MFX_ERR_NONE, sts);
         }
 
         sts = m_pmfxDEC->DecodeFrameAsync(m_pmfxBS, pmfxSurface, &pExtSurface->pSurface, &pExtSurface->Syncp);
+        // the decoder locks the working surface if it keeps it
+        m_DecSurfacePool.Release(pmfxSurface);
 
         if ( (MFX_WRN_DEVICE_BUSY == sts) &&
              (DevBusyTimer.GetTime() > MSDK_DEVICE_FREE_WAIT_INTERVAL/1000) )
@@ -531,37 +577,44 @@ mfxStatus CTranscodingPipeline::DecodeOneFrame(ExtendedSurface *pExtSurface)
 
     } //while processing
 
+    //--- Time measurements, a parked step is not counted
+    if (m_bCollectStatistics && MFX_ERR_NONE == sts)
+    {
+        inputStatistics.StopTimeMeasurementWithCheck();
+        inputStatistics.StartTimeMeasurement();
+    }
+
     return sts;
 
 } // mfxStatus CTranscodingPipeline::DecodeOneFrame(ExtendedSurface *pExtSurface)
 mfxStatus CTranscodingPipeline::DecodeLastFrame(ExtendedSurface *pExtSurface)
 {
     MFX_ITT_TASK("DecodeLastFrame");
+    MSDK_TRACE_SCOPE(TRACE_STAGE_DECODE, GetPipelineID(), m_nProcessedFramesNum);
     mfxFrameSurface1    *pmfxSurface = NULL;
     mfxStatus sts = MFX_ERR_MORE_SURFACE;
 
-    //--- Time measurements
-    if (statisticsWindowSize)
-    {
-        inputStatistics.StopTimeMeasurementWithCheck();
-        inputStatistics.StartTimeMeasurement();
-    }
-
     CTimer DevBusyTimer;
     DevBusyTimer.Start();
+    CDeviceBusyWaiter busyWaiter(&m_nBusyTime);
     // retrieve the buffered decoded frames
     while (MFX_ERR_MORE_SURFACE == sts || MFX_WRN_DEVICE_BUSY == sts)
     {
         if (MFX_WRN_DEVICE_BUSY == sts)
         {
-            WaitForDeviceToBecomeFree(*m_pmfxSession,m_LastDecSyncPoint,sts);
+            // the last decoding task should complete first
+            if (m_TranscodeState.bNonBlocking)
+                return ParkStep(&m_LastDecSyncPoint);
+            sts = busyWaiter.Wait(m_pmfxSession.get(), &m_LastDecSyncPoint);
+            MSDK_BREAK_ON_ERROR(sts);
         }
 
         // find new working surface
-        pmfxSurface = GetFreeSurface(true, MSDK_SURFACE_WAIT_INTERVAL);
+        sts = GetFreeSurface(true, MSDK_SURFACE_WAIT_INTERVAL, &pmfxSurface);
+        MSDK_CHECK_RESULT(sts, MFX_ERR_NONE, sts);
 
-        MSDK_CHECK_POINTER_SAFE(pmfxSurface, MFX_ERR_MEMORY_ALLOC, msdk_printf(MSDK_STRING("ERROR: No free surfaces in decoder pool (during long period)\n"))); // return an error if a free surface wasn't found
         sts = m_pmfxDEC->DecodeFrameAsync(NULL, pmfxSurface, &pExtSurface->pSurface, &pExtSurface->Syncp);
+        m_DecSurfacePool.Release(pmfxSurface);
 
         if ( (MFX_WRN_DEVICE_BUSY == sts) &&
              (DevBusyTimer.GetTime() > MSDK_DEVICE_FREE_WAIT_INTERVAL/1000) )
@@ -570,24 +623,32 @@ mfxStatus CTranscodingPipeline::DecodeLastFrame(ExtendedSurface *pExtSurface)
             return MFX_ERR_DEVICE_FAILED;
         }
     }
+
+    //--- Time measurements, a parked step is not counted
+    if (m_bCollectStatistics && MFX_ERR_NONE == sts)
+    {
+        inputStatistics.StopTimeMeasurementWithCheck();
+        inputStatistics.StartTimeMeasurement();
+    }
     return sts;
 }
 
 mfxStatus CTranscodingPipeline::VPPOneFrame(ExtendedSurface *pSurfaceIn, ExtendedSurface *pExtSurface)
 {
     MFX_ITT_TASK("VPPOneFrame");
+    MSDK_TRACE_SCOPE(TRACE_STAGE_VPP, GetPipelineID(), m_nProcessedFramesNum);
     MSDK_CHECK_POINTER(pExtSurface,  MFX_ERR_NULL_PTR);
     mfxFrameSurface1 *pmfxSurface = NULL;
     // find/wait for a free working surface
-    pmfxSurface = GetFreeSurface(false, MSDK_SURFACE_WAIT_INTERVAL);
-    MSDK_CHECK_POINTER_SAFE(pmfxSurface, MFX_ERR_MEMORY_ALLOC, msdk_printf(MSDK_STRING("ERROR: No free surfaces for VPP in encoder pool (during long period)\n"))); // return an error if a free surface wasn't found
+    mfxStatus sts = GetFreeSurface(false, MSDK_SURFACE_WAIT_INTERVAL, &pmfxSurface);
+    MSDK_CHECK_RESULT(sts, MFX_ERR_NONE, sts);
 
     // make sure picture structure has the initial value
     // surfaces are reused and VPP may change this parameter in certain configurations
     pmfxSurface->Info.PicStruct = m_mfxVppParams.vpp.Out.PicStruct ? m_mfxVppParams.vpp.Out.PicStruct : (m_bEncodeEnable ? m_mfxEncParams : m_mfxDecParams).mfx.FrameInfo.PicStruct;
 
     pExtSurface->pSurface = pmfxSurface;
-    mfxStatus sts = MFX_ERR_NONE;
+    CDeviceBusyWaiter vppBusyWaiter(&m_nBusyTime);
     for(;;)
     {
         sts = m_pmfxVPP->RunFrameVPPAsync(pSurfaceIn->pSurface, pmfxSurface, NULL, &pExtSurface->Syncp);
@@ -595,7 +656,16 @@ mfxStatus CTranscodingPipeline::VPPOneFrame(ExtendedSurface *pSurfaceIn, Extende
         if (MFX_ERR_NONE < sts && !pExtSurface->Syncp) // repeat the call if warning and no output
         {
             if (MFX_WRN_DEVICE_BUSY == sts)
-                MSDK_SLEEP(1); // wait if device is busy
+            {
+                if (m_TranscodeState.bNonBlocking)
+                {
+                    sts = ParkStep(NULL); // the step is retried from VPP
+                    break;
+                }
+                // wait for the oldest task of the session if there is one
+                sts = vppBusyWaiter.Wait(m_pmfxSession.get(), GetOldestSyncPoint());
+                MSDK_BREAK_ON_ERROR(sts);
+            }
         }
         else if (MFX_ERR_NONE < sts && pExtSurface->Syncp)
         {
@@ -607,6 +677,8 @@ mfxStatus CTranscodingPipeline::VPPOneFrame(ExtendedSurface *pSurfaceIn, Extende
             break;
         }
     }
+    // VPP locks the output surface, the encoder or the surface buffer locks it before VPP unlocks it
+    m_EncSurfacePool.Release(pmfxSurface);
     return sts;
 
 } // mfxStatus CTranscodingPipeline::DecodeOneFrame(ExtendedSurface *pExtSurface)
@@ -616,6 +688,8 @@ mfxStatus CTranscodingPipeline::EncodeOneFrame(ExtendedSurface *pExtSurface, mfx
     mfxStatus sts = MFX_ERR_NONE;
     mfxEncodeCtrl *pCtrl = (pExtSurface->pCtrl) ? &pExtSurface->pCtrl->encCtrl : NULL;
 
+    CDeviceBusyWaiter encBusyWaiter(&m_nBusyTime);
+    MSDK_TRACE_SCOPE(TRACE_STAGE_ENCODE, GetPipelineID(), m_nProcessedFramesNum);
     for (;;)
     {
         // at this point surface for encoder contains either a frame from file or a frame processed by vpp
@@ -624,7 +698,13 @@ mfxStatus CTranscodingPipeline::EncodeOneFrame(ExtendedSurface *pExtSurface, mfx
         if (MFX_ERR_NONE < sts && !pExtSurface->Syncp) // repeat the call if warning and no output
         {
             if (MFX_WRN_DEVICE_BUSY == sts)
-                MSDK_SLEEP(TIME_TO_SLEEP); // wait if device is busy
+            {
+                if (m_TranscodeState.bNonBlocking)
+                    return ParkStep(NULL); // the step is retried from encoding
+                // wait for the oldest task of the session if there is one
+                sts = encBusyWaiter.Wait(m_pmfxSession.get(), GetOldestSyncPoint());
+                MSDK_BREAK_ON_ERROR(sts);
+            }
         }
         else if (MFX_ERR_NONE < sts && pExtSurface->Syncp)
         {
@@ -663,6 +743,7 @@ mfxStatus CTranscodingPipeline::PreEncOneFrame(ExtendedSurface *pInSurface, Exte
         }
     }
     MSDK_CHECK_POINTER(pAux,  MFX_ERR_MEMORY_ALLOC);
+    CDeviceBusyWaiter preencBusyWaiter(&m_nBusyTime);
     for (;;)
     {
         pAux->encInput.InSurface = pInSurface->pSurface;
@@ -672,7 +753,11 @@ mfxStatus CTranscodingPipeline::PreEncOneFrame(ExtendedSurface *pInSurface, Exte
         if (MFX_ERR_NONE < sts && !pOutSurface->Syncp) // repeat the call if warning and no output
         {
             if (MFX_WRN_DEVICE_BUSY == sts)
-                MSDK_SLEEP(TIME_TO_SLEEP); // wait if device is busy
+            {
+                // wait for the oldest task of the session if there is one
+                sts = preencBusyWaiter.Wait(m_pmfxSession.get(), GetOldestSyncPoint());
+                MSDK_BREAK_ON_ERROR(sts);
+            }
         }
         else if (MFX_ERR_NONE <= sts && pOutSurface->Syncp)
         {
@@ -696,16 +781,10 @@ mfxStatus CTranscodingPipeline::PreEncOneFrame(ExtendedSurface *pInSurface, Exte
 void CTranscodingPipeline::NoMoreFramesSignal()
 {
     ExtendedSurface surf={};
-    SafetySurfaceBuffer   *pNextBuffer = m_pBuffer;
-    pNextBuffer->AddSurface(surf);
-    /*if 1_to_N mode */
-    if (0 == m_nVPPCompEnable)
+    // in 1_to_N mode all sinks read the same ring
+    if (MFX_ERR_NONE != m_pBuffer->AddSurface(surf))
     {
-        while (pNextBuffer->m_pNext)
-        {
-            pNextBuffer = pNextBuffer->m_pNext;
-            pNextBuffer->AddSurface(surf);
-        }
+        msdk_printf(MSDK_STRING("ERROR: timed out waiting surface release by downstream component\n"));
     }
 }
 
@@ -718,21 +797,18 @@ mfxStatus CTranscodingPipeline::Decode()
     ExtendedSurface PreEncExtSurface = {0};
     bool shouldReadNextFrame=true;
 
-    SafetySurfaceBuffer   *pNextBuffer = m_pBuffer;
     bool bEndOfFile = false;
     bool bLastCycle = false;
     time_t start = time(0);
     while (MFX_ERR_NONE == sts)
     {
-        pNextBuffer = m_pBuffer;
-
         if (time(0) - start >= m_nTimeout)
             bLastCycle = true;
 
         if (bLastCycle)
             SetNumFramesForReset(0);
 
-        msdk_tick nBeginTime = msdk_time_get_tick(); // microseconds.
+        msdk_tick nBeginTime = msdk_time_get_tick();
 
         if(shouldReadNextFrame)
         {
@@ -856,6 +932,7 @@ mfxStatus CTranscodingPipeline::Decode()
         if (!m_bIsJoinSession && m_pParentPipeline)
         {
             MFX_ITT_TASK("SyncOperation");
+            MSDK_TRACE_SCOPE(TRACE_STAGE_SYNC, GetPipelineID(), m_nProcessedFramesNum);
             sts = m_pmfxSession->SyncOperation(PreEncExtSurface.Syncp, MSDK_WAIT_INTERVAL);
             PreEncExtSurface.Syncp = NULL;
             MSDK_CHECK_RESULT(sts, MFX_ERR_NONE, sts);
@@ -863,35 +940,25 @@ mfxStatus CTranscodingPipeline::Decode()
 
 
         // Do not exceed buffer length (it should be not longer than AsyncDepth after adding newly processed surface)
-        while(pNextBuffer->GetLength()>=m_AsyncDepth)
+        while(m_pBuffer->GetLength()>=m_AsyncDepth)
         {
-            if (MFX_ERR_NONE != pNextBuffer->WaitForSurfaceRelease(MSDK_SURFACE_WAIT_INTERVAL)) {
+            if (MFX_ERR_NONE != m_pBuffer->WaitForSurfaceRelease(MSDK_SURFACE_WAIT_INTERVAL)) {
                 msdk_printf(MSDK_STRING("ERROR: timed out waiting surface release by downstream component\n"));
                 return MFX_ERR_NOT_FOUND;
             }
         }
 
-        // add surfaces in queue for all sinks
-        pNextBuffer->AddSurface(PreEncExtSurface);
-        /* one of key parts for N_to_1 mode:
-        * decoded frame should be in one buffer only as we have only 1 (one!) sink
-        * */
-        if (0 == m_nVPPCompEnable)
-        {
-            while (pNextBuffer->m_pNext)
-            {
-                pNextBuffer = pNextBuffer->m_pNext;
-                pNextBuffer->AddSurface(PreEncExtSurface);
-            }
-        }
+        // add surface in queue for all sinks, in 1_to_N mode they share one ring
+        // and in N_to_1 mode each source has own ring, so the surface is added once
+        sts = m_pBuffer->AddSurface(PreEncExtSurface);
+        MSDK_CHECK_RESULT(sts, MFX_ERR_NONE, sts);
 
         // We need to synchronize oldest stored surface if we've already stored enough surfaces in buffer (buffer length >= AsyncDepth)
         // Because we have to wait for decoder to finish processing and free some internally used surfaces
-        //mfxU32 len = pNextBuffer->GetLength();
-        if(pNextBuffer->GetLength()>=m_AsyncDepth)
+        if(m_pBuffer->GetLength()>=m_AsyncDepth)
         {
             ExtendedSurface frontSurface;
-            pNextBuffer->GetSurface(frontSurface);
+            m_pBuffer->GetOldestSurface(frontSurface);
 
             if(frontSurface.Syncp)
             {
@@ -911,7 +978,8 @@ mfxStatus CTranscodingPipeline::Decode()
             break;
         }
 
-        msdk_tick nFrameTime = msdk_time_get_tick() - nBeginTime;
+        // microseconds
+        msdk_tick nFrameTime = (msdk_tick)(MSDK_GET_TIME(msdk_time_get_tick(), nBeginTime, msdk_time_get_frequency()) * 1000000);
         if (nFrameTime < m_nReqFrameTime)
         {
             MSDK_USLEEP((mfxU32)(m_nReqFrameTime - nFrameTime));
@@ -946,7 +1014,7 @@ mfxStatus CTranscodingPipeline::Encode()
     bool shouldReadNextFrame=true;
     while (MFX_ERR_NONE == sts ||  MFX_ERR_MORE_DATA == sts)
     {
-        msdk_tick nBeginTime = msdk_time_get_tick(); // microseconds.
+        msdk_tick nBeginTime = msdk_time_get_tick();
 
         if(shouldReadNextFrame)
         {
@@ -976,6 +1044,7 @@ mfxStatus CTranscodingPipeline::Encode()
                 if (DecExtSurface.Syncp)
                 {
                     MFX_ITT_TASK("SyncOperation");
+                    MSDK_TRACE_SCOPE(TRACE_STAGE_SYNC, GetPipelineID(), m_nProcessedFramesNum);
                     sts = m_pParentPipeline->m_pmfxSession->SyncOperation(DecExtSurface.Syncp, MSDK_WAIT_INTERVAL);
                     MSDK_CHECK_RESULT(sts, MFX_ERR_NONE, sts);
                 }
@@ -1178,7 +1247,8 @@ mfxStatus CTranscodingPipeline::Encode()
             break;
         }
 
-        msdk_tick nFrameTime = msdk_time_get_tick() - nBeginTime;
+        // microseconds
+        msdk_tick nFrameTime = (msdk_tick)(MSDK_GET_TIME(msdk_time_get_tick(), nBeginTime, msdk_time_get_frequency()) * 1000000);
         if (nFrameTime < m_nReqFrameTime)
         {
             MSDK_USLEEP((mfxU32)(m_nReqFrameTime - nFrameTime));
@@ -1250,205 +1320,331 @@ void CTranscodingPipeline::SetSurfaceAuxIDR(ExtendedSurface& extSurface, PreEncA
 
 mfxStatus CTranscodingPipeline::Transcode()
 {
-    mfxStatus sts = MFX_ERR_NONE;
-    ExtendedSurface DecExtSurface = {0};
-    ExtendedSurface VppExtSurface = {0};
-    ExtendedBS *pBS = NULL;
-    bool bNeedDecodedFrames = true; // indicates if we need to decode frames
-    bool bEndOfFile = false;
-    bool bLastCycle = false;
-    bool bInsertIDR = false;
-    bool shouldReadNextFrame=true;
-    PreEncAuxBuffer encAuxCtrl;
-
-    MSDK_ZERO_MEMORY(encAuxCtrl);
-    encAuxCtrl.encCtrl.FrameType = MFX_FRAMETYPE_I | MFX_FRAMETYPE_IDR | MFX_FRAMETYPE_REF;
+    mfxStatus sts = StartTranscode();
 
-    time_t start = time(0);
-    while (MFX_ERR_NONE == sts )
+    while (MFX_ERR_NONE == sts)
     {
-        msdk_tick nBeginTime = msdk_time_get_tick(); // microseconds.
+        sts = TranscodeStep(false);
+    }
 
-        if (time(0) - start >= m_nTimeout)
-            bLastCycle = true;
-        if (m_MaxFramesForTranscode == m_nProcessedFramesNum)
-        {
-            DecExtSurface.pSurface = NULL;  // to get buffered VPP or ENC frames
-            bNeedDecodedFrames = false; // no more decoded frames needed
-        }
+    return sts;
+} // mfxStatus CTranscodingPipeline::Transcode()
 
-        // if need more decoded frames
-        // decode a frame
-        if (bNeedDecodedFrames && shouldReadNextFrame)
-        {
-            if (!bEndOfFile)
-            {
-                sts = DecodeOneFrame(&DecExtSurface);
-                if (MFX_ERR_MORE_DATA == sts)
-                {
-                    if (!bLastCycle)
-                    {
-                        bInsertIDR = true;
+mfxStatus CTranscodingPipeline::StartTranscode()
+{
+    MSDK_ZERO_MEMORY(m_TranscodeState);
+    m_TranscodeState.bNeedDecodedFrames = true;
+    m_TranscodeState.shouldReadNextFrame = true;
+    m_TranscodeState.encAuxCtrl.encCtrl.FrameType = MFX_FRAMETYPE_I | MFX_FRAMETYPE_IDR | MFX_FRAMETYPE_REF;
+    m_TranscodeState.start = time(0);
 
-                        static_cast<FileBitstreamProcessor_WithReset*>(m_pBSProcessor)->ResetInput();
-                        static_cast<FileBitstreamProcessor_WithReset*>(m_pBSProcessor)->ResetOutput();
-                        bNeedDecodedFrames = true;
+    return MFX_ERR_NONE;
+} // mfxStatus CTranscodingPipeline::StartTranscode()
 
-                        bEndOfFile = false;
-                        sts = MFX_ERR_NONE;
-                        continue;
-                    }
-                    else
-                    {
-                        bEndOfFile = true;
-                    }
-                }
-            }
+bool CTranscodingPipeline::IsStepSupported()
+{
+    // sessions exchanging surfaces with other sessions wait for each other inside Decode/Encode
+    return m_bDecodeEnable && m_bEncodeEnable && !m_nReqFrameTime;
+}
 
-            if (bEndOfFile)
-            {
-                sts = DecodeLastFrame(&DecExtSurface);
-            }
+mfxStatus CTranscodingPipeline::TranscodeStep(bool bNonBlocking)
+{
+    mfxStatus sts = MFX_ERR_NONE;
+    TranscodeState& state = m_TranscodeState;
+    ExtendedSurface& DecExtSurface = state.DecExtSurface;
+    ExtendedSurface& VppExtSurface = state.VppExtSurface;
 
-            if (sts == MFX_ERR_MORE_DATA)
-            {
-                DecExtSurface.pSurface = NULL;  // to get buffered VPP or ENC frames
-                sts = MFX_ERR_NONE;
-            }
+    state.bNonBlocking = bNonBlocking;
+    if (bNonBlocking)
+    {
+        // the output which would be written by the previous step, the step is not done till it is ready
+        while (m_BSPool.size() >= (state.bFlushing ? 1 : m_AsyncDepth))
+        {
+            if (!IsFirstBSReady())
+                return ParkStep(&m_BSPool.front()->Syncp);
 
+            sts = PutBS();
             MSDK_CHECK_RESULT(sts, MFX_ERR_NONE, sts);
         }
+    }
 
-        // pre-process a frame
-        if (m_pmfxVPP.get())
-        {
-            sts = VPPOneFrame(&DecExtSurface, &VppExtSurface);
-        }
-        else // no VPP - just copy pointers
-        {
-            VppExtSurface.pSurface = DecExtSurface.pSurface;
-            VppExtSurface.pCtrl = DecExtSurface.pCtrl;
-            VppExtSurface.Syncp = DecExtSurface.Syncp;
-        }
+    if (state.bFlushing)
+    {
+        return FinishTranscode();
+    }
 
-        if(MFX_ERR_MORE_SURFACE == sts)
+    // the frame is decoded and processed by the parked step already
+    if (state.bEncodePending)
+    {
+        return EncodeStepFrame(bNonBlocking);
+    }
+
+    state.nStepStart = msdk_time_get_tick();
+
+    if (time(0) - state.start >= m_nTimeout)
+        state.bLastCycle = true;
+    if (m_MaxFramesForTranscode == m_nProcessedFramesNum)
+    {
+        DecExtSurface.pSurface = NULL;  // to get buffered VPP or ENC frames
+        state.bNeedDecodedFrames = false; // no more decoded frames needed
+    }
+
+    // if need more decoded frames
+    // decode a frame
+    if (state.bNeedDecodedFrames && state.shouldReadNextFrame)
+    {
+        if (!state.bEndOfFile)
         {
-            shouldReadNextFrame=false;
-            sts=MFX_ERR_NONE;
+            sts = DecodeOneFrame(&DecExtSurface);
+            if (MFX_ERR_MORE_DATA == sts)
+            {
+                if (!state.bLastCycle)
+                {
+                    state.bInsertIDR = true;
+
+                    static_cast<FileBitstreamProcessor_WithReset*>(m_pBSProcessor)->ResetInput();
+                    static_cast<FileBitstreamProcessor_WithReset*>(m_pBSProcessor)->ResetOutput();
+                    state.bNeedDecodedFrames = true;
+
+                    state.bEndOfFile = false;
+                    return MFX_ERR_NONE;
+                }
+                else
+                {
+                    state.bEndOfFile = true;
+                }
+            }
         }
-        else
+
+        if (state.bEndOfFile)
         {
-            shouldReadNextFrame=true;
+            sts = DecodeLastFrame(&DecExtSurface);
         }
 
         if (sts == MFX_ERR_MORE_DATA)
         {
+            DecExtSurface.pSurface = NULL;  // to get buffered VPP or ENC frames
             sts = MFX_ERR_NONE;
-            if (NULL == DecExtSurface.pSurface) // there are no more buffered frames in VPP
-            {
-                VppExtSurface.pSurface = NULL; // to get buffered ENC frames
-            }
-            else
-            {
-                continue; // go get next frame from Decode
-            }
         }
 
         MSDK_CHECK_RESULT(sts, MFX_ERR_NONE, sts);
+    }
 
-        // encode frame
-        pBS = m_pBSStore->GetNext();
-        if (!pBS)
-            return MFX_ERR_NOT_FOUND;
-
-        m_BSPool.push_back(pBS);
+    // pre-process a frame
+    if (m_pmfxVPP.get())
+    {
+        sts = VPPOneFrame(&DecExtSurface, &VppExtSurface);
+    }
+    else // no VPP - just copy pointers
+    {
+        VppExtSurface.pSurface = DecExtSurface.pSurface;
+        VppExtSurface.pCtrl = DecExtSurface.pCtrl;
+        VppExtSurface.Syncp = DecExtSurface.Syncp;
+    }
 
-        // encode frame only if it wasn't encoded enough
-        SetSurfaceAuxIDR(VppExtSurface, &encAuxCtrl, bInsertIDR);
-        bInsertIDR = false;
+    if(MFX_ERR_MORE_SURFACE == sts)
+    {
+        state.shouldReadNextFrame=false;
+        sts=MFX_ERR_NONE;
+    }
+    else if (MFX_WRN_IN_EXECUTION == sts)
+    {
+        // the same decoded frame is processed by the next step
+        state.shouldReadNextFrame=false;
+        return sts;
+    }
+    else
+    {
+        state.shouldReadNextFrame=true;
+    }
 
-        if(bNeedDecodedFrames)
+    if (sts == MFX_ERR_MORE_DATA)
+    {
+        sts = MFX_ERR_NONE;
+        if (NULL == DecExtSurface.pSurface) // there are no more buffered frames in VPP
         {
-            if(m_mfxEncParams.mfx.CodecId != MFX_FOURCC_DUMP)
-            {
-                sts = EncodeOneFrame(&VppExtSurface, &m_BSPool.back()->Bitstream);
-            }
-            else
-            {
-                sts = Surface2BS(&VppExtSurface, &m_BSPool.back()->Bitstream,m_mfxVppParams.vpp.Out.FourCC);
-            }
+            VppExtSurface.pSurface = NULL; // to get buffered ENC frames
         }
         else
         {
-            sts = MFX_ERR_MORE_DATA;
+            return MFX_ERR_NONE; // go get next frame from Decode
         }
+    }
 
-        // check if we need one more frame from decode
-        if (MFX_ERR_MORE_DATA == sts)
-        {
-            // the task in not in Encode queue
-            m_BSPool.pop_back();
-            m_pBSStore->Release(pBS);
+    MSDK_CHECK_RESULT(sts, MFX_ERR_NONE, sts);
 
-            if (NULL == VppExtSurface.pSurface) // there are no more buffered frames in encoder
-            {
-                break;
-            }
-            sts = MFX_ERR_NONE;
-            continue;
-        }
+    return EncodeStepFrame(bNonBlocking);
+} // mfxStatus CTranscodingPipeline::TranscodeStep(bool bNonBlocking)
 
-        // check encoding result
-        MSDK_CHECK_RESULT(sts, MFX_ERR_NONE, sts);
+mfxStatus CTranscodingPipeline::EncodeStepFrame(bool bNonBlocking)
+{
+    mfxStatus sts = MFX_ERR_NONE;
+    TranscodeState& state = m_TranscodeState;
+    ExtendedSurface& VppExtSurface = state.VppExtSurface;
 
-        m_nProcessedFramesNum++;
-        if(statisticsWindowSize)
+    state.bEncodePending = false;
+
+    // encode frame
+    ExtendedBS *pBS = m_pBSStore->GetNext();
+    if (!pBS)
+        return MFX_ERR_NOT_FOUND;
+
+    m_BSPool.push_back(pBS);
+
+    // encode frame only if it wasn't encoded enough
+    SetSurfaceAuxIDR(VppExtSurface, &state.encAuxCtrl, state.bInsertIDR);
+
+    if(state.bNeedDecodedFrames)
+    {
+        if(m_mfxEncParams.mfx.CodecId != MFX_FOURCC_DUMP)
         {
-            if (m_nOutputFramesNum && 0 == m_nOutputFramesNum % statisticsWindowSize)
-            {
-                inputStatistics.PrintStatistics(GetPipelineID());
-                outputStatistics.PrintStatistics(GetPipelineID());
-                inputStatistics.ResetStatistics();
-                outputStatistics.ResetStatistics();
-                fflush(stdout);
-            }
+            sts = EncodeOneFrame(&VppExtSurface, &m_BSPool.back()->Bitstream);
         }
-        else if (0 == (m_nProcessedFramesNum - 1) % 100)
+        else
         {
-            msdk_printf(MSDK_STRING("."));
+            sts = Surface2BS(&VppExtSurface, &m_BSPool.back()->Bitstream,m_mfxVppParams.vpp.Out.FourCC);
         }
+    }
+    else
+    {
+        sts = MFX_ERR_MORE_DATA;
+    }
 
-        m_BSPool.back()->Syncp = VppExtSurface.Syncp;
+    if (MFX_ERR_MORE_DATA == sts || MFX_WRN_IN_EXECUTION == sts)
+    {
+        // the task in not in Encode queue
+        m_BSPool.pop_back();
+        m_pBSStore->Release(pBS);
+    }
+    if (MFX_WRN_IN_EXECUTION == sts)
+    {
+        state.bEncodePending = true;
+        return sts;
+    }
+    state.bInsertIDR = false;
 
-        if (m_BSPool.size() == m_AsyncDepth)
+    // check if we need one more frame from decode
+    if (MFX_ERR_MORE_DATA == sts)
+    {
+        if (NULL == VppExtSurface.pSurface) // there are no more buffered frames in encoder
         {
-            sts = PutBS();
-            MSDK_CHECK_RESULT(sts, MFX_ERR_NONE, sts);
+            // need to get buffered bitstream
+            state.bFlushing = true;
+            return bNonBlocking ? MFX_ERR_NONE : FinishTranscode();
         }
+        return MFX_ERR_NONE;
+    }
 
-        msdk_tick nFrameTime = msdk_time_get_tick() - nBeginTime;
-        if (nFrameTime < m_nReqFrameTime)
+    // check encoding result
+    MSDK_CHECK_RESULT(sts, MFX_ERR_NONE, sts);
+
+    m_nProcessedFramesNum++;
+    if(statisticsWindowSize)
+    {
+        if (m_nOutputFramesNum && 0 == m_nOutputFramesNum % statisticsWindowSize)
         {
-            MSDK_USLEEP((mfxU32)(m_nReqFrameTime - nFrameTime));
+            inputStatistics.PrintStatistics(GetPipelineID());
+            outputStatistics.PrintStatistics(GetPipelineID());
+            inputStatistics.ResetStatistics();
+            outputStatistics.ResetStatistics();
+            fflush(stdout);
         }
     }
-    MSDK_IGNORE_MFX_STS(sts, MFX_ERR_MORE_DATA);
+    else if (0 == (m_nProcessedFramesNum - 1) % 100)
+    {
+        msdk_printf(MSDK_STRING("."));
+    }
 
-    // need to get buffered bitstream
-    if (MFX_ERR_NONE == sts)
+    m_BSPool.back()->Syncp = VppExtSurface.Syncp;
+
+    // in non-blocking mode the output is written by the next step when it is ready
+    if (!bNonBlocking && m_BSPool.size() == m_AsyncDepth)
     {
-        while(m_BSPool.size())
+        sts = PutBS();
+        MSDK_CHECK_RESULT(sts, MFX_ERR_NONE, sts);
+    }
+
+    // microseconds
+    msdk_tick nFrameTime = (msdk_tick)(MSDK_GET_TIME(msdk_time_get_tick(), state.nStepStart, msdk_time_get_frequency()) * 1000000);
+    if (nFrameTime < m_nReqFrameTime)
+    {
+        MSDK_USLEEP((mfxU32)(m_nReqFrameTime - nFrameTime));
+    }
+
+    return MFX_ERR_NONE;
+} // mfxStatus CTranscodingPipeline::EncodeStepFrame(bool bNonBlocking)
+
+mfxStatus CTranscodingPipeline::ParkStep(mfxSyncPoint *pSyncPoint)
+{
+    if (!pSyncPoint || !*pSyncPoint)
+    {
+        pSyncPoint = GetOldestSyncPoint();
+    }
+    m_TranscodeState.pWaitSyncp = pSyncPoint;
+    return MFX_WRN_IN_EXECUTION;
+} // mfxStatus CTranscodingPipeline::ParkStep(mfxSyncPoint *pSyncPoint)
+
+mfxSyncPoint* CTranscodingPipeline::GetOldestSyncPoint()
+{
+    // the oldest output frees the most, then the last decoded frame;
+    // the returned sync point is NULL if nothing is outstanding
+    return (!m_BSPool.empty() && m_BSPool.front()->Syncp) ? &m_BSPool.front()->Syncp : &m_LastDecSyncPoint;
+} // mfxSyncPoint* CTranscodingPipeline::GetOldestSyncPoint()
+
+mfxStatus CTranscodingPipeline::WaitStep(mfxU32 nTimeout)
+{
+    mfxStatus sts = MFX_ERR_NONE;
+    mfxSyncPoint *pSyncPoint = m_TranscodeState.pWaitSyncp;
+    m_TranscodeState.pWaitSyncp = NULL;
+
+    msdk_tick nStart = msdk_time_get_tick();
+    if (pSyncPoint && *pSyncPoint)
+    {
+        sts = m_pmfxSession->SyncOperation(*pSyncPoint, nTimeout);
+        if (MFX_ERR_NONE == sts)
         {
-            sts = PutBS();
-            MSDK_CHECK_RESULT(sts, MFX_ERR_NONE, sts);
+            // retire completed sync point, the step doesn't synchronize it again
+            *pSyncPoint = NULL;
         }
+        MSDK_IGNORE_MFX_STS(sts, MFX_WRN_IN_EXECUTION);
     }
-
-    if (MFX_ERR_NONE == sts)
-        sts = MFX_WRN_VALUE_NOT_CHANGED;
+    else
+    {
+        // nothing of the session is in flight, the device is busy with other sessions
+        MSDK_SLEEP(nTimeout);
+    }
+    m_nBusyTime += msdk_time_get_tick() - nStart;
 
     return sts;
-} // mfxStatus CTranscodingPipeline::Transcode()
+} // mfxStatus CTranscodingPipeline::WaitStep(mfxU32 nTimeout)
+
+mfxStatus CTranscodingPipeline::FinishTranscode()
+{
+    mfxStatus sts = MFX_ERR_NONE;
+
+    while(m_BSPool.size())
+    {
+        sts = PutBS();
+        MSDK_CHECK_RESULT(sts, MFX_ERR_NONE, sts);
+    }
+
+    return MFX_WRN_VALUE_NOT_CHANGED;
+} // mfxStatus CTranscodingPipeline::FinishTranscode()
+
+bool CTranscodingPipeline::IsFirstBSReady()
+{
+    ExtendedBS *pBitstreamEx = m_BSPool.front();
+    if (pBitstreamEx->Syncp)
+    {
+        mfxStatus sts = m_pmfxSession->SyncOperation(pBitstreamEx->Syncp, 0);
+        if (MFX_WRN_IN_EXECUTION == sts)
+            return false;
+        // retire completed sync point, PutBS reports errors
+        if (MFX_ERR_NONE == sts)
+            pBitstreamEx->Syncp = NULL;
+    }
+    return true;
+}
 
 mfxStatus CTranscodingPipeline::PutBS()
 {
@@ -1457,6 +1653,7 @@ mfxStatus CTranscodingPipeline::PutBS()
     // get result coded stream, synchronize only if we still have sync point
     if(pBitstreamEx->Syncp)
     {
+        MSDK_TRACE_SCOPE(TRACE_STAGE_SYNC, GetPipelineID(), m_nOutputFramesNum);
         sts = m_pmfxSession->SyncOperation(pBitstreamEx->Syncp, MSDK_WAIT_INTERVAL);
     }
     MSDK_CHECK_RESULT(sts, MFX_ERR_NONE, sts);
@@ -1464,13 +1661,16 @@ mfxStatus CTranscodingPipeline::PutBS()
     m_nOutputFramesNum++;
 
     //--- Time measurements
-    if (statisticsWindowSize)
+    if (m_bCollectStatistics)
     {
         outputStatistics.StopTimeMeasurementWithCheck();
         outputStatistics.StartTimeMeasurement();
     }
 
-    sts = m_pBSProcessor->ProcessOutputBitstream(&pBitstreamEx->Bitstream);
+    {
+        MSDK_TRACE_SCOPE(TRACE_STAGE_WRITE, GetPipelineID(), m_nOutputFramesNum - 1);
+        sts = m_pBSProcessor->ProcessOutputBitstream(&pBitstreamEx->Bitstream);
+    }
     MSDK_CHECK_RESULT(sts, MFX_ERR_NONE, sts);
 
     UnPreEncAuxBuffer(pBitstreamEx->pCtrl);
@@ -1526,7 +1726,7 @@ mfxStatus CTranscodingPipeline::NV12toBS(mfxFrameSurface1* pSurface,mfxBitstream
     mfxFrameData& data = pSurface->Data;
     if((int)pBS->MaxLength-(int)pBS->DataLength < (int)(info.CropH*info.CropW*3/2))
     {
-        mfxStatus sts = ExtendMfxBitstream(pBS, pBS->DataLength+(int)(info.CropH*info.CropW*3/2));
+        mfxStatus sts = ExtendMfxBitstream(pBS, pBS->DataLength+(int)(info.CropH*info.CropW*3/2), m_nNumaNode);
         MSDK_CHECK_RESULT(sts, MFX_ERR_NONE, sts);
     }
 
@@ -1537,19 +1737,13 @@ mfxStatus CTranscodingPipeline::NV12toBS(mfxFrameSurface1* pSurface,mfxBitstream
     }
 
     mfxU16 h = info.CropH / 2;
-    mfxU16 w = info.CropW;
+    mfxU16 w = info.CropW / 2;
 
-    for(mfxU16 offset = 0; offset<2;offset++)
-    {
-        for (mfxU16 i = 0; i < h; i++)
-        {
-            for (mfxU16 j = offset; j < w; j += 2)
-            {
-                pBS->Data[pBS->DataLength]=*(data.UV + (info.CropY * data.Pitch / 2 + info.CropX) + i * data.Pitch + j);
-                pBS->DataLength++;
-            }
-        }
-    }
+    // U plane followed by V plane
+    mfxU8* pU = pBS->Data + pBS->DataLength;
+    mfxU8* pV = pU + w * h;
+    ConvertNV12ToPlanar(data.UV + (info.CropY * data.Pitch / 2 + info.CropX), data.Pitch, pU, w, pV, w, w, h);
+    pBS->DataLength += 2 * w * h;
 
     return MFX_ERR_NONE;
 }
@@ -1560,7 +1754,7 @@ mfxStatus CTranscodingPipeline::RGB4toBS(mfxFrameSurface1* pSurface,mfxBitstream
     mfxFrameData& data = pSurface->Data;
     if((int)pBS->MaxLength-(int)pBS->DataLength < (int)(info.CropH*info.CropW*4))
     {
-        mfxStatus sts = ExtendMfxBitstream(pBS, pBS->DataLength+(int)(info.CropH*info.CropW*4));
+        mfxStatus sts = ExtendMfxBitstream(pBS, pBS->DataLength+(int)(info.CropH*info.CropW*4), m_nNumaNode);
         MSDK_CHECK_RESULT(sts, MFX_ERR_NONE, sts);
     }
 
@@ -1579,7 +1773,7 @@ mfxStatus CTranscodingPipeline::YUY2toBS(mfxFrameSurface1* pSurface,mfxBitstream
     mfxFrameData& data = pSurface->Data;
     if((int)pBS->MaxLength-(int)pBS->DataLength < (int)(info.CropH*info.CropW*4))
     {
-        mfxStatus sts = ExtendMfxBitstream(pBS, pBS->DataLength+(int)(info.CropH*info.CropW*4));
+        mfxStatus sts = ExtendMfxBitstream(pBS, pBS->DataLength+(int)(info.CropH*info.CropW*4), m_nNumaNode);
         MSDK_CHECK_RESULT(sts, MFX_ERR_NONE, sts);
     }
 
@@ -1676,7 +1870,7 @@ mfxStatus CTranscodingPipeline::InitDecMfxParams(sInputParams *pInParams)
         {
             if (m_pmfxBS->MaxLength == m_pmfxBS->DataLength)
             {
-                sts = ExtendMfxBitstream(m_pmfxBS, m_pmfxBS->MaxLength * 2);
+                sts = m_pBSProcessor->ExtendInputBitstream(&m_pmfxBS);
                 MSDK_CHECK_RESULT(sts, MFX_ERR_NONE, sts);
             }
 
@@ -1921,6 +2115,12 @@ MFX_IOPATTERN_IN_VIDEO_MEMORY : MFX_IOPATTERN_IN_SYSTEM_MEMORY);
         m_mfxEncParams.mfx.NumRefFrame = pInParams->NumRefFrame;
     }
 
+    // outputs of segments are joined, so no frame may refer across a GOP boundary
+    if (pInParams->nSegmentFrames)
+    {
+        m_mfxEncParams.mfx.GopOptFlag |= MFX_GOP_CLOSED;
+    }
+
     return MFX_ERR_NONE;
 }// mfxStatus CTranscodingPipeline::InitEncMfxParams(sInputParams *pInParams)
 
@@ -2250,8 +2450,14 @@ mfxStatus CTranscodingPipeline::InitPluginMfxParams(sInputParams *pInParams)
     }
 
     // fill output frame info
-    // in case of rotation plugin sample output frameinfo is same as input
+    // in case of rotation plugin sample output frameinfo is same as input, transposed for 90 and 270 degrees
     MSDK_MEMCPY_VAR(m_mfxPluginParams.vpp.Out, &m_mfxPluginParams.vpp.In, sizeof(mfxFrameInfo));
+    if (90 == pInParams->nRotationAngle || 270 == pInParams->nRotationAngle)
+    {
+        std::swap(m_mfxPluginParams.vpp.Out.Width, m_mfxPluginParams.vpp.Out.Height);
+        std::swap(m_mfxPluginParams.vpp.Out.CropW, m_mfxPluginParams.vpp.Out.CropH);
+        std::swap(m_mfxPluginParams.vpp.Out.CropX, m_mfxPluginParams.vpp.Out.CropY);
+    }
 
     // configure and attach external parameters
     if (m_bUseOpaqueMemory)
@@ -2303,6 +2509,18 @@ mfxStatus CTranscodingPipeline::AllocFrames(mfxFrameAllocRequest *pRequest, bool
         (isDecAlloc) ? m_pSurfaceDecPool.push_back(surface):m_pSurfaceEncPool.push_back(surface);
     }
 
+    // opaque surfaces are allocated by the library, but they take memory as well
+    m_nSurfaceMemory += nSurfNum * GetFrameSize(pRequest->Info);
+    m_nPeakSurfaceMemory = std::max(m_nPeakSurfaceMemory, m_nSurfaceMemory);
+
+    SurfPointersArray& workArray = isDecAlloc ? m_pSurfaceDecPool : m_pSurfaceEncPool;
+    if (workArray.size())
+    {
+        CSurfacePool& pool = isDecAlloc ? m_DecSurfacePool : m_EncSurfacePool;
+        sts = pool.Init(&workArray[0], (mfxU16)workArray.size());
+        MSDK_CHECK_RESULT(sts, MFX_ERR_NONE, sts);
+    }
+
     (isDecAlloc) ? m_DecSurfaceType = pRequest->Type : m_EncSurfaceType = pRequest->Type;
 
     return MFX_ERR_NONE;
@@ -2636,6 +2854,9 @@ mfxStatus CTranscodingPipeline::InitOpaqueAllocBuffers()
 
 void CTranscodingPipeline::FreeFrames()
 {
+    m_DecSurfacePool.Close();
+    m_EncSurfacePool.Close();
+
     // free mfxFrameSurface structures and arrays of pointers
     mfxU32 i;
     for (i = 0; i < m_pSurfaceDecPool.size(); i++)
@@ -2657,6 +2878,7 @@ void CTranscodingPipeline::FreeFrames()
         m_pMFXAllocator->Free(m_pMFXAllocator->pthis, &m_mfxEncResponse);
         m_pMFXAllocator->Free(m_pMFXAllocator->pthis, &m_mfxDecResponse);
     }
+    m_nSurfaceMemory = 0;
 } // CTranscodingPipeline::FreeFrames()
 
 mfxStatus CTranscodingPipeline::Init(sInputParams *pParams,
@@ -2678,10 +2900,12 @@ mfxStatus CTranscodingPipeline::Init(sInputParams *pParams,
 
     m_nTimeout = pParams->nTimeout;
     m_AsyncDepth = (0 == pParams->nAsyncDepth)? 1: pParams->nAsyncDepth;
+    m_nNumaNode = pParams->nNumaNode;
     m_FrameNumberPreference = pParams->FrameNumberPreference;
     m_numEncoders = 0;
 
     statisticsWindowSize = pParams->statisticsWindowSize;
+    m_bCollectStatistics = statisticsWindowSize || pParams->bPerfReport;
 
     if (m_bEncodeEnable)
     {
@@ -2773,6 +2997,13 @@ mfxStatus CTranscodingPipeline::Init(sInputParams *pParams,
 
     m_pBuffer = pBuffer;
 
+    // decoding session puts its surfaces to the buffers, so it should know when they are released
+    if (Sink == pParams->eMode)
+    {
+        m_pBuffer->AddReleaseListener(&m_DecSurfacePool);
+        m_pBuffer->AddReleaseListener(&m_EncSurfacePool);
+    }
+
     mfxInitParam initPar;
     mfxExtThreadsParam threadsPar;
     mfxExtBuffer* extBufs[1];
@@ -3051,51 +3282,49 @@ mfxStatus CTranscodingPipeline::CompleteInit()
 
     return sts;
 } // mfxStatus CTranscodingPipeline::CompleteInit()
-mfxFrameSurface1* CTranscodingPipeline::GetFreeSurface(bool isDec, mfxU64 timeout)
+mfxStatus CTranscodingPipeline::GetFreeSurface(bool isDec, mfxU64 timeout, mfxFrameSurface1** ppSurface)
 {
-    mfxFrameSurface1* pSurf = NULL;
+    CSurfacePool& pool = isDec ? m_DecSurfacePool : m_EncSurfacePool;
+    mfxStatus sts = MFX_ERR_NONE;
 
-    CTimer t;
-    t.Start();
-    do
+    // Media SDK unlocks surfaces when the tasks using them complete, so the output of own tasks
+    // is written out, the oldest first, till a surface is free. Non-blocking step is parked instead of
+    // waiting for a task
+    bool bNonBlocking = m_TranscodeState.bNonBlocking;
+    *ppSurface = pool.GetFree(0);
+    while (!*ppSurface && !m_BSPool.empty())
     {
-        SurfPointersArray & workArray = isDec ? m_pSurfaceDecPool : m_pSurfaceEncPool;
+        if (bNonBlocking && !IsFirstBSReady())
+            return ParkStep(&m_BSPool.front()->Syncp);
 
-        for (mfxU32 i = 0; i < workArray.size(); i++)
-        {
-            if (!workArray[i]->Data.Locked)
-            {
-                pSurf = workArray[i];
-                break;
-            }
-        }
-        if (pSurf)
-        {
-            break;
-        }
-        else
-        {
-            MSDK_SLEEP(TIME_TO_SLEEP);
-        }
-    } while ( t.GetTime() < timeout / 1000 );
+        sts = PutBS();
+        MSDK_CHECK_RESULT(sts, MFX_ERR_NONE, sts);
+        *ppSurface = pool.GetFree(0);
+    }
 
-    return pSurf;
-} // mfxFrameSurface1* CTranscodingPipeline::GetFreeSurface(bool isDec)
+    // decoded frames which are not encoded by this session yet
+    if (!*ppSurface && m_LastDecSyncPoint)
+    {
+        sts = m_pmfxSession->SyncOperation(m_LastDecSyncPoint, bNonBlocking ? 0 : MSDK_WAIT_INTERVAL);
+        if (bNonBlocking && MFX_WRN_IN_EXECUTION == sts)
+            return ParkStep(&m_LastDecSyncPoint);
+        MSDK_CHECK_RESULT(sts, MFX_ERR_NONE, sts);
+        m_LastDecSyncPoint = NULL;
+        *ppSurface = pool.GetFree(0);
+    }
 
-mfxU32 CTranscodingPipeline::GetFreeSurfacesCount(bool isDec)
-{
-    SurfPointersArray& workArray = isDec ? m_pSurfaceDecPool : m_pSurfaceEncPool;
-    mfxU32 count=0;
-    for (mfxU32 i = 0; i < workArray.size(); i++)
+    // the rest are held by other sessions, they notify the pool when they release surfaces
+    if (!*ppSurface)
     {
-        if (!workArray[i]->Data.Locked)
-        {
-            count++;
-        }
+        if (bNonBlocking)
+            return ParkStep(NULL);
+        *ppSurface = pool.GetFree((mfxU32)timeout);
     }
-    return count;
-}
+    MSDK_CHECK_POINTER_SAFE(*ppSurface, MFX_ERR_MEMORY_ALLOC,
+        msdk_printf(MSDK_STRING("ERROR: No free surfaces in %s pool (during long period)\n"), isDec ? MSDK_STRING("decoder") : MSDK_STRING("encoder")));
 
+    return MFX_ERR_NONE;
+} // mfxStatus CTranscodingPipeline::GetFreeSurface(bool isDec, mfxU64 timeout, mfxFrameSurface1** ppSurface)
 
 PreEncAuxBuffer*  CTranscodingPipeline::GetFreePreEncAuxBuffer()
 {
@@ -3215,23 +3444,9 @@ mfxStatus CTranscodingPipeline::AllocateSufficientBuffer(mfxBitstream* pBS)
     mfxStatus sts = m_pmfxENC->GetVideoParam(&par);
     MSDK_CHECK_RESULT(sts, MFX_ERR_NONE, sts);
 
-    mfxU32 new_size = 0;
-    // if encoder provided us information about buffer size
-    if (0 != par.mfx.BufferSizeInKB)
-    {
-        new_size = par.mfx.BufferSizeInKB * 1000;
-    }
-    else
-    {
-        // trying to guess the size (e.g. for JPEG encoder)
-        new_size = (0 == pBS->MaxLength)
-            // some heuristic init value
-            ? 4 + (par.mfx.FrameInfo.Width * par.mfx.FrameInfo.Height * 3 + 1023)
-            // double existing size
-            : 2 * pBS->MaxLength;
-    }
+    mfxU32 new_size = GetSufficientBitstreamSize(par, pBS->MaxLength);
 
-    sts = ExtendMfxBitstream(pBS, new_size);
+    sts = ExtendMfxBitstream(pBS, new_size, m_nNumaNode);
     MSDK_CHECK_RESULT_SAFE(sts, MFX_ERR_NONE, sts, WipeMfxBitstream(pBS));
 
     return MFX_ERR_NONE;
@@ -3277,124 +3492,281 @@ void DecreaseReference(mfxFrameData *ptr)
     msdk_atomic_dec16((volatile mfxU16 *)&ptr->Locked);
 }
 
-SafetySurfaceBuffer::SafetySurfaceBuffer(SafetySurfaceBuffer *pNext)
-    :m_pNext(pNext),
-     m_IsBufferingAllowed(true)
+SurfaceRing::SurfaceRing(mfxU32 nCapacity, mfxU32 nConsumers)
+    :m_nMask(0),
+     m_nHead(0),
+     m_nTail(0),
+     m_bProducerWaiting(0),
+     m_pReleased(NULL)
 {
-    mfxStatus sts=MFX_ERR_NONE;
-    pRelEvent = new MSDKEvent(sts,false,false);
-    if(sts !=MFX_ERR_NONE)
+    mfxU32 nSize = 1;
+    while (nSize < nCapacity)
+        nSize <<= 1;
+    m_nMask = nSize - 1;
+
+    Slot slot;
+    MSDK_ZERO_MEMORY(slot);
+    m_Slots.resize(nSize, slot);
+
+    Consumer consumer;
+    MSDK_ZERO_MEMORY(consumer);
+    m_Consumers.resize(nConsumers, consumer);
+
+    mfxStatus sts = MFX_ERR_NONE;
+    m_pReleased = new MSDKEvent(sts, false, false);
+    if (sts != MFX_ERR_NONE)
     {
         msdk_printf(MSDK_STRING("Cannot create event (for release) for surfaces buffer\n"));
     }
 
-    pInsEvent = new MSDKEvent(sts,false,false);
-    if(sts !=MFX_ERR_NONE)
+    for (size_t i = 0; i < m_Consumers.size(); i++)
     {
-        msdk_printf(MSDK_STRING("Cannot create event (for insertion) for surfaces buffer\n"));
+        m_Consumers[i].pInserted = new MSDKEvent(sts, false, false);
+        if (sts != MFX_ERR_NONE)
+        {
+            msdk_printf(MSDK_STRING("Cannot create event (for insertion) for surfaces buffer\n"));
+        }
     }
+} // SurfaceRing::SurfaceRing
 
-} // SafetySurfaceBuffer::SafetySurfaceBuffer
+SurfaceRing::~SurfaceRing()
+{
+    for (size_t i = 0; i < m_Consumers.size(); i++)
+    {
+        delete m_Consumers[i].pInserted;
+    }
+    delete m_pReleased;
+} // SurfaceRing::~SurfaceRing
 
-SafetySurfaceBuffer::~SafetySurfaceBuffer()
+void SurfaceRing::ReleaseSlot(Slot& slot)
 {
-    delete pRelEvent;
-    delete pInsEvent;
-} //SafetySurfaceBuffer::~SafetySurfaceBuffer()
+    // the slot may be reused by the producer as soon as the counter drops to zero
+    mfxFrameSurface1* pSurface = slot.ExtSurface.pSurface;
+    if (msdk_atomic_dec16(&slot.nRefs))
+        return;
 
-mfxU32 SafetySurfaceBuffer::GetLength()
+    if (pSurface)
+    {
+        DecreaseReference(&pSurface->Data);
+        for (size_t i = 0; i < m_ReleaseListeners.size(); i++)
+        {
+            m_ReleaseListeners[i]->NotifyRelease();
+        }
+    }
+    if (msdk_atomic_cas32(&m_bProducerWaiting, 0, 1))
+    {
+        m_pReleased->Signal();
+    }
+}
+
+void SurfaceRing::Reclaim()
 {
-    AutomaticMutex guard(m_mutex);
-    return (mfxU32)m_SList.size();
+    for (size_t i = 0; i < m_Consumers.size(); i++)
+    {
+        Consumer& consumer = m_Consumers[i];
+        if (!msdk_atomic_load32(&consumer.bDetached))
+            continue;
+
+        for (; consumer.nCursor != m_nHead; consumer.nCursor++)
+        {
+            ReleaseSlot(m_Slots[consumer.nCursor & m_nMask]);
+        }
+    }
+
+    // slots are freed in the order of insertion as every consumer releases them in this order
+    while (m_nTail != m_nHead && 0 == m_Slots[m_nTail & m_nMask].nRefs)
+    {
+        m_nTail++;
+    }
 }
 
-mfxStatus SafetySurfaceBuffer::WaitForSurfaceRelease(mfxU32 msec)
+mfxU32 SurfaceRing::GetLength()
 {
-    return pRelEvent->TimedWait(msec);
+    Reclaim();
+    return m_nHead - m_nTail;
 }
 
-mfxStatus SafetySurfaceBuffer::WaitForSurfaceInsertion(mfxU32 msec)
+mfxStatus SurfaceRing::WaitForSurfaceRelease(mfxU32 msec)
 {
-    return pInsEvent->TimedWait(msec);
+    mfxU32 nLength = m_nHead - m_nTail;
+
+    msdk_atomic_cas32(&m_bProducerWaiting, 1, 0);
+    // a surface may have been released before the flag was raised
+    if (GetLength() < nLength)
+    {
+        msdk_atomic_store32(&m_bProducerWaiting, 0);
+        return MFX_ERR_NONE;
+    }
+    return m_pReleased->TimedWait(msec);
 }
 
-void SafetySurfaceBuffer::AddSurface(ExtendedSurface Surf)
+mfxStatus SurfaceRing::AddSurface(const ExtendedSurface& Surf)
 {
-    AutomaticMutex  guard(m_mutex);
+    while (GetLength() > m_nMask)
+    {
+        if (MFX_ERR_NONE != WaitForSurfaceRelease(MSDK_SURFACE_WAIT_INTERVAL))
+            return MFX_ERR_NOT_FOUND;
+    }
 
-    if(m_IsBufferingAllowed)
+    Slot& slot = m_Slots[m_nHead & m_nMask];
+    slot.ExtSurface = Surf;
+    slot.nRefs = (mfxU16)m_Consumers.size();
+    // Locked is used to signal when we can free surface
+    if (Surf.pSurface)
     {
-        SurfaceDescriptor sDescriptor;
-        // Locked is used to signal when we can free surface
-        sDescriptor.Locked     = 1;
-        sDescriptor.ExtSurface = Surf;
+        IncreaseReference(&Surf.pSurface->Data);
+    }
+    msdk_atomic_store32(&m_nHead, m_nHead + 1);
 
-        if (Surf.pSurface)
+    for (size_t i = 0; i < m_Consumers.size(); i++)
+    {
+        if (msdk_atomic_cas32(&m_Consumers[i].bWaiting, 0, 1))
         {
-            IncreaseReference(&Surf.pSurface->Data);
+            m_Consumers[i].pInserted->Signal();
         }
+    }
+    return MFX_ERR_NONE;
+} // SurfaceRing::AddSurface
 
-        m_SList.push_back(sDescriptor);
-        pInsEvent->Signal();
+mfxStatus SurfaceRing::GetOldestSurface(ExtendedSurface &Surf)
+{
+    if (!GetLength())
+    {
+        MSDK_ZERO_MEMORY(Surf);
+        return MFX_ERR_MORE_SURFACE;
     }
+    Surf = m_Slots[m_nTail & m_nMask].ExtSurface;
+    return MFX_ERR_NONE;
+}
 
-} // SafetySurfaceBuffer::AddSurface(mfxFrameSurface1 *pSurf)
+void SurfaceRing::AddReleaseListener(CSurfacePool* pPool)
+{
+    m_ReleaseListeners.push_back(pPool);
+}
 
-mfxStatus SafetySurfaceBuffer::GetSurface(ExtendedSurface &Surf)
+mfxStatus SurfaceRing::GetSurface(mfxU32 nConsumer, ExtendedSurface &Surf)
 {
-    AutomaticMutex guard(m_mutex);
+    Consumer& consumer = m_Consumers[nConsumer];
 
     // no ready surfaces
-    if (0 == m_SList.size())
+    if (consumer.bDetached || consumer.nCursor == msdk_atomic_load32(&m_nHead))
     {
-        Surf.pSurface=NULL;
-        Surf.pCtrl=NULL;
-        Surf.Syncp=0;
+        MSDK_ZERO_MEMORY(Surf);
         return MFX_ERR_MORE_SURFACE;
     }
 
-    SurfaceDescriptor sDescriptor = m_SList.front();
+    Surf = m_Slots[consumer.nCursor & m_nMask].ExtSurface;
+    return MFX_ERR_NONE;
+} // SurfaceRing::GetSurface
+
+mfxStatus SurfaceRing::ReleaseSurface(mfxU32 nConsumer, mfxFrameSurface1* pSurf)
+{
+    Consumer& consumer = m_Consumers[nConsumer];
 
-    Surf = sDescriptor.ExtSurface;
+    if (consumer.bDetached || consumer.nCursor == msdk_atomic_load32(&m_nHead))
+        return MFX_ERR_UNKNOWN;
 
+    Slot& slot = m_Slots[consumer.nCursor & m_nMask];
+    if (pSurf != slot.ExtSurface.pSurface)
+        return MFX_ERR_UNKNOWN;
 
+    consumer.nCursor++;
+    ReleaseSlot(slot);
     return MFX_ERR_NONE;
+} // SurfaceRing::ReleaseSurface
 
-} // SafetySurfaceBuffer::GetSurface()
+mfxStatus SurfaceRing::WaitForSurfaceInsertion(mfxU32 nConsumer, mfxU32 msec)
+{
+    Consumer& consumer = m_Consumers[nConsumer];
 
-mfxStatus SafetySurfaceBuffer::ReleaseSurface(mfxFrameSurface1* pSurf)
+    msdk_atomic_cas32(&consumer.bWaiting, 1, 0);
+    // a surface may have been added before the flag was raised
+    if (consumer.nCursor != msdk_atomic_load32(&m_nHead))
+    {
+        msdk_atomic_store32(&consumer.bWaiting, 0);
+        return MFX_ERR_NONE;
+    }
+    return consumer.pInserted->TimedWait(msec);
+}
+
+void SurfaceRing::CancelBuffering(mfxU32 nConsumer)
 {
-    AutomaticMutex guard(m_mutex);
-    std::list<SurfaceDescriptor>::iterator it;
-    for (it = m_SList.begin(); it != m_SList.end(); it++)
+    Consumer& consumer = m_Consumers[nConsumer];
+    if (consumer.bDetached)
+        return;
+
+    for (mfxU32 nHead = msdk_atomic_load32(&m_nHead); consumer.nCursor != nHead; consumer.nCursor++)
     {
-        if (pSurf == it->ExtSurface.pSurface)
-        {
-            it->Locked--;
-            if (it->ExtSurface.pSurface)
-                DecreaseReference(&it->ExtSurface.pSurface->Data);
-            if (0 == it->Locked)
-            {
-                m_SList.erase(it);
-                pRelEvent->Signal();
-            }
-            return MFX_ERR_NONE;
-        }
+        ReleaseSlot(m_Slots[consumer.nCursor & m_nMask]);
     }
-    return MFX_ERR_UNKNOWN;
+    // from now on the cursor belongs to the producer
+    msdk_atomic_cas32(&consumer.bDetached, 1, 0);
+}
+
+SafetySurfaceBuffer::SafetySurfaceBuffer(SurfaceRing *pRing, mfxU32 nConsumer, SafetySurfaceBuffer *pNext)
+    :m_pNext(pNext),
+     m_pRing(pRing),
+     m_nConsumer(nConsumer)
+{
+} // SafetySurfaceBuffer::SafetySurfaceBuffer
+
+SafetySurfaceBuffer::~SafetySurfaceBuffer()
+{
+} //SafetySurfaceBuffer::~SafetySurfaceBuffer()
+
+mfxU32 SafetySurfaceBuffer::GetLength()
+{
+    return m_pRing->GetLength();
+}
+
+mfxStatus SafetySurfaceBuffer::WaitForSurfaceRelease(mfxU32 msec)
+{
+    return m_pRing->WaitForSurfaceRelease(msec);
+}
 
-} // mfxStatus SafetySurfaceBuffer::ReleaseSurface(mfxFrameSurface1* pSurf)
+mfxStatus SafetySurfaceBuffer::WaitForSurfaceInsertion(mfxU32 msec)
+{
+    return m_pRing->WaitForSurfaceInsertion(m_nConsumer, msec);
+}
+
+mfxStatus SafetySurfaceBuffer::AddSurface(const ExtendedSurface& Surf)
+{
+    return m_pRing->AddSurface(Surf);
+}
+
+mfxStatus SafetySurfaceBuffer::GetOldestSurface(ExtendedSurface &Surf)
+{
+    return m_pRing->GetOldestSurface(Surf);
+}
+
+mfxStatus SafetySurfaceBuffer::GetSurface(ExtendedSurface &Surf)
+{
+    return m_pRing->GetSurface(m_nConsumer, Surf);
+}
+
+mfxStatus SafetySurfaceBuffer::ReleaseSurface(mfxFrameSurface1* pSurf)
+{
+    return m_pRing->ReleaseSurface(m_nConsumer, pSurf);
+}
 
 void SafetySurfaceBuffer::CancelBuffering()
 {
-    AutomaticMutex guard(m_mutex);
-    m_IsBufferingAllowed=false;
+    m_pRing->CancelBuffering(m_nConsumer);
+}
+
+void SafetySurfaceBuffer::AddReleaseListener(CSurfacePool* pPool)
+{
+    m_pRing->AddReleaseListener(pPool);
 }
 
 FileBitstreamProcessor::FileBitstreamProcessor()
 {
     MSDK_ZERO_MEMORY(m_Bitstream);
     m_Bitstream.TimeStamp=(mfxU64)-1;
+    m_nWriteBehindBuffers = 0;
+    m_bDirectIO = false;
+    m_nCompleteFrameCodecId = 0;
+    m_nNumaNode = -1;
 } // FileBitstreamProcessor::FileBitstreamProcessor()
 
 FileBitstreamProcessor::~FileBitstreamProcessor()
@@ -3411,7 +3783,7 @@ mfxStatus FileBitstreamProcessor::Init(msdk_char *pStrSrcFile, msdk_char *pStrDs
     mfxStatus sts;
     if (pStrSrcFile)
     {
-        m_pFileReader.reset(new CSmplBitstreamReader());
+        m_pFileReader.reset(CreateReader());
         sts = m_pFileReader->Init(pStrSrcFile);
         MSDK_CHECK_RESULT(sts, MFX_ERR_NONE, sts);
     }
@@ -3419,20 +3791,82 @@ mfxStatus FileBitstreamProcessor::Init(msdk_char *pStrSrcFile, msdk_char *pStrDs
     if (pStrDstFile && *pStrDstFile)
     {
         m_pFileWriter.reset(new CSmplBitstreamWriter);
+        m_pFileWriter->SetWriteBehind(m_nWriteBehindBuffers, 4 * 1024 * 1024, m_bDirectIO);
         sts = m_pFileWriter->Init(pStrDstFile);
         MSDK_CHECK_RESULT(sts, MFX_ERR_NONE, sts);
     }
 
-    sts = InitMfxBitstream(&m_Bitstream, 1024 * 1024);
+    sts = InitMfxBitstream(&m_Bitstream, 1024 * 1024, m_nNumaNode);
     MSDK_CHECK_RESULT(sts, MFX_ERR_NONE, sts);
 
     return MFX_ERR_NONE;
 
 } // FileBitstreamProcessor::Init(msdk_char *pStrSrcFile, msdk_char *pStrDstFile)
 
+CSmplBitstreamReader* FileBitstreamProcessor::CreateReader()
+{
+    switch (m_nCompleteFrameCodecId)
+    {
+    case MFX_CODEC_AVC:
+        return new CH264FrameReader();
+    case MFX_CODEC_HEVC:
+        return new CHEVCFrameReader();
+    default:
+        return new CSmplBitstreamReader();
+    }
+} // CSmplBitstreamReader* FileBitstreamProcessor::CreateReader()
+
+mfxStatus FileBitstreamProcessor::AppendInput(mfxBitstream *pBitstream)
+{
+    if (m_Bitstream.MaxLength - m_Bitstream.DataLength < pBitstream->DataLength)
+    {
+        mfxStatus sts = ExtendMfxBitstream(&m_Bitstream, m_Bitstream.DataLength + pBitstream->DataLength);
+        MSDK_CHECK_RESULT(sts, MFX_ERR_NONE, sts);
+    }
+
+    memmove(m_Bitstream.Data, m_Bitstream.Data + m_Bitstream.DataOffset, m_Bitstream.DataLength);
+    m_Bitstream.DataOffset = 0;
+    MSDK_MEMCPY_BITSTREAM(m_Bitstream, m_Bitstream.DataLength, pBitstream->Data + pBitstream->DataOffset, pBitstream->DataLength);
+    m_Bitstream.DataLength += pBitstream->DataLength;
+    m_Bitstream.DataFlag = pBitstream->DataFlag;
+    m_Bitstream.TimeStamp = pBitstream->TimeStamp;
+
+    return MFX_ERR_NONE;
+
+} // mfxStatus FileBitstreamProcessor::AppendInput(mfxBitstream *pBitstream)
+
 mfxStatus FileBitstreamProcessor::GetInputBitstream(mfxBitstream **pBitstream)
 {
-    mfxStatus sts = m_pFileReader->ReadNextFrame(&m_Bitstream);
+    mfxStatus sts;
+    if (m_nCompleteFrameCodecId)
+    {
+        // the previous frame is in the reader memory, which is reused by the next read
+        if (*pBitstream && *pBitstream != &m_Bitstream && (*pBitstream)->DataLength)
+        {
+            sts = AppendInput(*pBitstream);
+            MSDK_CHECK_RESULT(sts, MFX_ERR_NONE, sts);
+            (*pBitstream)->DataLength = 0;
+        }
+
+        // complete frames are decoded right from the reader memory,
+        // they are copied only to be joined with the data left by the decoder
+        mfxBitstream *pFrame = NULL;
+        sts = m_pFileReader->ReadNextFrameNoCopy(&m_Bitstream, &pFrame);
+        if (MFX_ERR_NONE != sts || !pFrame)
+            return sts;
+
+        if (pFrame != &m_Bitstream && m_Bitstream.DataLength)
+        {
+            sts = AppendInput(pFrame);
+            MSDK_CHECK_RESULT(sts, MFX_ERR_NONE, sts);
+            pFrame = &m_Bitstream;
+        }
+
+        *pBitstream = pFrame;
+        return MFX_ERR_NONE;
+    }
+
+    sts = m_pFileReader->ReadNextFrame(&m_Bitstream);
     if (MFX_ERR_NONE == sts)
     {
         *pBitstream = &m_Bitstream;
@@ -3442,6 +3876,25 @@ mfxStatus FileBitstreamProcessor::GetInputBitstream(mfxBitstream **pBitstream)
 
 } //  FileBitstreamProcessor::GetInputBitstream(mfxBitstream* pBitstream)
 
+mfxStatus FileBitstreamProcessor::ExtendInputBitstream(mfxBitstream **pBitstream)
+{
+    MSDK_CHECK_POINTER(pBitstream, MFX_ERR_NULL_PTR);
+    MSDK_CHECK_POINTER(*pBitstream, MFX_ERR_NULL_PTR);
+
+    if (*pBitstream == &m_Bitstream)
+        return ExtendMfxBitstream(&m_Bitstream, m_Bitstream.MaxLength * 2);
+
+    // the frame in the reader memory can't be extended, so it is moved to m_Bitstream
+    // which collects following frames till the decoder has enough data
+    mfxStatus sts = AppendInput(*pBitstream);
+    MSDK_CHECK_RESULT(sts, MFX_ERR_NONE, sts);
+    (*pBitstream)->DataLength = 0;
+    *pBitstream = &m_Bitstream;
+
+    return MFX_ERR_NONE;
+
+} // mfxStatus FileBitstreamProcessor::ExtendInputBitstream(mfxBitstream **pBitstream)
+
 mfxStatus FileBitstreamProcessor::ProcessOutputBitstream(mfxBitstream* pBitstream)
 {
     if (m_pFileWriter.get())
@@ -3458,7 +3911,7 @@ mfxStatus FileBitstreamProcessor_WithReset::Init(msdk_char *pStrSrcFile, msdk_ch
     {
         size_t SrcFileNameSize = msdk_strlen(pStrSrcFile);
         m_pSrcFile.assign(pStrSrcFile, pStrSrcFile + SrcFileNameSize + 1);
-        m_pFileReader.reset(new CSmplBitstreamReader());
+        m_pFileReader.reset(CreateReader());
         sts = m_pFileReader->Init(pStrSrcFile);
         MSDK_CHECK_RESULT(sts, MFX_ERR_NONE, sts);
     } else
@@ -3471,6 +3924,7 @@ mfxStatus FileBitstreamProcessor_WithReset::Init(msdk_char *pStrSrcFile, msdk_ch
         size_t DstFileNameSize = msdk_strlen(pStrDstFile);
         m_pDstFile.assign(pStrDstFile, pStrDstFile + DstFileNameSize + 1);
         m_pFileWriter.reset(new CSmplBitstreamWriter);
+        m_pFileWriter->SetWriteBehind(m_nWriteBehindBuffers, 4 * 1024 * 1024, m_bDirectIO);
         sts = m_pFileWriter->Init(pStrDstFile);
         MSDK_CHECK_RESULT(sts, MFX_ERR_NONE, sts);
     }
@@ -3479,7 +3933,7 @@ mfxStatus FileBitstreamProcessor_WithReset::Init(msdk_char *pStrSrcFile, msdk_ch
         m_pDstFile.resize(1, 0);
     }
 
-    sts = InitMfxBitstream(&m_Bitstream, 1024 * 1024);
+    sts = InitMfxBitstream(&m_Bitstream, 1024 * 1024, m_nNumaNode);
     MSDK_CHECK_RESULT(sts, MFX_ERR_NONE, sts);
 
     return MFX_ERR_NONE;
@@ -3499,3 +3953,30 @@ mfxStatus FileBitstreamProcessor_WithReset::ResetOutput()
     MSDK_CHECK_RESULT(sts, MFX_ERR_NONE, sts);
     return MFX_ERR_NONE;
 } // FileBitstreamProcessor_Benchmark::ResetOutput()
+
+SegmentBitstreamProcessor::SegmentBitstreamProcessor(mfxU32 nCodecId, mfxU32 nFirstFrame, mfxU32 nFrames)
+    : m_nCodecId(nCodecId)
+    , m_nFirstFrame(nFirstFrame)
+    , m_nFrames(nFrames)
+{
+} // SegmentBitstreamProcessor::SegmentBitstreamProcessor(mfxU32 nCodecId, mfxU32 nFirstFrame, mfxU32 nFrames)
+
+mfxStatus SegmentBitstreamProcessor::Init(msdk_char *pStrSrcFile, msdk_char *pStrDstFile)
+{
+    MSDK_CHECK_POINTER(pStrSrcFile, MFX_ERR_NULL_PTR);
+
+    mfxStatus sts = FileBitstreamProcessor::Init(NULL, pStrDstFile);
+    MSDK_CHECK_RESULT(sts, MFX_ERR_NONE, sts);
+
+    std::auto_ptr<CIndexedFrameReader> pReader(new CIndexedFrameReader());
+    sts = pReader->Init(pStrSrcFile, m_nCodecId, false);
+    MSDK_CHECK_RESULT(sts, MFX_ERR_NONE, sts);
+
+    sts = pReader->SetRange(m_nFirstFrame, m_nFrames);
+    MSDK_CHECK_RESULT(sts, MFX_ERR_NONE, sts);
+
+    m_pFileReader.reset(pReader.release());
+
+    return MFX_ERR_NONE;
+
+} // SegmentBitstreamProcessor::Init(msdk_char *pStrSrcFile, msdk_char *pStrDstFile)
@@ -78,6 +78,11 @@ mfxStatus Launcher::Init(int argc, msdk_char *argv[])
     sts = VerifyCrossSessionsOptions();
     MSDK_CHECK_RESULT(sts, MFX_ERR_NONE, sts);
 
+    sts = SplitSegments();
+    MSDK_CHECK_RESULT(sts, MFX_ERR_NONE, sts);
+
+    AssignAffinity();
+
 #if defined(_WIN32) || defined(_WIN64)
     if (m_eDevType == MFX_HANDLE_D3D9_DEVICE_MANAGER)
     {
@@ -224,6 +229,11 @@ mfxStatus Launcher::Init(int argc, msdk_char *argv[])
     // create sessions, allocators
     for (i = 0; i < m_InputParamsArray.size(); i++)
     {
+        // system memory surfaces of the session are placed on its NUMA node
+        SysMemAllocatorParams* pSysMemParams = dynamic_cast<SysMemAllocatorParams*>(m_pAllocParam.get());
+        if (pSysMemParams)
+            pSysMemParams->nNumaNode = m_InputParamsArray[i].nNumaNode;
+
         GeneralAllocator* pAllocator = new GeneralAllocator;
         sts = pAllocator->Init(m_pAllocParam.get());
         MSDK_CHECK_RESULT(sts, MFX_ERR_NONE, sts);
@@ -231,9 +241,20 @@ mfxStatus Launcher::Init(int argc, msdk_char *argv[])
 
         std::auto_ptr<ThreadTranscodeContext> pThreadPipeline(new ThreadTranscodeContext);
         // extend BS processing init
-        m_InputParamsArray[i].nTimeout == 0 ? m_pExtBSProcArray.push_back(new FileBitstreamProcessor) :
-                                        m_pExtBSProcArray.push_back(new FileBitstreamProcessor_WithReset);
+        if (m_InputParamsArray[i].nSegmentFrames)
+            m_pExtBSProcArray.push_back(new SegmentBitstreamProcessor(m_InputParamsArray[i].DecodeId,
+                                                                      m_InputParamsArray[i].nSegmentFirstFrame,
+                                                                      m_InputParamsArray[i].nSegmentFrames));
+        else
+            m_InputParamsArray[i].nTimeout == 0 ? m_pExtBSProcArray.push_back(new FileBitstreamProcessor) :
+                                            m_pExtBSProcArray.push_back(new FileBitstreamProcessor_WithReset);
+        m_pExtBSProcArray.back()->SetWriteBehind(m_InputParamsArray[i].nWriteBehindBuffers, m_InputParamsArray[i].bDirectIO);
+        if (m_InputParamsArray[i].bCompleteFrame)
+            m_pExtBSProcArray.back()->SetCompleteFrame(m_InputParamsArray[i].DecodeId);
+        m_pExtBSProcArray.back()->SetNumaNode(m_InputParamsArray[i].nNumaNode);
         pThreadPipeline->pPipeline.reset(CreatePipeline());
+        pThreadPipeline->affinity.assign(m_InputParamsArray[i].AffinityCPUs,
+                                         m_InputParamsArray[i].AffinityCPUs + m_InputParamsArray[i].nAffinityCPUs);
 
         pThreadPipeline->pBSProcessor = m_pExtBSProcArray.back();
         if (Sink == m_InputParamsArray[i].eMode)
@@ -249,6 +270,7 @@ mfxStatus Launcher::Init(int argc, msdk_char *argv[])
             }
             else /* 1_to_N mode*/
             {
+                // any buffer will do, all of them read the same ring and the decoder only adds surfaces to it
                 pBuffer = m_pBufferArray[m_pBufferArray.size() - 1];
             }
             pSinkPipeline = pThreadPipeline->pPipeline.get();
@@ -358,18 +380,54 @@ void Launcher::Run()
 
     MSDKThread * pthread = NULL;
 
+    if (m_parser.IsSchedulerMode())
+    {
+        m_pScheduler.reset(new CSessionScheduler);
+    }
+
     for (i = 0; i < totalSessions; i++)
     {
+        // bound sessions and sessions which can't be processed by steps get own threads
+        if (m_pScheduler.get() && m_pSessionArray[i]->affinity.empty() && m_pSessionArray[i]->pPipeline->IsStepSupported())
+        {
+            m_pScheduler->AddSession(m_pSessionArray[i]);
+            continue;
+        }
+        if (m_pScheduler.get())
+        {
+            msdk_printf(MSDK_STRING("Session %d is run by own thread\n"), i);
+        }
+
         pthread = new MSDKThread(sts, ThranscodeRoutine, (void *)m_pSessionArray[i]);
 
         m_HDLArray.push_back(pthread);
     }
 
-    for (i = 0; i < m_pSessionArray.size(); i++)
+    if (m_pScheduler.get())
+    {
+        sts = m_pScheduler->Start(m_parser.GetWorkerThreads());
+        if (MFX_ERR_NONE != sts)
+        {
+            msdk_printf(MSDK_STRING("error: failed to start worker threads\n"));
+        }
+        m_pScheduler->Wait();
+    }
+
+    for (i = 0; i < m_HDLArray.size(); i++)
     {
         m_HDLArray[i]->Wait();
     }
 
+    // the last output written behind is flushed here, so write errors fail the session
+    for (i = 0; i < m_pExtBSProcArray.size(); i++)
+    {
+        sts = m_pExtBSProcArray[i]->CloseOutput();
+        if (MFX_ERR_NONE != sts && MFX_ERR_NONE == m_pSessionArray[i]->transcodingSts)
+            m_pSessionArray[i]->transcodingSts = sts;
+    }
+
+    JoinSegments();
+
     msdk_printf(MSDK_STRING("\nTranscoding finished\n"));
 
 } // mfxStatus Launcher::Init()
@@ -423,6 +481,15 @@ mfxStatus Launcher::ProcessResult()
             }
         }
 
+        if (m_pSessionArray[i]->busy_time > 0)
+        {
+            msdk_printf(MSDK_STRING("Device busy waits: %.3f sec\n"), m_pSessionArray[i]->busy_time);
+            if (pPerfFile)
+            {
+                msdk_fprintf(pPerfFile, MSDK_STRING("Device busy waits: %.3f sec\n"), m_pSessionArray[i]->busy_time);
+            }
+        }
+
         if (pPerfFile)
         {
             if (Native == m_InputParamsArray[i].eMode || Sink == m_InputParamsArray[i].eMode)
@@ -437,6 +504,10 @@ mfxStatus Launcher::ProcessResult()
 
     }
 
+    WriteReport();
+
+    CBitstreamPool::Instance().PrintStatistics();
+
     if (SuccessTranscode)
     {
         msdk_printf(MSDK_STRING("\nThe test PASSED\n"));
@@ -457,6 +528,346 @@ mfxStatus Launcher::ProcessResult()
     }
 } // mfxStatus Launcher::ProcessResult()
 
+namespace
+{
+    // named value of a report record, strings are quoted in JSON
+    struct ReportField
+    {
+        ReportField(const msdk_string& _name, const msdk_string& _value, bool _bString)
+            : name(_name), value(_value), bString(_bString) {}
+
+        msdk_string name;
+        msdk_string value;
+        bool bString;
+    };
+
+    typedef std::vector<ReportField> ReportRecord;
+
+    template <class T>
+    void AddField(ReportRecord& record, const msdk_string& name, T value)
+    {
+        msdk_stringstream stream;
+        stream.setf(std::ios::fixed);
+        stream.precision(3);
+        stream << value;
+        record.push_back(ReportField(name, stream.str(), false));
+    }
+
+    void AddStringField(ReportRecord& record, const msdk_string& name, const msdk_string& value)
+    {
+        record.push_back(ReportField(name, value, true));
+    }
+
+    msdk_string GetCodecName(mfxU32 codecId)
+    {
+        if (!codecId)
+            return MSDK_STRING("none");
+        // four character codes like "AVC " are padded with spaces
+        msdk_string name = CodecIdToStr(codecId);
+        size_t len = name.find_last_not_of(MSDK_STRING(" \0"));
+        return name.substr(0, len + 1);
+    }
+
+    // interval statistics in milliseconds
+    void AddStatistics(ReportRecord& record, const msdk_string& prefix, CTimeStatistics stat)
+    {
+        const msdk_char* names[] = { MSDK_STRING("avg"), MSDK_STRING("p50"), MSDK_STRING("p90"),
+            MSDK_STRING("p99"), MSDK_STRING("p99_9"), MSDK_STRING("max") };
+        mfxF64 values[] = { stat.GetAvgTime(), stat.GetPercentile(50), stat.GetPercentile(90),
+            stat.GetPercentile(99), stat.GetPercentile(99.9), stat.GetMaxTime() };
+
+        AddField(record, prefix + MSDK_STRING("samples"), stat.GetNumMeasurements());
+        for (size_t i = 0; i < MSDK_ARRAY_LEN(names); i++)
+        {
+            AddField(record, prefix + names[i], stat.GetNumMeasurements() ? values[i] * 1000 : 0);
+        }
+    }
+}
+
+void Launcher::WriteReport()
+{
+    FILE* pReportFile = m_parser.GetReportFile();
+    if (!pReportFile)
+        return;
+
+    std::vector<ReportRecord> records;
+    for (mfxU32 i = 0; i < m_pSessionArray.size(); i++)
+    {
+        ThreadTranscodeContext* pContext = m_pSessionArray[i];
+        const sInputParams& params = m_InputParamsArray[i];
+        ReportRecord record;
+
+        mfxVideoParam par = pContext->pPipeline->GetOutputParam();
+
+        AddField(record, MSDK_STRING("session"), i);
+        AddStringField(record, MSDK_STRING("status"), (MFX_ERR_NONE == pContext->transcodingSts) ? MSDK_STRING("PASSED") : MSDK_STRING("FAILED"));
+        AddField(record, MSDK_STRING("frames"), pContext->numTransFrames);
+        AddField(record, MSDK_STRING("wall_time"), pContext->working_time);
+        AddField(record, MSDK_STRING("fps"), (pContext->working_time > 0) ? pContext->numTransFrames / pContext->working_time : 0);
+        AddField(record, MSDK_STRING("cpu_time"), pContext->cpu_time);
+        AddField(record, MSDK_STRING("busy_time"), pContext->busy_time);
+        AddStringField(record, MSDK_STRING("decoder"), GetCodecName(params.DecodeId));
+        AddStringField(record, MSDK_STRING("encoder"), GetCodecName(params.EncodeId));
+        AddField(record, MSDK_STRING("width"), par.mfx.FrameInfo.CropW);
+        AddField(record, MSDK_STRING("height"), par.mfx.FrameInfo.CropH);
+        AddField(record, MSDK_STRING("async_depth"), par.AsyncDepth);
+        AddField(record, MSDK_STRING("surface_memory"), pContext->pPipeline->GetPeakSurfaceMemory());
+        AddStatistics(record, MSDK_STRING("input_"), pContext->pPipeline->GetInputStatistics());
+        AddStatistics(record, MSDK_STRING("output_"), pContext->pPipeline->GetOutputStatistics());
+
+        records.push_back(record);
+    }
+
+    if (m_parser.IsReportCSV())
+    {
+        for (size_t j = 0; records.size() && j < records[0].size(); j++)
+        {
+            msdk_fprintf(pReportFile, MSDK_STRING("%s%s"), j ? MSDK_STRING(",") : MSDK_STRING(""), records[0][j].name.c_str());
+        }
+        msdk_fprintf(pReportFile, MSDK_STRING("\n"));
+
+        for (size_t i = 0; i < records.size(); i++)
+        {
+            for (size_t j = 0; j < records[i].size(); j++)
+            {
+                msdk_fprintf(pReportFile, MSDK_STRING("%s%s"), j ? MSDK_STRING(",") : MSDK_STRING(""), records[i][j].value.c_str());
+            }
+            msdk_fprintf(pReportFile, MSDK_STRING("\n"));
+        }
+    }
+    else
+    {
+        msdk_fprintf(pReportFile, MSDK_STRING("{\n  \"total_time\": %.3f,\n  \"sessions\": ["), GetTime(m_StartTime));
+        for (size_t i = 0; i < records.size(); i++)
+        {
+            msdk_fprintf(pReportFile, MSDK_STRING("%s\n    {"), i ? MSDK_STRING(",") : MSDK_STRING(""));
+            for (size_t j = 0; j < records[i].size(); j++)
+            {
+                const msdk_char* quote = records[i][j].bString ? MSDK_STRING("\"") : MSDK_STRING("");
+                msdk_fprintf(pReportFile, MSDK_STRING("%s\"%s\": %s%s%s"), j ? MSDK_STRING(", ") : MSDK_STRING(""),
+                    records[i][j].name.c_str(), quote, records[i][j].value.c_str(), quote);
+            }
+            msdk_fprintf(pReportFile, MSDK_STRING("}"));
+        }
+        msdk_fprintf(pReportFile, MSDK_STRING("\n  ]\n}\n"));
+    }
+    fflush(pReportFile);
+} // void Launcher::WriteReport()
+
+mfxStatus Launcher::SplitSegments()
+{
+    std::vector<sInputParams> params;
+
+    for (mfxU32 i = 0; i < m_InputParamsArray.size(); i++)
+    {
+        const sInputParams& job = m_InputParamsArray[i];
+        if (job.nSegments < 2)
+        {
+            params.push_back(job);
+            continue;
+        }
+
+        if (job.nTimeout)
+        {
+            PrintError(MSDK_STRING("-segments is not compatible with -timeout\n"));
+            return MFX_ERR_UNSUPPORTED;
+        }
+
+        // the index is written next to the input, so repeated jobs do not parse the input again
+        CBitstreamIndex index;
+        mfxStatus sts = index.Open(job.strSrcFile, job.DecodeId, true);
+        if (MFX_ERR_NONE != sts)
+        {
+            msdk_printf(MSDK_STRING("error: failed to index %s\n"), job.strSrcFile);
+            return sts;
+        }
+
+        mfxU32 nFrames = MSDK_MIN(index.GetCount(), job.MaxFrameNumber);
+        MSDK_CHECK_ERROR(nFrames, 0, MFX_ERR_MORE_DATA);
+
+        // segments of about equal length start from the key frames before their boundaries
+        std::vector<mfxU32> starts(1, 0);
+        for (mfxU32 j = 1; j < job.nSegments; j++)
+        {
+            mfxU32 nStart = index.FindKeyFrame((mfxU32)((mfxU64)nFrames * j / job.nSegments));
+            if (nStart < nFrames && nStart > starts.back())
+                starts.push_back(nStart);
+        }
+        starts.push_back(nFrames);
+
+        SegmentGroup group;
+        group.nFirstSession = (mfxU32)params.size();
+        group.nSessions = (mfxU32)starts.size() - 1;
+        m_SegmentGroups.push_back(group);
+
+        msdk_printf(MSDK_STRING("Session %d: %d frames are split into %d segment(s)\n"), i, nFrames, group.nSessions);
+
+        for (mfxU32 j = 0; j < group.nSessions; j++)
+        {
+            sInputParams segment = job;
+            segment.nSegmentFirstFrame = starts[j];
+            segment.nSegmentFrames = starts[j + 1] - starts[j];
+            segment.MaxFrameNumber = MFX_INFINITE;
+
+            // the first segment writes the output, others write temporary files appended to it
+            if (j)
+            {
+                msdk_stringstream name;
+                name << job.strDstFile << MSDK_STRING(".seg") << j;
+                if (name.str().size() >= MSDK_MAX_FILENAME_LEN)
+                {
+                    PrintError(MSDK_STRING("Destination file name is too long for -segments\n"));
+                    return MFX_ERR_UNSUPPORTED;
+                }
+                msdk_strncopy_s(segment.strDstFile, MSDK_MAX_FILENAME_LEN, name.str().c_str(), MSDK_MAX_FILENAME_LEN - 1);
+                segment.strDstFile[MSDK_MAX_FILENAME_LEN - 1] = 0;
+            }
+            params.push_back(segment);
+        }
+    }
+
+    m_InputParamsArray.swap(params);
+
+    return MFX_ERR_NONE;
+} // mfxStatus Launcher::SplitSegments()
+
+void Launcher::JoinSegments()
+{
+    const mfxU32 nBufferSize = 4 * 1024 * 1024;
+    std::vector<mfxU8> buffer;
+
+    for (size_t g = 0; g < m_SegmentGroups.size(); g++)
+    {
+        const SegmentGroup& group = m_SegmentGroups[g];
+        ThreadTranscodeContext* pFirst = m_pSessionArray[group.nFirstSession];
+
+        // outputs are closed already, a segment failed to be written fails the job
+        for (mfxU32 i = group.nFirstSession; i < group.nFirstSession + group.nSessions; i++)
+        {
+            if (MFX_ERR_NONE != m_pSessionArray[i]->transcodingSts && MFX_ERR_NONE == pFirst->transcodingSts)
+                pFirst->transcodingSts = m_pSessionArray[i]->transcodingSts;
+        }
+
+        // segments of a failed job are kept for analysis
+        if (MFX_ERR_NONE != pFirst->transcodingSts)
+            continue;
+
+        FILE* pDst = NULL;
+        MSDK_FOPEN(pDst, m_InputParamsArray[group.nFirstSession].strDstFile, MSDK_STRING("ab"));
+        if (!pDst)
+        {
+            pFirst->transcodingSts = MFX_ERR_NULL_PTR;
+            continue;
+        }
+        buffer.resize(nBufferSize);
+
+        for (mfxU32 i = group.nFirstSession + 1; i < group.nFirstSession + group.nSessions && MFX_ERR_NONE == pFirst->transcodingSts; i++)
+        {
+            const msdk_char* strSegmentFile = m_InputParamsArray[i].strDstFile;
+            FILE* pSegment = NULL;
+            MSDK_FOPEN(pSegment, strSegmentFile, MSDK_STRING("rb"));
+            if (!pSegment)
+            {
+                pFirst->transcodingSts = MFX_ERR_NULL_PTR;
+                break;
+            }
+
+            size_t nRead;
+            while ((nRead = fread(&buffer[0], 1, buffer.size(), pSegment)) > 0)
+            {
+                if (fwrite(&buffer[0], 1, nRead, pDst) != nRead)
+                {
+                    pFirst->transcodingSts = MFX_ERR_UNDEFINED_BEHAVIOR;
+                    break;
+                }
+            }
+            fclose(pSegment);
+
+            if (MFX_ERR_NONE == pFirst->transcodingSts)
+                msdk_remove(strSegmentFile);
+        }
+
+        if (fclose(pDst) && MFX_ERR_NONE == pFirst->transcodingSts)
+            pFirst->transcodingSts = MFX_ERR_UNDEFINED_BEHAVIOR;
+
+        if (MFX_ERR_NONE != pFirst->transcodingSts)
+            msdk_printf(MSDK_STRING("error: failed to join segments of session %d\n"), group.nFirstSession);
+    }
+} // void Launcher::JoinSegments()
+
+void Launcher::AssignAffinity()
+{
+    std::vector<msdkCpuInfo> cpus;
+    if (MFX_ERR_NONE != msdk_thread_get_topology(cpus))
+        cpus.clear();
+
+    // logical processors of each physical core, by nodes
+    typedef std::map<mfxU32, std::vector<mfxU32> > CoreMap;
+    std::map<mfxU32, CoreMap> nodes;
+    for (size_t i = 0; i < cpus.size(); i++)
+    {
+        nodes[cpus[i].nNode][cpus[i].nCore].push_back(cpus[i].nCpu);
+    }
+
+    // cores in the order of assignment: one core of each node in turn
+    std::vector<CoreMap::iterator> nodeCores;
+    std::vector<mfxU32> nodeIds;
+    for (std::map<mfxU32, CoreMap>::iterator it = nodes.begin(); it != nodes.end(); ++it)
+    {
+        nodeCores.push_back(it->second.begin());
+        nodeIds.push_back(it->first);
+    }
+    std::vector<std::vector<mfxU32> > cores;
+    std::vector<mfxU32> coreNodes;
+    for (bool bAdded = true; bAdded; )
+    {
+        bAdded = false;
+        for (size_t j = 0; j < nodeCores.size(); j++)
+        {
+            if (nodeCores[j] != nodes[nodeIds[j]].end())
+            {
+                cores.push_back(nodeCores[j]->second);
+                coreNodes.push_back(nodeIds[j]);
+                ++nodeCores[j];
+                bAdded = true;
+            }
+        }
+    }
+
+    mfxU32 nAutoSessions = 0;
+    for (mfxU32 i = 0; i < m_InputParamsArray.size(); i++)
+    {
+        sInputParams& params = m_InputParamsArray[i];
+        if (params.bAutoAffinity)
+        {
+            if (cores.empty())
+            {
+                msdk_printf(MSDK_STRING("WARNING: automatic affinity is not supported, session %d is not bound\n"), i);
+                continue;
+            }
+            size_t core = nAutoSessions++ % cores.size();
+            params.nAffinityCPUs = (mfxU32)std::min(cores[core].size(), (size_t)MAX_AFFINITY_CPUS);
+            std::copy(cores[core].begin(), cores[core].begin() + params.nAffinityCPUs, params.AffinityCPUs);
+            if (nodes.size() > 1)
+                params.nNumaNode = coreNodes[core];
+        }
+        else if (params.nAffinityCPUs && nodes.size() > 1)
+        {
+            for (size_t j = 0; j < cpus.size(); j++)
+            {
+                if (cpus[j].nCpu == params.AffinityCPUs[0])
+                    params.nNumaNode = cpus[j].nNode;
+            }
+        }
+
+        if (params.nAffinityCPUs)
+        {
+            msdk_printf(MSDK_STRING("Session %d is bound to %d processor(s) starting from %d, NUMA node %d\n"),
+                i, params.nAffinityCPUs, params.AffinityCPUs[0], params.nNumaNode);
+        }
+    }
+} // void Launcher::AssignAffinity()
+
 mfxStatus Launcher::VerifyCrossSessionsOptions()
 {
     bool IsSinkPresence = false;
@@ -622,15 +1033,36 @@ mfxStatus Launcher::CreateSafetyBuffers()
 {
     SafetySurfaceBuffer* pBuffer     = NULL;
     SafetySurfaceBuffer* pPrevBuffer = NULL;
+    SurfaceRing*         pRing       = NULL;
+
+    // a decoding session keeps up to AsyncDepth surfaces in its ring plus the end of stream mark
+    mfxU32 nRingSize = 1;
+    mfxU32 nSources  = 0;
+    for (mfxU32 i = 0; i < m_InputParamsArray.size(); i++)
+    {
+        if (Source == m_InputParamsArray[i].eMode || Sink == m_InputParamsArray[i].eMode)
+        {
+            nRingSize = MSDK_MAX(nRingSize, m_InputParamsArray[i].nAsyncDepth);
+        }
+        if (Source == m_InputParamsArray[i].eMode)
+        {
+            nSources++;
+        }
+    }
+    nRingSize++;
 
     for (mfxU32 i = 0; i < m_InputParamsArray.size(); i++)
     {
-        /* this is for 1 to N case*/
+        /* this is for 1 to N case: all sources read one ring, each through own buffer */
         if ((Source == m_InputParamsArray[i].eMode) &&
             (Native == m_InputParamsArray[0].eModeExt))
         {
-            pBuffer = new SafetySurfaceBuffer(pPrevBuffer);
-            pPrevBuffer = pBuffer;
+            if (!pRing)
+            {
+                pRing = new SurfaceRing(nRingSize, nSources);
+                m_pRingArray.push_back(pRing);
+            }
+            pBuffer = new SafetySurfaceBuffer(pRing, (mfxU32)m_pBufferArray.size(), NULL);
             m_pBufferArray.push_back(pBuffer);
         }
 
@@ -640,7 +1072,9 @@ mfxStatus Launcher::CreateSafetyBuffers()
              ( (VppComp     == m_InputParamsArray[0].eModeExt) ||
                (VppCompOnly == m_InputParamsArray[0].eModeExt) ) )
         {
-            pBuffer = new SafetySurfaceBuffer(pPrevBuffer);
+            pRing = new SurfaceRing(nRingSize, 1);
+            m_pRingArray.push_back(pRing);
+            pBuffer = new SafetySurfaceBuffer(pRing, 0, pPrevBuffer);
             pPrevBuffer = pBuffer;
             m_pBufferArray.push_back(pBuffer);
         }
@@ -651,6 +1085,9 @@ mfxStatus Launcher::CreateSafetyBuffers()
 
 void Launcher::Close()
 {
+    // the scheduler refers to the sessions
+    m_pScheduler.reset();
+
     while(m_pSessionArray.size())
     {
         delete m_pSessionArray[m_pSessionArray.size()-1];
@@ -666,6 +1103,11 @@ void Launcher::Close()
         m_pBufferArray[m_pBufferArray.size() - 1] = NULL;
         m_pBufferArray.pop_back();
     }
+    while(m_pRingArray.size())
+    {
+        delete m_pRingArray[m_pRingArray.size()-1];
+        m_pRingArray.pop_back();
+    }
 
     while(m_pExtBSProcArray.size())
     {
@@ -0,0 +1,267 @@
+/******************************************************************************\
+Copyright (c) 2005-2016, Intel Corporation
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without modification, are permitted provided that the following conditions are met:
+
+1. Redistributions of source code must retain the above copyright notice, this list of conditions and the following disclaimer.
+
+2. Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the following disclaimer in the documentation and/or other materials provided with the distribution.
+
+3. Neither the name of the copyright holder nor the names of its contributors may be used to endorse or promote products derived from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+This sample was distributed or derived from the Intel's Media Samples package.
+The original version of this sample may be obtained from https://software.intel.com/en-us/intel-media-server-studio
+or https://software.intel.com/en-us/media-client-solutions-support.
+\**********************************************************************************/
+
+#include "mfx_samples_config.h"
+
+#include <stdio.h>
+
+#include "session_scheduler.h"
+#include "transcode_utils.h"
+
+using namespace TranscodingSample;
+
+// ms, bounds the wait for a task of one session while tasks of other sessions of the thread may complete first
+enum
+{
+    PARKED_WAIT_TIME = 5
+};
+
+CSessionScheduler::CSessionScheduler()
+    : m_nActiveTasks(0)
+    , m_pTaskAvailable(NULL)
+    , m_StartTime(0)
+{
+}
+
+CSessionScheduler::~CSessionScheduler()
+{
+    Wait();
+
+    for (size_t i = 0; i < m_Workers.size(); i++)
+    {
+        MSDK_SAFE_DELETE(m_Workers[i]->pThread);
+        MSDK_SAFE_DELETE(m_Workers[i]);
+    }
+    for (size_t i = 0; i < m_Tasks.size(); i++)
+    {
+        MSDK_SAFE_DELETE(m_Tasks[i]);
+    }
+    MSDK_SAFE_DELETE(m_pTaskAvailable);
+}
+
+void CSessionScheduler::AddSession(ThreadTranscodeContext *pContext)
+{
+    Task *pTask = new Task;
+    pTask->pContext = pContext;
+    pTask->cpu_time = 0;
+    pTask->nParkedSince = 0;
+    m_Tasks.push_back(pTask);
+}
+
+mfxStatus CSessionScheduler::Start(mfxU32 nThreads)
+{
+    if (!nThreads)
+        nThreads = msdk_thread_get_cpu_count();
+    // there is no use in threads which can't have a session
+    nThreads = std::min(nThreads, (mfxU32)m_Tasks.size());
+
+    m_StartTime = GetTick();
+    m_nActiveTasks = (mfxU32)m_Tasks.size();
+
+    for (mfxU32 i = 0; i < m_Tasks.size(); i++)
+    {
+        mfxStatus sts = m_Tasks[i]->pContext->pPipeline->StartTranscode();
+        MSDK_CHECK_RESULT(sts, MFX_ERR_NONE, sts);
+    }
+
+    mfxStatus sts = MFX_ERR_NONE;
+    m_pTaskAvailable = new MSDKEvent(sts, false, false);
+    MSDK_CHECK_RESULT(sts, MFX_ERR_NONE, sts);
+
+    m_WorkerArgs.resize(nThreads);
+    for (mfxU32 i = 0; i < nThreads; i++)
+    {
+        m_Workers.push_back(new Worker);
+        m_WorkerArgs[i].pScheduler = this;
+        m_WorkerArgs[i].nIndex = i;
+    }
+    // sessions are spread evenly, then threads balance the load themselves
+    for (mfxU32 i = 0; i < m_Tasks.size(); i++)
+    {
+        m_Workers[i % nThreads]->tasks.push_back(m_Tasks[i]);
+    }
+
+    for (mfxU32 i = 0; i < nThreads; i++)
+    {
+        m_Workers[i]->pThread = new MSDKThread(sts, WorkerRoutine, &m_WorkerArgs[i]);
+        MSDK_CHECK_RESULT(sts, MFX_ERR_NONE, sts);
+    }
+
+    return MFX_ERR_NONE;
+}
+
+void CSessionScheduler::Wait()
+{
+    for (size_t i = 0; i < m_Workers.size(); i++)
+    {
+        if (m_Workers[i]->pThread)
+        {
+            // a thread is joined once, the destructor waits again
+            m_Workers[i]->pThread->Wait();
+            MSDK_SAFE_DELETE(m_Workers[i]->pThread);
+        }
+    }
+}
+
+mfxU32 MFX_STDCALL CSessionScheduler::WorkerRoutine(void *pObj)
+{
+    WorkerArg *pArg = (WorkerArg*)pObj;
+
+    char threadName[32];
+    sprintf(threadName, "transcode w%u", pArg->nIndex);
+    msdk_thread_set_name(threadName);
+
+    pArg->pScheduler->RunWorker(pArg->nIndex);
+    return 0;
+}
+
+void CSessionScheduler::RunWorker(mfxU32 nIndex)
+{
+    Worker *pWorker = m_Workers[nIndex];
+
+    while (msdk_atomic_load32(&m_nActiveTasks))
+    {
+        Task *pTask = GetTask(nIndex);
+        if (!pTask)
+        {
+            // all sessions are being processed by other threads, wait till one can be taken
+            m_pTaskAvailable->Wait();
+            continue;
+        }
+
+        mfxF64 start = msdk_thread_get_cpu_time();
+        mfxStatus sts = pTask->pContext->pPipeline->TranscodeStep(true);
+        pTask->cpu_time += msdk_thread_get_cpu_time() - start;
+
+        if (MFX_ERR_NONE == sts)
+        {
+            pTask->nParkedSince = 0;
+            pWorker->nIdleSteps = 0;
+            PutTask(nIndex, pTask);
+            continue;
+        }
+
+        if (MFX_WRN_IN_EXECUTION == sts)
+        {
+            // the step is parked, if every session of the thread is parked too the thread waits for this one
+            bool bWait = ++pWorker->nIdleSteps > GetTaskCount(nIndex);
+            if (bWait)
+            {
+                pWorker->nIdleSteps = 0;
+            }
+            sts = WaitParked(pTask, bWait);
+        }
+
+        if (MFX_ERR_NONE == sts)
+        {
+            PutTask(nIndex, pTask);
+        }
+        else
+        {
+            FinishTask(pTask, sts);
+        }
+    }
+
+    // wake up the next thread waiting for a session, it finishes too
+    m_pTaskAvailable->Signal();
+}
+
+CSessionScheduler::Task* CSessionScheduler::GetTask(mfxU32 nIndex)
+{
+    {
+        Worker *pWorker = m_Workers[nIndex];
+        AutomaticMutex guard(pWorker->mutex);
+        if (pWorker->tasks.size())
+        {
+            Task *pTask = pWorker->tasks.front();
+            pWorker->tasks.pop_front();
+            return pTask;
+        }
+    }
+
+    for (mfxU32 i = 1; i < m_Workers.size(); i++)
+    {
+        Worker *pVictim = m_Workers[(nIndex + i) % m_Workers.size()];
+        AutomaticMutex guard(pVictim->mutex);
+        // the thread keeps at least one session to process
+        if (pVictim->tasks.size() > 1)
+        {
+            Task *pTask = pVictim->tasks.back();
+            pVictim->tasks.pop_back();
+            return pTask;
+        }
+    }
+
+    return NULL;
+}
+
+size_t CSessionScheduler::PutTask(mfxU32 nIndex, Task *pTask)
+{
+    Worker *pWorker = m_Workers[nIndex];
+    AutomaticMutex guard(pWorker->mutex);
+    pWorker->tasks.push_back(pTask);
+    if (pWorker->tasks.size() > 1)
+    {
+        // the task can be taken by a thread without sessions
+        m_pTaskAvailable->Signal();
+    }
+    return pWorker->tasks.size();
+}
+
+size_t CSessionScheduler::GetTaskCount(mfxU32 nIndex)
+{
+    Worker *pWorker = m_Workers[nIndex];
+    AutomaticMutex guard(pWorker->mutex);
+    return pWorker->tasks.size();
+}
+
+void CSessionScheduler::FinishTask(Task *pTask, mfxStatus sts)
+{
+    ThreadTranscodeContext *pContext = pTask->pContext;
+
+    MSDK_IGNORE_MFX_STS(sts, MFX_WRN_VALUE_NOT_CHANGED);
+    pContext->transcodingSts = sts;
+    pContext->working_time = GetTime(m_StartTime);
+    pContext->numTransFrames = pContext->pPipeline->GetProcessFrames();
+    pContext->busy_time = pContext->pPipeline->GetBusyTime();
+    pContext->cpu_time = pTask->cpu_time;
+
+    {
+        AutomaticMutex guard(m_mutex);
+        m_nActiveTasks--;
+    }
+    // threads without sessions finish if it was the last one
+    m_pTaskAvailable->Signal();
+}
+
+mfxStatus CSessionScheduler::WaitParked(Task *pTask, bool bWait)
+{
+    msdk_tick nNow = msdk_time_get_tick();
+    if (!pTask->nParkedSince)
+    {
+        pTask->nParkedSince = nNow;
+    }
+    else if (MSDK_GET_TIME(nNow, pTask->nParkedSince, msdk_time_get_frequency()) * 1000 > MSDK_DEVICE_FREE_WAIT_INTERVAL)
+    {
+        msdk_printf(MSDK_STRING("ERROR: Session is waiting for device (during long period)\n"));
+        return MFX_ERR_DEVICE_FAILED;
+    }
+
+    return bWait ? pTask->pContext->pPipeline->WaitStep(PARKED_WAIT_TIME) : MFX_ERR_NONE;
+}
@@ -99,6 +99,13 @@ void TranscodingSample::PrintHelp()
     msdk_printf(MSDK_STRING("  -?            Print this help and exit\n"));
     msdk_printf(MSDK_STRING("  -p <file-name>\n"));
     msdk_printf(MSDK_STRING("                Collect performance statistics in specified file\n"));
+    msdk_printf(MSDK_STRING("  -workers <N>\n"));
+    msdk_printf(MSDK_STRING("                Run sessions by a pool of N threads instead of a thread per session,\n"));
+    msdk_printf(MSDK_STRING("                0 - thread per logical processor. Sessions with -affinity, -fps or\n"));
+    msdk_printf(MSDK_STRING("                exchanging surfaces with other sessions still run by own threads\n"));
+    msdk_printf(MSDK_STRING("  -report <file-name>\n"));
+    msdk_printf(MSDK_STRING("                Write per session performance report in specified file,\n"));
+    msdk_printf(MSDK_STRING("                in CSV format if file name ends with .csv, in JSON format otherwise\n"));
     msdk_printf(MSDK_STRING("  -timeout <seconds>\n"));
     msdk_printf(MSDK_STRING("                Set time to run transcoding in seconds\n"));
     msdk_printf(MSDK_STRING("  -greedy \n"));
@@ -123,6 +130,18 @@ void TranscodingSample::PrintHelp()
     msdk_printf(MSDK_STRING("  -sys          Force usage of external system allocator\n"));
     msdk_printf(MSDK_STRING("  -fps <frames per second>\n"));
     msdk_printf(MSDK_STRING("                Transcoding frame rate limit\n"));
+    msdk_printf(MSDK_STRING("  -write_behind <num>\n"));
+    msdk_printf(MSDK_STRING("                Collect output in num 4MB buffers which are written to file by a separate thread\n"));
+    msdk_printf(MSDK_STRING("  -direct_io    Together with -write_behind, write output bypassing page cache (Linux only)\n"));
+    msdk_printf(MSDK_STRING("  -complete_frame\n"));
+    msdk_printf(MSDK_STRING("                Split H.264 or H.265 input into access units and pass complete frames to decoder\n"));
+    msdk_printf(MSDK_STRING("  -segments <N>\n"));
+    msdk_printf(MSDK_STRING("                Split H.264, VP8 or JPEG input at key frames into N segments transcoded by parallel\n"));
+    msdk_printf(MSDK_STRING("                sessions and join their outputs. The input is indexed to <file-name>.idx\n"));
+    msdk_printf(MSDK_STRING("  -affinity <cpu-list|auto>\n"));
+    msdk_printf(MSDK_STRING("                Bind session thread to logical processors, like 0-3,8. System memory surfaces\n"));
+    msdk_printf(MSDK_STRING("                are placed on NUMA node of the first processor. auto binds sessions to physical\n"));
+    msdk_printf(MSDK_STRING("                cores in turn, taking cores from different NUMA nodes one after another\n"));
     msdk_printf(MSDK_STRING("  -pe           Set encoding plugin for this particular session.\n"));
     msdk_printf(MSDK_STRING("                This setting overrides plugin settings defined by SET clause.\n"));
     msdk_printf(MSDK_STRING("  -pd           Set decoding plugin for this particular session.\n"));
@@ -175,7 +194,9 @@ void TranscodingSample::PrintHelp()
     msdk_printf(MSDK_STRING("  -ec::nv12|rgb4|yuy2|nv16|p010|p210   Forces encoder input to use provided chroma mode\n"));
     msdk_printf(MSDK_STRING("  -dc::nv12|rgb4|yuy2   Forces decoder output to use provided chroma mode\n"));
     msdk_printf(MSDK_STRING("     NOTE: chroma transform VPP may be automatically enabled if -ec/-dc parameters are provided\n"));
-    msdk_printf(MSDK_STRING("  -angle 180    Enables 180 degrees picture rotation user module before encoding\n"));
+    msdk_printf(MSDK_STRING("  -angle 90|180|270 Enables clockwise picture rotation user module before encoding\n"));
+    msdk_printf(MSDK_STRING("                Width and height are swapped for 90 and 270 degrees\n"));
+    msdk_printf(MSDK_STRING("  -mirror h|v   Enables horizontal or vertical picture mirroring by rotation user module, applied before rotation\n"));
     msdk_printf(MSDK_STRING("  -opencl       Uses implementation of rotation plugin (enabled with -angle option) through Intel(R) OpenCL\n"));
     msdk_printf(MSDK_STRING("  -w            Destination picture width, invokes VPP resize\n"));
     msdk_printf(MSDK_STRING("  -h            Destination picture height, invokes VPP resize\n"));
@@ -277,6 +298,10 @@ CmdProcessor::CmdProcessor()
     m_decoderPlugins.clear();
     m_encoderPlugins.clear();
     m_PerfFILE = NULL;
+    m_ReportFILE = NULL;
+    m_bReportCSV = false;
+    m_bSchedulerMode = false;
+    m_nWorkerThreads = 0;
     m_parName = NULL;
     m_nTimeout = 0;
     statisticsWindowSize = 0;
@@ -291,6 +316,8 @@ CmdProcessor::~CmdProcessor()
     m_encoderPlugins.clear();
     if (m_PerfFILE)
         fclose(m_PerfFILE);
+    if (m_ReportFILE)
+        fclose(m_ReportFILE);
 
 } //CmdProcessor::~CmdProcessor()
 
@@ -373,6 +400,39 @@ mfxStatus CmdProcessor::ParseCmdLine(int argc, msdk_char *argv[])
                 return MFX_ERR_UNSUPPORTED;
             }
         }
+        else if (0 == msdk_strcmp(argv[0], MSDK_STRING("-workers")))
+        {
+            --argc;
+            ++argv;
+            if (!argv[0] || MFX_ERR_NONE != msdk_opt_read(argv[0], m_nWorkerThreads))
+            {
+                msdk_printf(MSDK_STRING("error: -workers requires number of threads\n"));
+                return MFX_ERR_UNSUPPORTED;
+            }
+            m_bSchedulerMode = true;
+        }
+        else if (0 == msdk_strcmp(argv[0], MSDK_STRING("-report")))
+        {
+            if (m_ReportFILE)
+            {
+                msdk_printf(MSDK_STRING("error: only one report file is supported"));
+                return MFX_ERR_UNSUPPORTED;
+            }
+            --argc;
+            ++argv;
+            if (!argv[0]) {
+                msdk_printf(MSDK_STRING("error: no argument given for '-report' option\n"));
+                return MFX_ERR_UNSUPPORTED;
+            }
+            size_t len = msdk_strlen(argv[0]);
+            m_bReportCSV = len >= 4 && 0 == msdk_stricmp(argv[0] + len - 4, MSDK_STRING(".csv"));
+            MSDK_FOPEN(m_ReportFILE, argv[0], MSDK_STRING("w"));
+            if (NULL == m_ReportFILE)
+            {
+                msdk_printf(MSDK_STRING("error: report file \"%s\" can't be created"), argv[0]);
+                return MFX_ERR_UNSUPPORTED;
+            }
+        }
         else if (0 == msdk_strcmp(argv[0], MSDK_STRING("--")))
         {
             // just skip separator "--" which delimits cmd options and pipeline settings
@@ -536,6 +596,40 @@ mfxStatus CmdProcessor::TokenizeLine(msdk_char *pLine, mfxU32 length)
     return ParseParamsForOneSession(argc, argv);
 }
 
+// parses list of logical processors like "0-3,8"
+static mfxStatus ParseCpuList(const msdk_char* strList, TranscodingSample::sInputParams& InputParams)
+{
+    InputParams.nAffinityCPUs = 0;
+    const msdk_char* str = strList;
+    for (;;)
+    {
+        msdk_char* end = NULL;
+        long first = msdk_strtol(str, &end, 10);
+        long last = first;
+        if (end == str || first < 0)
+            return MFX_ERR_UNSUPPORTED;
+        str = end;
+        if (*str == MSDK_CHAR('-'))
+        {
+            last = msdk_strtol(str + 1, &end, 10);
+            if (end == str + 1 || last < first)
+                return MFX_ERR_UNSUPPORTED;
+            str = end;
+        }
+        for (long cpu = first; cpu <= last; cpu++)
+        {
+            if (InputParams.nAffinityCPUs == MAX_AFFINITY_CPUS)
+                return MFX_ERR_UNSUPPORTED;
+            InputParams.AffinityCPUs[InputParams.nAffinityCPUs++] = (mfxU32)cpu;
+        }
+        if (!*str)
+            return MFX_ERR_NONE;
+        if (*str != MSDK_CHAR(','))
+            return MFX_ERR_UNSUPPORTED;
+        str++;
+    }
+}
+
 mfxStatus CmdProcessor::ParseParamsForOneSession(mfxU32 argc, msdk_char *argv[])
 {
     mfxStatus sts = MFX_ERR_NONE;
@@ -550,6 +644,7 @@ mfxStatus CmdProcessor::ParseParamsForOneSession(mfxU32 argc, msdk_char *argv[])
     InputParams.shouldUseGreedyFormula = shouldUseGreedyFormula;
 
     InputParams.statisticsWindowSize = statisticsWindowSize;
+    InputParams.bPerfReport = (NULL != m_ReportFILE);
 
     if (0 == msdk_strcmp(argv[0], MSDK_STRING("set")))
     {
@@ -664,6 +759,48 @@ mfxStatus CmdProcessor::ParseParamsForOneSession(mfxU32 argc, msdk_char *argv[])
         {
             InputParams.bIsPerf = true;
         }
+        else if (0 == msdk_strcmp(argv[i], MSDK_STRING("-write_behind")))
+        {
+            VAL_CHECK(i+1 == argc, i, argv[i]);
+            i++;
+            if (MFX_ERR_NONE != msdk_opt_read(argv[i], InputParams.nWriteBehindBuffers))
+            {
+                PrintError(MSDK_STRING("-write_behind %s is invalid"), argv[i]);
+                return MFX_ERR_UNSUPPORTED;
+            }
+        }
+        else if (0 == msdk_strcmp(argv[i], MSDK_STRING("-direct_io")))
+        {
+            InputParams.bDirectIO = true;
+        }
+        else if (0 == msdk_strcmp(argv[i], MSDK_STRING("-complete_frame")))
+        {
+            InputParams.bCompleteFrame = true;
+        }
+        else if (0 == msdk_strcmp(argv[i], MSDK_STRING("-segments")))
+        {
+            VAL_CHECK(i+1 == argc, i, argv[i]);
+            i++;
+            if (MFX_ERR_NONE != msdk_opt_read(argv[i], InputParams.nSegments))
+            {
+                PrintError(MSDK_STRING("-segments %s is invalid"), argv[i]);
+                return MFX_ERR_UNSUPPORTED;
+            }
+        }
+        else if (0 == msdk_strcmp(argv[i], MSDK_STRING("-affinity")))
+        {
+            VAL_CHECK(i+1 == argc, i, argv[i]);
+            i++;
+            if (0 == msdk_strcmp(argv[i], MSDK_STRING("auto")))
+            {
+                InputParams.bAutoAffinity = true;
+            }
+            else if (MFX_ERR_NONE != ParseCpuList(argv[i], InputParams))
+            {
+                PrintError(MSDK_STRING("-affinity %s is invalid"), argv[i]);
+                return MFX_ERR_UNSUPPORTED;
+            }
+        }
         else if (0 == msdk_strcmp(argv[i], MSDK_STRING("-threads")))
         {
             VAL_CHECK(i+1 == argc, i, argv[i]);
@@ -1047,6 +1184,27 @@ mfxStatus CmdProcessor::ParseParamsForOneSession(mfxU32 argc, msdk_char *argv[])
             skipped+=2;
         }
 
+        else if (0 == msdk_strcmp(argv[i], MSDK_STRING("-mirror")))
+        {
+            VAL_CHECK(i+1 == argc, i, argv[i]);
+            i++;
+            if (0 == msdk_strcmp(argv[i], MSDK_STRING("h")))
+            {
+                InputParams.nMirror = 1;
+            }
+            else if (0 == msdk_strcmp(argv[i], MSDK_STRING("v")))
+            {
+                InputParams.nMirror = 2;
+            }
+            else
+            {
+                PrintError(MSDK_STRING("-mirror %s is invalid"), argv[i]);
+                return MFX_ERR_UNSUPPORTED;
+            }
+            if (InputParams.strVPPPluginDLLPath[0] == '\0') {
+                msdk_opt_read(MSDK_CPU_ROTATE_PLUGIN, InputParams.strVPPPluginDLLPath);
+            }
+        }
         else if (0 == msdk_strcmp(argv[i], MSDK_STRING("-opencl")))
         {
             msdk_opt_read(MSDK_OCL_ROTATE_PLUGIN, InputParams.strVPPPluginDLLPath);
@@ -1276,6 +1434,21 @@ mfxStatus CmdProcessor::VerifyAndCorrectInputParams(TranscodingSample::sInputPar
         return MFX_ERR_UNSUPPORTED;
     }
 
+    if (InputParams.nSegments > 1 &&
+        (Native != InputParams.eMode || Native != InputParams.eModeExt || !CBitstreamIndex::IsCodecSupported(InputParams.DecodeId) ||
+         InputParams.bIsMVC))
+    {
+        PrintError(MSDK_STRING("-segments is supported only for file to file transcoding of H.264 (not MVC), VP8 and JPEG streams\n"));
+        return MFX_ERR_UNSUPPORTED;
+    }
+
+    if (InputParams.bCompleteFrame &&
+        ((MFX_CODEC_AVC != InputParams.DecodeId && MFX_CODEC_HEVC != InputParams.DecodeId) || InputParams.bIsMVC))
+    {
+        PrintError(MSDK_STRING("-complete_frame is supported only for H.264 and H.265 input\n"));
+        return MFX_ERR_UNSUPPORTED;
+    }
+
     if(InputParams.dEncoderFrameRate && InputParams.bEnableExtLA)
     {
         PrintError(MSDK_STRING("-la_ext and -fe options cannot be used together\n"));
@@ -1288,6 +1461,12 @@ mfxStatus CmdProcessor::VerifyAndCorrectInputParams(TranscodingSample::sInputPar
         return MFX_ERR_UNSUPPORTED;
     }
 
+    if (InputParams.bOpenCL && ((InputParams.nRotationAngle && InputParams.nRotationAngle != 180) || InputParams.nMirror))
+    {
+        PrintError(MSDK_STRING("-opencl supports only 180 degrees rotation, -mirror is not supported\n"));
+        return MFX_ERR_UNSUPPORTED;
+    }
+
     if ((InputParams.nTargetUsage || InputParams.nBitRate) && (MFX_CODEC_JPEG == InputParams.EncodeId))
     {
         PrintError(MSDK_STRING("-b and -u options are supported only for H.264, MPEG2 and MVC encoders. For JPEG encoder use -q\n"));
@@ -32,6 +32,8 @@ typedef struct {
     mfxU32 EndLine;
 } DataChunk;
 
+// Processes a frame by bands of lines (chunks), chunks of one frame may be processed
+// by different threads simultaneously. Each chunk reads and writes surfaces directly.
 class Processor
 {
 public:
@@ -45,23 +47,37 @@ protected:
     //locks frame or report of an error
     mfxStatus LockFrame(mfxFrameSurface1 *frame);
     mfxStatus UnlockFrame(mfxFrameSurface1 *frame);
+    // locks both frames once for all chunks, they are unlocked in destructor
+    mfxStatus LockFrames();
+    mfxStatus UnlockFrames();
 
     mfxFrameSurface1  *m_pIn;
     mfxFrameSurface1  *m_pOut;
     mfxFrameAllocator *m_pAlloc;
 
-    std::vector<mfxU8> m_YIn, m_UVIn;
-    std::vector<mfxU8> m_YOut, m_UVOut;
-
+    MSDKMutex m_mutex; // protects m_bLocked
+    bool m_bLocked;
 };
 
-class Rotator180 : public Processor
+// Rotates by a multiple of 90 degrees and/or mirrors a frame. Any of these transforms is
+// an optional transposition followed by horizontal and/or vertical flips of the result.
+// Chunks are bands of output lines.
+class Rotator : public Processor
 {
 public:
-    Rotator180();
-    virtual ~Rotator180();
+    Rotator(const RotateParam &param);
+    virtual ~Rotator();
 
     virtual mfxStatus Process(DataChunk *chunk);
+
+protected:
+    // transforms lines [start, end) of the output plane, w and h are input plane sizes in elements
+    void ProcessPlane(const mfxU8 *src, mfxU32 src_pitch, mfxU32 w, mfxU32 h,
+                      mfxU8 *dst, mfxU32 dst_pitch, mfxU32 elem_size, mfxU32 start, mfxU32 end);
+
+    bool m_bTranspose;
+    bool m_bFlipX;
+    bool m_bFlipY;
 };
 
 typedef struct {
@@ -22,9 +22,17 @@ or https://software.intel.com/en-us/media-client-solutions-support.
 
 #include "mfxdefs.h"
 
+enum
+{
+    ROTATE_MIRROR_NONE       = 0,
+    ROTATE_MIRROR_HORIZONTAL = 1, // left and right sides are swapped
+    ROTATE_MIRROR_VERTICAL   = 2  // top and bottom are swapped
+};
+
 struct RotateParam
 {
-    mfxU16   Angle;  // rotation angle
+    mfxU16   Angle;  // clockwise rotation angle: 0, 90, 180 or 270
+    mfxU16   Mirror; // one of ROTATE_MIRROR_*, applied before rotation
 };
 
 #endif // __MFX_PLUGIN_ROTATE_API_H__
@@ -20,14 +20,13 @@ or https://software.intel.com/en-us/media-client-solutions-support.
 #include "mfx_samples_config.h"
 
 #include <stdio.h>
+#include <tmmintrin.h>
 #include "plugin_rotate.h"
 
 // disable "unreferenced formal parameter" warning -
 // not all formal parameters of interface functions will be used by sample plugin
 #pragma warning(disable : 4100)
 
-#define SWAP_BYTES(a, b) {mfxU8 tmp; tmp = a; a = b; b = tmp;}
-
 //defining module template for generic plugin
 #include "mfx_plugin_module.h"
 PluginModuleTemplate g_PluginModule = {
@@ -37,6 +36,9 @@ PluginModuleTemplate g_PluginModule = {
     NULL
 };
 
+// upper limit of bands a frame is split into
+#define MAX_ROTATE_THREADS 16
+
 /* Rotate class implementation */
 Rotate::Rotate() :
     m_bInited(false),
@@ -50,8 +52,9 @@ Rotate::Rotate() :
     memset(&m_Param, 0, sizeof(m_Param));
 
     memset(&m_PluginParam, 0, sizeof(m_PluginParam));
-    m_PluginParam.MaxThreadNum = 1;
-    m_PluginParam.ThreadPolicy = MFX_THREADPOLICY_SERIAL;
+    // frame is split into bands processed in parallel, one band per CPU
+    m_PluginParam.MaxThreadNum = (mfxU16)MSDK_MIN(msdk_thread_get_cpu_count(), (mfxU32)MAX_ROTATE_THREADS);
+    m_PluginParam.ThreadPolicy = MFX_THREADPOLICY_PARALLEL;
 }
 
 Rotate::~Rotate()
@@ -130,15 +133,9 @@ mfxStatus Rotate::Submit(const mfxHDL *in, mfxU32 in_num, const mfxHDL *out, mfx
     m_pTasks[ind].Out = real_surface_out;
     m_pTasks[ind].bBusy = true;
 
-    switch (m_Param.Angle)
-    {
-    case 180:
-        m_pTasks[ind].pProcessor = new Rotator180;
-        MSDK_CHECK_POINTER(m_pTasks[ind].pProcessor, MFX_ERR_MEMORY_ALLOC);
-        break;
-    default:
-        return MFX_ERR_UNSUPPORTED;
-    }
+    // parameters were validated in SetAuxParams
+    m_pTasks[ind].pProcessor = new Rotator(m_Param);
+    MSDK_CHECK_POINTER(m_pTasks[ind].pProcessor, MFX_ERR_MEMORY_ALLOC);
 
     m_pTasks[ind].pProcessor->SetAllocator(&m_mfxCore.FrameAllocator());
     m_pTasks[ind].pProcessor->Init(real_surface_in, real_surface_out);
@@ -231,19 +228,20 @@ mfxStatus Rotate::Init(mfxVideoParam *mfxParam)
     MSDK_CHECK_POINTER(m_pTasks, MFX_ERR_MEMORY_ALLOC);
     memset(m_pTasks, 0, sizeof(RotateTask) * m_MaxNumTasks);
 
-    m_NumChunks = m_PluginParam.MaxThreadNum;
+    // every chunk has at least one output line
+    m_NumChunks = MSDK_MAX(MSDK_MIN((mfxU32)m_PluginParam.MaxThreadNum, (mfxU32)mfxParam->vpp.Out.CropH), 1u);
     m_pChunks = new DataChunk [m_NumChunks];
     MSDK_CHECK_POINTER(m_pChunks, MFX_ERR_MEMORY_ALLOC);
     memset(m_pChunks, 0, sizeof(DataChunk) * m_NumChunks);
 
-    // divide frame into data chunks
-    mfxU32 num_lines_in_chunk = mfxParam->vpp.In.CropH / m_NumChunks; // integer division
-    mfxU32 remainder_lines = mfxParam->vpp.In.CropH % m_NumChunks; // get remainder
+    // divide output frame into data chunks, output size differs from input one for 90 and 270 degrees
+    mfxU32 num_lines_in_chunk = mfxParam->vpp.Out.CropH / m_NumChunks; // integer division
+    mfxU32 remainder_lines = mfxParam->vpp.Out.CropH % m_NumChunks; // get remainder
     // remaining lines are distributed among first chunks (+ extra 1 line each)
     for (mfxU32 i = 0; i < m_NumChunks; i++)
     {
         m_pChunks[i].StartLine = (i == 0) ? 0 : m_pChunks[i-1].EndLine + 1;
-        m_pChunks[i].EndLine = (i < remainder_lines) ? (i + 1) * num_lines_in_chunk : (i + 1) * num_lines_in_chunk - 1;
+        m_pChunks[i].EndLine = m_pChunks[i].StartLine + num_lines_in_chunk + ((i < remainder_lines) ? 1 : 0) - 1;
     }
 
     m_bInited = true;
@@ -253,13 +251,18 @@ mfxStatus Rotate::Init(mfxVideoParam *mfxParam)
 
 mfxStatus Rotate::SetAuxParams(void* auxParam, int auxParamSize)
 {
-    RotateParam *pRotatePar = (RotateParam *)auxParam;
-    MSDK_CHECK_POINTER(pRotatePar, MFX_ERR_NULL_PTR);
+    MSDK_CHECK_POINTER(auxParam, MFX_ERR_NULL_PTR);
+    MSDK_CHECK_ERROR(auxParamSize < (int)sizeof(mfxU16), true, MFX_ERR_INVALID_VIDEO_PARAM);
+
+    // applications built against older RotateParam pass the angle only
+    RotateParam par;
+    memset(&par, 0, sizeof(par));
+    MSDK_MEMCPY_VAR(par, auxParam, MSDK_MIN((size_t)auxParamSize, sizeof(par)));
 
     // check validity of parameters
-    mfxStatus sts = CheckParam(&m_VideoParam, pRotatePar);
+    mfxStatus sts = CheckParam(&m_VideoParam, &par);
     MSDK_CHECK_RESULT(sts, MFX_ERR_NONE, sts);
-    m_Param = *pRotatePar;
+    m_Param = par;
     return MFX_ERR_NONE;
 }
 
@@ -341,15 +344,33 @@ mfxU32 Rotate::FindFreeTaskIdx()
 mfxStatus Rotate::CheckParam(mfxVideoParam *mfxParam, RotateParam *pRotatePar)
 {
     MSDK_CHECK_POINTER(mfxParam, MFX_ERR_NULL_PTR);
+    MSDK_CHECK_POINTER(pRotatePar, MFX_ERR_NULL_PTR);
 
     mfxInfoVPP *pParam = &mfxParam->vpp;
 
-    // only NV12 color format is supported
-    if (MFX_FOURCC_NV12 != pParam->In.FourCC || MFX_FOURCC_NV12 != pParam->Out.FourCC)
+    // NV12, P010 and RGB4 color formats are supported, no color conversion
+    if (pParam->In.FourCC != pParam->Out.FourCC ||
+        (MFX_FOURCC_NV12 != pParam->In.FourCC && MFX_FOURCC_P010 != pParam->In.FourCC && MFX_FOURCC_RGB4 != pParam->In.FourCC))
     {
         return MFX_ERR_UNSUPPORTED;
     }
 
+    if ((pRotatePar->Angle != 0 && pRotatePar->Angle != 90 && pRotatePar->Angle != 180 && pRotatePar->Angle != 270) ||
+        pRotatePar->Mirror > ROTATE_MIRROR_VERTICAL)
+    {
+        return MFX_ERR_UNSUPPORTED;
+    }
+
+    // width and height are swapped by 90 and 270 degrees rotation
+    bool bTranspose = (90 == pRotatePar->Angle || 270 == pRotatePar->Angle);
+    mfxU16 out_w = bTranspose ? pParam->In.CropH : pParam->In.CropW;
+    mfxU16 out_h = bTranspose ? pParam->In.CropW : pParam->In.CropH;
+
+    if (pParam->Out.CropW != out_w || pParam->Out.CropH != out_h)
+    {
+        return MFX_ERR_INVALID_VIDEO_PARAM;
+    }
+
     return MFX_ERR_NONE;
 }
 
@@ -374,11 +395,13 @@ Processor::Processor()
     : m_pIn(NULL)
     , m_pOut(NULL)
     , m_pAlloc(NULL)
+    , m_bLocked(false)
 {
 }
 
 Processor::~Processor()
 {
+    UnlockFrames();
 }
 
 mfxStatus Processor::SetAllocator(mfxFrameAllocator *pAlloc)
@@ -426,95 +449,292 @@ mfxStatus Processor::UnlockFrame(mfxFrameSurface1 *frame)
     return m_pAlloc->Unlock(m_pAlloc->pthis, frame->Data.MemId, &frame->Data);
 }
 
+mfxStatus Processor::LockFrames()
+{
+    AutomaticMutex guard(m_mutex);
+
+    // the first chunk locks frames for the others
+    if (m_bLocked)
+        return MFX_ERR_NONE;
 
-/* 180 degrees rotator class implementation */
-Rotator180::Rotator180() : Processor()
+    mfxStatus sts = LockFrame(m_pIn);
+    MSDK_CHECK_RESULT(sts, MFX_ERR_NONE, sts);
+
+    sts = LockFrame(m_pOut);
+    MSDK_CHECK_RESULT_SAFE(sts, MFX_ERR_NONE, sts, UnlockFrame(m_pIn));
+
+    m_bLocked = true;
+    return MFX_ERR_NONE;
+}
+
+mfxStatus Processor::UnlockFrames()
 {
+    AutomaticMutex guard(m_mutex);
+
+    if (!m_bLocked)
+        return MFX_ERR_NONE;
+
+    m_bLocked = false;
+
+    mfxStatus sts = UnlockFrame(m_pIn);
+    mfxStatus sts_out = UnlockFrame(m_pOut);
+
+    return (MFX_ERR_NONE != sts) ? sts : sts_out;
 }
 
-Rotator180::~Rotator180()
+
+/* Rotator class implementation */
+Rotator::Rotator(const RotateParam &param) : Processor()
 {
+    // mirroring is applied first, it flips the image as is
+    m_bTranspose = false;
+    m_bFlipX = (ROTATE_MIRROR_HORIZONTAL == param.Mirror);
+    m_bFlipY = (ROTATE_MIRROR_VERTICAL == param.Mirror);
+
+    // each clockwise rotation by 90 degrees transposes the image and flips it horizontally,
+    // transposition of a flipped image is the transposed image flipped in the other direction
+    for (mfxU32 i = 0; i < param.Angle / 90u; i++)
+    {
+        bool bFlipX = !m_bFlipY;
+        m_bFlipY = m_bFlipX;
+        m_bFlipX = bFlipX;
+        m_bTranspose = !m_bTranspose;
+    }
 }
 
-mfxStatus Rotator180::Process(DataChunk *chunk)
+Rotator::~Rotator()
 {
-    MSDK_CHECK_POINTER(chunk, MFX_ERR_NULL_PTR);
+}
 
-    mfxStatus sts = MFX_ERR_NONE;
-    if (MFX_ERR_NONE != (sts = LockFrame(m_pIn)))return sts;
-    if (MFX_ERR_NONE != (sts = LockFrame(m_pOut)))
+// returns shuffle mask which reverses order of elem_size byte elements in a register
+static __m128i GetReverseMask(mfxU32 elem_size)
+{
+    switch (elem_size)
     {
-        UnlockFrame(m_pIn);
-        return sts;
+    case 1:
+        return _mm_setr_epi8(15, 14, 13, 12, 11, 10, 9, 8, 7, 6, 5, 4, 3, 2, 1, 0);
+    case 2:
+        return _mm_setr_epi8(14, 15, 12, 13, 10, 11, 8, 9, 6, 7, 4, 5, 2, 3, 0, 1);
+    default:
+        return _mm_setr_epi8(12, 13, 14, 15, 8, 9, 10, 11, 4, 5, 6, 7, 0, 1, 2, 3);
     }
+}
 
-    mfxU32 i, j, in_pitch, out_pitch, h, w;
+// writes nCount elements of src to dst in reverse order
+static void ReverseElements(const mfxU8 *src, mfxU8 *dst, mfxU32 nCount, mfxU32 elem_size)
+{
+    const __m128i mask = GetReverseMask(elem_size);
+    mfxU32 nBytes = nCount * elem_size;
+    mfxU32 i = 0;
 
-    in_pitch = m_pIn->Data.Pitch;
-    out_pitch = m_pOut->Data.Pitch;
-    h = m_pIn->Info.CropH;
-    w = m_pIn->Info.CropW;
+    for (; i + 16 <= nBytes; i += 16)
+    {
+        __m128i x = _mm_loadu_si128((const __m128i *)(src + i));
+        _mm_storeu_si128((__m128i *)(dst + nBytes - 16 - i), _mm_shuffle_epi8(x, mask));
+    }
+    for (; i < nBytes; i += elem_size)
+    {
+        memcpy(dst + nBytes - elem_size - i, src + i, elem_size);
+    }
+}
 
-    m_YIn.assign(m_pIn->Data.Y, m_pIn->Data.Y + h * in_pitch);
-    m_UVIn.assign(m_pIn->Data.UV, m_pIn->Data.UV + h * in_pitch / 2);
+// interleaves units of u bytes taken from the low (high) halves of a and b
+static inline __m128i UnpackLo(__m128i a, __m128i b, mfxU32 u)
+{
+    switch (u)
+    {
+    case 1:  return _mm_unpacklo_epi8(a, b);
+    case 2:  return _mm_unpacklo_epi16(a, b);
+    case 4:  return _mm_unpacklo_epi32(a, b);
+    default: return _mm_unpacklo_epi64(a, b);
+    }
+}
 
-    m_YOut.resize(m_pOut->Info.Height * out_pitch);
-    m_UVOut.resize(m_pOut->Info.Height * out_pitch / 2);
+static inline __m128i UnpackHi(__m128i a, __m128i b, mfxU32 u)
+{
+    switch (u)
+    {
+    case 1:  return _mm_unpackhi_epi8(a, b);
+    case 2:  return _mm_unpackhi_epi16(a, b);
+    case 4:  return _mm_unpackhi_epi32(a, b);
+    default: return _mm_unpackhi_epi64(a, b);
+    }
+}
+
+// Transposes a square tile of N = 16 / E elements of E bytes held in N registers.
+// log2(N) interleaving passes transpose the tile with bit-reversed order of elements
+// within output rows, so input rows are expected in bit-reversed order.
+template <mfxU32 E>
+static inline void TransposeTile(__m128i *r)
+{
+    const mfxU32 N = 16 / E;
+    __m128i t[N];
+
+    for (mfxU32 u = E; u < 16; u *= 2)
+    {
+        for (mfxU32 i = 0; i < N / 2; i++)
+        {
+            t[2 * i]     = UnpackLo(r[i], r[i + N / 2], u);
+            t[2 * i + 1] = UnpackHi(r[i], r[i + N / 2], u);
+        }
+        for (mfxU32 i = 0; i < N; i++)
+        {
+            r[i] = t[i];
+        }
+    }
+}
+
+static const mfxU8 g_BitReverse16[16] = { 0, 8, 4, 12, 2, 10, 6, 14, 1, 9, 5, 13, 3, 11, 7, 15 };
+static const mfxU8 g_BitReverse8[8]   = { 0, 4, 2, 6, 1, 5, 3, 7 };
+static const mfxU8 g_BitReverse4[4]   = { 0, 2, 1, 3 };
+
+// Processes output lines [start, end) of a transposed and flipped plane by tiles fitting
+// into registers, so every input line is read 16 bytes at a time and stays in cache
+// while the tile row is processed. Borders not covering a whole tile are copied by elements.
+template <mfxU32 E>
+static void TransposePlane(const mfxU8 *src, mfxU32 src_pitch, mfxU32 w, mfxU32 h,
+                           mfxU8 *dst, mfxU32 dst_pitch, mfxU32 start, mfxU32 end,
+                           bool bFlipX, bool bFlipY)
+{
+    const mfxU32 N = 16 / E;
+    const mfxU8 *order = (16 == N) ? g_BitReverse16 : (8 == N) ? g_BitReverse8 : g_BitReverse4;
+    const __m128i mask = GetReverseMask(E);
+    // output line is an input column
+    const mfxU32 out_w = h;
+    const mfxU32 out_h = w;
+    __m128i r[N];
+    mfxU32 x, y, i;
+
+    for (y = start; y < end; y += N)
+    {
+        mfxU32 lines = MSDK_MIN(N, end - y);
+        x = 0;
+
+        if (N == lines)
+        {
+            // tile of transposed (not yet flipped) image: lines are input columns starting from col,
+            // columns are input lines starting from row
+            mfxU32 col = bFlipY ? out_h - y - N : y;
+
+            for (; x + N <= out_w; x += N)
+            {
+                mfxU32 row = bFlipX ? out_w - x - N : x;
+
+                for (i = 0; i < N; i++)
+                {
+                    r[i] = _mm_loadu_si128((const __m128i *)(src + (row + order[i]) * src_pitch + col * E));
+                }
+
+                TransposeTile<E>(r);
+
+                for (i = 0; i < N; i++)
+                {
+                    __m128i line = bFlipX ? _mm_shuffle_epi8(r[i], mask) : r[i];
+                    mfxU32 out_y = bFlipY ? y + N - 1 - i : y + i;
+                    _mm_storeu_si128((__m128i *)(dst + out_y * dst_pitch + x * E), line);
+                }
+            }
+        }
 
-    sts = UnlockFrame(m_pIn);
-    MSDK_CHECK_RESULT(MFX_ERR_NONE, sts, MFX_ERR_NONE);
-    sts = UnlockFrame(m_pOut);
-    MSDK_CHECK_RESULT(MFX_ERR_NONE, sts, MFX_ERR_NONE);
+        // right border and bottom lines of the band
+        for (i = y; i < y + lines; i++)
+        {
+            mfxU32 in_x = bFlipY ? out_h - 1 - i : i;
 
-    mfxU8 *in_luma = &m_YIn.front() + m_pIn->Info.CropY * in_pitch + m_pIn->Info.CropX;
-    mfxU8 *out_luma = &m_YOut.front() + m_pOut->Info.CropY * out_pitch + m_pOut->Info.CropX;
+            for (mfxU32 j = x; j < out_w; j++)
+            {
+                mfxU32 in_y = bFlipX ? out_w - 1 - j : j;
+                memcpy(dst + i * dst_pitch + j * E, src + in_y * src_pitch + in_x * E, E);
+            }
+        }
+    }
+}
 
-    mfxU8 *in_chroma = &m_UVIn.front() + m_pIn->Info.CropY / 2 * in_pitch + m_pIn->Info.CropX;
-    mfxU8 *out_chroma = &m_UVOut.front() + m_pOut->Info.CropY / 2 * out_pitch + m_pOut->Info.CropX;
+void Rotator::ProcessPlane(const mfxU8 *src, mfxU32 src_pitch, mfxU32 w, mfxU32 h,
+                           mfxU8 *dst, mfxU32 dst_pitch, mfxU32 elem_size, mfxU32 start, mfxU32 end)
+{
+    if (m_bTranspose)
+    {
+        switch (elem_size)
+        {
+        case 1:
+            TransposePlane<1>(src, src_pitch, w, h, dst, dst_pitch, start, end, m_bFlipX, m_bFlipY);
+            break;
+        case 2:
+            TransposePlane<2>(src, src_pitch, w, h, dst, dst_pitch, start, end, m_bFlipX, m_bFlipY);
+            break;
+        default:
+            TransposePlane<4>(src, src_pitch, w, h, dst, dst_pitch, start, end, m_bFlipX, m_bFlipY);
+            break;
+        }
+        return;
+    }
 
-    mfxU8 *cur_line = 0; // current line in the destination image
+    // i-th line images into i-th or h-1-i-th line, elements are copied or mirrored
+    for (mfxU32 i = start; i < end; i++)
+    {
+        const mfxU8 *in_line = src + (m_bFlipY ? h - 1 - i : i) * src_pitch;
+        mfxU8 *out_line = dst + i * dst_pitch;
+
+        if (m_bFlipX)
+            ReverseElements(in_line, out_line, w, elem_size);
+        else
+            memcpy(out_line, in_line, w * elem_size);
+    }
+}
+
+mfxStatus Rotator::Process(DataChunk *chunk)
+{
+    MSDK_CHECK_POINTER(chunk, MFX_ERR_NULL_PTR);
+
+    mfxStatus sts = LockFrames();
+    MSDK_CHECK_RESULT(sts, MFX_ERR_NONE, sts);
+
+    mfxU32 in_pitch, out_pitch, h, w, out_h, start, end;
+
+    in_pitch = m_pIn->Data.Pitch;
+    out_pitch = m_pOut->Data.Pitch;
+    h = m_pIn->Info.CropH;
+    w = m_pIn->Info.CropW;
+    out_h = m_pOut->Info.CropH;
+
+    const mfxFrameInfo &in_info = m_pIn->Info;
+    const mfxFrameInfo &out_info = m_pOut->Info;
+
+    start = chunk->StartLine;
+    end = chunk->EndLine + 1;
 
     switch (m_pIn->Info.FourCC)
     {
     case MFX_FOURCC_NV12:
-          for (i = chunk->StartLine; i <= chunk->EndLine; i++)
-          {
-              // rotate Y plane
-              cur_line = out_luma + (h-1-i) * out_pitch;
-
-              // i-th line images into h-1-i-th line, w bytes in line
-              MSDK_MEMCPY_BUF(cur_line, 0, w,  in_luma + i * in_pitch, w);
-
-              // mirror line's elements with respect to the middle element, element=Yj
-              for (j = 0; j < w / 2; j++)
-              {
-                  SWAP_BYTES(cur_line[j], cur_line[w-1-j]);
-              }
-
-              // rotate VU plane, contains h/2 lines
-              cur_line = out_chroma + (h/2-1-i/2) * out_pitch;
-
-              // i-th line images into h-1-i-th line, w bytes in line
-              MSDK_MEMCPY_BUF(cur_line, 0, w, in_chroma + i/2 * in_pitch, w);
-
-              // mirror line's elements with respect to the middle element, element=VjUj
-              for (j = 0; j < w/2 - 1; j = j + 2)
-              {
-                  SWAP_BYTES(cur_line[j], cur_line[w-1-j-1]); // 0 -> -1
-                  SWAP_BYTES(cur_line[j+1], cur_line[w-1-j]); // 1 -> -0
-              }
-          }
-          break;
+    case MFX_FOURCC_P010:
+    {
+        // luma sample has 1 or 2 bytes, UV pair has twice more
+        mfxU32 elem_size = (MFX_FOURCC_P010 == in_info.FourCC) ? 2 : 1;
+
+        ProcessPlane(m_pIn->Data.Y + in_info.CropY * in_pitch + in_info.CropX * elem_size, in_pitch, w, h,
+                     m_pOut->Data.Y + out_info.CropY * out_pitch + out_info.CropX * elem_size, out_pitch,
+                     elem_size, start, end);
+
+        // chroma line belongs to the chunk with the first of two corresponding luma lines
+        ProcessPlane(m_pIn->Data.UV + in_info.CropY / 2 * in_pitch + in_info.CropX * elem_size, in_pitch, w / 2, h / 2,
+                     m_pOut->Data.UV + out_info.CropY / 2 * out_pitch + out_info.CropX * elem_size, out_pitch,
+                     2 * elem_size, (start + 1) / 2, MSDK_MIN((end + 1) / 2, out_h / 2));
+        break;
+    }
+    case MFX_FOURCC_RGB4:
+    {
+        const mfxU8 *in_ptr = MSDK_MIN(MSDK_MIN(m_pIn->Data.R, m_pIn->Data.G), m_pIn->Data.B);
+        mfxU8 *out_ptr = MSDK_MIN(MSDK_MIN(m_pOut->Data.R, m_pOut->Data.G), m_pOut->Data.B);
+
+        ProcessPlane(in_ptr + in_info.CropY * in_pitch + in_info.CropX * 4, in_pitch, w, h,
+                     out_ptr + out_info.CropY * out_pitch + out_info.CropX * 4, out_pitch,
+                     4, start, end);
+        break;
+    }
     default:
         return MFX_ERR_UNSUPPORTED;
     }
 
-    // copy data from temporary buffer to output surface
-    sts = LockFrame(m_pOut);
-    MSDK_CHECK_RESULT(MFX_ERR_NONE, sts, MFX_ERR_NONE);
-    MSDK_MEMCPY_BUF(m_pOut->Data.Y, chunk->StartLine * out_pitch, m_YOut.size(), &m_YOut.front(), m_YOut.size());
-    MSDK_MEMCPY_BUF(m_pOut->Data.UV, chunk->StartLine * out_pitch, m_UVOut.size(), &m_UVOut.front(), m_UVOut.size());
-    sts = UnlockFrame(m_pOut);
-
-    return sts;
+    return MFX_ERR_NONE;
 }
@@ -172,6 +172,7 @@ struct sInputParams
     bool     bPartialAccel;
 
     bool     bPerf;
+    bool     bMemoryMappedInput;
     mfxU32   numFrames;
     mfxU16   numRepeat;
     bool     isOutput;
@@ -212,6 +213,7 @@ struct sInputParams
     {
         bInitEx             = false;
         bPerf               = false;
+        bMemoryMappedInput  = false;
         need_plugin         = false;
         use_extapi          = false;
         MSDK_ZERO_MEMORY(strPlgGuid);
@@ -274,7 +276,8 @@ public :
 
     mfxStatus  Init(
         const msdk_char *strFileName,
-        PTSMaker *pPTSMaker);
+        PTSMaker *pPTSMaker,
+        bool bMemoryMapped = false);
 
     mfxStatus  PreAllocateFrameChunk(
         mfxVideoParam* pVideoParam,
@@ -293,8 +296,13 @@ public :
 
 private:
     mfxStatus  GetPreAllocFrame(mfxFrameSurface1 **pSurface);
+    mfxU32     ReadData(mfxU8* pDst, mfxU32 nSize);
+    bool       MapNextFrame(mfxFrameData* pData, mfxFrameInfo* pInfo);
 
     FILE*       m_fSrc;
+    mfxU8*      m_pMappedData;   // whole input file if it is memory mapped
+    mfxU64      m_nMappedSize;
+    mfxU64      m_nMappedOffset;
     std::list<mfxFrameSurface1>::iterator m_it;
     std::list<mfxFrameSurface1>           m_SurfacesList;
     bool                                  m_isPerfMode;
@@ -332,6 +340,7 @@ private:
     PTSMaker                              *m_pPTSMaker;
     bool                                   m_outYV12;
     std::auto_ptr<mfxU8>                   m_outSurfYV12;
+    std::vector<mfxU8>                     m_ChromaBuffer; // V and U planes converted from NV12
 };
 
 
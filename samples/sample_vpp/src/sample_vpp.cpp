@@ -224,6 +224,36 @@ mfxStatus OutputProcessFrame(
 } // mfxStatus OutputProcessFrame(
 
 
+// waits while the device is busy: for the oldest VPP task not known to be complete if there is one,
+// nCompleted counts the tasks from the head of syncPoints which the previous waits saw complete
+mfxStatus WaitDeviceBusy(
+    CDeviceBusyWaiter& busyWaiter,
+    MFXVideoSession& session,
+    std::list<SurfaceVPPStore::SyncPair>& syncPoints,
+    size_t& nCompleted)
+{
+    mfxSyncPoint syncp = NULL;
+    std::list<SurfaceVPPStore::SyncPair>::iterator it = syncPoints.begin();
+    for (size_t i = 0; i < nCompleted && it != syncPoints.end(); i++)
+    {
+        ++it;
+    }
+    if (it != syncPoints.end())
+    {
+        syncp = it->first;
+    }
+
+    // the waiter retires the local copy, the list keeps the sync point for OutputProcessFrame
+    bool bPending = (NULL != syncp);
+    mfxStatus sts = busyWaiter.Wait(&session, &syncp);
+    if (MFX_ERR_NONE == sts && bPending && !syncp)
+    {
+        nCompleted++;
+    }
+    return sts;
+
+} // mfxStatus WaitDeviceBusy(...)
+
 void ownToMfxFrameInfo( sOwnFrameInfo* in, mfxFrameInfo* out, bool copyCropParams=false)
 {
     out->Width          = in->nWidth;
@@ -264,6 +294,7 @@ int main(int argc, msdk_char *argv[])
 {
     mfxStatus           sts = MFX_ERR_NONE;
     mfxU32              nFrames = 0;
+    msdk_tick           nBusyTime = 0; // time spent in waits for busy device
     mfxU16              nInStreamInd = 0;
 
     CRawVideoReader     yuvReaders[MAX_INPUT_STREAMS];
@@ -394,14 +425,14 @@ int main(int argc, msdk_char *argv[])
         {
             ownToMfxFrameInfo( &(Params.inFrameInfo[i]), &(realFrameInfoIn[i]) );
             // Set ptsMaker for the first stream only - it will store PTSes
-            sts = yuvReaders[i].Init(Params.compositionParam.streamInfo[i].streamName,i==0 ? ptsMaker.get() : NULL);
+            sts = yuvReaders[i].Init(Params.compositionParam.streamInfo[i].streamName,i==0 ? ptsMaker.get() : NULL, Params.bMemoryMappedInput);
             MSDK_CHECK_RESULT(sts, MFX_ERR_NONE, sts);
         }
     }
     else
     {
         ownToMfxFrameInfo( &(Params.frameInfoIn[0]),  &realFrameInfoIn[0]);
-        sts = yuvReaders[VPP_IN].Init(Params.strSrcFile,ptsMaker.get());
+        sts = yuvReaders[VPP_IN].Init(Params.strSrcFile,ptsMaker.get(),Params.bMemoryMappedInput);
         MSDK_CHECK_RESULT_SAFE(sts, MFX_ERR_NONE, sts, msdk_printf(MSDK_STRING("Cannot initialize file reader")));
     }
     ownToMfxFrameInfo( &(Params.frameInfoOut[0]), &realFrameInfoOut);
@@ -653,6 +684,8 @@ int main(int argc, msdk_char *argv[])
 
             if ( Params.use_extapi )
             {
+                CDeviceBusyWaiter busyWaiter(&nBusyTime);
+                size_t nCompleted = 0;
                 sts = frameProcessor.pmfxVPP->RunFrameVPPAsyncEx(
                     pInSurf[nInStreamInd],
                     pWorkSurf,
@@ -662,7 +695,8 @@ int main(int argc, msdk_char *argv[])
 
                 while(MFX_WRN_DEVICE_BUSY == sts)
                 {
-                    MSDK_SLEEP(500);
+                    sts = WaitDeviceBusy(busyWaiter, frameProcessor.mfxSession, surfStore.m_SyncPoints, nCompleted);
+                    MSDK_BREAK_ON_ERROR(sts);
                     sts = frameProcessor.pmfxVPP->RunFrameVPPAsyncEx(
                         pInSurf[nInStreamInd],
                         pWorkSurf,
@@ -775,6 +809,8 @@ int main(int argc, msdk_char *argv[])
 
             if ( Params.use_extapi )
             {
+                CDeviceBusyWaiter busyWaiter(&nBusyTime);
+                size_t nCompleted = 0;
                 sts = frameProcessor.pmfxVPP->RunFrameVPPAsyncEx(
                     NULL,
                     pWorkSurf,
@@ -782,7 +818,8 @@ int main(int argc, msdk_char *argv[])
                     &syncPoint );
                 while(MFX_WRN_DEVICE_BUSY == sts)
                 {
-                    MSDK_SLEEP(500);
+                    sts = WaitDeviceBusy(busyWaiter, frameProcessor.mfxSession, surfStore.m_SyncPoints, nCompleted);
+                    MSDK_BREAK_ON_ERROR(sts);
                     sts = frameProcessor.pmfxVPP->RunFrameVPPAsyncEx(
                         NULL,
                         pWorkSurf,
@@ -843,6 +880,10 @@ int main(int argc, msdk_char *argv[])
     msdk_printf(MSDK_STRING("Total frames %d \n"), nFrames);
     msdk_printf(MSDK_STRING("Total time %.2f sec \n"), statTimer.GetTotalTime());
     msdk_printf(MSDK_STRING("Frames per second %.3f fps \n"), nFrames / statTimer.GetTotalTime());
+    if (nBusyTime)
+    {
+        msdk_printf(MSDK_STRING("Device busy waits %.3f sec \n"), MSDK_GET_TIME(nBusyTime, 0, msdk_time_get_frequency()));
+    }
 
     PutPerformanceToFile(Params, nFrames / statTimer.GetTotalTime());
 
@@ -197,6 +197,7 @@ msdk_printf(MSDK_STRING("   [-n frames] - number of frames to VPP process\n\n"))
 msdk_printf(MSDK_STRING("   [-iopattern IN/OUT surface type] -  IN/OUT surface type: sys_to_sys, sys_to_d3d, d3d_to_sys, d3d_to_d3d    (def: sys_to_sys)\n"));
 msdk_printf(MSDK_STRING("   [-async n] - maximum number of asynchronious tasks. def: -async 1 \n"));
 msdk_printf(MSDK_STRING("   [-perf_opt n m] - n: number of prefetech frames. m : number of passes. In performance mode app preallocates bufer and load first n frames,  def: no performace 1 \n"));
+msdk_printf(MSDK_STRING("   [-mmap] - read input files through memory mapping. With -perf_opt and system memory input surfaces point directly into the file \n"));
 msdk_printf(MSDK_STRING("   [-pts_check] - checking of time stampls. Default is OFF \n"));
 msdk_printf(MSDK_STRING("   [-pts_jump ] - checking of time stamps jumps. Jump for random value since 13-th frame. Also, you can change input frame rate (via pts). Default frame_rate = sf \n"));
 msdk_printf(MSDK_STRING("   [-pts_fr ]   - input frame rate which used for pts. Default frame_rate = sf \n"));
@@ -1307,6 +1308,10 @@ mfxStatus vppParseInputString(msdk_char* strInput[], mfxU8 nArgNum, sInputParams
                 i++;
                 msdk_sscanf(strInput[i], MSDK_STRING("%hu"), &pParams->numRepeat);
             }
+            else if (0 == msdk_strcmp(strInput[i], MSDK_STRING("-mmap")) )
+            {
+                pParams->bMemoryMappedInput = true;
+            }
             else if (0 == msdk_strcmp(strInput[i], MSDK_STRING("-pts_check")) )
             {
                 pParams->ptsCheck = true;
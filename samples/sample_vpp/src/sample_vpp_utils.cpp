@@ -21,6 +21,7 @@ or https://software.intel.com/en-us/media-client-solutions-support.
 #include "mfxvideo++.h"
 #include "vm/time_defs.h"
 #include "sample_utils.h"
+#include "chroma_conversion.h"
 
 #include "sample_vpp_pts.h"
 
@@ -793,19 +794,31 @@ void WipeParams(sInputParams* pParams)
 CRawVideoReader::CRawVideoReader()
 {
     m_fSrc = 0;
+    m_pMappedData = 0;
+    m_nMappedSize = 0;
+    m_nMappedOffset = 0;
     m_isPerfMode = false;
     m_Repeat = 0;
     m_pPTSMaker = 0;
 }
 
-mfxStatus CRawVideoReader::Init(const msdk_char *strFileName, PTSMaker *pPTSMaker)
+mfxStatus CRawVideoReader::Init(const msdk_char *strFileName, PTSMaker *pPTSMaker, bool bMemoryMapped)
 {
     Close();
 
     MSDK_CHECK_POINTER(strFileName, MFX_ERR_NULL_PTR);
 
-    MSDK_FOPEN(m_fSrc,strFileName, MSDK_STRING("rb"));
-    MSDK_CHECK_POINTER(m_fSrc, MFX_ERR_ABORTED);
+    if (bMemoryMapped)
+    {
+        m_pMappedData = msdk_file_map(strFileName, &m_nMappedSize);
+        MSDK_CHECK_POINTER(m_pMappedData, MFX_ERR_ABORTED);
+        m_nMappedOffset = 0;
+    }
+    else
+    {
+        MSDK_FOPEN(m_fSrc,strFileName, MSDK_STRING("rb"));
+        MSDK_CHECK_POINTER(m_fSrc, MFX_ERR_ABORTED);
+    }
 
     m_pPTSMaker = pPTSMaker;
 
@@ -824,8 +837,96 @@ void CRawVideoReader::Close()
         fclose(m_fSrc);
         m_fSrc = 0;
     }
+    // surfaces may point into the mapping, so drop them first
     m_SurfacesList.clear();
+    if (m_pMappedData)
+    {
+        msdk_file_unmap(m_pMappedData, m_nMappedSize);
+        m_pMappedData = 0;
+        m_nMappedSize = m_nMappedOffset = 0;
+    }
+
+}
+
+mfxU32 CRawVideoReader::ReadData(mfxU8* pDst, mfxU32 nSize)
+{
+    if (!m_pMappedData)
+        return (mfxU32)fread(pDst, 1, nSize, m_fSrc);
+
+    nSize = (mfxU32)MSDK_MIN((mfxU64)nSize, m_nMappedSize - m_nMappedOffset);
+    MSDK_MEMCPY(pDst, m_pMappedData + m_nMappedOffset, nSize);
+    m_nMappedOffset += nSize;
+
+    return nSize;
+}
+
+bool CRawVideoReader::MapNextFrame(mfxFrameData* pData, mfxFrameInfo* pInfo)
+{
+    mfxU32 w = pInfo->Width, h = pInfo->Height;
+    mfxU32 pitch, nFrameSize;
+
+    // the frame in the file must match the surface exactly, without cropping
+    if (!m_pMappedData || pInfo->CropX || pInfo->CropY ||
+        (pInfo->CropW && pInfo->CropW != w) || (pInfo->CropH && pInfo->CropH != h))
+        return false;
+
+    switch (pInfo->FourCC)
+    {
+    case MFX_FOURCC_NV12:
+    case MFX_FOURCC_YV12:
+        pitch = w;
+        nFrameSize = w * h + 2 * (w / 2) * (h / 2);
+        break;
+    case MFX_FOURCC_P010:
+        pitch = 2 * w;
+        nFrameSize = 2 * w * h + w * h;
+        break;
+    case MFX_FOURCC_YUY2:
+        pitch = 2 * w;
+        nFrameSize = 2 * w * h;
+        break;
+    case MFX_FOURCC_RGB4:
+        pitch = 4 * w;
+        nFrameSize = 4 * w * h;
+        break;
+    default:
+        return false;
+    }
+
+    if (pitch > 0xFFFF || m_nMappedOffset + nFrameSize > m_nMappedSize)
+        return false;
 
+    mfxU8* pFrame = m_pMappedData + m_nMappedOffset;
+    m_nMappedOffset += nFrameSize;
+
+    pData->Pitch = (mfxU16)pitch;
+    switch (pInfo->FourCC)
+    {
+    case MFX_FOURCC_NV12:
+    case MFX_FOURCC_P010:
+        pData->Y = pFrame;
+        pData->U = pData->Y + pitch * h;
+        pData->V = pData->U + (MFX_FOURCC_P010 == pInfo->FourCC ? 2 : 1);
+        break;
+    case MFX_FOURCC_YV12:
+        pData->Y = pFrame;
+        pData->V = pData->Y + w * h;
+        pData->U = pData->V + (w / 2) * (h / 2);
+        break;
+    case MFX_FOURCC_YUY2:
+        pData->Y = pFrame;
+        pData->U = pData->Y + 1;
+        pData->V = pData->Y + 3;
+        break;
+    case MFX_FOURCC_RGB4:
+        pData->B = pFrame;
+        pData->G = pData->B + 1;
+        pData->R = pData->B + 2;
+        pData->A = pData->B + 3;
+        break;
+    }
+
+    return true;
 }
 
 mfxStatus CRawVideoReader::LoadNextFrame(mfxFrameData* pData, mfxFrameInfo* pInfo)
@@ -857,7 +958,7 @@ mfxStatus CRawVideoReader::LoadNextFrame(mfxFrameData* pData, mfxFrameInfo* pInf
         // read luminance plane
         for(i = 0; i < h; i++)
         {
-            nBytesRead = (mfxU32)fread(ptr + i * pitch, 1, w, m_fSrc);
+            nBytesRead = ReadData(ptr + i * pitch, w);
             IOSTREAM_MSDK_CHECK_NOT_EQUAL(nBytesRead, w, MFX_ERR_MORE_DATA);
         }
 
@@ -868,14 +969,14 @@ mfxStatus CRawVideoReader::LoadNextFrame(mfxFrameData* pData, mfxFrameInfo* pInf
         ptr  = pData->V + (pInfo->CropX >> 1) + (pInfo->CropY >> 1) * pitch;
         for(i = 0; i < h; i++)
         {
-            nBytesRead = (mfxU32)fread(ptr + i * pitch, 1, w, m_fSrc);
+            nBytesRead = ReadData(ptr + i * pitch, w);
             IOSTREAM_MSDK_CHECK_NOT_EQUAL(nBytesRead, w, MFX_ERR_MORE_DATA);
         }
         // load U
         ptr  = pData->U + (pInfo->CropX >> 1) + (pInfo->CropY >> 1) * pitch;
         for(i = 0; i < h; i++)
         {
-            nBytesRead = (mfxU32)fread(ptr + i * pitch, 1, w, m_fSrc);
+            nBytesRead = ReadData(ptr + i * pitch, w);
             IOSTREAM_MSDK_CHECK_NOT_EQUAL(nBytesRead, w, MFX_ERR_MORE_DATA);
         }
     }
@@ -886,7 +987,7 @@ mfxStatus CRawVideoReader::LoadNextFrame(mfxFrameData* pData, mfxFrameInfo* pInf
         // read luminance plane
         for(i = 0; i < h; i++)
         {
-            nBytesRead = (mfxU32)fread(ptr + i * pitch, 1, w, m_fSrc);
+            nBytesRead = ReadData(ptr + i * pitch, w);
             IOSTREAM_MSDK_CHECK_NOT_EQUAL(nBytesRead, w, MFX_ERR_MORE_DATA);
         }
     }
@@ -897,7 +998,7 @@ mfxStatus CRawVideoReader::LoadNextFrame(mfxFrameData* pData, mfxFrameInfo* pInf
         // read luminance plane
         for(i = 0; i < h; i++)
         {
-            nBytesRead = (mfxU32)fread(ptr + i * pitch, 1, w, m_fSrc);
+            nBytesRead = ReadData(ptr + i * pitch, w);
             IOSTREAM_MSDK_CHECK_NOT_EQUAL(nBytesRead, w, MFX_ERR_MORE_DATA);
         }
 
@@ -907,14 +1008,14 @@ mfxStatus CRawVideoReader::LoadNextFrame(mfxFrameData* pData, mfxFrameInfo* pInf
         ptr  = pData->V + (pInfo->CropX >> 1) + (pInfo->CropY >> 1) * pitch;
         for(i = 0; i < h; i++)
         {
-            nBytesRead = (mfxU32)fread(ptr + i * pitch, 1, w, m_fSrc);
+            nBytesRead = ReadData(ptr + i * pitch, w);
             IOSTREAM_MSDK_CHECK_NOT_EQUAL(nBytesRead, w, MFX_ERR_MORE_DATA);
         }
         // load U
         ptr  = pData->U + (pInfo->CropX >> 1) + (pInfo->CropY >> 1) * pitch;
         for(i = 0; i < h; i++)
         {
-            nBytesRead = (mfxU32)fread(ptr + i * pitch, 1, w, m_fSrc);
+            nBytesRead = ReadData(ptr + i * pitch, w);
             IOSTREAM_MSDK_CHECK_NOT_EQUAL(nBytesRead, w, MFX_ERR_MORE_DATA);
         }
     }
@@ -925,7 +1026,7 @@ mfxStatus CRawVideoReader::LoadNextFrame(mfxFrameData* pData, mfxFrameInfo* pInf
         // read luminance plane
         for(i = 0; i < h; i++)
         {
-            nBytesRead = (mfxU32)fread(ptr + i * pitch, 1, w, m_fSrc);
+            nBytesRead = ReadData(ptr + i * pitch, w);
             IOSTREAM_MSDK_CHECK_NOT_EQUAL(nBytesRead, w, MFX_ERR_MORE_DATA);
         }
 
@@ -935,14 +1036,14 @@ mfxStatus CRawVideoReader::LoadNextFrame(mfxFrameData* pData, mfxFrameInfo* pInf
         ptr  = pData->V + (pInfo->CropX >> 1) + (pInfo->CropY >> 1) * pitch;
         for(i = 0; i < h; i++)
         {
-            nBytesRead = (mfxU32)fread(ptr + i * pitch, 1, w, m_fSrc);
+            nBytesRead = ReadData(ptr + i * pitch, w);
             IOSTREAM_MSDK_CHECK_NOT_EQUAL(nBytesRead, w, MFX_ERR_MORE_DATA);
         }
         // load U
         ptr  = pData->U + (pInfo->CropX >> 1) + (pInfo->CropY >> 1) * pitch;
         for(i = 0; i < h; i++)
         {
-            nBytesRead = (mfxU32)fread(ptr + i * pitch, 1, w, m_fSrc);
+            nBytesRead = ReadData(ptr + i * pitch, w);
             IOSTREAM_MSDK_CHECK_NOT_EQUAL(nBytesRead, w, MFX_ERR_MORE_DATA);
         }
     }
@@ -953,7 +1054,7 @@ mfxStatus CRawVideoReader::LoadNextFrame(mfxFrameData* pData, mfxFrameInfo* pInf
         // read luminance plane
         for(i = 0; i < h; i++)
         {
-            nBytesRead = (mfxU32)fread(ptr + i * pitch, 1, w, m_fSrc);
+            nBytesRead = ReadData(ptr + i * pitch, w);
             IOSTREAM_MSDK_CHECK_NOT_EQUAL(nBytesRead, w, MFX_ERR_MORE_DATA);
         }
 
@@ -963,14 +1064,14 @@ mfxStatus CRawVideoReader::LoadNextFrame(mfxFrameData* pData, mfxFrameInfo* pInf
         ptr  = pData->V + (pInfo->CropX >> 1) + (pInfo->CropY >> 1) * pitch;
         for(i = 0; i < h; i++)
         {
-            nBytesRead = (mfxU32)fread(ptr + i * pitch, 1, w, m_fSrc);
+            nBytesRead = ReadData(ptr + i * pitch, w);
             IOSTREAM_MSDK_CHECK_NOT_EQUAL(nBytesRead, w, MFX_ERR_MORE_DATA);
         }
         // load U
         ptr  = pData->U + (pInfo->CropX >> 1) + (pInfo->CropY >> 1) * pitch;
         for(i = 0; i < h; i++)
         {
-            nBytesRead = (mfxU32)fread(ptr + i * pitch, 1, w, m_fSrc);
+            nBytesRead = ReadData(ptr + i * pitch, w);
             IOSTREAM_MSDK_CHECK_NOT_EQUAL(nBytesRead, w, MFX_ERR_MORE_DATA);
         }
     }
@@ -981,7 +1082,7 @@ mfxStatus CRawVideoReader::LoadNextFrame(mfxFrameData* pData, mfxFrameInfo* pInf
         // read luminance plane
         for(i = 0; i < h; i++)
         {
-            nBytesRead = (mfxU32)fread(ptr + i * pitch, 1, w, m_fSrc);
+            nBytesRead = ReadData(ptr + i * pitch, w);
             IOSTREAM_MSDK_CHECK_NOT_EQUAL(nBytesRead, w, MFX_ERR_MORE_DATA);
         }
 
@@ -989,14 +1090,14 @@ mfxStatus CRawVideoReader::LoadNextFrame(mfxFrameData* pData, mfxFrameInfo* pInf
         ptr  = pData->V + (pInfo->CropX >> 1) + (pInfo->CropY >> 1) * pitch;
         for(i = 0; i < h; i++)
         {
-            nBytesRead = (mfxU32)fread(ptr + i * pitch, 1, w, m_fSrc);
+            nBytesRead = ReadData(ptr + i * pitch, w);
             IOSTREAM_MSDK_CHECK_NOT_EQUAL(nBytesRead, w, MFX_ERR_MORE_DATA);
         }
         // load U
         ptr  = pData->U + (pInfo->CropX >> 1) + (pInfo->CropY >> 1) * pitch;
         for(i = 0; i < h; i++)
         {
-            nBytesRead = (mfxU32)fread(ptr + i * pitch, 1, w, m_fSrc);
+            nBytesRead = ReadData(ptr + i * pitch, w);
             IOSTREAM_MSDK_CHECK_NOT_EQUAL(nBytesRead, w, MFX_ERR_MORE_DATA);
         }
     }
@@ -1007,7 +1108,7 @@ mfxStatus CRawVideoReader::LoadNextFrame(mfxFrameData* pData, mfxFrameInfo* pInf
         // read luminance plane
         for(i = 0; i < h; i++)
         {
-            nBytesRead = (mfxU32)fread(ptr + i * pitch, 1, w, m_fSrc);
+            nBytesRead = ReadData(ptr + i * pitch, w);
             IOSTREAM_MSDK_CHECK_NOT_EQUAL(nBytesRead, w, MFX_ERR_MORE_DATA);
         }
 
@@ -1016,7 +1117,7 @@ mfxStatus CRawVideoReader::LoadNextFrame(mfxFrameData* pData, mfxFrameInfo* pInf
         ptr = pData->UV + pInfo->CropX + (pInfo->CropY >> 1) * pitch;
         for (i = 0; i < h; i++)
         {
-            nBytesRead = (mfxU32)fread(ptr + i * pitch, 1, w, m_fSrc);
+            nBytesRead = ReadData(ptr + i * pitch, w);
             IOSTREAM_MSDK_CHECK_NOT_EQUAL(nBytesRead, w, MFX_ERR_MORE_DATA);
         }
     }
@@ -1027,7 +1128,7 @@ mfxStatus CRawVideoReader::LoadNextFrame(mfxFrameData* pData, mfxFrameInfo* pInf
         // read luminance plane
         for(i = 0; i < h; i++)
         {
-            nBytesRead = (mfxU32)fread(ptr + i * pitch, 1, w, m_fSrc);
+            nBytesRead = ReadData(ptr + i * pitch, w);
             IOSTREAM_MSDK_CHECK_NOT_EQUAL(nBytesRead, w, MFX_ERR_MORE_DATA);
         }
 
@@ -1035,7 +1136,7 @@ mfxStatus CRawVideoReader::LoadNextFrame(mfxFrameData* pData, mfxFrameInfo* pInf
         ptr = pData->UV + pInfo->CropX + (pInfo->CropY >> 1) * pitch;
         for (i = 0; i < h; i++)
         {
-            nBytesRead = (mfxU32)fread(ptr + i * pitch, 1, w, m_fSrc);
+            nBytesRead = ReadData(ptr + i * pitch, w);
             IOSTREAM_MSDK_CHECK_NOT_EQUAL(nBytesRead, w, MFX_ERR_MORE_DATA);
         }
     }
@@ -1046,7 +1147,7 @@ mfxStatus CRawVideoReader::LoadNextFrame(mfxFrameData* pData, mfxFrameInfo* pInf
         // read luminance plane
         for(i = 0; i < h; i++)
         {
-            nBytesRead = (mfxU32)fread(ptr + i * pitch, 1, w * 2, m_fSrc);
+            nBytesRead = ReadData(ptr + i * pitch, w * 2);
             IOSTREAM_MSDK_CHECK_NOT_EQUAL(nBytesRead, w*2, MFX_ERR_MORE_DATA);
         }
 
@@ -1055,7 +1156,7 @@ mfxStatus CRawVideoReader::LoadNextFrame(mfxFrameData* pData, mfxFrameInfo* pInf
         ptr = pData->UV + pInfo->CropX + (pInfo->CropY >> 1) * pitch;
         for (i = 0; i < h; i++)
         {
-            nBytesRead = (mfxU32)fread(ptr + i * pitch, 1, w*2, m_fSrc);
+            nBytesRead = ReadData(ptr + i * pitch, w*2);
             IOSTREAM_MSDK_CHECK_NOT_EQUAL(nBytesRead, w*2, MFX_ERR_MORE_DATA);
         }
     }
@@ -1066,7 +1167,7 @@ mfxStatus CRawVideoReader::LoadNextFrame(mfxFrameData* pData, mfxFrameInfo* pInf
         // read luminance plane
         for(i = 0; i < h; i++)
         {
-            nBytesRead = (mfxU32)fread(ptr + i * pitch, 1, w * 2, m_fSrc);
+            nBytesRead = ReadData(ptr + i * pitch, w * 2);
             IOSTREAM_MSDK_CHECK_NOT_EQUAL(nBytesRead, w*2, MFX_ERR_MORE_DATA);
         }
 
@@ -1074,7 +1175,7 @@ mfxStatus CRawVideoReader::LoadNextFrame(mfxFrameData* pData, mfxFrameInfo* pInf
         ptr = pData->UV + pInfo->CropX + (pInfo->CropY >> 1) * pitch;
         for (i = 0; i < h; i++)
         {
-            nBytesRead = (mfxU32)fread(ptr + i * pitch, 1, w*2, m_fSrc);
+            nBytesRead = ReadData(ptr + i * pitch, w*2);
             IOSTREAM_MSDK_CHECK_NOT_EQUAL(nBytesRead, w*2, MFX_ERR_MORE_DATA);
         }
     }
@@ -1089,7 +1190,7 @@ mfxStatus CRawVideoReader::LoadNextFrame(mfxFrameData* pData, mfxFrameInfo* pInf
 
         for(i = 0; i < h; i++)
         {
-            nBytesRead = (mfxU32)fread(ptr + i * pitch, 1, 3*w, m_fSrc);
+            nBytesRead = ReadData(ptr + i * pitch, 3*w);
             IOSTREAM_MSDK_CHECK_NOT_EQUAL(nBytesRead, 3*w, MFX_ERR_MORE_DATA);
         }
     }
@@ -1106,7 +1207,7 @@ mfxStatus CRawVideoReader::LoadNextFrame(mfxFrameData* pData, mfxFrameInfo* pInf
 
         for(i = 0; i < h; i++)
         {
-            nBytesRead = (mfxU32)fread(ptr + i * pitch, 1, 4*w, m_fSrc);
+            nBytesRead = ReadData(ptr + i * pitch, 4*w);
             IOSTREAM_MSDK_CHECK_NOT_EQUAL(nBytesRead, 4*w, MFX_ERR_MORE_DATA);
         }
     }
@@ -1116,7 +1217,7 @@ mfxStatus CRawVideoReader::LoadNextFrame(mfxFrameData* pData, mfxFrameInfo* pInf
 
         for(i = 0; i < h; i++)
         {
-            nBytesRead = (mfxU32)fread(ptr + i * pitch, 1, 2*w, m_fSrc);
+            nBytesRead = ReadData(ptr + i * pitch, 2*w);
             IOSTREAM_MSDK_CHECK_NOT_EQUAL(nBytesRead, 2*w, MFX_ERR_MORE_DATA);
         }
     }
@@ -1126,7 +1227,7 @@ mfxStatus CRawVideoReader::LoadNextFrame(mfxFrameData* pData, mfxFrameInfo* pInf
 
         for(i = 0; i < h; i++)
         {
-            nBytesRead = (mfxU32)fread(ptr + i * pitch, 1, 2*w, m_fSrc);
+            nBytesRead = ReadData(ptr + i * pitch, 2*w);
             IOSTREAM_MSDK_CHECK_NOT_EQUAL(nBytesRead, 2*w, MFX_ERR_MORE_DATA);
         }
     }
@@ -1137,7 +1238,7 @@ mfxStatus CRawVideoReader::LoadNextFrame(mfxFrameData* pData, mfxFrameInfo* pInf
         // read luminance plane
         for(i = 0; i < h; i++)
         {
-            nBytesRead = (mfxU32)fread(ptr + i * pitch, 1, w, m_fSrc);
+            nBytesRead = ReadData(ptr + i * pitch, w);
             IOSTREAM_MSDK_CHECK_NOT_EQUAL(nBytesRead, w, MFX_ERR_MORE_DATA);
         }
 
@@ -1147,14 +1248,14 @@ mfxStatus CRawVideoReader::LoadNextFrame(mfxFrameData* pData, mfxFrameInfo* pInf
         ptr  = pData->U + (pInfo->CropX >> 1) + (pInfo->CropY >> 1) * pitch;
         for(i = 0; i < h; i++)
         {
-            nBytesRead = (mfxU32)fread(ptr + i * pitch, 1, w, m_fSrc);
+            nBytesRead = ReadData(ptr + i * pitch, w);
             IOSTREAM_MSDK_CHECK_NOT_EQUAL(nBytesRead, w, MFX_ERR_MORE_DATA);
         }
         // load U
         ptr  = pData->V + (pInfo->CropX >> 1) + (pInfo->CropY >> 1) * pitch;
         for(i = 0; i < h; i++)
         {
-            nBytesRead = (mfxU32)fread(ptr + i * pitch, 1, w, m_fSrc);
+            nBytesRead = ReadData(ptr + i * pitch, w);
             IOSTREAM_MSDK_CHECK_NOT_EQUAL(nBytesRead, w, MFX_ERR_MORE_DATA);
         }
     }
@@ -1239,6 +1340,29 @@ mfxStatus  CRawVideoReader::PreAllocateFrameChunk(mfxVideoParam* pVideoParam,
     mfxFrameSurface1      surface;
     m_isPerfMode = true;
     m_Repeat = pParams->numRepeat;
+
+    // system memory surfaces can point directly into the mapped file, no need to allocate and fill them
+    if (m_pMappedData && !(pParams->IOPattern & MFX_IOPATTERN_IN_VIDEO_MEMORY))
+    {
+        for(;m_SurfacesList.size() < pParams->numFrames;)
+        {
+            MSDK_ZERO_MEMORY(surface);
+            surface.Info = pVideoParam->vpp.In;
+            if (!MapNextFrame(&surface.Data, &surface.Info))
+                break;
+            m_SurfacesList.push_back(surface);
+        }
+
+        if (m_SurfacesList.size() == pParams->numFrames)
+        {
+            m_it = m_SurfacesList.begin();
+            return MFX_ERR_NONE;
+        }
+
+        // layout differs from the file, fall back to copying
+        m_SurfacesList.clear();
+        m_nMappedOffset = 0;
+    }
     request.Info = pVideoParam->vpp.In;
     request.Type = (pParams->IOPattern & MFX_IOPATTERN_IN_VIDEO_MEMORY)?(MFX_MEMTYPE_FROM_VPPIN|MFX_MEMTYPE_INTERNAL_FRAME|MFX_MEMTYPE_DXVA2_PROCESSOR_TARGET):
         (MFX_MEMTYPE_FROM_VPPIN|MFX_MEMTYPE_INTERNAL_FRAME|MFX_MEMTYPE_SYSTEM_MEMORY);
@@ -1545,7 +1669,6 @@ mfxStatus CRawVideoWriter::WriteFrame(
     }
     else if( pInfo->FourCC == MFX_FOURCC_NV12 && m_outYV12 )
     {
-        int j=0;
         ptr   = pData->Y + (pInfo->CropX ) + (pInfo->CropY ) * pitch;
 
         for (i = 0; i < h; i++)
@@ -1558,19 +1681,15 @@ mfxStatus CRawVideoWriter::WriteFrame(
         w >>= 1;
         ptr  = pData->UV + (pInfo->CropX ) + (pInfo->CropY >> 1) * pitch;
 
-        for(i = 0; i < h; i++)
+        mfxU32 planeSize = (mfxU32)w * h;
+        m_ChromaBuffer.resize(2 * planeSize);
+        if (planeSize)
         {
-            for(j = 0; j < w; j++)
-            {
-                fputc(ptr[i*pitch + j*2 + 1],  m_fDst);
-            }
-        }
-        for(i = 0; i < h; i++)
-        {
-            for(j = 0; j < w; j++)
-            {
-                fputc(ptr[i*pitch + j*2],  m_fDst);
-            }
+            mfxU8* pV = &m_ChromaBuffer[0];
+            mfxU8* pU = pV + planeSize;
+            ConvertNV12ToPlanar(ptr, pitch, pU, w, pV, w, w, h);
+
+            MSDK_CHECK_NOT_EQUAL( fwrite(pV, 1, 2 * planeSize, m_fDst), 2 * planeSize, MFX_ERR_UNDEFINED_BEHAVIOR);
         }
     }
     else if( pInfo->FourCC == MFX_FOURCC_NV16 )